@@ -118,6 +118,28 @@ pub fn build(b: *std.Build) void {
         run_cmd.addArgs(args);
     }
 
+    // `zig build bench` runs every display mode against the software panel in
+    // `src/panel_emulator.zig` and reports tick-to-glass latency, bytes on the
+    // wire and frame rate for each. A separate executable rather than a flag
+    // on the main one, so the service binary carries none of it. Always built
+    // optimized: a Debug build's timings describe the safety checks, not the
+    // code being measured. Arguments after `--` are passed through, e.g.
+    // `zig build bench -- --seconds=60 --emulate-latency=25`.
+    const bench_exe = b.addExecutable(.{
+        .name = "zig_vorne_m1000_bench",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("src/bench.zig"),
+            .target = target,
+            .optimize = .ReleaseSafe,
+        }),
+    });
+    const run_bench = b.addRunArtifact(bench_exe);
+    if (b.args) |args| {
+        run_bench.addArgs(args);
+    }
+    const bench_step = b.step("bench", "Measure each display mode against the panel emulator");
+    bench_step.dependOn(&run_bench.step);
+
     // Creates an executable that will run `test` blocks from the provided module.
     // Here `mod` needs to define a target, which is why earlier we made sure to
     // set the releative field.
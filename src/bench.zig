@@ -0,0 +1,217 @@
+//! `zig build bench`: every display mode, run against the panel emulator,
+//! with tick-to-glass latency and wire usage reported per mode.
+//!
+//! Each mode is run exactly as `main` runs it -- same loop, same sender, same
+//! `protocol.send` pacing -- except that the port is the emulator's pty and
+//! `latency_probe` is installed. Nothing about a mode is stubbed out for the
+//! benchmark's sake; if it were, the numbers would describe the stub.
+//!
+//! Without a Blu-ray player or VLC server on the network, those two modes
+//! still exercise their whole display path: Blu-ray mode's line 1 carries the
+//! time of day, and VLC mode redraws both lines at its frame rate regardless.
+//! Playback-driven content (a running play clock, cues) needs the real source
+//! to be reachable, and is measured when it is.
+//!
+//! Options: `--seconds=<n>` per mode (default 20), `--window-frames=<n>` and
+//! `--window-bytes=<n>` for the transport's window (default stop-and-wait, as
+//! `vorne_config.jsonc` would set them), plus every `--emulate-<knob>=<value>`
+//! that `main` accepts. For example:
+//!
+//!     zig build bench -- --seconds=60 --emulate-latency=25 --emulate-jitter=10
+//!     zig build bench -- --window-frames=3 --window-bytes=128
+//!
+//! After the latency table comes how late each thread woke for its deadlines
+//! (`realtime.zig`), under the `"realtime"` settings in `vorne_config.jsonc`
+//! if there are any -- run it with and without to see what they buy.
+
+const std = @import("std");
+const Io = std.Io;
+const protocol = @import("protocol.zig");
+const serial = @import("serial.zig");
+const time = @import("time.zig");
+const clocks = @import("clocks.zig");
+const bluray = @import("bluray.zig");
+const vlc = @import("vlc.zig");
+const cues = @import("cues.zig");
+const dbg = @import("debug_log.zig");
+const vorne_config = @import("vorne_config.zig");
+const panel_emulator = @import("panel_emulator.zig");
+const transport = @import("transport.zig");
+const latency_probe = @import("latency_probe.zig");
+const realtime = @import("realtime.zig");
+const Mode = @import("mode.zig").Mode;
+
+pub const std_options: std.Options = .{
+    .logFn = dbg.logFn,
+    .log_level = .info,
+};
+
+const default_seconds = 20;
+
+pub fn main(init: std.process.Init) !void {
+    const allocator = std.heap.page_allocator;
+    const io = init.io;
+
+    vorne_config.load(io, allocator);
+    realtime.configure(vorne_config.realtimeOptions());
+    cues.configureDirPath(io);
+
+    var seconds: u32 = default_seconds;
+    var emulator_options: panel_emulator.Options = .{};
+    var transport_options: transport.Options = .{};
+    var args = init.minimal.args.iterate();
+    _ = args.skip(); // argv[0]
+    while (args.next()) |arg| {
+        if (std.mem.startsWith(u8, arg, "--seconds=")) {
+            seconds = std.fmt.parseInt(u32, arg["--seconds=".len..], 10) catch {
+                std.log.err("Bad {s}\n", .{arg});
+                return error.InvalidArgument;
+            };
+        } else if (std.mem.startsWith(u8, arg, "--window-frames=")) {
+            transport_options.window_frames = std.fmt.parseInt(u8, arg["--window-frames=".len..], 10) catch 0;
+            if (transport_options.window_frames == 0 or transport_options.window_frames > transport.max_in_flight) {
+                std.log.err("Bad {s}: 1 to {d}\n", .{ arg, transport.max_in_flight });
+                return error.InvalidArgument;
+            }
+        } else if (std.mem.startsWith(u8, arg, "--window-bytes=")) {
+            transport_options.window_bytes = std.fmt.parseInt(u16, arg["--window-bytes=".len..], 10) catch {
+                std.log.err("Bad {s}\n", .{arg});
+                return error.InvalidArgument;
+            };
+        } else if (std.mem.startsWith(u8, arg, "--emulate-")) {
+            try panel_emulator.parseArg(arg, &emulator_options);
+        } else {
+            std.log.err("Unrecognized option {s}\n", .{arg});
+            return error.InvalidArgument;
+        }
+    }
+
+    var results: [3]Result = undefined;
+    for (std.enums.values(Mode), &results) |m, *result| {
+        result.* = try runOne(io, allocator, m, seconds, emulator_options, transport_options);
+    }
+
+    std.debug.print(
+        "\n{d} s per mode, window {d} frames/{d} bytes, reply latency {d}+/-{d} ms, drop {d:.1}%, panel buffer {d} bytes, {d} baud\n\n",
+        .{
+            seconds,
+            transport_options.window_frames,
+            transport_options.window_bytes,
+            emulator_options.reply_latency_ms,
+            emulator_options.reply_jitter_ms,
+            emulator_options.drop_rate * 100,
+            emulator_options.input_buffer_bytes,
+            emulator_options.baud,
+        },
+    );
+    std.debug.print("{s:<8} {s:>8} {s:>9} {s:>9} {s:>9} {s:>9} {s:>7} {s:>10} {s:>10}\n", .{
+        "mode", "changes", "p50 ms", "p99 ms", "max ms", "bytes/s", "fps", "skipped", "overflowed",
+    });
+    for (results) |r| {
+        const s = r.summary;
+        std.debug.print("{s:<8} {d:>8} {d:>9.1} {d:>9.1} {d:>9.1} {d:>9.0} {d:>7.2} {d:>10} {d:>10}\n", .{
+            @tagName(r.mode),
+            s.samples,
+            millis(s.p50_us),
+            millis(s.p99_us),
+            millis(s.max_us),
+            s.bytes_per_s,
+            s.frames_per_s,
+            s.superseded,
+            r.overflowed,
+        });
+    }
+
+    std.debug.print("\n{s:<24} {s:<8} {s:>8} {s:>9} {s:>9} {s:>10} {s:>10}\n", .{
+        "wakes", "thread", "count", "<=1 ms %", "<=2 ms %", "p99 us", "max us",
+    });
+    for (realtime.all()) |*h| {
+        const s = h.summary();
+        if (s.wakes == 0) continue;
+        const wakes: f64 = @floatFromInt(s.wakes);
+        std.debug.print("{s:<24} {s:<8} {d:>8} {d:>9.2} {d:>9.2} {?d:>10} {d:>10}\n", .{
+            h.device(),
+            @tagName(h.role),
+            s.wakes,
+            @as(f64, @floatFromInt(s.within(1_000))) * 100 / wakes,
+            @as(f64, @floatFromInt(s.within(2_000))) * 100 / wakes,
+            s.percentileUs(99),
+            s.max_us,
+        });
+    }
+}
+
+const Result = struct {
+    mode: Mode,
+    summary: latency_probe.Summary,
+    /// Frames the emulated panel lost to a full input buffer: a window set
+    /// wider than `--emulate-buffer` allows.
+    overflowed: u64,
+};
+
+fn millis(us: i64) f64 {
+    return @as(f64, @floatFromInt(us)) / std.time.us_per_ms;
+}
+
+fn nowMicros(io: Io) i64 {
+    return @intCast(@divFloor(time.nowNanos(io), std.time.ns_per_us));
+}
+
+fn runOne(
+    io: Io,
+    allocator: std.mem.Allocator,
+    m: Mode,
+    seconds: u32,
+    emulator_options: panel_emulator.Options,
+    transport_options: transport.Options,
+) !Result {
+    std.log.info("bench: {s} for {d} s\n", .{ @tagName(m), seconds });
+
+    var emulator = try panel_emulator.Emulator.open(io, emulator_options);
+    try emulator.start();
+    defer emulator.close();
+
+    const port = try serial.SerialPort.open(io, emulator.slavePath(), allocator);
+    defer port.close(allocator);
+    port.transport.options = transport_options;
+
+    // The same entry sequence `main` performs on every mode switch, before the
+    // probe is installed so the init frame is not counted.
+    try protocol.sendUnitDefaultInitCmd(port, 1);
+
+    const recorder = try allocator.create(latency_probe.Recorder);
+    defer allocator.destroy(recorder);
+    recorder.* = .init(emulator_options.baud, nowMicros(io));
+    latency_probe.install(recorder);
+    defer latency_probe.install(null);
+
+    var mode = std.atomic.Value(Mode).init(m);
+    // Ends the run the way the web page ends a mode: by switching away from
+    // it, which every mode loop already checks for on each pass.
+    const stopper = try std.Thread.spawn(.{}, stopAfter, .{ io, &mode, seconds });
+    defer stopper.join();
+
+    switch (m) {
+        .Clocks => try clocks.runClocks(io, allocator, port, &mode, null),
+        .Bluray => {
+            var cue_state: cues.State = .{};
+            var sources: bluray.Sources = .init(io, &cue_state);
+            try sources.start(io, allocator);
+            defer sources.deinit();
+            try bluray.runBlurayClocks(io, allocator, port, &mode, &sources, null);
+        },
+        .Vlc => try vlc.runVlcClocks(io, allocator, port, &mode, null),
+    }
+
+    return .{
+        .mode = m,
+        .summary = recorder.summarize(nowMicros(io)),
+        .overflowed = emulator.stats.frames_overflowed.load(.monotonic),
+    };
+}
+
+fn stopAfter(io: Io, mode: *std.atomic.Value(Mode), seconds: u32) void {
+    io.sleep(.fromSeconds(seconds), .awake) catch {};
+    const running = mode.load(.acquire);
+    mode.store(if (running == .Clocks) .Bluray else .Clocks, .release);
+}
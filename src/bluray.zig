@@ -13,7 +13,14 @@ const cues = @import("cues.zig");
 const webvtt = @import("webvtt.zig");
 const vorne_charset = @import("vorne_charset.zig");
 const dbg = @import("debug_log.zig");
+const file_watch = @import("file_watch.zig");
 const Marquee = @import("marquee.zig").Marquee;
+const latency_probe = @import("latency_probe.zig");
+const metrics = @import("metrics.zig");
+const bus = @import("bus.zig");
+const render = @import("render.zig");
+const Cell = @import("cell.zig").Cell;
+const Event = @import("event.zig").Event;
 
 const Writer = std.Io.Writer;
 const maxbufsz = str_utils.maxbufsz;
@@ -36,80 +43,21 @@ pub const SUNCHAR = protocol.DLE ++ "O"; // ☼
 /// being guessed at.
 pub const LOCK_HUNTING_CHAR = "@";
 
-/// How often the selected cue file is checked for edits. One `stat` per second
-/// is nothing next to the HTTP polling already going on, and it makes the file
-/// editable while a disc is running.
+/// How often the selected cue file is checked for edits when the cue directory
+/// cannot be watched (`file_watch.zig`). One `stat` per second is nothing next
+/// to the HTTP polling already going on, and it keeps the file editable while
+/// a disc is running. Watched, it is checked only when something in the
+/// directory changed.
 pub const CUE_STAT_INTERVAL_MS: i64 = 1000;
 
-/// Longest the polling thread sleeps in one go. Only bounds how quickly it
-/// notices a mode change; the poll cadence itself comes from the phase lock.
-const POLL_THREAD_SLICE_MS: i64 = 50;
-
-/// How often the cue thread checks the file and, less often, the timezone.
-/// Also bounds how quickly it notices a mode change.
-const CUE_THREAD_SLICE_MS: i64 = 200;
-
-/// A render pass later than this past its scheduled wake is reported.
-///
-/// The display loop is treated as a real-time task: every wake exists because
-/// something is due on screen at that instant, so being late is a defect rather
-/// than a slow frame. Nothing on the loop should be able to cause one -- all
-/// file, network, *and* serial I/O is on other threads (the serial write and
-/// its wait for the panel's reply live on `senderLoop`) -- which makes a
-/// report here a genuine real-time-scheduling anomaly (OS jitter, a starved
-/// thread) rather than, as it could be before the collator/sender split,
-/// evidence of nothing more than the panel being slow to answer.
-const DEADLINE_SLACK_MS: i64 = 12;
-
 /// Ceiling on how long the display loop sleeps when it has nothing scheduled.
 ///
-/// The two clocks on line 1 are woken for exactly: the loop sleeps until the
-/// next real-time second or the next playback tick, whichever comes first. This
-/// only bounds the latency of everything not modelled that way -- a scroll
-/// step, a cue boundary, a mode change.
-const DISPLAY_IDLE_SLICE_MS: i64 = 25;
-
-/// How often both lines are redrawn in full even though nothing changed.
-///
-/// Two things make this necessary, and either alone would be enough.
-///
-/// Redraw suppression (see `last_line1`/`last_line2`) assumes a byte written to
-/// the port is a byte the panel rendered. Nothing in this protocol guarantees
-/// that: there is no flow control, and the unit's reply is drained without ever
-/// being inspected, so a frame the panel misses is indistinguishable from one it
-/// drew. Suppression then makes that permanent -- the content has not changed,
-/// so it is never sent again, and the line stays stale until something unrelated
-/// alters it.
-///
-/// Incremental column updates (`protocol.appendChangedColsToCmdList`) make it
-/// sharper still: in the steady state *only the columns that moved* are ever
-/// transmitted, so nothing repaints the rest of the line. Anything the panel
-/// loses -- a dropped frame, arriving here from another display mode, a glitch
-/// on the wire -- stays lost. Observed on hardware as a blank line with only
-/// the seconds digits ticking, those being the only columns still being sent.
-///
-/// So this redraw covers *both* lines, in full, bypassing the diff. Scoping it
-/// to line 2 alone (an earlier version did) is wrong: the reasoning that line 1
-/// rewrites itself every second holds only while it is written whole.
-const FORCE_REFRESH_MS: i64 = 3000;
-
-/// How long after entering Blu-ray mode to keep forcing a full redraw on
-/// every pass, rather than trusting `have_last1`/`have_last2` after the very
-/// first one.
-///
-/// The first pass's full redraw is sent right behind the mode-entry init.
-/// `protocol.send` waits for the panel's reply before either call returns,
-/// which is a much stronger guarantee than a fixed delay -- but it is still
-/// evidence the panel answered *something*, not proof the frame it just
-/// received rendered correctly. If that one frame is lost anyway,
-/// `have_last1`/`have_last2` are still marked true, since the write itself
-/// succeeded, and every following pass reverts to an incremental diff against
-/// a record of content the panel never actually showed -- so the panel can
-/// stay blank for the full `FORCE_REFRESH_MS` before anything forces a
-/// resend. Repeating the full redraw for a few seconds right after entry
-/// means a lost frame self-heals on the very next
-/// pass instead.
-const ENTRY_FULL_REDRAW_MS: i64 = 3000;
+/// Everything on screen is woken for exactly: the loop sleeps until the next
+/// real-time second, playback tick, scroll step or cue boundary, and a new
+/// snapshot or cue list wakes it at once (`Sources.display_wake`). This only
+/// bounds what a person does -- a mode change, a re-init, arming the cues --
+/// where a tenth of a second goes unnoticed.
+const DISPLAY_IDLE_SLICE_MS: i64 = 100;
 
 /// Why line 2 currently holds whatever it holds. Logged only when it changes
 /// (`runBlurayClocks`'s `seen_line2_source`), the same "log on change, not
@@ -133,35 +81,26 @@ const Line2Source = enum {
     nothing_selected,
 };
 
-/// Why a pass redraws both lines whole rather than diffing columns.
+/// The collator half of a `render.Pipeline`: each pass builds both lines for
+/// the instant it woke at and publishes them; the pipeline's sender -- or,
+/// with a `unit`, `bus.zig`'s scheduler -- owns the port.
 ///
-/// Named explicitly, rather than folded straight into a bool, so the reason
-/// can be logged on change -- the same "log on change" discipline
-/// `seen_line2_source` already uses below. Without this, "why did the panel
-/// just repaint whole" was invisible in the log; only the fact that a frame
-/// went out was.
-const RedrawReason = enum {
-    /// Nothing has ever been sent, or the last send's line wasn't recorded --
-    /// there is no known-good record to diff against.
-    missing_record,
-    /// Still inside `ENTRY_FULL_REDRAW_MS` of entering the mode -- see its doc.
-    entry_window,
-    /// A cue's start or end marker was crossed this pass -- see `cue_boundary`.
-    cue_boundary,
-    /// `FORCE_REFRESH_MS` has elapsed since the last full redraw.
-    periodic,
-};
-
+/// The player and the cue file come from `sources`, which every display in
+/// Blu-ray mode shares -- see `Sources`.
 pub fn runBlurayClocks(
     io: Io,
     allocator: std.mem.Allocator,
     port: anytype,
     mode: *std.atomic.Value(Mode),
-    cue_state: *cues.State,
-    resync_requested: *std.atomic.Value(bool),
+    sources: *Sources,
+    unit: ?*bus.Unit,
 ) !void {
     std.log.info("Starting Blu-Ray run mode...\n", .{});
 
+    const cue_state = sources.cue_state;
+    sources.enter();
+    defer sources.leave();
+
     var playtime_buf: [maxbufsz]u8 = undefined;
     // Holds the play time with `LOCK_HUNTING_CHAR` prefixed. Separate from
     // `playtime_buf` because the unmarked string is the source it is built
@@ -174,9 +113,15 @@ pub fn runBlurayClocks(
 
     // Line 2 comes from the cue file chosen on the web page. The file is
     // watched and parsed on the cue thread; what arrives here is a ready-made
-    // list, collected with one atomic load per frame.
+    // list, collected with one atomic load per frame. `cue_ref` is this
+    // loop's hold on it, shared with every other Blu-ray display.
+    var cue_ref: ?*SharedCues = null;
+    defer if (cue_ref) |shared| shared.release();
     var cue_list: ?webvtt.CueList = null;
-    defer if (cue_list) |list| list.deinit();
+    var seen_cue_version: u64 = 0;
+    // Where in `cue_list` the last pass looked, so that following playback
+    // costs a comparison rather than a search. Reset with the list.
+    var cue_cursor: webvtt.Cursor = .{};
 
     // Sweeps line 2 back and forth when the message is wider than the display.
     var scroller: Marquee = .{};
@@ -208,37 +153,32 @@ pub fn runBlurayClocks(
     //   * the cue file is watched and parsed on `cueLoop`, along with the
     //     timezone. Both are file I/O, and a cue file arrives whenever it
     //     happens to be saved.
-    var cell: SnapshotCell = .{};
-    var cue_cell: CueCell = .{};
-    defer cue_cell.deinit();
-    var zone: time.SharedZone = .init(time.getTimezoneInfo(io));
+    //
+    // Both belong to `sources`, not to this loop, so that a second display
+    // in Blu-ray mode costs no more polls and no more parses.
+    const cell = &sources.snapshot;
+    const cue_cell = &sources.cue_cell;
+    const zone = &sources.zone;
 
-    // What this loop wants shown, handed to `senderLoop` -- which owns the
+    // What this loop wants shown goes to the pipeline, whose sender owns the
     // port and decides how to actually get it onto the wire -- so that this
-    // loop is never blocked by a serial round trip. See `DrawCell` and
-    // `senderLoop`'s own doc for why the split exists.
-    var draw_cell: DrawCell = .{};
-    // A cue boundary is a one-shot event distinct from the published content
-    // itself -- see `DrawCell`'s "latest wins" doc for why folding it into
-    // the frame would risk the sender never seeing it.
-    var cue_boundary_pending: std.atomic.Value(bool) = .init(false);
-
-    var stop_workers = std.atomic.Value(bool).init(false);
-    const poller = try std.Thread.spawn(.{}, pollLoop, .{ io, allocator, &cell, resync_requested, &stop_workers });
-    const cue_thread = try std.Thread.spawn(.{}, cueLoop, .{ io, allocator, cue_state, &cue_cell, &zone, &stop_workers });
-    const sender = try std.Thread.spawn(.{}, senderLoop, .{ io, allocator, port, &draw_cell, &cue_boundary_pending, &stop_workers });
-    defer {
-        stop_workers.store(true, .release);
-        poller.join();
-        cue_thread.join();
-        sender.join();
-    }
+    // loop is never blocked by a serial round trip. See `render.zig`.
+    var pipeline: render.Pipeline = .{ .name = "bluray" };
+    try pipeline.start(io, allocator, port, unit);
+    defer pipeline.stop();
 
     // What the previous pass scheduled, so lateness can be reported.
-    var due_ms: i64 = 0;
-    var late_frames: u32 = 0;
+    var deadline = pipeline.deadline();
+    // What the previous pass published, for the benchmark probe only -- see
+    // `latency_probe.zig`. Untouched unless a probe is installed.
+    var probe_line1: ?[maxbufsz]u8 = null;
+    var probe_line2: ?[maxbufsz]u8 = null;
 
     while (true) {
+        // Taken before this pass reads either cell, so a publish landing
+        // after the read still cuts the sleep below short.
+        const wake_seen = sources.display_wake.seq();
+
         // Check for shutdown signal
         if (process_mgmt.shouldShutdown()) {
             std.log.info("Blu-Ray display received shutdown signal, exiting gracefully...\n", .{});
@@ -308,15 +248,15 @@ pub fn runBlurayClocks(
         // A jump of more than one second between consecutive passes means
         // this collator itself skipped a real-time second -- something
         // stalled it (OS scheduling, a starved thread) for over a second
-        // between wakes, distinct from and in addition to `DEADLINE_SLACK_MS`'s
-        // generic lateness report: that one says "this pass started late" in
-        // milliseconds, which is easy to skim past; this says, in exactly the
-        // terms someone watching the panel would use, "the displayed second
-        // itself skipped." Unconditional, like `senderLoop`'s "serial comm
-        // slow" -- and deliberately the complementary half of that message:
-        // together they cover every place a skipped second visible on the
-        // panel could actually originate, and say which one it was rather
-        // than leaving it to be inferred.
+        // between wakes, distinct from and in addition to
+        // `render.DEADLINE_SLACK_MS`'s generic lateness report: that one says
+        // "this pass started late" in milliseconds, which is easy to skim
+        // past; this says, in exactly the terms someone watching the panel
+        // would use, "the displayed second itself skipped." Unconditional,
+        // like the sender's "serial comm slow" -- and deliberately the
+        // complementary half of that message: together they cover every place
+        // a skipped second visible on the panel could actually originate, and
+        // say which one it was rather than leaving it to be inferred.
         if (seen_clock_second) |prev| {
             if (clock_second - prev > 1) {
                 std.log.warn(
@@ -339,9 +279,11 @@ pub fn runBlurayClocks(
         // Collect a cue file the cue thread has finished parsing. One atomic
         // load on almost every pass; the pointer swap and the arena free only
         // happen when the selection changes or the file is edited.
-        if (cue_cell.take()) |fresh| {
-            if (cue_list) |list| list.deinit();
-            cue_list = fresh;
+        if (cue_cell.take(&seen_cue_version)) |fresh| {
+            if (cue_ref) |shared| shared.release();
+            cue_ref = fresh;
+            cue_list = if (fresh) |shared| shared.list else null;
+            cue_cursor = .{};
             // Only fires on an actual transition (cueLoop publishes on load or
             // clear, not every pass), so this is safe at render-loop rate.
             if (cue_list) |list| {
@@ -352,8 +294,8 @@ pub fn runBlurayClocks(
         }
 
         // The selected file's name, kept only to show while disarmed. Re-read
-        // just when it changes, so the common pass takes no lock at all.
-        const generation = cue_state.generation.load(.acquire);
+        // just when it changes, so the common pass copies nothing at all.
+        const generation = cue_state.generation();
         if (generation != seen_generation) {
             seen_generation = generation;
             name_len = 0;
@@ -371,10 +313,20 @@ pub fn runBlurayClocks(
         // A warning cue is pinned rather than swept: it has to be readable the
         // instant it appears, not a sweep later.
         var may_scroll = true;
+        // Known up front for a cue, measured when it was parsed; anything
+        // else on line 2 is measured below.
+        var line2_cue_cols: ?usize = null;
         var line2_source: Line2Source = undefined;
         // Captured before the block below can change `seen_cue_span`, so it
         // can be compared against afterward -- see `cue_boundary`.
         const prev_cue_span = seen_cue_span;
+        // The cue at the play position, and when it next changes, in one
+        // lookup shared by line 2 and the wake below. Only while the position
+        // is live; otherwise it is frozen, and neither uses it.
+        const cue_here: ?webvtt.CueList.Lookup = if (cue_list) |list|
+            if (snap.positionIsLive()) cue_cursor.lookup(list, snap.playTimeMillis(now_ms)) else null
+        else
+            null;
         const line2: []const u8 = if (cue_state.isArmed()) blk: {
             // Only show a cue while the position it is keyed to is actually
             // being tracked. Stopped, paused, seeking, or simply not answering
@@ -387,23 +339,24 @@ pub fn runBlurayClocks(
                 seen_cue_span = null;
                 break :blk "";
             }
-            const list = cue_list orelse {
+            const here = cue_here orelse {
                 line2_source = .armed_no_cue_list;
                 seen_cue_span = null;
                 break :blk "";
             };
             // Outside every cue's span the line is blank, checked afresh each
             // pass rather than left holding the last message.
-            const cue = list.at(snap.playTimeMillis(now_ms)) orelse {
+            const cue = here.cue orelse {
                 line2_source = .armed_no_cue_here;
                 seen_cue_span = null;
                 break :blk "";
             };
             may_scroll = cue.scroll;
+            line2_cue_cols = cue.cols;
             line2_source = .cue;
             if (seen_cue_span == null or seen_cue_span.?.start_ms != cue.start_ms or seen_cue_span.?.end_ms != cue.end_ms) {
                 seen_cue_span = .{ .start_ms = cue.start_ms, .end_ms = cue.end_ms };
-                const cols = (str_utils.strlensz(cue.text) catch unreachable)[0];
+                const cols = cue.cols;
                 // `cue.text` is already transcoded into the panel's own
                 // character set (see webvtt.zig's `appendPayload`), so
                 // printing it directly is mojibake or an invisible control
@@ -466,7 +419,7 @@ pub fn runBlurayClocks(
             // SPP frame. The frame is left malformed, its CRC fails, and the
             // panel discards the whole thing, line 1 included: the write
             // reports success and nothing renders at all.
-            const cols = (str_utils.strlensz(line2) catch unreachable)[0];
+            const cols = line2_cue_cols orelse (str_utils.strlensz(line2) catch unreachable)[0];
             if (cols <= str_utils.maxchars) break :blk line2;
             break :blk line2[0..(str_utils.idxChar2Str(line2, str_utils.maxchars) catch line2.len)];
         };
@@ -477,25 +430,35 @@ pub fn runBlurayClocks(
         const line2_cols = (str_utils.strlensz(line2_window) catch unreachable)[0];
         try str_utils.copyLeftJustify(&line2buf, line2_window, @min(line2_cols, str_utils.maxchars), null);
 
-        // Hand the freshly built frame to `senderLoop`, which owns the port
-        // and decides how -- or whether -- to get it onto the wire (one frame
-        // per send, line 1 preferred over line 2, full redraw vs. column diff;
-        // see that function's own doc). Publishing is a spin-locked copy of
+        // Hand the freshly built frame to the pipeline's sender, which owns
+        // the port and decides how -- or whether -- to get it onto the wire
+        // (one frame per send, line 1 preferred over line 2, full redraw vs.
+        // column diff; see `render.zig`). Publishing is a wait-free copy of
         // two small buffers, never a write to the panel, so this loop is never
         // blocked by a serial round trip -- which is the whole point of the
         // split: this loop can always tell the sender what *should* be shown
         // right now, even while the sender is still busy getting the last
         // thing it was told out the door.
-        draw_cell.publish(&linebuf, &line2buf);
-        // A one-shot flag, not folded into the published frame: `draw_cell`
-        // is "latest wins" (see its own doc), so a boundary flagged on one
-        // publish could be silently superseded by a later one before the
-        // sender ever looks. `cue_boundary` only means "this pass changed
-        // `seen_cue_span`" -- whatever content the sender eventually reads
-        // already reflects the post-boundary state regardless of which
-        // publish it came from, so it does not matter that the flag and the
-        // frame that originally set it may not arrive together.
-        if (cue_boundary) cue_boundary_pending.store(true, .release);
+        pipeline.publish(&linebuf, &line2buf);
+        // A line whose content changed this pass became due at the instant
+        // this pass was scheduled for -- the tick, second or scroll step that
+        // woke it -- not whenever it happened to run.
+        if (latency_probe.active() != null) {
+            const became_due_ms = deadline.dueOr(now_ms);
+            if (probe_line1 == null or !std.mem.eql(u8, &probe_line1.?, &linebuf)) latency_probe.contentDue(1, became_due_ms);
+            if (probe_line2 == null or !std.mem.eql(u8, &probe_line2.?, &line2buf)) latency_probe.contentDue(2, became_due_ms);
+            probe_line1 = linebuf;
+            probe_line2 = line2buf;
+        }
+        // A one-shot request, not folded into the published frame: what is
+        // published is "latest wins" (see `render.DrawCell`), so a boundary
+        // flagged on one publish could be silently superseded by a later one
+        // before the sender ever looks. `cue_boundary` only means "this pass
+        // changed `seen_cue_span`" -- whatever content the sender eventually
+        // reads already reflects the post-boundary state regardless of which
+        // publish it came from, so it does not matter that the request and
+        // the frame that originally made it may not arrive together.
+        if (cue_boundary) pipeline.requestRedraw();
 
         // Sleep until the next moment something on the display is due to
         // change: the next playback tick, the next real-time second, or the
@@ -509,12 +472,12 @@ pub fn runBlurayClocks(
         // already agreed on. That is only safe because this loop no longer
         // performs the one operation that used to make it stale by the time
         // scheduling ran: the blocking write-and-wait-for-reply now lives on
-        // `senderLoop`, on its own thread, so nothing between capturing
+        // the pipeline's sender, on its own thread, so nothing between capturing
         // `now_ms` above and reading it again here can take a meaningfully
         // different amount of time pass to pass. Before the split, this
         // reused the frame's `now_ms` even though a serial round trip could
         // land in between, which was the dominant source of the "Display pass
-        // N ms late" reports -- see the split's own rationale on `senderLoop`.
+        // N ms late" reports -- see the split's own rationale in `render.zig`.
         var wake_ms = now_ms + DISPLAY_IDLE_SLICE_MS;
         if (snap.nextTickMs(now_ms)) |tick_ms| wake_ms = @min(wake_ms, tick_ms);
         // The displayed second flips on a local-time boundary. Offsets are
@@ -530,35 +493,17 @@ pub fn runBlurayClocks(
         // warning cues are only a second long, so noticing them on some later
         // sample risks stepping over one entirely -- and a warning that never
         // appears is worse than one that appears a little late.
-        if (cue_list) |list| {
-            if (snap.positionIsLive()) {
-                const position_ms = snap.playTimeMillis(now_ms);
-                if (list.nextBoundaryMs(position_ms)) |boundary_ms| {
-                    wake_ms = @min(wake_ms, now_ms + (boundary_ms - position_ms));
-                }
+        if (cue_here) |here| {
+            if (here.next_boundary_ms) |boundary_ms| {
+                wake_ms = @min(wake_ms, now_ms + (boundary_ms - snap.playTimeMillis(now_ms)));
             }
         }
 
         // Report a pass that started noticeably after the instant it was
-        // scheduled for. Every wake exists because something was due on screen
-        // then, and there is no catching up afterwards -- a late pass is a
-        // frame shown late, so it is a defect worth seeing in the log rather
-        // than something to absorb quietly. Unconditional (`std.log`, not
-        // `dbg.print`/`.display`): this can only mean the collator itself
-        // stalled -- nothing it does can block since the sender split (see
-        // `senderLoop`'s own doc) -- which is exactly the kind of fault a
-        // debug category being off must not be able to hide.
-        if (due_ms != 0 and now_ms - due_ms > DEADLINE_SLACK_MS) {
-            late_frames += 1;
-            std.log.warn(
-                "Display pass {d} ms late (deadline {d}, {d} so far)\n",
-                .{ now_ms - due_ms, due_ms, late_frames },
-            );
-        }
-        due_ms = wake_ms;
-
-        const sleep_ms = wake_ms - time.nowMillis(io);
-        if (sleep_ms > 0) try io.sleep(.fromMilliseconds(sleep_ms), .awake);
+        // scheduled for, then sleep to the next -- see `render.Deadline`.
+        // This can only mean the collator itself stalled: nothing it does
+        // can block since the sender split.
+        deadline.waitUntil(io, now_ms, wake_ms, &sources.display_wake, wake_seen);
     }
 }
 
@@ -840,58 +785,97 @@ pub const Snapshot = struct {
     }
 };
 
-/// Hands a freshly parsed cue file from the loader thread to the display loop.
+/// A parsed cue file, shared by every display loop showing it and freed by
+/// whichever lets go of it last -- the loader, on replacing it, or a display
+/// loop, on taking the next one or leaving Blu-ray mode.
+const SharedCues = struct {
+    list: webvtt.CueList,
+    refs: std.atomic.Value(u32),
+    allocator: std.mem.Allocator,
+
+    /// Wrap `list`, holding one reference for the caller. On failure `list`
+    /// is still the caller's.
+    fn create(allocator: std.mem.Allocator, list: webvtt.CueList) !*SharedCues {
+        const shared = try allocator.create(SharedCues);
+        shared.* = .{ .list = list, .refs = .init(1), .allocator = allocator };
+        return shared;
+    }
+
+    fn retain(self: *SharedCues) *SharedCues {
+        _ = self.refs.fetchAdd(1, .monotonic);
+        return self;
+    }
+
+    fn release(self: *SharedCues) void {
+        if (self.refs.fetchSub(1, .acq_rel) != 1) return;
+        self.list.deinit();
+        self.allocator.destroy(self);
+    }
+};
+
+/// Hands a freshly parsed cue file from the loader thread to the display loops.
 ///
 /// The display loop must never touch the filesystem. Reading and parsing a cue
 /// file means an SD-card read and a parse of the whole thing -- milliseconds,
 /// unbounded, and landing at whatever moment the file happens to be saved. The
-/// lookup itself is a scan of a sorted array and costs about a microsecond, so
-/// it stays on the display loop; only the I/O moves.
+/// lookup itself is a step along a prebuilt index (see `webvtt.Cursor`) and
+/// costs well under a microsecond, so it stays on the display loop; only the
+/// I/O moves.
+///
+/// Every display loop reads the same publication, so taking one does not
+/// consume it: each loop keeps the generation it last took, and takes its own
+/// reference to the list.
+///
+/// The pointer itself goes through a `cell.Cell`, so a display loop never
+/// waits on the loader. What the cell cannot do alone is keep the list alive
+/// between a display reading the pointer and retaining it, so `takers`
+/// counts displays in that window, and a publish holds on to the list it
+/// replaced until none are. That wait is the loader's, never a display's,
+/// and no longer than one `retain`.
 const CueCell = struct {
-    guard: std.atomic.Value(bool) = .init(false),
-    /// Whether `pending` holds something the display loop has not taken yet.
-    /// Checked with a plain atomic load so the common case never takes the lock.
-    ready: std.atomic.Value(bool) = .init(false),
-    pending: ?webvtt.CueList = null,
-
-    fn acquire(self: *CueCell) void {
-        while (self.guard.cmpxchgWeak(false, true, .acquire, .monotonic) != null) {
-            std.atomic.spinLoopHint();
-        }
+    current: Cell(?*SharedCues) = .init(null),
+    /// Display loops between reading `current` and retaining what they read.
+    takers: std.atomic.Value(u32) = .init(0),
+
+    /// Publish a newly loaded list, or null to mean "no cue file". Takes over
+    /// the caller's reference.
+    fn publish(self: *CueCell, shared: ?*SharedCues) void {
+        const previous = self.current.read();
+        self.current.publish(shared);
+        // A read-modify-write rather than a load, so it cannot be ordered
+        // ahead of the publish: a taker not counted here started after it,
+        // and so reads `shared`, never `previous`.
+        while (self.takers.fetchAdd(0, .seq_cst) != 0) std.atomic.spinLoopHint();
+        if (previous) |stale| stale.release();
     }
 
-    fn release(self: *CueCell) void {
-        self.guard.store(false, .release);
-    }
-
-    /// Publish a newly loaded list, or null to mean "no cue file".
-    fn publish(self: *CueCell, list: ?webvtt.CueList) void {
-        self.acquire();
-        defer self.release();
-        // An earlier publication the display never collected is stale by
-        // definition, and nothing holds a reference to it, so it can go here.
-        if (self.pending) |stale| stale.deinit();
-        self.pending = list;
-        self.ready.store(true, .release);
-    }
-
-    /// Take whatever is waiting. The outer optional is "was there an update at
-    /// all"; the inner one is the list, which is null when the selection was
+    /// Take whatever was published since `seen` and update it. The outer
+    /// optional is "was there an update at all"; the inner one is the list,
+    /// with a reference for the caller, which is null when the selection was
     /// cleared and the line should go blank.
-    fn take(self: *CueCell) ??webvtt.CueList {
-        if (!self.ready.load(.acquire)) return null;
-        self.acquire();
-        defer self.release();
-        const taken = self.pending;
-        self.pending = null;
-        self.ready.store(false, .release);
+    fn take(self: *CueCell, seen: *u64) ??*SharedCues {
+        if (self.current.generation.load(.acquire) == seen.*) return null;
+        _ = self.takers.fetchAdd(1, .seq_cst);
+        defer _ = self.takers.fetchSub(1, .release);
+        const fresh = self.current.take(seen) orelse return null;
+        const taken: ?*SharedCues = if (fresh) |shared| shared.retain() else null;
         return taken;
     }
 
-    /// Release anything still held. Only safe once the loader has stopped.
+    /// The current list, with a reference for the caller, or null when there
+    /// is none. For a reader that is not a display loop and so keeps no
+    /// `seen` -- the status API.
+    fn retain(self: *CueCell) ?*SharedCues {
+        _ = self.takers.fetchAdd(1, .seq_cst);
+        defer _ = self.takers.fetchSub(1, .release);
+        const current = self.current.read() orelse return null;
+        return current.retain();
+    }
+
+    /// Release the cell's own reference. Only safe once the loader has stopped.
     fn deinit(self: *CueCell) void {
-        if (self.pending) |list| list.deinit();
-        self.pending = null;
+        if (self.current.read()) |shared| shared.release();
+        self.current = .init(null);
     }
 };
 
@@ -906,21 +890,41 @@ fn cueLoop(
     cue_state: *cues.State,
     cell: *CueCell,
     zone: *time.SharedZone,
+    wake: *Event,
     stop: *std.atomic.Value(bool),
 ) void {
     var loaded_generation: u64 = 0;
     var name_buf: [cues.max_name_len]u8 = undefined;
     var name_len: usize = 0;
     var loaded_print: ?cues.Fingerprint = null;
-    var next_zone_ms: i64 = 0;
-    var next_stat_ms: i64 = 0;
+    // The list last published for the current selection, held so the next
+    // edit of the same file re-parses only what changed. Dropped with the
+    // selection.
+    var loaded: ?*SharedCues = null;
+    defer if (loaded) |shared| shared.release();
+    var zone_refresh: time.ZoneRefresh = .{};
+    var cue_watch: file_watch.Subscription = .{ .topic = .cues, .poll_ms = CUE_STAT_INTERVAL_MS };
+
+    // Everything this loop waits on rings `wake`: a selection from the web
+    // page, and the watcher seeing a file change. `Sources.deinit` rings it
+    // to stop.
+    cue_state.name.changed.forwardTo(wake);
+    defer cue_state.name.changed.forwardTo(null);
+    cue_watch.forwardTo(wake);
+    defer cue_watch.forwardTo(null);
 
-    while (!stop.load(.acquire)) {
-        const generation = cue_state.generation.load(.acquire);
+    while (true) {
+        // Before `stop`, as in `pollLoop`.
+        const seen = wake.seq();
+        if (stop.load(.acquire)) break;
+
+        const generation = cue_state.generation();
         if (generation != loaded_generation) {
             loaded_generation = generation;
             loaded_print = null;
-            next_stat_ms = 0; // load the new selection immediately
+            if (loaded) |shared| shared.release();
+            loaded = null;
+            cue_watch.reset(); // load the new selection immediately
             name_len = 0;
             if (cue_state.currentName(&name_buf)) |name| {
                 name_len = name.len;
@@ -935,21 +939,30 @@ fn cueLoop(
 
         const now_ms = time.nowMillis(io);
 
-        if (name_len > 0 and now_ms >= next_stat_ms) {
-            next_stat_ms = now_ms + CUE_STAT_INTERVAL_MS;
+        // Asked even with nothing selected, so an edit made meanwhile is not
+        // taken for one to the file selected next -- `reset` covers that.
+        if (cue_watch.changed(now_ms) and name_len > 0) {
             const name = name_buf[0..name_len];
             // A file that cannot be stat'ed -- deleted, or a temporary being
-            // renamed into place by an editor -- is left alone. The next pass
-            // picks it up, and the cues already loaded beat a blank line.
+            // renamed into place by an editor -- is left alone. Its arrival is
+            // another change, and the cues already loaded beat a blank line.
             if (cues.fingerprint(io, name)) |current| {
                 const stale = if (loaded_print) |previous| !previous.eql(current) else true;
                 if (stale) {
-                    if (cues.load(io, allocator, name)) |fresh| {
+                    const previous = if (loaded) |shared| shared.list else null;
+                    if (cues.load(io, allocator, name, current, previous)) |fresh| {
                         dbg.print(.cues, 
                             "cueLoop: loaded '{s}': {d} cues, title '{s}'\n",
                             .{ name, fresh.cues.len, fresh.title },
                         );
-                        cell.publish(fresh);
+                        if (SharedCues.create(allocator, fresh)) |shared| {
+                            if (loaded) |old| old.release();
+                            loaded = shared.retain();
+                            cell.publish(shared);
+                        } else |err| {
+                            fresh.deinit();
+                            std.log.err("Failed to share cue file {s}: {}\n", .{ name, err });
+                        }
                     } else |err| {
                         // Keep whatever is already on screen: a briefly broken
                         // file is normal while editing, and blanking line 2
@@ -957,7 +970,8 @@ fn cueLoop(
                         dbg.print(.cues, "Failed to load cue file {s}: {}\n", .{ name, err });
                     }
                     // Recorded either way, so a file that fails to parse is not
-                    // re-read every second until it is saved again.
+                    // re-read on every change to its neighbours until it is
+                    // saved again.
                     loaded_print = current;
                 }
             } else {
@@ -972,451 +986,152 @@ fn cueLoop(
             }
         }
 
-        if (now_ms >= next_zone_ms) {
-            next_zone_ms = now_ms + time.SharedZone.refresh_interval_ms;
-            zone.store(time.getTimezoneInfo(io));
-        }
+        if (zone_refresh.poll(io, now_ms)) |zi| zone.store(zi);
 
-        io.sleep(.fromMilliseconds(CUE_THREAD_SLICE_MS), .awake) catch return;
+        // Woken for a DST edge exactly, so the display changes with it, and
+        // otherwise only by `wake` -- or the next stat, without a watcher.
+        wake.wait(seen, @min(zone_refresh.msUntilChange(now_ms), cue_watch.msUntilDue(now_ms)));
     }
 }
 
-/// Hands a `Snapshot` from the polling thread to the display loop.
+/// The player poller and the cue loader, run once for however many displays
+/// are in Blu-ray mode.
 ///
-/// A spin lock, for the same reason as in `cues.zig`: the critical section is a
-/// copy of a handful of words, and `std.Thread.Mutex` does not exist in 0.16.
-const SnapshotCell = struct {
-    guard: std.atomic.Value(bool) = .init(false),
-    value: Snapshot = .{},
-
-    fn acquire(self: *SnapshotCell) void {
-        while (self.guard.cmpxchgWeak(false, true, .acquire, .monotonic) != null) {
-            std.atomic.spinLoopHint();
-        }
+/// Both threads are started with the process and live as long as it does. The
+/// cue loader keeps its file loaded throughout, so a display entering Blu-ray
+/// mode has its cues at once; the poller only talks to the player while at
+/// least one display is in the mode (`enter`/`leave`), since a poll is a
+/// network round trip the player has to answer.
+pub const Sources = struct {
+    cue_state: *cues.State,
+    /// One-shot "force a PLL resync now" from the web page, consumed by
+    /// `pollLoop`. `swap`-based, so a request cannot be lost or double-fired.
+    resync_requested: std.atomic.Value(bool) = .init(false),
+    snapshot: SnapshotCell = .init(.{}),
+    cue_cell: CueCell = .{},
+    zone: time.SharedZone,
+    /// How many display loops are in Blu-ray mode.
+    users: std.atomic.Value(u32) = .init(0),
+    stop: std.atomic.Value(bool) = .init(false),
+    poller: ?std.Thread = null,
+    cue_thread: ?std.Thread = null,
+    /// What each thread sleeps on between its deadlines -- see `event.zig`.
+    /// The poller's: a display entering or leaving, a resync, stopping.
+    poll_wake: Event = .{},
+    /// The cue loader's, rung from elsewhere -- see `cueLoop`.
+    cue_wake: Event = .{},
+    /// Every Blu-ray display loop's: a new snapshot or cue list, forwarded
+    /// from their cells by `start`.
+    display_wake: Event = .{},
+
+    pub fn init(io: Io, cue_state: *cues.State) Sources {
+        return .{
+            .cue_state = cue_state,
+            .zone = .init(time.getTimezoneInfo(io)),
+        };
     }
 
-    fn release(self: *SnapshotCell) void {
-        self.guard.store(false, .release);
+    /// Start both threads. `self` must not move until `deinit`.
+    pub fn start(self: *Sources, io: Io, allocator: std.mem.Allocator) !void {
+        self.snapshot.changed.forwardTo(&self.display_wake);
+        self.cue_cell.current.changed.forwardTo(&self.display_wake);
+        self.poller = try std.Thread.spawn(.{}, pollLoop, .{ io, allocator, &self.snapshot, &self.resync_requested, &self.users, &self.poll_wake, &self.stop });
+        self.cue_thread = try std.Thread.spawn(.{}, cueLoop, .{ io, allocator, self.cue_state, &self.cue_cell, &self.zone, &self.cue_wake, &self.stop });
     }
 
-    fn publish(self: *SnapshotCell, value: Snapshot) void {
-        self.acquire();
-        defer self.release();
-        self.value = value;
+    /// Ask the poller to resync the phase lock. Safe from any thread, and
+    /// harmless outside Blu-ray mode -- the next time that mode starts, a
+    /// freshly initialized phase lock has nothing to resync anyway.
+    pub fn requestResync(self: *Sources) void {
+        self.resync_requested.store(true, .release);
+        self.poll_wake.notify();
     }
 
-    fn read(self: *SnapshotCell) Snapshot {
-        self.acquire();
-        defer self.release();
-        return self.value;
+    /// The text of the cue at the player's position at `now_ms`, copied into
+    /// `buf` and cut to fit, in the panel's character set. Null with no cue
+    /// file loaded, the player stopped, or no cue at the position; whether
+    /// line 2 is actually showing it is `cues.State.isArmed`. Safe from any
+    /// thread.
+    pub fn cueAt(self: *Sources, now_ms: i64, buf: []u8) ?[]const u8 {
+        const snap = self.snapshot.read();
+        if (!snap.positionIsLive()) return null;
+        const shared = self.cue_cell.retain() orelse return null;
+        defer shared.release();
+        const cue = shared.list.at(snap.playTimeMillis(now_ms)) orelse return null;
+        const len = @min(cue.text.len, buf.len);
+        @memcpy(buf[0..len], cue.text[0..len]);
+        return buf[0..len];
     }
-};
 
-/// Hands the collator's (`runBlurayClocks`) freshly built frame to
-/// `senderLoop`. A spin lock, for the same reason as `SnapshotCell`: the
-/// critical section is a copy of two small fixed buffers, and
-/// `std.Thread.Mutex` does not exist in 0.16.
-///
-/// Deliberately "latest wins," not a queue: the sender only ever cares what
-/// should be on screen *right now*. A publish the sender has not yet picked
-/// up is simply overwritten by the next one rather than queued behind it --
-/// nothing is lost by that, since an intermediate scroll-step frame the
-/// sender never saw was already superseded by the one it does see.
-const DrawCell = struct {
-    guard: std.atomic.Value(bool) = .init(false),
-    /// Whether the collator has published anything yet -- `senderLoop` has
-    /// nothing to send before the first pass runs.
-    have: bool = false,
-    line1: [maxbufsz]u8 = undefined,
-    line2: [maxbufsz]u8 = undefined,
-
-    const Frame = struct { line1: [maxbufsz]u8, line2: [maxbufsz]u8 };
-
-    fn acquire(self: *DrawCell) void {
-        while (self.guard.cmpxchgWeak(false, true, .acquire, .monotonic) != null) {
-            std.atomic.spinLoopHint();
-        }
+    /// Stop and join both threads, and release the loaded cue file.
+    pub fn deinit(self: *Sources) void {
+        self.stop.store(true, .release);
+        self.poll_wake.notify();
+        self.cue_wake.notify();
+        if (self.poller) |t| t.join();
+        if (self.cue_thread) |t| t.join();
+        self.poller = null;
+        self.cue_thread = null;
+        self.cue_cell.deinit();
     }
 
-    fn release(self: *DrawCell) void {
-        self.guard.store(false, .release);
+    fn enter(self: *Sources) void {
+        _ = self.users.fetchAdd(1, .acq_rel);
+        self.poll_wake.notify();
     }
 
-    fn publish(self: *DrawCell, line1: *const [maxbufsz]u8, line2: *const [maxbufsz]u8) void {
-        self.acquire();
-        defer self.release();
-        self.line1 = line1.*;
-        self.line2 = line2.*;
-        self.have = true;
-    }
-
-    /// The most recently published frame, or null before the collator has
-    /// published anything at all.
-    fn read(self: *DrawCell) ?Frame {
-        self.acquire();
-        defer self.release();
-        if (!self.have) return null;
-        return .{ .line1 = self.line1, .line2 = self.line2 };
+    fn leave(self: *Sources) void {
+        _ = self.users.fetchSub(1, .acq_rel);
+        self.poll_wake.notify();
     }
 };
 
-/// How often `senderLoop` checks `DrawCell` for fresh content when it has
-/// nothing outstanding. Not a pacing mechanism -- `protocol.send` already
-/// paces the wire by waiting for the panel's reply -- just how quickly a
-/// freshly published frame is noticed while the sender is idle. Small enough
-/// that a tick or scroll step is picked up as soon as whatever send was
-/// already in flight completes; the panel's own round trip, not this, is what
-/// actually bounds latency.
-const SENDER_IDLE_SLICE_MS: i64 = 10;
-
-/// How far above the recent-average round trip (`senderLoop`'s
-/// `send_ewma_ms`) a single confirmed send's wait for the panel's reply has
-/// to be before it is logged as slow.
-///
-/// A multiple of the *rolling* average rather than a fixed number of
-/// milliseconds, because what counts as "slow" depends on this panel and this
-/// wiring -- a deployment that normally sees 20 ms replies and one that
-/// normally sees 150 ms are both fine right up until either one roughly
-/// triples. This exists because the collator/sender split (see `senderLoop`'s
-/// own doc) moved the one thing that can genuinely stall a pass -- the
-/// blocking wait for the panel's reply -- off the collator entirely. That
-/// fixed the collator's own `DEADLINE_SLACK_MS` report being a false signal
-/// for ordinary serial latency, but it also means a slow *reply* no longer
-/// shows up anywhere unless something says so explicitly: a stall here
-/// previously surfaced as a late collator pass, which was the wrong
-/// attribution (it blamed the render loop for the wire), but at least it
-/// surfaced. This is that signal, correctly attributed.
-const SEND_SLOW_MULTIPLE: i64 = 3;
-
-/// Absolute floor added on top of `SEND_SLOW_MULTIPLE`'s comparison, so a
-/// very fast, very tight baseline (a handful of ms) doesn't make ordinary
-/// jitter look like an anomaly.
-const SEND_SLOW_MARGIN_MS: i64 = 50;
-
-/// A reply taking longer than this is flagged regardless of the adaptive
-/// baseline above -- not a multiple of anything, a hard ceiling.
-///
-/// The relative check (`SEND_SLOW_MULTIPLE`) has a blind spot: a *sustained*
-/// degradation, not a single spike, ratchets the average up one sample at a
-/// time, each one individually landing just under threshold relative to
-/// wherever the average had already climbed to from the sample before it --
-/// observed on hardware as a ~3.5 s stretch of 100-176 ms replies where only
-/// the first sample got flagged and the rest rode the rising average under
-/// the radar. An adaptive-only check can never catch that, because nothing
-/// about it is a spike relative to its own immediate history.
-///
-/// This is the backstop: the protocol has a hard physical ceiling on what a
-/// reply *should* cost, independent of any baseline. The largest frame this
-/// code ever sends is a full two-line redraw, documented (CLAUDE.md, "One
-/// frame per pass, and line 1 wins") at roughly 31 ms of wire time at 19200
-/// baud. A reply taking more than double that is not "a bigger frame" -- it
-/// is added latency, full stop, no matter how the recent average has
-/// drifted.
-const SEND_SLOW_ABSOLUTE_MS: i64 = 75;
-
-/// Owns the serial port and turns whatever the collator (`runBlurayClocks`)
-/// last published into frames on the wire.
-///
-/// Split out from the collator so the two are never coupled by a blocking
-/// call. Before this split, one thread did both jobs: build the draw buffers,
-/// diff them, and send -- all in the same pass. The diffing itself was always
-/// correct and immediate (a fresh `now_ms` and a `memcmp`, every pass), but it
-/// could not *run* while that same thread was blocked inside `protocol.send`
-/// waiting for the panel's reply. A line-2 scroll-step send starting shortly
-/// before a real-time tick came due would still be in flight when it did, so
-/// the tick was not even looked at until the pass after -- by which point a
-/// second real second had often already ticked over. That produced the clock
-/// visibly skipping a second while the marquee was scrolling. A round-trip
-/// estimate was tried first, predicting whether a line-2 send would still be
-/// outstanding by the next tick and skipping it if so -- a real improvement,
-/// but only probabilistic: it depended on the estimate being right.
-///
-/// This is the structural fix instead: the collator never touches the port,
-/// so it is never blocked and always holds the true current state; this
-/// thread continuously sends whatever `draw.read()` says is *latest*, gated
-/// only by however long the panel actually takes to answer. Because it always
-/// re-reads fresh after every send completes, a tick that landed mid-send is
-/// simply reflected the moment it checks again -- no prediction needed.
-///
-/// Owns every piece of "what has the panel actually been sent" bookkeeping --
-/// `last_line1`/`last_line2`/`have_last1`/`have_last2`, the redraw-reason
-/// timers (`FORCE_REFRESH_MS`, `ENTRY_FULL_REDRAW_MS`) -- since it is the only
-/// thread that knows what actually went out. The collator does not, and must
-/// not: it only knows what *should* be shown.
-///
-/// One frame per send, and line 1 preferred over line 2 when both are due --
-/// unchanged from the single-thread version, and for the same reason: nothing
-/// renders until a frame's CRC arrives, so a frame carrying both lines costs
-/// roughly 31 ms against 18 ms for one alone, and two frames back to back with
-/// no gap is what makes the panel drop the second one (no flow control, small
-/// input buffer). Deferring line 2 to the next send costs it at most one
-/// `SENDER_IDLE_SLICE_MS` of latency and cannot starve, since line 1 changes
-/// only a couple of times a second.
-fn senderLoop(
-    io: Io,
-    allocator: std.mem.Allocator,
-    port: anytype,
-    draw: *DrawCell,
-    cue_boundary_pending: *std.atomic.Value(bool),
-    stop: *std.atomic.Value(bool),
-) void {
-    var cmd_parts = std.ArrayList(u8).empty;
-    defer cmd_parts.deinit(allocator);
-
-    // Last content actually put on the wire, so only a line that changed is
-    // re-clocked out -- see the equivalent comment this replaced in
-    // `runBlurayClocks` for the full rationale. A flag per line: the two are
-    // sent in separate passes, so a single shared flag would mark one line's
-    // record valid on the strength of the *other* line having gone out.
-    var last_line1: [maxbufsz]u8 = undefined;
-    var last_line2: [maxbufsz]u8 = undefined;
-    var have_last1 = false;
-    var have_last2 = false;
-    // See `FORCE_REFRESH_MS`.
-    var last_refresh_ms: i64 = 0;
-    // See `ENTRY_FULL_REDRAW_MS`. This thread's own start is mode entry, so
-    // there is no need for the lazy "set from the first pass" `?i64` the
-    // collator used to need before it had a `now_ms` to seed from.
-    const entry_ms = time.nowMillis(io);
-    // For "log only on change" -- see `RedrawReason`.
-    var seen_redraw_reason: ?RedrawReason = null;
-    // Rolling average of how long a *confirmed* send's wait for the panel's
-    // reply actually takes -- see `SEND_SLOW_MULTIPLE`'s doc. Seeded with a
-    // plausible guess so the first few sends, before a real sample exists,
-    // are not compared against zero.
-    var send_ewma_ms: i64 = 150;
-    var slow_sends: u32 = 0;
-
-    while (!stop.load(.acquire)) {
-        const frame = draw.read() orelse {
-            io.sleep(.fromMilliseconds(SENDER_IDLE_SLICE_MS), .awake) catch return;
-            continue;
-        };
-        const linebuf = frame.line1;
-        const line2buf = frame.line2;
-
-        const now_ms = time.nowMillis(io);
-        // One-shot: `swap` both reads and clears it, so a boundary flagged
-        // between this check and the last cannot be lost or double-counted.
-        const cue_boundary = cue_boundary_pending.swap(false, .acq_rel);
-        // See `.timing`'s own doc. Gated behind `enabled` for the same
-        // reason as the collator's equivalent: cheap, but not free, and this
-        // loop can run every `SENDER_IDLE_SLICE_MS` even when idle.
-        const timing_on = dbg.enabled(.timing);
-
-        cmd_parts.clearRetainingCapacity();
-        const line1_changed = !have_last1 or !std.mem.eql(u8, &linebuf, &last_line1);
-        // Whether the *content* changed, kept separate from whether it gets
-        // sent: a periodic refresh re-sends identical content, and reporting
-        // that as a line-2 update every few seconds would bury the
-        // transitions actually worth reading in the log.
-        const line2_changed = !have_last2 or !std.mem.eql(u8, &line2buf, &last_line2);
-
-        // A full redraw of *both* lines, periodically and whenever what is on
-        // the panel is unknown -- entering Blu-ray mode, or after a failed
-        // send. Not optional once line updates are incremental: a column diff
-        // rewrites only the columns that moved, so nothing in the steady
-        // state ever repaints the rest of a line the panel lost to a dropped
-        // frame or a glitch on the wire.
-        const in_entry_window = now_ms - entry_ms < ENTRY_FULL_REDRAW_MS;
-
-        const redraw_reason: ?RedrawReason = if (!have_last1 or !have_last2)
-            .missing_record
-        else if (in_entry_window)
-            .entry_window
-        else if (cue_boundary)
-            .cue_boundary
-        else if (now_ms - last_refresh_ms >= FORCE_REFRESH_MS)
-            .periodic
-        else
-            null;
-        const full_redraw = redraw_reason != null;
-
-        if (redraw_reason != seen_redraw_reason) {
-            seen_redraw_reason = redraw_reason;
-            if (redraw_reason) |reason| {
-                dbg.print(.redraw, "bluray: full redraw -> {s}\n", .{@tagName(reason)});
-            }
-        }
-
-        // Which lines this send actually carried, so the records are updated
-        // for exactly those and no others.
-        var sent_line1 = false;
-        var sent_line2 = false;
-
-        // An allocator failure building the command string (a handful of
-        // bytes) is exceedingly unlikely, but is skipped rather than crashing
-        // this thread: `continue` re-reads `draw` next iteration, so a
-        // transient hiccup just costs one send's worth of latency, same as
-        // any other skipped pass.
-        if (full_redraw) {
-            last_refresh_ms = now_ms;
-            protocol.appendStrToCmdList(allocator, &cmd_parts, 1, 1, &linebuf) catch |err| {
-                std.log.err("bluray: failed to build display frame: {}\n", .{err});
-                continue;
-            };
-            protocol.appendStrToCmdList(allocator, &cmd_parts, 2, 1, &line2buf) catch |err| {
-                std.log.err("bluray: failed to build display frame: {}\n", .{err});
-                continue;
-            };
-            sent_line1 = true;
-            sent_line2 = true;
-        } else if (line1_changed) {
-            // Send only the columns that moved -- see `appendChangedColsToCmdList`.
-            protocol.appendChangedColsToCmdList(allocator, &cmd_parts, 1, &last_line1, &linebuf) catch |err| {
-                std.log.err("bluray: failed to build display frame: {}\n", .{err});
-                continue;
-            };
-            sent_line1 = true;
-        } else if (line2_changed) {
-            // Line 2 yields to line 1 -- see this function's own doc.
-            protocol.appendChangedColsToCmdList(allocator, &cmd_parts, 2, &last_line2, &line2buf) catch |err| {
-                std.log.err("bluray: failed to build display frame: {}\n", .{err});
-                continue;
-            };
-            sent_line2 = true;
-        }
-
-        // Covers everything above: reading `draw`, the diff, and building
-        // `cmd_parts` -- all arithmetic and `memcmp`, so this should read
-        // close to zero. Read unconditionally (not gated on `timing_on`, the
-        // way `.timing`'s own breakdown line is) since it also feeds the
-        // slow-send warning below, which has to stay on regardless of debug
-        // config -- a send only happens when there is actually something to
-        // send, so this is not the same cost as reading the clock on every
-        // idle poll.
-        const t_built_ms: i64 = time.nowMillis(io);
-
-        if (cmd_parts.items.len > 0) {
-            // Logged on every attempt, not just failures -- this is the one
-            // point that can confirm or rule out the send path itself when the
-            // panel and the `cue -> ...`/`line2 source -> ...` logs disagree
-            // about what should be on screen.
-            const report_line2 = sent_line2 and line2_changed and dbg.enabled(.serial);
-            var readable: std.ArrayList(u8) = .empty;
-            defer readable.deinit(allocator);
-            if (report_line2) vorne_charset.decodeToUtf8(allocator, &readable, &line2buf) catch {};
-
-            const send_result = protocol.sendUnitDisplayCmd(allocator, port, 1, cmd_parts.items);
-            const t_sent_ms = time.nowMillis(io);
-            const send_wait_ms = t_sent_ms - t_built_ms;
-            if (timing_on) {
-                dbg.print(.timing,
-                    "bluray sender: build={d}ms send_wait={d}ms total={d}ms line1={} line2={} full={}\n",
-                    .{
-                        t_built_ms - now_ms,
-                        send_wait_ms,
-                        t_sent_ms - now_ms,
-                        sent_line1,
-                        sent_line2,
-                        full_redraw,
-                    },
-                );
-            }
-            if (send_result) |replied| {
-                if (replied) {
-                    // Only update the "what has the panel actually been
-                    // shown" record when the panel *confirmed* it -- writing
-                    // succeeding is not the same thing (see `protocol.send`'s
-                    // doc). Recording an unconfirmed frame as shown is what
-                    // produced a clock digit frozen mid-rollover on hardware:
-                    // the next pass would diff against a record that had
-                    // silently advanced past whatever the panel actually
-                    // still displayed, and send only the columns *it*
-                    // believed had changed since then -- permanently
-                    // stranding the rest.
-                    if (sent_line1) {
-                        last_line1 = linebuf;
-                        have_last1 = true;
-                    }
-                    if (sent_line2) {
-                        last_line2 = line2buf;
-                        have_last2 = true;
-                    }
-                    if (report_line2) {
-                        dbg.print(.serial, "bluray: sending line 2: \"{s}\" send status: success\n", .{readable.items});
-                    }
-                    // Unconditional (like the collator's own "Display pass
-                    // late" report), and deliberately worded to lay blame on
-                    // the wire/panel rather than the render loop: the
-                    // collator can no longer stall on this send at all (see
-                    // `senderLoop`'s own doc), so a slow reply here used to
-                    // show up nowhere except as a misattributed late collator
-                    // pass -- or, before that split existed at all, as
-                    // exactly the kind of periodic stutter a full
-                    // `FORCE_REFRESH_MS` redraw (a bigger frame, so a bigger
-                    // target for the panel to be slow answering) would
-                    // produce with no accompanying deadline warning anywhere.
-                    if (send_wait_ms > send_ewma_ms * SEND_SLOW_MULTIPLE + SEND_SLOW_MARGIN_MS or
-                        send_wait_ms > SEND_SLOW_ABSOLUTE_MS)
-                    {
-                        slow_sends += 1;
-                        std.log.warn(
-                            "bluray: serial comm slow: panel took {d} ms to reply (usually ~{d} ms), {d} so far -- this is the wire/panel, not the render loop\n",
-                            .{ send_wait_ms, send_ewma_ms, slow_sends },
-                        );
-                    } else {
-                        // Fed from *ordinary* confirmed sends only -- flagged
-                        // ones excluded, not just timeouts (see
-                        // `send_ewma_ms`'s own doc for the timeout half of
-                        // this). A cluster of consecutive slow replies would
-                        // otherwise drag the baseline up after the first one,
-                        // raising the very threshold meant to catch the rest
-                        // of the cluster -- observed on hardware as a 96 ms
-                        // reply warning, immediately followed by a 108 ms
-                        // reply that stayed silent because the first spike had
-                        // already pushed the average (and so the threshold)
-                        // up enough to swallow the second. Keeping the
-                        // baseline anchored to genuinely normal sends means
-                        // every send in a slow stretch gets compared against
-                        // the same "normal" figure, not against each other.
-                        send_ewma_ms = @divFloor(send_ewma_ms * 3 + send_wait_ms, 4);
-                    }
-                } else {
-                    // Unconditional, like the write-failure branch below: an
-                    // unconfirmed frame is exactly the situation
-                    // `FORCE_REFRESH_MS`/`missing_record` exist to recover
-                    // from, but that recovery only works if this is visible.
-                    // The record is deliberately left untouched -- see above
-                    // -- so the very next pass retries against last known-good
-                    // content rather than compounding the gap.
-                    std.log.warn("bluray: display did not confirm frame (no reply within {d} ms)\n", .{protocol.timeout_ms});
-                }
-            } else |err| {
-                // Unconditional: a frame that did not reach the panel is an
-                // operational fault, not diagnostic chatter, and suppressing
-                // it because `serial` happens to be switched off would hide
-                // the single most useful line in the log.
-                std.log.err("bluray: failed to send display frame: {}\n", .{err});
-            }
-        } else {
-            // Nothing changed, so nothing to send -- wait a slice before
-            // checking `draw` again rather than busy-looping. When something
-            // *was* sent, loop straight back around instead: `protocol.send`
-            // already paced the wire by waiting for the reply, and checking
-            // immediately is what lets a tick that landed mid-send be picked
-            // up the instant this thread is free, rather than up to another
-            // `SENDER_IDLE_SLICE_MS` late.
-            io.sleep(.fromMilliseconds(SENDER_IDLE_SLICE_MS), .awake) catch return;
-        }
-    }
-}
+/// Hands a `Snapshot` from the polling thread to the display loops. A copy of
+/// a handful of words, so a plain `cell.Cell`: a display mid-read never holds
+/// up a poll landing, nor the other way round.
+const SnapshotCell = Cell(Snapshot);
 
 /// Poll the player on its own thread, publishing each result for the display.
 ///
-/// Runs until `stop` is set. Sleeps in short slices rather than straight
-/// through to the next poll so that a mode change is noticed promptly.
+/// Runs until `stop` is set. Sleeps straight through to the next poll the
+/// phase lock schedules, or indefinitely with no display in Blu-ray mode;
+/// `wake` cuts either short for a display entering or leaving, a resync, or
+/// stopping.
 fn pollLoop(
     io: Io,
     allocator: std.mem.Allocator,
     cell: *SnapshotCell,
     resync_requested: *std.atomic.Value(bool),
+    users: *std.atomic.Value(u32),
+    wake: *Event,
     stop: *std.atomic.Value(bool),
 ) void {
     var player = BlurayPlayer.init(io, allocator);
     defer player.deinit();
+    var polling = false;
+
+    while (true) {
+        // Taken before anything is looked at, `stop` included, so a ring
+        // after the look is not slept through.
+        const seen = wake.seq();
+        if (stop.load(.acquire)) break;
+
+        // Nobody in Blu-ray mode: leave the player alone, and start the next
+        // display that enters from a fresh lock, as if this thread had only
+        // just been started for it.
+        if (users.load(.acquire) == 0) {
+            if (polling) {
+                polling = false;
+                player.deinit();
+                player = BlurayPlayer.init(io, allocator);
+                cell.publish(.{});
+                dbg.print(.bluray, "pollLoop: no Blu-ray display left, polling paused\n", .{});
+            }
+            wake.wait(seen, std.math.maxInt(i64));
+            continue;
+        }
+        polling = true;
 
-    while (!stop.load(.acquire)) {
         // A one-shot signal from the web page: `swap` both reads and clears it
         // atomically, so a request cannot be lost or double-fired between the
         // check and the reset.
@@ -1428,11 +1143,7 @@ fn pollLoop(
         player.poll();
         cell.publish(player.snapshot());
 
-        const now_ms = time.nowMillis(io);
-        const wait_ms = @min(player.lock.next_poll_ms - now_ms, POLL_THREAD_SLICE_MS);
-        if (wait_ms > 0) {
-            io.sleep(.fromMilliseconds(wait_ms), .awake) catch return;
-        }
+        wake.wait(seen, player.lock.next_poll_ms - time.nowMillis(io));
     }
 }
 
@@ -1655,6 +1366,9 @@ pub const BlurayPlayer = struct {
         //     of it.
         const after = LockObservable.capture(&self.lock);
         after.logChangesFrom(before, kind);
+        if (after.locked != before.locked) {
+            metrics.lock_transitions.of(if (after.locked) .locked else .searching).inc();
+        }
 
         if (self.last_update_time == prev_sample_ms) {
             // The request went out but no sample landed: player off, CGI
@@ -1769,6 +1483,7 @@ pub const BlurayPlayer = struct {
         defer self.allocator.free(response);
         const recv_ms = time.nowMillis(self.io);
         self.last_rtt_ms = recv_ms - sent_ms;
+        metrics.poll_time.observe(self.last_rtt_ms * std.time.us_per_ms);
         // The player read its own clock somewhere inside the request window.
         // The midpoint is the least-biased estimate; timestamping on arrival
         // would bias every sample late by roughly a full round trip.
@@ -2181,6 +1896,34 @@ test "nextTickMs marks exactly when playTimeSeconds increments, whatever the lea
     try std.testing.expectEqual(before + 1, snap.playTimeSeconds(tick));
 }
 
+test "every display takes the same cue list, freed once the last lets go" {
+    var cell: CueCell = .{};
+    const list = try webvtt.parse(std.testing.allocator, "WEBVTT\n\n00:00:01.000 --> 00:00:02.000\nHELLO\n");
+    cell.publish(try SharedCues.create(std.testing.allocator, list));
+
+    var seen_a: u64 = 0;
+    var seen_b: u64 = 0;
+    const a = (cell.take(&seen_a) orelse return error.TestExpectedUpdate).?;
+    const b = (cell.take(&seen_b) orelse return error.TestExpectedUpdate).?;
+    try std.testing.expectEqual(a, b);
+    // Taken once per display, not once overall.
+    try std.testing.expectEqual(@as(??*SharedCues, null), cell.take(&seen_a));
+    // A reader keeping no `seen` gets its own reference too.
+    const c = cell.retain().?;
+    try std.testing.expectEqual(a, c);
+    c.release();
+
+    // Clearing the selection reaches both, and the list outlives the cell's
+    // hold on it until both displays have let go -- the testing allocator
+    // reports a leak or a double free otherwise.
+    cell.publish(null);
+    try std.testing.expectEqual(@as(?*SharedCues, null), (cell.take(&seen_a) orelse return error.TestExpectedUpdate));
+    try std.testing.expectEqualStrings("HELLO", b.list.cues[0].text);
+    a.release();
+    b.release();
+    cell.deinit();
+}
+
 test "authValue is uppercase hex SHA-256 of key ++ nonce" {
     // SHA-256("ab"), i.e. key "a" concatenated with nonce "b".
     const expected = "FB8E20FC2E4C3F248C60C39BD652F3C1347298BB977B8B4D5903B85055620603";
@@ -0,0 +1,443 @@
+//! Several M1000s on one RS-485 bus, each showing its own content.
+//!
+//! Every unit gets a `Unit`: a "latest wins" slot its render loop publishes
+//! two lines into, exactly as a mode's collator publishes to its
+//! `render.DrawCell`, plus the scheduler's record of what that unit has actually
+//! been shown. One scheduler thread (`Bus.run`) owns the port and decides,
+//! pass by pass, which single frame goes on the wire next:
+//!
+//! 1. **A group frame**, when every unit on the bus wants the same text on a
+//!    line and at least one is not showing it. A group frame (`u` rather than
+//!    `U`) is rendered by every unit in the group at once, so identical
+//!    content -- the time of day on a row of clocks -- costs one frame however
+//!    many panels there are. This is what keeps bus load growing slower than
+//!    the panel count.
+//! 2. **Otherwise a unit frame**, round robin: the search for a unit with
+//!    something to send starts just past whichever unit was served last, so a
+//!    panel whose content changes constantly (a scrolling marquee) cannot
+//!    starve one that changes once a second. Within a unit the rules are
+//!    `render.zig`'s `senderLoop`'s: only the columns that moved, line 1
+//!    before line 2, and a full redraw when the record is missing, stale, or
+//!    asked for.
+//!
+//! RS-485 is half duplex: a unit answering while the host is still talking
+//! collides with it. So the bus runs the transport stop-and-wait -- one unit
+//! frame outstanding at a time -- whatever `vorne_config.jsonc`'s window says,
+//! and a group frame is followed by a pause for the panels' turnaround (see
+//! `transport.Transport.broadcast`) since none of them will answer it.
+//!
+//! Group frames are never confirmed, so what they set in each unit's record
+//! is taken on trust. The per-unit full redraw every `REFRESH_MS`, which *is*
+//! confirmed, is what catches a unit that missed one.
+//!
+//! Each unit's record is published to its `Unit.showing` cell as it changes,
+//! for the web page's status API and live mirror, the way a port's sender
+//! publishes `serial.SerialPort.shown`.
+
+const std = @import("std");
+const Io = std.Io;
+const dbg = @import("debug_log.zig");
+const protocol = @import("protocol.zig");
+const serial = @import("serial.zig");
+const str_utils = @import("str_utils.zig");
+const time = @import("time.zig");
+const mode_mod = @import("mode.zig");
+const Cell = @import("cell.zig").Cell;
+const Event = @import("event.zig").Event;
+const realtime = @import("realtime.zig");
+const panel_mirror = @import("panel_mirror.zig");
+
+const maxbufsz = str_utils.maxbufsz;
+
+pub const max_units = 8;
+pub const lines = 2;
+
+pub const Line = [maxbufsz]u8;
+
+/// How often each unit is redrawn in full by unit address, and so confirmed,
+/// regardless of what group frames have told its record -- see the file doc.
+const REFRESH_MS: i64 = 5000;
+
+/// Longest the scheduler sleeps with nothing to send. A publish, a redraw
+/// request or a refresh falling due wakes it at once (`Bus.wake`); this only
+/// bounds how soon it notices a re-init request or `stop`.
+const IDLE_SLICE_MS: i64 = 100;
+
+/// One panel on the bus.
+pub const Unit = struct {
+    address: u8,
+
+    /// What the render loop last published, null before its first pass --
+    /// a `cell.Cell` like `render.zig`'s `DrawCell`, and "latest wins" for
+    /// the same reason.
+    want: Cell(?[lines]Line) = .init(null),
+    /// Set by the render loop (a cue boundary, say) to ask for a full redraw.
+    redraw_requested: std.atomic.Value(bool) = .init(false),
+
+    // Owned by the scheduler thread.
+    shown: [lines]Line = undefined,
+    have_shown: [lines]bool = @splat(false),
+    last_refresh_ms: i64 = 0,
+
+    /// `shown`, as of the last frame that set it, once both lines are known;
+    /// null before. Published by the scheduler, read from any thread.
+    showing: Cell(?[lines]Line) = .init(null),
+
+    /// What this unit should show now. Safe from any thread.
+    pub fn publish(self: *Unit, line1: *const Line, line2: *const Line) void {
+        self.want.publish(.{ line1.*, line2.* });
+    }
+
+    pub fn requestRedraw(self: *Unit) void {
+        self.redraw_requested.store(true, .release);
+        // Forwarded to the scheduler's `Bus.wake`, as a publish is.
+        self.want.changed.notify();
+    }
+
+    fn read(self: *const Unit) ?[lines]Line {
+        return self.want.read();
+    }
+
+    fn forget(self: *Unit) void {
+        self.have_shown = @splat(false);
+    }
+
+    /// Publish `shown` to `showing` and wake the web server's mirror. Not
+    /// until both lines are known, and a forgotten record keeps what was
+    /// published last, as a port's `shown` does.
+    fn publishShown(self: *Unit) void {
+        if (!self.have_shown[0] or !self.have_shown[1]) return;
+        self.showing.publish(self.shown);
+        panel_mirror.notify();
+    }
+};
+
+/// Which frame the scheduler built, so its outcome can be recorded.
+const Planned = struct {
+    /// Index into `Bus.units`, or null for a group frame.
+    unit: ?usize,
+    lines: [lines]bool,
+    full: bool = false,
+};
+
+pub const Bus = struct {
+    port: *serial.SerialPort,
+    /// The group address every unit on this bus answers to.
+    group: u8,
+    units: [max_units]Unit = undefined,
+    n_units: usize = 0,
+    /// Where the next round-robin search starts.
+    next_unit: usize = 0,
+    /// Rung by every unit's `want` while `run` is running, so the scheduler
+    /// sleeps on one word for all of them.
+    wake: Event = .{},
+
+    pub fn init(port: *serial.SerialPort, group: u8) Bus {
+        // Half duplex -- see the file doc.
+        port.transport.options.window_frames = 1;
+        return .{ .port = port, .group = group };
+    }
+
+    /// Add the unit at `address`. Before `run` starts only; the returned
+    /// pointer stays valid for as long as the `Bus` does not move.
+    pub fn addUnit(self: *Bus, address: u8) !*Unit {
+        if (self.n_units == max_units) return error.TooManyUnits;
+        for (self.units[0..self.n_units]) |*u| {
+            if (u.address == address) return error.DuplicateAddress;
+        }
+        self.units[self.n_units] = .{ .address = address };
+        self.n_units += 1;
+        return &self.units[self.n_units - 1];
+    }
+
+    /// Initialize every unit, one by one so each is confirmed, and forget
+    /// whatever they were thought to show.
+    pub fn initUnits(self: *Bus) void {
+        for (self.units[0..self.n_units]) |*u| {
+            protocol.sendUnitDefaultInitCmd(self.port, u.address) catch |err| {
+                std.log.err("bus: failed to initialize unit {d}: {}\n", .{ u.address, err });
+            };
+            u.forget();
+        }
+    }
+
+    /// The scheduler: one frame per pass until `stop` is set. Also services
+    /// the web page's re-init request, since this thread owns the port.
+    pub fn run(self: *Bus, io: Io, stop: *std.atomic.Value(bool)) void {
+        var frame: protocol.FrameBuilder = undefined;
+        var wants: [max_units]?[lines]Line = undefined;
+        realtime.enterThread("bus");
+        const lateness = realtime.lateness(self.port.device, null, .bus);
+        for (self.units[0..self.n_units]) |*u| u.want.changed.forwardTo(&self.wake);
+        defer {
+            for (self.units[0..self.n_units]) |*u| u.want.changed.forwardTo(null);
+        }
+        while (!stop.load(.acquire)) {
+            // Taken before the units are read, so a publish landing after
+            // the read still cuts the sleep below short.
+            const seen = self.wake.seq();
+            if (mode_mod.takeReinitRequest()) {
+                std.log.info("bus: re-initializing all units\n", .{});
+                self.initUnits();
+            }
+            for (self.units[0..self.n_units], wants[0..self.n_units]) |*u, *w| w.* = u.read();
+            const now_ms = time.nowMillis(io);
+
+            const planned = self.plan(wants[0..self.n_units], now_ms, &frame) orelse {
+                self.idle(io, wants[0..self.n_units], now_ms, seen, lateness);
+                continue;
+            };
+            if (planned.unit) |i| {
+                const confirmed = protocol.sendFrame(self.port, &frame) catch |err| blk: {
+                    std.log.err("bus: failed to send to unit {d}: {}\n", .{ self.units[i].address, err });
+                    break :blk false;
+                };
+                self.commitUnit(i, &wants[i].?, planned, confirmed, now_ms);
+            } else {
+                protocol.broadcast(self.port, frame.finish()) catch |err| {
+                    std.log.err("bus: failed to send group frame: {}\n", .{err});
+                    continue;
+                };
+                self.commitGroup(wants[0..self.n_units], planned);
+            }
+        }
+    }
+
+    /// Sleep, every unit up to date, until one publishes or asks for a
+    /// redraw, or the first full refresh falls due.
+    fn idle(self: *Bus, io: Io, wants: []const ?[lines]Line, now_ms: i64, seen: u32, lateness: *realtime.Lateness) void {
+        var wake_ms = now_ms + IDLE_SLICE_MS;
+        for (self.units[0..self.n_units], wants) |*u, want| {
+            if (want != null) wake_ms = @min(wake_ms, u.last_refresh_ms + REFRESH_MS);
+        }
+        const sleep_ms = wake_ms - time.nowMillis(io);
+        self.wake.wait(seen, sleep_ms);
+        // Only a wake that ran to `wake_ms` was due at a set time.
+        if (sleep_ms > 0 and self.wake.seq() == seen) lateness.recordWake(io, wake_ms);
+    }
+
+    /// Choose and build the next frame, or null if every unit is up to date.
+    fn plan(self: *Bus, wants: []const ?[lines]Line, now_ms: i64, frame: *protocol.FrameBuilder) ?Planned {
+        if (self.n_units >= 2) {
+            for (0..lines) |l| {
+                if (self.planGroup(wants, l, frame)) return .{ .unit = null, .lines = onlyLine(l) };
+            }
+        }
+
+        for (0..self.n_units) |k| {
+            const i = (self.next_unit + k) % self.n_units;
+            const want = wants[i] orelse continue;
+            const unit = &self.units[i];
+            const full = !unit.have_shown[0] or !unit.have_shown[1] or
+                now_ms - unit.last_refresh_ms >= REFRESH_MS or
+                unit.redraw_requested.swap(false, .acq_rel);
+
+            frame.* = .init(protocol.single_crc16, unit.address, protocol.display_cmd);
+            var sent: [lines]bool = @splat(false);
+            if (full) {
+                for (0..lines) |l| {
+                    protocol.appendStrToFrame(frame, @intCast(l + 1), 1, &want[l]) catch unreachable;
+                }
+                sent = @splat(true);
+            } else {
+                // Line 1 first -- see `senderLoop`'s doc.
+                for (0..lines) |l| {
+                    if (std.mem.eql(u8, &unit.shown[l], &want[l])) continue;
+                    protocol.appendChangedColsToFrame(frame, @intCast(l + 1), &unit.shown[l], &want[l]) catch unreachable;
+                    sent[l] = true;
+                    break;
+                }
+                if (frame.payload().len == 0) continue;
+            }
+            self.next_unit = (i + 1) % self.n_units;
+            return .{ .unit = i, .lines = sent, .full = full };
+        }
+        return null;
+    }
+
+    /// Build a group frame for line `l` if every unit wants the same text
+    /// there and at least one is not showing it.
+    fn planGroup(self: *Bus, wants: []const ?[lines]Line, l: usize, frame: *protocol.FrameBuilder) bool {
+        const first = wants[0] orelse return false;
+        var stale = false;
+        // What every unit shows on this line, if they all show the same.
+        var common: ?*const Line = &self.units[0].shown[l];
+        for (self.units[0..self.n_units], wants) |*unit, maybe_want| {
+            const want = maybe_want orelse return false;
+            if (!std.mem.eql(u8, &want[l], &first[l])) return false;
+            if (!unit.have_shown[l] or !std.mem.eql(u8, &unit.shown[l], &want[l])) stale = true;
+            if (common) |c| {
+                if (!unit.have_shown[l] or !std.mem.eql(u8, &unit.shown[l], c)) common = null;
+            }
+        }
+        if (!stale) return false;
+
+        frame.* = .init(protocol.group_crc16, self.group, protocol.display_cmd);
+        const line: u8 = @intCast(l + 1);
+        if (common) |prev| {
+            protocol.appendChangedColsToFrame(frame, line, prev, &first[l]) catch unreachable;
+        } else {
+            protocol.appendStrToFrame(frame, line, 1, &first[l]) catch unreachable;
+        }
+        return true;
+    }
+
+    fn commitUnit(self: *Bus, i: usize, want: *const [lines]Line, planned: Planned, confirmed: bool, now_ms: i64) void {
+        const unit = &self.units[i];
+        if (!confirmed) {
+            // Unknown now -- redraw in full next time, as `senderLoop` does.
+            unit.forget();
+            dbg.print(.serial, "bus: unit {d} did not confirm a frame\n", .{unit.address});
+            return;
+        }
+        for (0..lines) |l| {
+            if (!planned.lines[l]) continue;
+            unit.shown[l] = want[l];
+            unit.have_shown[l] = true;
+        }
+        if (planned.full) unit.last_refresh_ms = now_ms;
+        unit.publishShown();
+    }
+
+    fn commitGroup(self: *Bus, wants: []const ?[lines]Line, planned: Planned) void {
+        for (self.units[0..self.n_units], wants) |*unit, want| {
+            for (0..lines) |l| {
+                if (!planned.lines[l]) continue;
+                unit.shown[l] = want.?[l];
+                unit.have_shown[l] = true;
+            }
+            unit.publishShown();
+        }
+    }
+};
+
+fn onlyLine(l: usize) [lines]bool {
+    var sent: [lines]bool = @splat(false);
+    sent[l] = true;
+    return sent;
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+fn lineOf(text: []const u8) Line {
+    var line: Line = undefined;
+    str_utils.clearVorneLineBuf(&line) catch unreachable;
+    str_utils.copyLeftJustify(&line, text, str_utils.maxchars, null) catch unreachable;
+    return line;
+}
+
+/// A bus with no port, for exercising `plan` alone.
+fn testBus(addresses: []const u8) Bus {
+    var bus: Bus = .{ .port = undefined, .group = 0 };
+    for (addresses) |a| _ = bus.addUnit(a) catch unreachable;
+    return bus;
+}
+
+fn settle(bus: *Bus, wants: []const ?[lines]Line) void {
+    for (bus.units[0..bus.n_units], wants) |*u, w| {
+        u.shown = w.?;
+        u.have_shown = @splat(true);
+        u.last_refresh_ms = 0;
+    }
+}
+
+test "content every unit shares goes out once, by group address" {
+    var bus = testBus(&.{ 1, 2, 3 });
+    const wants = [_]?[lines]Line{
+        .{ lineOf("12:00:01"), lineOf("clock") },
+        .{ lineOf("12:00:01"), lineOf("bluray") },
+        .{ lineOf("12:00:01"), lineOf("cues") },
+    };
+    var shown = wants;
+    shown[0].?[0] = lineOf("12:00:00");
+    shown[1].?[0] = lineOf("12:00:00");
+    shown[2].?[0] = lineOf("12:00:00");
+    settle(&bus, &shown);
+
+    var frame: protocol.FrameBuilder = undefined;
+    const planned = bus.plan(&wants, 1000, &frame).?;
+    try testing.expectEqual(@as(?usize, null), planned.unit);
+    // Every unit showed the same thing, so the group frame is a diff.
+    try testing.expectEqualStrings(protocol.ESC ++ "1;8C1", frame.payload());
+    try testing.expectEqual(protocol.group_crc16[1], frame.buf[1]);
+
+    bus.commitGroup(&wants, planned);
+    try testing.expectEqual(@as(?Planned, null), bus.plan(&wants, 1000, &frame));
+}
+
+test "units with different changes are served round robin" {
+    var bus = testBus(&.{ 1, 2 });
+    const before = [_]?[lines]Line{
+        .{ lineOf("a"), lineOf("x") },
+        .{ lineOf("b"), lineOf("y") },
+    };
+    settle(&bus, &before);
+    const after = [_]?[lines]Line{
+        .{ lineOf("a"), lineOf("x1") },
+        .{ lineOf("b"), lineOf("y1") },
+    };
+
+    var frame: protocol.FrameBuilder = undefined;
+    const first = bus.plan(&after, 1000, &frame).?;
+    try testing.expectEqual(@as(?usize, 0), first.unit);
+    // Unit 1 is not served again, although it is first in the list, until
+    // unit 2 has had its turn.
+    const second = bus.plan(&after, 1000, &frame).?;
+    try testing.expectEqual(@as(?usize, 1), second.unit);
+    try testing.expectEqual(@as(u8, '2'), frame.buf[2]);
+}
+
+test "a unit that misses a frame is redrawn in full" {
+    var bus = testBus(&.{ 1, 2 });
+    const wants = [_]?[lines]Line{
+        .{ lineOf("a"), lineOf("x") },
+        .{ lineOf("b"), lineOf("y") },
+    };
+    settle(&bus, &wants);
+    var frame: protocol.FrameBuilder = undefined;
+    try testing.expectEqual(@as(?Planned, null), bus.plan(&wants, 1000, &frame));
+
+    bus.commitUnit(1, &wants[1].?, .{ .unit = 1, .lines = .{ true, false } }, false, 1000);
+    const planned = bus.plan(&wants, 1000, &frame).?;
+    try testing.expectEqual(@as(?usize, 1), planned.unit);
+    try testing.expect(planned.full);
+}
+
+test "the periodic refresh is per unit, by unit address" {
+    var bus = testBus(&.{ 1, 2 });
+    const wants = [_]?[lines]Line{
+        .{ lineOf("same"), lineOf("same") },
+        .{ lineOf("same"), lineOf("same") },
+    };
+    settle(&bus, &wants);
+    var frame: protocol.FrameBuilder = undefined;
+    const planned = bus.plan(&wants, REFRESH_MS, &frame).?;
+    try testing.expect(planned.unit != null);
+    try testing.expect(planned.full);
+}
+
+test "what a unit shows is published once both lines are known" {
+    var bus = testBus(&.{ 1, 2 });
+    const wants = [_]?[lines]Line{
+        .{ lineOf("12:00:00"), lineOf("clock") },
+        .{ lineOf("12:00:00"), lineOf("bluray") },
+    };
+
+    bus.commitUnit(0, &wants[0].?, .{ .unit = 0, .lines = .{ true, false } }, true, 1000);
+    try testing.expectEqual(@as(?[lines]Line, null), bus.units[0].showing.read());
+    bus.commitUnit(0, &wants[0].?, .{ .unit = 0, .lines = .{ false, true } }, true, 1000);
+    try testing.expectEqualSlices(u8, &wants[0].?[1], &bus.units[0].showing.read().?[1]);
+
+    // A group frame is taken on trust, as in the scheduler's own record.
+    bus.commitUnit(1, &wants[1].?, .{ .unit = 1, .lines = .{ false, true } }, true, 1000);
+    bus.commitGroup(&wants, .{ .unit = null, .lines = .{ true, false } });
+    try testing.expectEqualSlices(u8, &wants[1].?[0], &bus.units[1].showing.read().?[0]);
+
+    // A frame the unit did not confirm leaves the last publication standing.
+    bus.commitUnit(1, &wants[1].?, .{ .unit = 1, .lines = .{ true, false } }, false, 1000);
+    try testing.expect(bus.units[1].showing.read() != null);
+}
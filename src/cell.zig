@@ -0,0 +1,208 @@
+//! A value handed from one thread to others without either side waiting.
+//!
+//! Every hand-over in the display pipeline used to be a spin lock around a
+//! copy: the poller's snapshot, the collator's frame, the selected cue file.
+//! A spin lock is only as short as its holder is running, though, and a
+//! holder descheduled mid-copy leaves the display loop spinning until the
+//! scheduler gets back to it -- precisely the jitter `render.DEADLINE_SLACK_MS`
+//! reports. `Cell` is a sequence lock over two slots instead, which the VLC
+//! receiver's status cell had already shown the way to:
+//!
+//! - A write fills the slot the last publication is *not* in, then makes it
+//!   the current one. It never waits for a reader. Writers wait only for each
+//!   other, and every cell here has a single writer in practice.
+//! - A read copies the current slot and checks the slot's sequence number did
+//!   not move under it. It never waits for a writer either: a slot is only
+//!   overwritten once the writer has published twice since the reader picked
+//!   it, and then the reader simply copies the newer one. No reader can be
+//!   held up by a writer that has stopped running.
+//!
+//! Each publication is numbered, so a reader that only wants what is new --
+//! the cue loop's selection, a display's cue list -- checks one atomic load
+//! (`take`) rather than copying anything, and each rings the cell's
+//! `changed` event, so a reader with nothing else to do can sleep until the
+//! next one rather than polling for it.
+//!
+//! Right for values up to a few hundred bytes, all the pipeline passes: the
+//! copy is the only cost, and a reader retrying one is the rare case. Values
+//! holding pointers need more than this -- something has to keep the
+//! pointee alive until readers are done with it; see `bluray.CueCell`.
+
+const std = @import("std");
+const Event = @import("event.zig").Event;
+
+pub fn Cell(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        /// How many publications there have been; the latest is in
+        /// `slots[generation & 1]`. 0 for the value the cell started with.
+        generation: std.atomic.Value(u64) = .init(0),
+        slots: [2]Slot,
+        /// Serializes writers. Never touched by readers.
+        writer: std.atomic.Value(bool) = .init(false),
+        /// Rung after every publication.
+        changed: Event = .{},
+
+        const Slot = struct {
+            /// Odd while the slot is being written.
+            seq: std.atomic.Value(u64) = .init(0),
+            /// Which publication the slot holds, written with `value`.
+            generation: u64 = 0,
+            value: T,
+        };
+
+        /// A value and the publication it came from.
+        pub const Tagged = struct {
+            value: T,
+            generation: u64,
+        };
+
+        pub fn init(value: T) Self {
+            return .{ .slots = .{ .{ .value = value }, .{ .value = value } } };
+        }
+
+        pub fn publish(self: *Self, value: T) void {
+            while (self.writer.cmpxchgWeak(false, true, .acquire, .monotonic) != null) {
+                std.atomic.spinLoopHint();
+            }
+            defer self.writer.store(false, .release);
+
+            const generation = self.generation.load(.monotonic) + 1;
+            const slot = &self.slots[generation & 1];
+            const seq = slot.seq.load(.monotonic);
+            // Odd while the copy is in progress. Acquire, so none of the
+            // copy's stores can be seen before readers can see the odd count.
+            _ = slot.seq.fetchAdd(1, .acquire);
+            slot.generation = generation;
+            slot.value = value;
+            slot.seq.store(seq + 2, .release);
+            self.generation.store(generation, .release);
+            self.changed.notify();
+        }
+
+        /// The latest value and its publication.
+        pub fn readTagged(self: *const Self) Tagged {
+            while (true) {
+                const slot = &self.slots[self.generation.load(.acquire) & 1];
+                const before = slot.seq.load(.acquire);
+                if (before & 1 == 0) {
+                    const copy: Tagged = .{ .value = slot.value, .generation = slot.generation };
+                    // A release read-modify-write, so the copy's loads cannot
+                    // move past the re-check -- a seqlock's read barrier
+                    // without a fence. `@constCast` only for the RMW: it
+                    // stores back what it read.
+                    const after = @constCast(&slot.seq).fetchAdd(0, .release);
+                    if (after == before) return copy;
+                }
+                // The writer has lapped this slot; the other is newer.
+                std.atomic.spinLoopHint();
+            }
+        }
+
+        pub fn read(self: *const Self) T {
+            return self.readTagged().value;
+        }
+
+        /// The latest value if it is newer than `seen.*`, which is moved up to
+        /// it; null otherwise. Several readers can each take every
+        /// publication, as each keeps its own `seen`.
+        pub fn take(self: *const Self, seen: *u64) ?T {
+            if (self.generation.load(.acquire) == seen.*) return null;
+            const tagged = self.readTagged();
+            seen.* = tagged.generation;
+            return tagged.value;
+        }
+    };
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+test "a cell hands over the latest value, once per reader with take" {
+    var cell: Cell(u32) = .init(7);
+    try testing.expectEqual(@as(u32, 7), cell.read());
+
+    var seen_a: u64 = 0;
+    var seen_b: u64 = 0;
+    try testing.expectEqual(@as(?u32, null), cell.take(&seen_a));
+
+    cell.publish(1);
+    cell.publish(2);
+    cell.publish(3);
+    try testing.expectEqual(@as(?u32, 3), cell.take(&seen_a)); // the latest, not a queue
+    try testing.expectEqual(@as(?u32, null), cell.take(&seen_a));
+    try testing.expectEqual(@as(?u32, 3), cell.take(&seen_b));
+    try testing.expectEqual(@as(u64, 3), cell.readTagged().generation);
+}
+
+/// A value that is torn if its words disagree.
+const Wide = struct {
+    words: [24]u64,
+
+    fn of(n: u64) Wide {
+        return .{ .words = @splat(n) };
+    }
+
+    fn whole(self: Wide) bool {
+        for (self.words) |w| {
+            if (w != self.words[0]) return false;
+        }
+        return true;
+    }
+};
+
+const Stress = struct {
+    cell: Cell(Wide) = .init(.of(0)),
+    done: std.atomic.Value(bool) = .init(false),
+    torn: std.atomic.Value(u32) = .init(0),
+    backwards: std.atomic.Value(u32) = .init(0),
+    reads: std.atomic.Value(u64) = .init(0),
+
+    fn write(self: *Stress, from: u64, count: u64) void {
+        var n = from;
+        while (n < from + count) : (n += 1) self.cell.publish(.of(n));
+    }
+
+    fn readUntilDone(self: *Stress) void {
+        var last_generation: u64 = 0;
+        var reads: u64 = 0;
+        var seen: u64 = 0;
+        while (!self.done.load(.acquire)) : (reads += 1) {
+            const tagged = self.cell.readTagged();
+            if (!tagged.value.whole()) _ = self.torn.fetchAdd(1, .monotonic);
+            if (tagged.generation < last_generation) _ = self.backwards.fetchAdd(1, .monotonic);
+            last_generation = tagged.generation;
+            if (self.cell.take(&seen)) |value| {
+                if (!value.whole()) _ = self.torn.fetchAdd(1, .monotonic);
+            }
+        }
+        _ = self.reads.fetchAdd(reads, .monotonic);
+    }
+};
+
+test "readers racing writers never see a torn or older value" {
+    var stress: Stress = .{};
+    var readers: [3]std.Thread = undefined;
+    for (&readers) |*t| t.* = try std.Thread.spawn(.{}, Stress.readUntilDone, .{&stress});
+
+    // Two writers, though every real cell has one, so writers racing each
+    // other are covered too.
+    const per_writer = 200_000;
+    const writers = [_]std.Thread{
+        try std.Thread.spawn(.{}, Stress.write, .{ &stress, 1, per_writer }),
+        try std.Thread.spawn(.{}, Stress.write, .{ &stress, 1_000_000, per_writer }),
+    };
+    for (writers) |t| t.join();
+    stress.done.store(true, .release);
+    for (readers) |t| t.join();
+
+    try testing.expectEqual(@as(u32, 0), stress.torn.load(.monotonic));
+    try testing.expectEqual(@as(u32, 0), stress.backwards.load(.monotonic));
+    try testing.expectEqual(@as(u64, 2 * per_writer), stress.cell.readTagged().generation);
+    try testing.expect(stress.reads.load(.monotonic) > 0);
+    try testing.expect(stress.cell.read().whole());
+}
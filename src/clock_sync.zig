@@ -0,0 +1,532 @@
+//! Where the VLC status server's clock stands against ours, and where VLC's
+//! play position stands as of any instant on our clock.
+//!
+//! Every status packet says two things: the play position, and the server's
+//! own clock reading when it was sent. The display used to extrapolate the
+//! position from our wall clock minus the server's, which silently assumed
+//! the two hosts agree to the millisecond -- a Windows host a few hundred ms
+//! off showed the play clock flipping that far from VLC's own second. Taking
+//! arrival times instead is no better: every packet's network and scheduling
+//! delay lands in the displayed position as wobble.
+//!
+//! So the server's timestamps are treated as a one-way time-transfer
+//! protocol, NTP-style:
+//!
+//! - `ClockSync` maps our monotonic clock onto the server's from (send time,
+//!   arrival time) pairs. Arrival minus send is the clock offset plus that
+//!   packet's delay; delay is never negative and its floor is steady, so the
+//!   least-delayed packets in each window of server time trace the offset,
+//!   and a line fitted through those window minima gives both the offset and
+//!   the rate at which the two clocks drift apart. Windows whose minimum
+//!   still sits well above the line -- every packet in them delayed -- are
+//!   rejected before the final fit. What cannot be recovered one-way is the
+//!   floor of the delay itself; it stays folded into the offset, which on a
+//!   LAN is a fraction of a millisecond.
+//! - `PlayClock` models the play position in *server* time, phase-locked to
+//!   VLC's reports the way `phase_lock.PhaseLock` locks onto the Blu-ray
+//!   player's: a rebase on a jump, small corrections folded in gradually, and
+//!   `locked` once the reports agree with the model. The reports are stamped
+//!   on the server, so network jitter never reaches this half at all; what
+//!   it smooths is VLC's own granularity in reporting its position.
+//! - `Timeline` composes the two into a straight line on our clock, which is
+//!   all the display needs to know when the next second flips.
+//!
+//! Like `phase_lock.zig`, free of I/O: `Receiver` feeds samples in from its
+//! thread, and the tests drive a simulated server deterministically.
+
+const std = @import("std");
+const Io = std.Io;
+const Phase = @import("phase_lock.zig").Phase;
+
+/// Our clock for everything here: monotonic, so a wall-clock step on this
+/// host cannot look like the server's clock jumping.
+pub fn localMicros(io: Io) i64 {
+    return @intCast(@divFloor(Io.Timestamp.now(io, .awake).nanoseconds, std.time.ns_per_us));
+}
+
+/// Server time each window's least-delayed sample is taken from. A heartbeat
+/// comes every second, a burst of four on every change, so a window holds a
+/// handful of samples at least.
+pub const window_us: i64 = 4 * std.time.us_per_s;
+/// Windows kept for the fit: about two minutes of server time, long enough
+/// for a crystal's drift to show above the delay jitter.
+pub const max_windows = 32;
+/// Fewer windows, or a shorter span, than this and the rate is not fitted:
+/// the offset alone is better than a slope fitted to noise.
+pub const min_fit_windows = 4;
+pub const min_fit_span_us: i64 = 10 * std.time.us_per_s;
+/// The most two clocks can plausibly drift apart: well beyond any crystal,
+/// so a fit past it is noise, and clamped.
+pub const max_skew: f64 = 500e-6;
+/// A window whose minimum sits this many times the median residual above
+/// the line -- every packet in it delayed -- is left out of the final fit.
+/// Never tighter than `min_reject_us`, or on a quiet LAN ordinary
+/// microsecond scatter would be thrown away.
+pub const reject_factor: f64 = 4;
+pub const min_reject_us: f64 = 2 * std.time.us_per_ms;
+/// A packet arriving this long before the model says it could have -- a
+/// negative delay -- means one of the clocks was stepped; start over.
+pub const step_us: i64 = 50 * std.time.us_per_ms;
+/// Server time going backwards by more than this is a different server run
+/// (its monotonic clock restarted), not reordering; start over.
+pub const restart_us: i64 = std.time.us_per_s;
+
+pub const ClockSync = struct {
+    /// The first sample, which everything else is stored relative to so the
+    /// fit works on small numbers.
+    have_base: bool = false,
+    base_server_us: i64 = 0,
+    base_local_us: i64 = 0,
+    /// Newest server time seen, relative to the base.
+    last_x_us: i64 = 0,
+    /// Oldest first. `x` is server time since the base; `y` is arrival minus
+    /// send, relative to the base pair: offset change plus delay.
+    windows: [max_windows]Window = undefined,
+    n_windows: usize = 0,
+    /// The fit, `y = intercept + slope * x`: where arrival minus send would
+    /// sit for a packet with the floor delay.
+    fitted: bool = false,
+    slope: f64 = 0,
+    intercept_us: f64 = 0,
+    /// Times the estimate was thrown away, for the logs.
+    resets: u32 = 0,
+
+    const Window = struct { start_us: i64, x_us: i64, y_us: i64 };
+
+    /// Fold in a packet sent at `server_us` on the server's clock that
+    /// arrived at `local_us` on ours.
+    pub fn sample(self: *ClockSync, server_us: i64, local_us: i64) void {
+        if (!self.have_base) self.rebase(server_us, local_us);
+        if (server_us - self.base_server_us < self.last_x_us - restart_us) {
+            self.restart(server_us, local_us);
+        }
+        const x = server_us - self.base_server_us;
+        const y = (local_us - self.base_local_us) - x;
+        if (self.fitted and @as(f64, @floatFromInt(y)) < self.lineAt(x) - @as(f64, @floatFromInt(step_us))) {
+            self.restart(server_us, local_us);
+            return self.sample(server_us, local_us);
+        }
+        self.last_x_us = @max(self.last_x_us, x);
+
+        if (self.n_windows > 0 and x - self.windows[self.n_windows - 1].start_us < window_us) {
+            const w = &self.windows[self.n_windows - 1];
+            if (y < w.y_us) {
+                w.x_us = x;
+                w.y_us = y;
+            }
+        } else {
+            if (self.n_windows == max_windows) {
+                std.mem.copyForwards(Window, self.windows[0 .. max_windows - 1], self.windows[1..max_windows]);
+                self.n_windows -= 1;
+            }
+            self.windows[self.n_windows] = .{ .start_us = x, .x_us = x, .y_us = y };
+            self.n_windows += 1;
+        }
+        self.fit();
+    }
+
+    /// The server's clock as of `local_us` on ours, or null before the first
+    /// sample.
+    pub fn toServer(self: *const ClockSync, local_us: i64) ?i64 {
+        if (!self.fitted) return null;
+        const l: f64 = @floatFromInt(local_us - self.base_local_us);
+        const x = (l - self.intercept_us) / (1 + self.slope);
+        return self.base_server_us + @as(i64, @intFromFloat(@round(x)));
+    }
+
+    /// Our clock when the server's read `server_us`.
+    pub fn toLocal(self: *const ClockSync, server_us: i64) ?i64 {
+        if (!self.fitted) return null;
+        const x = server_us - self.base_server_us;
+        return self.base_local_us + x + @as(i64, @intFromFloat(@round(self.lineAt(x))));
+    }
+
+    /// How much faster our clock runs than the server's, in parts per
+    /// million; for the logs.
+    pub fn skewPpm(self: *const ClockSync) f64 {
+        return self.slope * 1e6;
+    }
+
+    fn lineAt(self: *const ClockSync, x: i64) f64 {
+        return self.intercept_us + self.slope * @as(f64, @floatFromInt(x));
+    }
+
+    fn rebase(self: *ClockSync, server_us: i64, local_us: i64) void {
+        self.* = .{ .have_base = true, .base_server_us = server_us, .base_local_us = local_us, .resets = self.resets };
+    }
+
+    fn restart(self: *ClockSync, server_us: i64, local_us: i64) void {
+        self.resets += 1;
+        self.rebase(server_us, local_us);
+    }
+
+    fn fit(self: *ClockSync) void {
+        const windows = self.windows[0..self.n_windows];
+        self.fitted = windows.len > 0;
+        if (windows.len == 0) return;
+
+        var keep: [max_windows]bool = @splat(true);
+        const span = windows[windows.len - 1].x_us - windows[0].x_us;
+        if (windows.len < min_fit_windows or span < min_fit_span_us) {
+            self.slope = 0;
+        } else {
+            // A first fit through every window, to find the ones sitting well
+            // above the rest; then the fit that counts, without them.
+            var line = leastSquares(windows, &keep);
+            var residuals: [max_windows]f64 = undefined;
+            for (windows, residuals[0..windows.len]) |w, *r| {
+                r.* = @abs(@as(f64, @floatFromInt(w.y_us)) - (line.intercept + line.slope * @as(f64, @floatFromInt(w.x_us))));
+            }
+            const sorted = residuals[0..windows.len];
+            var by_size: [max_windows]f64 = undefined;
+            @memcpy(by_size[0..windows.len], sorted);
+            std.mem.sort(f64, by_size[0..windows.len], {}, std.sort.asc(f64));
+            const limit = @max(reject_factor * by_size[windows.len / 2], min_reject_us);
+            for (windows, residuals[0..windows.len], keep[0..windows.len]) |w, r, *k| {
+                // Only windows above the line: one below it is the
+                // least-delayed evidence there is.
+                const above = @as(f64, @floatFromInt(w.y_us)) > line.intercept + line.slope * @as(f64, @floatFromInt(w.x_us));
+                k.* = !(above and r > limit);
+            }
+            line = leastSquares(windows, &keep);
+            self.slope = std.math.clamp(line.slope, -max_skew, max_skew);
+        }
+
+        // The line through the least-delayed window once the slope is taken
+        // out: the fit's own intercept is an average, and so includes the
+        // typical delay rather than the floor.
+        var lowest: f64 = std.math.inf(f64);
+        for (windows, keep[0..windows.len]) |w, k| {
+            if (!k) continue;
+            lowest = @min(lowest, @as(f64, @floatFromInt(w.y_us)) - self.slope * @as(f64, @floatFromInt(w.x_us)));
+        }
+        self.intercept_us = lowest;
+    }
+
+    const Line = struct { intercept: f64, slope: f64 };
+
+    fn leastSquares(windows: []const Window, keep: *const [max_windows]bool) Line {
+        var n: f64 = 0;
+        var sx: f64 = 0;
+        var sy: f64 = 0;
+        for (windows, keep[0..windows.len]) |w, k| {
+            if (!k) continue;
+            n += 1;
+            sx += @floatFromInt(w.x_us);
+            sy += @floatFromInt(w.y_us);
+        }
+        if (n < 2) return .{ .intercept = if (n > 0) sy / n else 0, .slope = 0 };
+        const mx = sx / n;
+        const my = sy / n;
+        var sxx: f64 = 0;
+        var sxy: f64 = 0;
+        for (windows, keep[0..windows.len]) |w, k| {
+            if (!k) continue;
+            const dx = @as(f64, @floatFromInt(w.x_us)) - mx;
+            sxx += dx * dx;
+            sxy += dx * (@as(f64, @floatFromInt(w.y_us)) - my);
+        }
+        const slope = if (sxx > 0) sxy / sxx else 0;
+        return .{ .intercept = my - slope * mx, .slope = slope };
+    }
+};
+
+/// A report further than this from the model is a seek, a pause or a resume
+/// that moved the position, not jitter: rebase onto it. Below the status
+/// server's own seek threshold, so anything it sends a burst for is taken
+/// at once.
+pub const jump_us: i64 = 300 * std.time.us_per_ms;
+/// How much of each report's disagreement with the model is taken, as a
+/// shift: quickly while searching, slowly once locked, so one late report
+/// cannot move the displayed second.
+pub const search_gain_shift = 1;
+pub const locked_gain_shift = 3;
+/// The smoothed disagreement under which the model counts as locked.
+pub const lock_noise_us: i64 = 25 * std.time.us_per_ms;
+
+/// VLC's play position as a function of server time.
+pub const PlayClock = struct {
+    phase: Phase = .searching,
+    have_anchor: bool = false,
+    running: bool = false,
+    /// The position was `anchor_content_us` at server time
+    /// `anchor_server_us`, and advances one for one with server time while
+    /// running.
+    anchor_server_us: i64 = 0,
+    anchor_content_us: i64 = 0,
+    /// Running average of how far reports land from the model.
+    noise_us: i64 = 0,
+    /// Bumped on every rebase: the points at which the displayed position
+    /// may legitimately go backwards. See `Monotonic`.
+    epoch: u32 = 0,
+
+    /// Fold in a report: the position was `content_ms` at `server_us`.
+    pub fn sample(self: *PlayClock, server_us: i64, content_ms: u64, running: bool) void {
+        const content_us: i64 = @intCast(content_ms * std.time.us_per_ms);
+        if (!running) {
+            // Nothing is counting; the report is the whole truth.
+            if (!self.have_anchor or self.running or content_us != self.anchor_content_us) self.epoch +%= 1;
+            self.* = .{ .have_anchor = true, .running = false, .anchor_server_us = server_us, .anchor_content_us = content_us, .epoch = self.epoch };
+            return;
+        }
+        if (!self.have_anchor or !self.running) return self.rebase(server_us, content_us);
+
+        const residual = content_us - self.predict(server_us);
+        if (residual > jump_us or residual < -jump_us) return self.rebase(server_us, content_us);
+
+        const shift: u6 = if (self.phase == .locked) locked_gain_shift else search_gain_shift;
+        self.anchor_content_us += residual >> shift;
+        const magnitude: i64 = @intCast(@abs(residual));
+        self.noise_us += (magnitude - self.noise_us) >> 2;
+        self.phase = if (self.noise_us <= lock_noise_us) .locked else .searching;
+    }
+
+    /// The position at `server_us`.
+    pub fn predict(self: *const PlayClock, server_us: i64) i64 {
+        if (!self.running) return self.anchor_content_us;
+        return self.anchor_content_us + (server_us - self.anchor_server_us);
+    }
+
+    fn rebase(self: *PlayClock, server_us: i64, content_us: i64) void {
+        self.* = .{
+            .have_anchor = true,
+            .running = true,
+            .anchor_server_us = server_us,
+            .anchor_content_us = content_us,
+            // The first report after a jump is as noisy as any other; start
+            // from the lock threshold rather than from zero, so the next few
+            // are weighed as searching.
+            .noise_us = 2 * lock_noise_us,
+            .epoch = self.epoch +% 1,
+        };
+    }
+};
+
+/// The play position as a straight line on our monotonic clock: `ClockSync`
+/// and `PlayClock` composed, as of the latest report. Small and plain, so it
+/// is published alongside the status it came from.
+pub const Timeline = struct {
+    valid: bool = false,
+    running: bool = false,
+    /// The position was `content_us` at `local_us` on our clock...
+    local_us: i64 = 0,
+    content_us: i64 = 0,
+    /// ...and advances this many microseconds per one of ours while running:
+    /// one, corrected for the server's clock running fast or slow.
+    rate: f64 = 1,
+    epoch: u32 = 0,
+
+    pub fn compose(sync: *const ClockSync, play: *const PlayClock) Timeline {
+        if (!play.have_anchor) return .{};
+        const local_us = sync.toLocal(play.anchor_server_us) orelse return .{};
+        return .{
+            .valid = true,
+            .running = play.running,
+            .local_us = local_us,
+            .content_us = play.anchor_content_us,
+            .rate = 1 / (1 + sync.slope),
+            .epoch = play.epoch,
+        };
+    }
+
+    /// The position at `local_us`, in microseconds; never negative.
+    pub fn contentMicros(self: *const Timeline, local_us: i64) i64 {
+        if (!self.running) return @max(self.content_us, 0);
+        const elapsed: f64 = @floatFromInt(local_us - self.local_us);
+        return @max(self.content_us + @as(i64, @intFromFloat(elapsed * self.rate)), 0);
+    }
+
+    /// When, on our clock, the position next reaches a whole second after
+    /// `local_us`; null when it is not moving.
+    pub fn nextSecondAt(self: *const Timeline, local_us: i64) ?i64 {
+        if (!self.running or self.rate <= 0) return null;
+        const now = self.contentMicros(local_us);
+        const next = (@divFloor(now, std.time.us_per_s) + 1) * std.time.us_per_s;
+        const wait: f64 = @as(f64, @floatFromInt(next - now)) / self.rate;
+        return local_us + @as(i64, @intFromFloat(@ceil(wait)));
+    }
+};
+
+/// Keeps the displayed position from stepping backwards between rebases.
+///
+/// Once locked, corrections are a few milliseconds, but one that lands just
+/// after a second has flipped would flip it back, and the panel would show
+/// the same second twice. Holding the last value until the model catches up
+/// costs at most the size of the correction. Across a rebase -- a seek, a
+/// pause -- going backwards is the truth, and is let through.
+pub const Monotonic = struct {
+    have: bool = false,
+    epoch: u32 = 0,
+    last_us: i64 = 0,
+
+    pub fn apply(self: *Monotonic, timeline: *const Timeline, content_us: i64) i64 {
+        if (!timeline.running) {
+            self.have = false;
+            return content_us;
+        }
+        if (self.have and self.epoch == timeline.epoch and content_us < self.last_us) return self.last_us;
+        self.* = .{ .have = true, .epoch = timeline.epoch, .last_us = content_us };
+        return content_us;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Tests: a simulated server, its clock offset and drifting, sending through a
+// jittery network.
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+const Sim = struct {
+    prng: std.Random.DefaultPrng,
+    /// Our clock, microseconds.
+    local_us: i64 = 1_000_000_000,
+    /// The server's clock reads `offset_us` ahead of ours at local 0, and
+    /// runs `skew` faster.
+    offset_us: i64 = -7_345_678,
+    skew: f64 = 120e-6,
+    /// Delay floor, and the typical jitter above it.
+    floor_us: i64 = 300,
+    jitter_us: i64 = 3_000,
+    /// One packet in this many is held up a long time.
+    stall_every: u32 = 20,
+    stall_us: i64 = 250_000,
+    sent: u32 = 0,
+
+    fn init(seed: u64) Sim {
+        return .{ .prng = .init(seed) };
+    }
+
+    fn serverAt(self: *const Sim, local_us: i64) i64 {
+        return local_us + self.offset_us + @as(i64, @intFromFloat(@as(f64, @floatFromInt(local_us)) * self.skew));
+    }
+
+    /// Send one packet `gap_us` after the last; returns (server send time,
+    /// local arrival time).
+    fn send(self: *Sim, sync: *ClockSync, gap_us: i64) struct { server_us: i64, local_us: i64 } {
+        self.local_us += gap_us;
+        const server_us = self.serverAt(self.local_us);
+        const random = self.prng.random();
+        var delay = self.floor_us + @as(i64, @intFromFloat(random.floatExp(f64) * @as(f64, @floatFromInt(self.jitter_us))));
+        self.sent += 1;
+        if (self.sent % self.stall_every == 0) delay += self.stall_us;
+        const arrival = self.local_us + delay;
+        sync.sample(server_us, arrival);
+        return .{ .server_us = server_us, .local_us = arrival };
+    }
+};
+
+test "the offset converges to the delay floor despite jitter and stalls" {
+    var sim = Sim.init(1);
+    var sync: ClockSync = .{};
+    for (0..120) |_| _ = sim.send(&sync, 1_000_000);
+
+    // Our clock now, mapped to the server's: behind by the delay floor, and
+    // otherwise off by no more than the fitted rate's error.
+    const mapped = sync.toServer(sim.local_us).?;
+    const err = sim.serverAt(sim.local_us) - mapped;
+    try testing.expect(@abs(err - sim.floor_us) < 1_000);
+}
+
+test "the rate between the clocks is recovered" {
+    var sim = Sim.init(2);
+    var sync: ClockSync = .{};
+    for (0..150) |_| _ = sim.send(&sync, 1_000_000);
+
+    // Our clock runs slow against the server's by the skew, so arrival
+    // minus send falls at that rate.
+    try testing.expectApproxEqAbs(-sim.skew * 1e6, sync.skewPpm(), 20);
+
+    // Extrapolated a minute past the last sample, the mapping still holds.
+    const later = sim.local_us + 60 * std.time.us_per_s;
+    const err = sim.serverAt(later) - sync.toServer(later).?;
+    try testing.expect(@abs(err) < 2_000);
+}
+
+test "a stepped clock restarts the estimate instead of bending it" {
+    var sim = Sim.init(3);
+    var sync: ClockSync = .{};
+    for (0..40) |_| _ = sim.send(&sync, 1_000_000);
+    sim.offset_us += 5 * std.time.us_per_s; // The server's clock jumps ahead
+    for (0..10) |_| _ = sim.send(&sync, 1_000_000);
+
+    try testing.expectEqual(@as(u32, 1), sync.resets);
+    const err = sim.serverAt(sim.local_us) - sync.toServer(sim.local_us).?;
+    try testing.expect(@abs(err) < 10_000);
+}
+
+test "a restarted server starts the estimate over" {
+    var sync: ClockSync = .{};
+    sync.sample(500_000_000, 10_000);
+    sync.sample(501_000_000, 1_010_000);
+    sync.sample(2_000, 2_010_000); // Monotonic clock from boot again
+    try testing.expectEqual(@as(u32, 1), sync.resets);
+    try testing.expectEqual(@as(i64, 2_000), sync.toServer(2_010_000).?);
+}
+
+test "the play clock rebases on a seek and locks through reporting noise" {
+    var play: PlayClock = .{};
+    var prng: std.Random.DefaultPrng = .init(4);
+    const random = prng.random();
+
+    // Reports every 250 ms, each up to 40 ms off the true position -- VLC
+    // reports where its input last was, not where its output is.
+    var server_us: i64 = 0;
+    var truth_us: i64 = 90_000_000;
+    for (0..40) |_| {
+        server_us += 250_000;
+        truth_us += 250_000;
+        const noise: i64 = random.intRangeAtMost(i64, -40_000, 0);
+        play.sample(server_us, @intCast(@divFloor(truth_us + noise, 1000)), true);
+    }
+    try testing.expectEqual(Phase.locked, play.phase);
+    try testing.expect(@abs(play.predict(server_us) - truth_us) < 30_000);
+
+    const epoch = play.epoch;
+    truth_us += 600_000_000; // A ten-minute seek
+    play.sample(server_us, @intCast(@divFloor(truth_us, 1000)), true);
+    try testing.expect(play.epoch != epoch);
+    try testing.expectEqual(truth_us, play.predict(server_us));
+}
+
+test "a paused play clock holds its position" {
+    var play: PlayClock = .{};
+    play.sample(1_000_000, 5_000, true);
+    play.sample(2_000_000, 6_000, false);
+    try testing.expect(!play.running);
+    try testing.expectEqual(@as(i64, 6_000_000), play.predict(9_000_000));
+}
+
+test "a timeline flips the second when the server's position does" {
+    var sim = Sim.init(5);
+    var sync: ClockSync = .{};
+    var play: PlayClock = .{};
+    // The server's position is its clock minus a fixed start, so the true
+    // position at any local instant is known exactly.
+    const start_server_us: i64 = sim.serverAt(sim.local_us) - 3_600_000_000 - 123_456;
+    for (0..60) |_| {
+        const packet = sim.send(&sync, 1_000_000);
+        const content_ms: u64 = @intCast(@divFloor(packet.server_us - start_server_us, 1000));
+        play.sample(packet.server_us, content_ms, true);
+    }
+    const timeline: Timeline = .compose(&sync, &play);
+    try testing.expect(timeline.valid and timeline.running);
+
+    const edge = timeline.nextSecondAt(sim.local_us).?;
+    const truth_at_edge = sim.serverAt(edge) - start_server_us;
+    // Within a couple of milliseconds of the server's own second, and on
+    // its far side: the delay floor shows up as flipping that much late.
+    const into = @mod(truth_at_edge, std.time.us_per_s);
+    const late = if (into > std.time.us_per_s / 2) into - std.time.us_per_s else into;
+    try testing.expect(@abs(late) < 2_000);
+}
+
+test "monotonic holds a small step back, and lets a rebase through" {
+    var timeline: Timeline = .{ .valid = true, .running = true, .epoch = 1 };
+    var guard: Monotonic = .{};
+    try testing.expectEqual(@as(i64, 10_000_000), guard.apply(&timeline, 10_000_000));
+    try testing.expectEqual(@as(i64, 10_000_000), guard.apply(&timeline, 9_995_000));
+    try testing.expectEqual(@as(i64, 10_010_000), guard.apply(&timeline, 10_010_000));
+    timeline.epoch = 2;
+    try testing.expectEqual(@as(i64, 4_000_000), guard.apply(&timeline, 4_000_000));
+}
@@ -1,43 +1,50 @@
 const std = @import("std");
 const Io = std.Io;
-const protocol = @import("protocol.zig");
 const time = @import("time.zig");
 const config = @import("config.zig");
 const process_mgmt = @import("process_mgmt.zig");
 const mode_mod = @import("mode.zig");
+const latency_probe = @import("latency_probe.zig");
+const str_utils = @import("str_utils.zig");
+const bus = @import("bus.zig");
+const file_watch = @import("file_watch.zig");
+const render = @import("render.zig");
 const Mode = mode_mod.Mode;
 
-pub fn runClocks(io: Io, allocator: std.mem.Allocator, port: anytype, mode: *std.atomic.Value(Mode)) !void {
-    // Build the command string dynamically
-    var cmd_parts = std.ArrayList(u8).empty;
-    defer cmd_parts.deinit(allocator);
+/// Longest the loop sleeps in one go. Only bounds how quickly it notices a
+/// mode change, a re-init or shutdown; the ticks themselves are woken for
+/// exactly.
+const IDLE_SLICE_MS: i64 = 250;
+
+/// The collator half of a `render.Pipeline`: each pass builds both lines whole
+/// and publishes them, and the pipeline's sender -- or, with a `unit`,
+/// `bus.zig`'s scheduler -- sends only the columns that moved. Ticking over
+/// the seconds digit therefore costs one column on the wire without this loop
+/// having to know which column that is.
+///
+/// A pass is woken for each UTC second, early by however long the sender has
+/// lately taken to get a frame to the panel (`Pipeline.sendLeadMs`), and
+/// builds the second about to begin -- so the digit changes on the panel at
+/// the edge, not up to a poll interval after it. Building is incremental too:
+/// the date is worked out once a day (`time.RandyLine`), and the countdown's
+/// label is laid out once per config (`Countdown`).
+pub fn runClocks(io: Io, allocator: std.mem.Allocator, port: anytype, mode: *std.atomic.Value(Mode), unit: ?*bus.Unit) !void {
+    var pipeline: render.Pipeline = .{ .name = "clocks" };
+    try pipeline.start(io, allocator, port, unit);
+    defer pipeline.stop();
+    var deadline = pipeline.deadline();
 
-    var last_full_update_utc: i64 = 0;
     var clock = time.LocalClock.init(io);
-    var line1_buf: [20]u8 = undefined;
-    var line2_buf: [20]u8 = undefined;
-    var msg1_buf: [128]u8 = undefined;
-    var msg2_buf: [128]u8 = undefined;
-    var line2_config: ?config.CountdownConfig = null;
-
-    last_full_update_utc = 0; // force full update on first run
-
-    // Line 1 is only ever fully redrawn on the first pass and then again on a
-    // 10-second boundary -- every pass in between sends just the seconds
-    // digit. That is fine once the panel and this loop agree on what line 1
-    // says, but a dropped frame is exactly how they stop agreeing. `protocol.send`
-    // waits for the panel's reply before returning, which is a much stronger
-    // guarantee than a fixed delay -- but it is still evidence of "the panel
-    // answered something", not proof the frame it just received rendered
-    // correctly. If the very first full frame is lost anyway, line 1 stayed
-    // blank for up to 10 seconds, since nothing else was due to trigger a full
-    // resend. Repeating the full draw for a few seconds right after entry,
-    // instead of just once, means a single dropped frame self-heals on the
-    // very next pass -- half a second later -- rather than on the next
-    // 10-second boundary. Cheap insurance behind a real mechanism, not a
-    // substitute for one.
-    const entry_full_redraw_s: i64 = 3;
-    var entry_utc_timestamp: ?i64 = null;
+    var line1_text: time.RandyLine = .{};
+    var countdown: Countdown = .{};
+    // Read on entry, then whenever the file changes, so an edit to it shows
+    // up without a restart -- or every 10 seconds if it cannot be watched.
+    var config_watch: file_watch.Subscription = .{ .topic = .countdown, .poll_ms = 10_000 };
+
+    // The second the previous pass built, so one that wakes early, or for a
+    // slice, does not rebuild it -- and the benchmark probe hears about each
+    // tick once (see `latency_probe.zig`).
+    var built_utc: ?i64 = null;
     while (true) {
         // Check for shutdown signal
         if (process_mgmt.shouldShutdown()) {
@@ -61,73 +68,134 @@ pub fn runClocks(io: Io, allocator: std.mem.Allocator, port: anytype, mode: *std
             return;
         }
 
-        line1_buf = undefined;
-        line2_buf = undefined;
-        msg1_buf = undefined;
-        msg2_buf = undefined;
-        cmd_parts.clearAndFree(allocator);
-
-        // Get current local timestamp
-        const now = clock.read(io);
-        const utc_timestamp = now.utc;
-        const timestamp = now.local;
-        const seconds = @mod(timestamp, 60);
-
-        if (entry_utc_timestamp == null) entry_utc_timestamp = utc_timestamp;
-        const in_entry_window = utc_timestamp - entry_utc_timestamp.? < entry_full_redraw_s;
-
-        // Check if we need a full update (every 10 seconds, first time, still
-        // within the just-entered-this-mode window, or timestamp changed)
-        if (last_full_update_utc == 0 or in_entry_window or (@mod(seconds, 10) == 0 and utc_timestamp != last_full_update_utc)) {
-            const display_str = time.formatRandyTimestamp(timestamp, &line1_buf, &clock.zi) catch unreachable;
-            const time_cmd_str = std.fmt.bufPrint(&msg1_buf, "{s}{s}", .{ protocol.ESC ++ "C", display_str }) catch unreachable;
-            try cmd_parts.appendSlice(allocator, time_cmd_str);
-            last_full_update_utc = utc_timestamp;
+        const now_ms = time.nowMillis(io);
+        const lead_ms = pipeline.sendLeadMs();
 
+        // The second that will have begun by the time this pass's frame
+        // reaches the panel.
+        const reading = clock.readAt(io, now_ms + lead_ms);
+        const utc_timestamp = reading.utc;
+
+        const config_changed = config_watch.changed(now_ms);
+        if (config_changed) {
             // Load countdown configuration from JSON
-            line2_config = config.loadCountdownConfig(io, allocator);
-        } else {
-            // Just update the ones place of seconds (column 19, assuming format "25Au06W200/20:37:13D")
-            const ones_digit = @as(u8, @intCast(@mod(seconds, 10))) + '0';
-            const ones_digit_cmd = try protocol.unitUpdateChar(&line1_buf, 1, 16, ones_digit);
-            try cmd_parts.appendSlice(allocator, ones_digit_cmd);
+            countdown.configure(config.loadCountdownConfig(io, allocator));
+        }
+
+        if (config_changed or built_utc != utc_timestamp) {
+            // Both lines tick with the real second: line 1 is the clock, line
+            // 2 the countdown.
+            if (built_utc != utc_timestamp) {
+                latency_probe.contentDue(1, utc_timestamp * std.time.ms_per_s);
+                latency_probe.contentDue(2, utc_timestamp * std.time.ms_per_s);
+            }
+            built_utc = utc_timestamp;
+
+            const display_str = line1_text.format(reading.local, &clock.zi);
+            var line1: render.Line = undefined;
+            var line2: render.Line = undefined;
+            try str_utils.clearVorneLineBuf(&line1);
+            try str_utils.copyLeftJustify(&line1, display_str, str_utils.maxchars, null);
+            try str_utils.clearVorneLineBuf(&line2);
+            try str_utils.copyLeftJustify(&line2, countdown.at(utc_timestamp), str_utils.maxchars, null);
+            pipeline.publish(&line1, &line2);
         }
 
-        // Create a 20-character line with left-justified label and right-justified dhms_str
-        // If they overlap, dhms_str takes precedence
-        var line2_display: [20]u8 = [_]u8{' '} ** 20; // Fill with spaces
+        const next_edge_ms = (utc_timestamp + 1) * std.time.ms_per_s - lead_ms;
+        try deadline.sleepUntil(io, now_ms, @min(next_edge_ms, now_ms + IDLE_SLICE_MS));
+    }
+}
 
-        if (line2_config) |cfg| {
-            // line 2: always full draw
-            const delta_sec = utc_timestamp - time.ymdhmsToTimestamp(cfg.target_date);
-            const dhms = time.timedeltaToDhms(delta_sec);
-            const dhms_str = time.formatDhms(dhms, &line2_buf) catch unreachable;
+/// Line 2: the countdown's label on the left and the time to go (or since)
+/// right-justified, the countdown winning where they overlap.
+///
+/// The label is laid out once per config, and from then on only the columns
+/// the countdown covers are rewritten, unless its width changes -- a day
+/// boundary in the count, or the sign flipping -- when the label may have to
+/// give way or may get a column back, and the line is laid out again.
+const Countdown = struct {
+    text: [str_utils.maxchars]u8 = [_]u8{' '} ** str_utils.maxchars,
+    cfg: ?config.CountdownConfig = null,
+    /// The target as a timestamp, worked out once per config.
+    target_utc: i64 = 0,
+    /// Width of the countdown as last laid out; 0 to lay the line out afresh.
+    width: usize = 0,
+
+    fn configure(self: *Countdown, cfg: ?config.CountdownConfig) void {
+        self.cfg = cfg;
+        if (cfg) |c| self.target_utc = time.ymdhmsToTimestamp(c.target_date);
+        self.width = 0;
+    }
 
+    /// The line as of `utc`. Blank with no config.
+    fn at(self: *Countdown, utc: i64) []const u8 {
+        const n = str_utils.maxchars;
+        const cfg = self.cfg orelse {
+            @memset(&self.text, ' ');
+            return &self.text;
+        };
+        var dhms_buf: [20]u8 = undefined;
+        const dhms = time.formatDhms(time.timedeltaToDhms(utc - self.target_utc), &dhms_buf) catch unreachable;
+        const width = @min(dhms.len, n);
+
+        if (width != self.width) {
+            self.width = width;
+            @memset(&self.text, ' ');
             // Find the actual length of the label (stop at first null byte)
             const label_len = std.mem.indexOfScalar(u8, &cfg.label, 0) orelse cfg.label.len;
-
-            // Calculate how much space we have for the label
-            const max_label_len = if (dhms_str.len >= 20) 0 else 20 - dhms_str.len;
-            const actual_label_len = @min(label_len, max_label_len);
-
-            // Copy label to the left side
-            if (actual_label_len > 0) {
-                @memcpy(line2_display[0..actual_label_len], cfg.label[0..actual_label_len]);
-            }
-
-            // Copy dhms_str to the right side
-            const dhms_start_pos = if (dhms_str.len >= 20) 0 else 20 - dhms_str.len;
-            const dhms_copy_len = @min(dhms_str.len, 20);
-            @memcpy(line2_display[dhms_start_pos .. dhms_start_pos + dhms_copy_len], dhms_str[0..dhms_copy_len]);
+            const shown = @min(label_len, n - width);
+            @memcpy(self.text[0..shown], cfg.label[0..shown]);
         }
+        @memcpy(self.text[n - width ..], dhms[0..width]);
+        return &self.text;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+/// Line 2 built from scratch, the way every pass used to.
+fn countdownFromScratch(cfg: config.CountdownConfig, utc: i64, out: *[str_utils.maxchars]u8) void {
+    var dhms_buf: [20]u8 = undefined;
+    const dhms = time.formatDhms(time.timedeltaToDhms(utc - time.ymdhmsToTimestamp(cfg.target_date)), &dhms_buf) catch unreachable;
+    @memset(out, ' ');
+    const label_len = std.mem.indexOfScalar(u8, &cfg.label, 0) orelse cfg.label.len;
+    const max_label_len = if (dhms.len >= 20) 0 else 20 - dhms.len;
+    const actual_label_len = @min(label_len, max_label_len);
+    @memcpy(out[0..actual_label_len], cfg.label[0..actual_label_len]);
+    const dhms_start_pos = if (dhms.len >= 20) 0 else 20 - dhms.len;
+    const dhms_copy_len = @min(dhms.len, 20);
+    @memcpy(out[dhms_start_pos .. dhms_start_pos + dhms_copy_len], dhms[0..dhms_copy_len]);
+}
 
-        const msg2_str = try std.fmt.bufPrint(&msg2_buf, "{s}{s}", .{ protocol.ESC ++ "2;C", line2_display });
-        try cmd_parts.appendSlice(allocator, msg2_str);
-
-        const cmd_slice = try cmd_parts.toOwnedSlice(allocator);
-        _ = protocol.sendUnitDisplayCmd(allocator, port, 1, cmd_slice) catch |err| return err;
-
-        // Sleep until next second
-        try io.sleep(.fromMilliseconds(500), .awake);
+test "Countdown rewritten in place matches one built from scratch" {
+    var cfg: config.CountdownConfig = .{ .label = [_]u8{0} ** str_utils.maxbufsz, .target_date = .{
+        .year = 2024,
+        .month = 3,
+        .day = 10,
+        .hour = 12,
+        .minute = 0,
+        .second = 0,
+    } };
+    // Long enough that the countdown has to cut into it.
+    const label = "LAUNCH WINDOW OPENS";
+    @memcpy(cfg.label[0..label.len], label);
+    const target = time.ymdhmsToTimestamp(cfg.target_date);
+
+    var countdown: Countdown = .{};
+    countdown.configure(cfg);
+    var expected: [str_utils.maxchars]u8 = undefined;
+    // From eleven days out, through the day boundaries and the target, to
+    // well after it: widths change at each, and the label comes and goes.
+    var t = target - 11 * std.time.s_per_day - 30;
+    while (t < target + 2 * std.time.s_per_day) : (t += if (@abs(t - target) < 120) 1 else 997) {
+        countdownFromScratch(cfg, t, &expected);
+        try testing.expectEqualStrings(&expected, countdown.at(t));
     }
+
+    countdown.configure(null);
+    try testing.expectEqualStrings(" " ** str_utils.maxchars, countdown.at(target));
 }
@@ -32,7 +32,7 @@ const countdown_cfg_default_path = "/home/emanspeaks/line2_config.jsonc";
 /// itself stays separate and keeps being re-read while running: its contents
 /// are display copy meant to be edited live, unlike the wiring settings, which
 /// are read once at startup.
-fn countdownCfgPath() []const u8 {
+pub fn countdownCfgPath() []const u8 {
     return vorne_config.line2ConfigPath() orelse countdown_cfg_default_path;
 }
 
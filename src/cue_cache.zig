@@ -0,0 +1,384 @@
+//! A compiled form of a cue file, kept beside it and mapped straight in.
+//!
+//! Loading a `.vtt` means reading the whole file, tokenising it, transcoding
+//! every payload from UTF-8 into the panel's character set, measuring it,
+//! sorting, and building `webvtt.CueList`'s boundary index -- fine for a page
+//! of warnings, but a subtitle-derived file runs to thousands of cues, and
+//! selecting one mid-movie left line 2 blank while all that ran. The result of
+//! all of it is written next to the source as `<name>.vttc`, and the next load
+//! of the same file is an `mmap` and a header check.
+//!
+//! The cache is keyed by the source's `cues.Fingerprint` -- modification time
+//! and size -- recorded in its header. A cache whose key no longer matches,
+//! or that is damaged, truncated, from another version or written on a host
+//! of the other byte order, is ignored and rewritten from the source; nothing
+//! is ever shown from it that `webvtt.parse` would not have produced. That
+//! includes a cache compiled by another build: the header also records
+//! `compiler`, which changes with `webvtt.compile_version` and with any edit
+//! to the character tables the text was encoded with, so a new mapping or
+//! parsing rule is never masked by text compiled under the old one.
+//!
+//! Layout, native byte order, every array at a multiple of its alignment from
+//! the page-aligned start of the mapping so it is used in place:
+//!
+//!   Header
+//!   Record         [cue_count]       one per cue, sorted by start
+//!   i64            [boundary_count]  `CueList.boundaries`
+//!   u32            [boundary_count]  `CueList.shown`
+//!   u8             [title_len]       the title
+//!   u8             [text_len]        every cue's text, panel-encoded, end to end
+
+const std = @import("std");
+const Io = std.Io;
+const webvtt = @import("webvtt.zig");
+const vorne_charset = @import("vorne_charset.zig");
+
+/// Appended to the cue file's name. `cues.isValidName` wants `.vtt` at the
+/// very end, so a cache never shows up in the web page's list.
+pub const suffix = "c";
+
+const magic = "VTTC".*;
+/// Bumped whenever the layout changes. Also a byte-order check: written on a
+/// host of the other order it reads back as something else entirely.
+const version: u32 = 2;
+
+/// What compiled the cache: `webvtt.compile_version` and a hash of every
+/// `vorne_charset` table a payload is encoded through. Computed at build
+/// time, so a table edit cannot be shipped without invalidating old caches.
+const compiler: u64 = blk: {
+    @setEvalBranchQuota(1_000_000);
+    var h = std.hash.Fnv1a_64.init();
+    h.update(&std.mem.toBytes(webvtt.compile_version));
+    for (vorne_charset.control_chars) |entry| hashEntry(&h, entry);
+    for (vorne_charset.extended_chars) |entry| hashEntry(&h, entry);
+    for (vorne_charset.ascii_folds) |fold| {
+        h.update(&std.mem.toBytes(@as(u32, fold[0])));
+        hashEntry(&h, fold[1]);
+    }
+    h.update(&[_]u8{vorne_charset.unmappable});
+    break :blk h.final();
+};
+
+/// Length-prefixed, so moving a byte from one entry to the next still counts.
+fn hashEntry(h: *std.hash.Fnv1a_64, entry: []const u8) void {
+    h.update(&std.mem.toBytes(@as(u32, @intCast(entry.len))));
+    h.update(entry);
+}
+
+const Header = extern struct {
+    magic: [4]u8,
+    version: u32,
+    compiler: u64,
+    source_mtime_ns: i64,
+    source_size: u64,
+    cue_count: u32,
+    boundary_count: u32,
+    title_len: u32,
+    text_len: u32,
+};
+
+const Record = extern struct {
+    start_ms: i64,
+    end_ms: i64,
+    text_off: u32,
+    text_len: u32,
+    cols: u32,
+    flags: u32,
+
+    const scroll_flag: u32 = 1;
+};
+
+comptime {
+    // Everything after the header starts 8-aligned, and each array keeps the
+    // next one aligned; see the layout above.
+    std.debug.assert(@sizeOf(Header) % 8 == 0);
+    std.debug.assert(@sizeOf(Record) % 8 == 0);
+}
+
+/// What a cache must have been built from to be used.
+pub const Key = struct {
+    mtime_ns: i128,
+    size: u64,
+};
+
+/// The compiled form of `list`, parsed from a source file matching `key`.
+/// Null if the list cannot be represented -- a modification time past 2262,
+/// or more than 4 GiB of text -- in which case there is simply no cache.
+pub fn encode(allocator: std.mem.Allocator, list: webvtt.CueList, key: Key) std.mem.Allocator.Error!?[]align(8) u8 {
+    const mtime_ns = std.math.cast(i64, key.mtime_ns) orelse return null;
+    var text_len: usize = 0;
+    for (list.cues) |cue| text_len += cue.text.len;
+    if (text_len > std.math.maxInt(u32) or list.title.len > std.math.maxInt(u32) or
+        list.cues.len > std.math.maxInt(u32)) return null;
+
+    const layout = Layout.of(list.cues.len, list.boundaries.len, list.title.len, text_len);
+    const bytes = try allocator.alignedAlloc(u8, .of(u64), layout.total);
+
+    const header: Header = .{
+        .magic = magic,
+        .version = version,
+        .compiler = compiler,
+        .source_mtime_ns = mtime_ns,
+        .source_size = key.size,
+        .cue_count = @intCast(list.cues.len),
+        .boundary_count = @intCast(list.boundaries.len),
+        .title_len = @intCast(list.title.len),
+        .text_len = @intCast(text_len),
+    };
+    @memcpy(bytes[0..@sizeOf(Header)], std.mem.asBytes(&header));
+
+    const text = bytes[layout.text..][0..text_len];
+    var off: usize = 0;
+    for (list.cues, 0..) |cue, i| {
+        const record: Record = .{
+            .start_ms = cue.start_ms,
+            .end_ms = cue.end_ms,
+            .text_off = @intCast(off),
+            .text_len = @intCast(cue.text.len),
+            .cols = @intCast(cue.cols),
+            .flags = if (cue.scroll) Record.scroll_flag else 0,
+        };
+        @memcpy(bytes[layout.records + i * @sizeOf(Record) ..][0..@sizeOf(Record)], std.mem.asBytes(&record));
+        @memcpy(text[off..][0..cue.text.len], cue.text);
+        off += cue.text.len;
+    }
+    const boundaries = std.mem.sliceAsBytes(list.boundaries);
+    @memcpy(bytes[layout.boundaries..][0..boundaries.len], boundaries);
+    const shown = std.mem.sliceAsBytes(list.shown);
+    @memcpy(bytes[layout.shown..][0..shown.len], shown);
+    @memcpy(bytes[layout.title..][0..list.title.len], list.title);
+    return bytes;
+}
+
+/// A list reading from `bytes` in place, or null if `bytes` is not a sound
+/// cache for a source matching `key`. Only the `Cue` array itself is built,
+/// in the list's arena: its `text` slices, the boundary index and the title
+/// all point into `bytes`, which must outlive the list.
+pub fn decode(allocator: std.mem.Allocator, bytes: []align(8) const u8, key: Key) std.mem.Allocator.Error!?webvtt.CueList {
+    if (bytes.len < @sizeOf(Header)) return null;
+    const header = std.mem.bytesToValue(Header, bytes[0..@sizeOf(Header)]);
+    if (!std.mem.eql(u8, &header.magic, &magic) or header.version != version) return null;
+    if (header.compiler != compiler) return null;
+    if (header.source_mtime_ns != key.mtime_ns or header.source_size != key.size) return null;
+
+    const layout = Layout.of(header.cue_count, header.boundary_count, header.title_len, header.text_len);
+    if (layout.total != bytes.len) return null;
+
+    const records = arrayAt(Record, bytes, layout.records, header.cue_count);
+    const shown = arrayAt(u32, bytes, layout.shown, header.boundary_count);
+    const text = bytes[layout.text..][0..header.text_len];
+    // Checked before anything indexes with them, so a damaged cache is
+    // refused rather than read out of bounds.
+    for (records) |record| {
+        if (@as(u64, record.text_off) + record.text_len > text.len) return null;
+    }
+    for (shown) |index| {
+        if (index != webvtt.CueList.no_cue and index >= header.cue_count) return null;
+    }
+
+    const arena = try allocator.create(std.heap.ArenaAllocator);
+    errdefer allocator.destroy(arena);
+    arena.* = .init(allocator);
+    errdefer arena.deinit();
+
+    const cues = try arena.allocator().alloc(webvtt.Cue, records.len);
+    for (records, cues) |record, *cue| {
+        cue.* = .{
+            .start_ms = record.start_ms,
+            .end_ms = record.end_ms,
+            .text = text[record.text_off..][0..record.text_len],
+            .cols = record.cols,
+            .scroll = record.flags & Record.scroll_flag != 0,
+        };
+    }
+    return .{
+        .arena = arena,
+        .cues = cues,
+        .title = bytes[layout.title..][0..header.title_len],
+        .boundaries = arrayAt(i64, bytes, layout.boundaries, header.boundary_count),
+        .shown = shown,
+    };
+}
+
+/// Map the cache at `path` and read a list from it, or null if there is none
+/// usable for `key`. The list owns the mapping.
+pub fn load(allocator: std.mem.Allocator, path: [:0]const u8, key: Key) ?webvtt.CueList {
+    // Private and read-only: `store` replaces a cache by renaming a new file
+    // over it, so a mapping only ever sees the file it was made from.
+    const mapped = (mapFile(path, std.math.maxInt(u32)) catch return null) orelse return null;
+    var list = (decode(allocator, mapped, key) catch null) orelse {
+        std.posix.munmap(mapped);
+        return null;
+    };
+    list.mapped = mapped;
+    return list;
+}
+
+pub const MapError = error{ CannotOpen, FileTooBig } || std.posix.MMapError;
+
+/// `path` mapped private and read-only, or null if it is empty; unmap it with
+/// `std.posix.munmap`. Only for a file replaced by rename, never written in
+/// place, as a cache is: a mapping of one truncated under it faults.
+fn mapFile(path: [:0]const u8, max_bytes: usize) MapError!?[]align(std.heap.page_size_min) const u8 {
+    const linux = std.os.linux;
+    const rc = linux.open(path, .{ .ACCMODE = .RDONLY, .CLOEXEC = true }, 0);
+    if (linux.errno(rc) != .SUCCESS) return error.CannotOpen;
+    const fd: linux.fd_t = @intCast(rc);
+    defer _ = linux.close(fd);
+
+    const end = linux.lseek(fd, 0, linux.SEEK.END);
+    if (linux.errno(end) != .SUCCESS) return error.CannotOpen;
+    if (end == 0) return null;
+    if (end > max_bytes) return error.FileTooBig;
+    return try std.posix.mmap(null, end, std.posix.PROT.READ, .{ .TYPE = .PRIVATE }, fd, 0);
+}
+
+/// Compile `list` and write it to `path`, through a temporary file renamed
+/// into place so that a list already mapped from the old cache -- by this
+/// process, or by a reader racing the write -- never sees it change.
+pub fn store(io: Io, allocator: std.mem.Allocator, path: [:0]const u8, list: webvtt.CueList, key: Key) !void {
+    const bytes = (try encode(allocator, list, key)) orelse return;
+    defer allocator.free(bytes);
+
+    var tmp_buf: [512]u8 = undefined;
+    const written = try std.fmt.bufPrint(&tmp_buf, "{s}.tmp\x00", .{path});
+    const tmp = written[0 .. written.len - 1 :0];
+    try Io.Dir.cwd().writeFile(io, .{ .sub_path = tmp, .data = bytes });
+    errdefer Io.Dir.cwd().deleteFile(io, tmp) catch {};
+    const rc = std.os.linux.rename(tmp, path);
+    if (std.os.linux.errno(rc) != .SUCCESS) return error.RenameFailed;
+}
+
+/// Where each part of a cache of the given sizes starts, and its length.
+const Layout = struct {
+    records: usize,
+    boundaries: usize,
+    shown: usize,
+    title: usize,
+    text: usize,
+    total: usize,
+
+    fn of(cue_count: usize, boundary_count: usize, title_len: usize, text_len: usize) Layout {
+        var layout: Layout = undefined;
+        layout.records = @sizeOf(Header);
+        layout.boundaries = layout.records + cue_count * @sizeOf(Record);
+        layout.shown = layout.boundaries + boundary_count * @sizeOf(i64);
+        layout.title = layout.shown + boundary_count * @sizeOf(u32);
+        layout.text = layout.title + title_len;
+        layout.total = layout.text + text_len;
+        return layout;
+    }
+};
+
+/// `n` values of `T` at `offset` into `bytes`, in place. `Layout` keeps every
+/// such offset aligned for its type.
+fn arrayAt(comptime T: type, bytes: []align(8) const u8, offset: usize, n: usize) []const T {
+    const ptr: [*]const T = @ptrCast(@alignCast(bytes[offset..].ptr));
+    return ptr[0..n];
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+const sample =
+    "WEBVTT Blade Runner\n\n" ++
+    "00:00:10.000 --> 00:01:00.000\nLONG <b>CUE</b> \u{00E9}\n\n" ++
+    "00:00:20.000 --> 00:00:30.000\n*WARNING\n\n" ++
+    "00:02:00.000 --> 00:02:05.000\nLAST\n";
+
+const sample_key: Key = .{ .mtime_ns = 1_700_000_000_123_456_789, .size = sample.len };
+
+fn expectSameList(expected: webvtt.CueList, actual: webvtt.CueList) !void {
+    try testing.expectEqualStrings(expected.title, actual.title);
+    try testing.expectEqual(expected.cues.len, actual.cues.len);
+    for (expected.cues, actual.cues) |e, a| {
+        try testing.expectEqual(e.start_ms, a.start_ms);
+        try testing.expectEqual(e.end_ms, a.end_ms);
+        try testing.expectEqualStrings(e.text, a.text);
+        try testing.expectEqual(e.cols, a.cols);
+        try testing.expectEqual(e.scroll, a.scroll);
+    }
+    try testing.expectEqualSlices(i64, expected.boundaries, actual.boundaries);
+    try testing.expectEqualSlices(u32, expected.shown, actual.shown);
+}
+
+test "a compiled cue file reads back as the list it was built from" {
+    var parsed = try webvtt.parse(testing.allocator, sample);
+    defer parsed.deinit();
+    const bytes = (try encode(testing.allocator, parsed, sample_key)).?;
+    defer testing.allocator.free(bytes);
+
+    var cached = (try decode(testing.allocator, bytes, sample_key)).?;
+    defer cached.deinit();
+    try expectSameList(parsed, cached);
+    // Lookups go through the stored index, not a rebuilt one.
+    try testing.expectEqualStrings("*WARNING", cached.at(25_000).?.text);
+    try testing.expectEqual(@as(?i64, 120_000), cached.nextBoundaryMs(60_000));
+}
+
+test "a cache built from another version of the file is ignored" {
+    var parsed = try webvtt.parse(testing.allocator, sample);
+    defer parsed.deinit();
+    const bytes = (try encode(testing.allocator, parsed, sample_key)).?;
+    defer testing.allocator.free(bytes);
+
+    try testing.expect(null == try decode(testing.allocator, bytes, .{ .mtime_ns = sample_key.mtime_ns + 1, .size = sample_key.size }));
+    try testing.expect(null == try decode(testing.allocator, bytes, .{ .mtime_ns = sample_key.mtime_ns, .size = sample_key.size + 1 }));
+}
+
+test "a cache compiled by another parser or character map is ignored" {
+    var parsed = try webvtt.parse(testing.allocator, sample);
+    defer parsed.deinit();
+    const bytes = (try encode(testing.allocator, parsed, sample_key)).?;
+    defer testing.allocator.free(bytes);
+
+    // The same source, but its text encoded under other rules.
+    bytes[@offsetOf(Header, "compiler")] ^= 1;
+    try testing.expect(null == try decode(testing.allocator, bytes, sample_key));
+}
+
+test "a damaged cache is refused rather than read" {
+    var parsed = try webvtt.parse(testing.allocator, sample);
+    defer parsed.deinit();
+    const bytes = (try encode(testing.allocator, parsed, sample_key)).?;
+    defer testing.allocator.free(bytes);
+
+    // Cut short anywhere, including inside the header.
+    try testing.expect(null == try decode(testing.allocator, bytes[0 .. bytes.len - 1], sample_key));
+    try testing.expect(null == try decode(testing.allocator, bytes[0..8], sample_key));
+
+    // A text slice pointing past the text.
+    const text_off = bytes[@sizeOf(Header) + @sizeOf(Record) + @offsetOf(Record, "text_off") ..][0..4];
+    const saved = text_off.*;
+    std.mem.writeInt(u32, text_off, 1 << 30, .native);
+    try testing.expect(null == try decode(testing.allocator, bytes, sample_key));
+    text_off.* = saved;
+
+    // The wrong version, or the other byte order.
+    bytes[4] ^= 0xFF;
+    try testing.expect(null == try decode(testing.allocator, bytes, sample_key));
+}
+
+test "a stored cache is mapped back in" {
+    var threaded: Io.Threaded = .init(testing.allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+
+    const path = "cue_cache_test_probe.vttc";
+    defer Io.Dir.cwd().deleteFile(io, path) catch {};
+
+    var parsed = try webvtt.parse(testing.allocator, sample);
+    defer parsed.deinit();
+    try store(io, testing.allocator, path, parsed, sample_key);
+
+    var cached = load(testing.allocator, path, sample_key).?;
+    defer cached.deinit();
+    try testing.expect(cached.mapped != null);
+    try expectSameList(parsed, cached);
+
+    try testing.expect(load(testing.allocator, path, .{ .mtime_ns = 0, .size = 0 }) == null);
+    try testing.expect(load(testing.allocator, "cue_cache_test_probe_absent.vttc", sample_key) == null);
+}
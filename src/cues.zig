@@ -15,6 +15,9 @@ const dbg = @import("debug_log.zig");
 const vorne_config = @import("vorne_config.zig");
 const Io = std.Io;
 const webvtt = @import("webvtt.zig");
+const cue_cache = @import("cue_cache.zig");
+const metrics = @import("metrics.zig");
+const Cell = @import("cell.zig").Cell;
 
 /// Directory scanned for cue files, unless overridden by
 /// `dir_path_config_path`. Every `*.vtt` in it appears in the web page's
@@ -129,38 +132,33 @@ pub fn configureDirPath(io: Io) void {
 pub const extension = ".vtt";
 
 /// Longest file name accepted, so a selection fits in a fixed buffer and can be
-/// copied out under the lock without allocating.
+/// copied out of `State` without allocating.
 pub const max_name_len = 96;
 
 /// Upper bound on a cue file. A feature-length file of 20-column messages is a
 /// few kilobytes; this is generous.
-const max_cue_bytes: Io.Limit = .limited(1 << 20);
+const max_cue_bytes: usize = 1 << 20;
 
 /// The selected cue file and whether its cues are being shown.
 ///
-/// The web handler writes and the display loop reads every frame, so the name
-/// needs mutual exclusion. `generation` is bumped on every change, letting the
-/// display loop notice a new selection with a single atomic load rather than
-/// taking the lock -- or re-reading the file -- on every frame.
+/// The web handler writes and the display loop reads, so the name goes
+/// through a `cell.Cell`: a copy of at most `max_name_len` bytes, which a
+/// display loop never waits on. Its generation moves on with every change,
+/// letting the display loop notice a new selection with a single atomic load
+/// rather than copying the name -- or re-reading the file -- on every frame,
+/// and its `changed` event wakes the cue loader for it.
 pub const State = struct {
-    /// A spin lock rather than a full mutex: every critical section here is a
-    /// copy of at most `max_name_len` bytes, entered either once per web click
-    /// or once per changed selection, so there is never anything worth sleeping
-    /// on and contention is effectively zero.
-    lock: std.atomic.Value(bool) = .init(false),
-    name_buf: [max_name_len]u8 = undefined,
-    name_len: usize = 0,
-    generation: std.atomic.Value(u64) = .init(1),
+    name: Cell(Name) = .init(.{}),
     armed: std.atomic.Value(bool) = .init(false),
 
-    fn acquire(self: *State) void {
-        while (self.lock.cmpxchgWeak(false, true, .acquire, .monotonic) != null) {
-            std.atomic.spinLoopHint();
-        }
-    }
+    const Name = struct {
+        buf: [max_name_len]u8 = undefined,
+        len: usize = 0,
+    };
 
-    fn release(self: *State) void {
-        self.lock.store(false, .release);
+    /// Moves on with every `select` and `clear`; 0 until the first.
+    pub fn generation(self: *const State) u64 {
+        return self.name.generation.load(.acquire);
     }
 
     pub fn isArmed(self: *const State) bool {
@@ -176,30 +174,24 @@ pub const State = struct {
     /// directory.
     pub fn select(self: *State, name: []const u8) bool {
         if (!isValidName(name)) return false;
-        self.acquire();
-        defer self.release();
-        @memcpy(self.name_buf[0..name.len], name);
-        self.name_len = name.len;
-        _ = self.generation.fetchAdd(1, .release);
+        var selected: Name = .{ .len = name.len };
+        @memcpy(selected.buf[0..name.len], name);
+        self.name.publish(selected);
         return true;
     }
 
     /// Clear the selection, which also blanks the line.
     pub fn clear(self: *State) void {
-        self.acquire();
-        defer self.release();
-        self.name_len = 0;
-        _ = self.generation.fetchAdd(1, .release);
+        self.name.publish(.{});
     }
 
     /// Copy the current selection into `buf`, returning it, or null when
     /// nothing is selected.
-    pub fn currentName(self: *State, buf: *[max_name_len]u8) ?[]const u8 {
-        self.acquire();
-        defer self.release();
-        if (self.name_len == 0) return null;
-        @memcpy(buf[0..self.name_len], self.name_buf[0..self.name_len]);
-        return buf[0..self.name_len];
+    pub fn currentName(self: *const State, buf: *[max_name_len]u8) ?[]const u8 {
+        const current = self.name.read();
+        if (current.len == 0) return null;
+        buf.* = current.buf;
+        return buf[0..current.len];
     }
 };
 
@@ -265,10 +257,21 @@ pub fn freeNames(allocator: std.mem.Allocator, names: [][]const u8) void {
 
 /// Sized for the worst case a configured directory path can reach
 /// (`max_dir_path_len`), not for whatever `default_dir_path` happens to be.
-const PathBuf = [max_dir_path_len + 1 + max_name_len]u8;
+const PathBuf = [max_dir_path_len + 1 + max_name_len + 1]u8;
 
-fn buildPath(buf: *PathBuf, name: []const u8) []const u8 {
-    return std.fmt.bufPrint(buf, "{s}/{s}", .{ dirPath(), name }) catch unreachable;
+/// NUL-terminated, for the raw `open` that maps it.
+fn buildPath(buf: *PathBuf, name: []const u8) [:0]const u8 {
+    const path = std.fmt.bufPrint(buf, "{s}/{s}\x00", .{ dirPath(), name }) catch unreachable;
+    return path[0 .. path.len - 1 :0];
+}
+
+/// A `PathBuf` with room for `cue_cache.suffix` too.
+const CachePathBuf = [@sizeOf(PathBuf) + cue_cache.suffix.len]u8;
+
+/// Where the compiled cache of cue file `name` lives: beside it.
+fn buildCachePath(buf: *CachePathBuf, name: []const u8) [:0]const u8 {
+    const path = std.fmt.bufPrint(buf, "{s}/{s}" ++ cue_cache.suffix ++ "\x00", .{ dirPath(), name }) catch unreachable;
+    return path[0 .. path.len - 1 :0];
 }
 
 /// Enough of a cue file's metadata to tell whether it has been edited.
@@ -295,15 +298,52 @@ pub fn fingerprint(io: Io, name: []const u8) ?Fingerprint {
     return .{ .mtime_ns = stat.mtime.nanoseconds, .size = stat.size };
 }
 
-/// Read and parse one cue file from `dirPath()`.
-pub fn load(io: Io, allocator: std.mem.Allocator, name: []const u8) !webvtt.CueList {
+/// Load one cue file from `dirPath()`, whose `fingerprint` was `print`: from
+/// its compiled cache if that was built from this very version of it, else by
+/// parsing it, leaving a cache behind for next time. See `cue_cache.zig`.
+///
+/// `previous` is the list last loaded from the same file, if it is still
+/// held. After an edit, only the part of the file that changed is parsed
+/// again -- see `webvtt.reparse`.
+pub fn load(io: Io, allocator: std.mem.Allocator, name: []const u8, print: Fingerprint, previous: ?webvtt.CueList) !webvtt.CueList {
     if (!isValidName(name)) return error.InvalidCueFileName;
 
+    const started_ns = Io.Timestamp.now(io, .real).nanoseconds;
+    const key: cue_cache.Key = .{ .mtime_ns = print.mtime_ns, .size = print.size };
+    var cache_buf: CachePathBuf = undefined;
+    const cache_path = buildCachePath(&cache_buf, name);
+    if (cue_cache.load(allocator, cache_path, key)) |list| {
+        dbg.print(.cues, "cues: '{s}' loaded from its cache\n", .{name});
+        metrics.cue_load_time.of(.cache).observeSince(io, started_ns);
+        return list;
+    }
+
+    // Read, not mapped: an editor saving in place can truncate the file
+    // mid-parse, and a mapped read past the new end is a SIGBUS that takes
+    // the whole service down. A copy can only be stale, and the stat below
+    // keeps a stale one out of the cache. Every cue's text is copied out of
+    // it, so it goes when the parse is done.
     var path_buf: PathBuf = undefined;
-    const source = try Io.Dir.readFileAlloc(.cwd(), io, buildPath(&path_buf, name), allocator, max_cue_bytes);
+    const source = try Io.Dir.cwd().readFileAlloc(io, buildPath(&path_buf, name), allocator, .limited(max_cue_bytes));
     defer allocator.free(source);
-
-    return webvtt.parse(allocator, source);
+    const list = if (previous) |old|
+        try webvtt.reparse(allocator, old, source)
+    else
+        try webvtt.parse(allocator, source);
+
+    // Only cached if the file is still the version `print` describes -- one
+    // saved between the stat and the read would otherwise be cached under
+    // the old key. The cue directory may well be read-only; that only costs
+    // the next load a parse.
+    if (fingerprint(io, name)) |now| {
+        if (now.eql(print)) {
+            cue_cache.store(io, allocator, cache_path, list, key) catch |err| {
+                dbg.print(.cues, "cues: cannot write cache {s}: {}\n", .{ cache_path, err });
+            };
+        }
+    }
+    metrics.cue_load_time.of(.parse).observeSince(io, started_ns);
+    return list;
 }
 
 // ---------------------------------------------------------------------------
@@ -342,15 +382,15 @@ test "selection is rejected rather than silently accepted when invalid" {
     try testing.expect(state.select("movie.vtt"));
     try testing.expectEqualStrings("movie.vtt", state.currentName(&buf).?);
 
-    const generation = state.generation.load(.acquire);
+    const generation = state.generation();
     try testing.expect(!state.select("../escape.vtt"));
     // A rejected selection must not disturb the current one.
     try testing.expectEqualStrings("movie.vtt", state.currentName(&buf).?);
-    try testing.expectEqual(generation, state.generation.load(.acquire));
+    try testing.expectEqual(generation, state.generation());
 
     state.clear();
     try testing.expectEqual(@as(?[]const u8, null), state.currentName(&buf));
-    try testing.expect(generation != state.generation.load(.acquire));
+    try testing.expect(generation != state.generation());
 }
 
 test "a fingerprint changes when either mtime or size does" {
@@ -24,6 +24,7 @@
 const std = @import("std");
 const Io = std.Io;
 const jsonc = @import("jsonc.zig");
+const flight_recorder = @import("flight_recorder.zig");
 
 /// Production location. The repository holds an example copy at its root.
 pub const config_path = "/home/emanspeaks/vorne_config.jsonc";
@@ -50,7 +51,7 @@ pub const Category = enum {
     /// seeing on its own, without the per-pass "line2 source" and "late pass"
     /// chatter `display` also carries.
     redraw,
-    /// Per-send wall-clock breakdown on the Blu-ray sender thread: how long
+    /// Per-send wall-clock breakdown on each mode's sender thread: how long
     /// building the command string took versus the panel's actual reply time,
     /// plus which lines and whether it was a full redraw. There used to be a
     /// collator-side equivalent too, but at millisecond resolution every
@@ -96,6 +97,9 @@ pub fn enabled(cat: Category) bool {
 /// Print, if `cat` is switched on. Same formatting as `std.debug.print`,
 /// prefixed with a timestamp and the category.
 ///
+/// Recorded in `flight_recorder.zig` either way, and once its drainer is
+/// running, printed from there rather than here -- see that file's doc.
+///
 /// The timestamp is what makes these lines usable for the thing they exist
 /// for: nearly every question asked of this log is about *when* relative to
 /// something else -- did the cue text go out before or after the panel should
@@ -108,8 +112,11 @@ pub fn enabled(cat: Category) bool {
 /// and more useful here, since every interesting interval is a difference
 /// between two of these lines rather than an absolute moment.
 pub fn print(comptime cat: Category, comptime fmt: []const u8, args: anytype) void {
+    const now_ns = nowNanos();
+    flight_recorder.record(now_ns, cat, fmt, args);
     if (!enabled(cat)) return;
-    printStamp(cat);
+    if (flight_recorder.isDraining()) return;
+    printStamp(cat, now_ns);
     std.debug.print(fmt, args);
 }
 
@@ -121,15 +128,21 @@ pub fn print(comptime cat: Category, comptime fmt: []const u8, args: anytype) vo
 /// for. It is written once at startup, before any thread that logs exists.
 var clock_io: ?Io = null;
 
-fn printStamp(cat: Category) void {
-    const io = clock_io orelse {
+/// Now, on the real-time clock; 0 with no clock yet.
+fn nowNanos() i64 {
+    const io = clock_io orelse return 0;
+    return @intCast(Io.Timestamp.now(io, .real).nanoseconds);
+}
+
+fn printStamp(cat: Category, now_ns: i64) void {
+    if (clock_io == null) {
         // Before `vorne_config.load` ran, so there is no clock to read. Still
         // label the line, rather than dropping the prefix and producing a log
         // whose columns do not line up.
         std.debug.print("[--:--:--.--- UTC {s}] ", .{@tagName(cat)});
         return;
-    };
-    const ms: i64 = @intCast(@divFloor(Io.Timestamp.now(io, .real).nanoseconds, std.time.ns_per_ms));
+    }
+    const ms = @divFloor(now_ns, std.time.ns_per_ms);
     // UTC, and labelled as such. Local time needs the offset held behind
     // `time.SharedZone`, which would make this depend on the display's
     // threading and on `time.zig` -- which imports this module.
@@ -144,7 +157,7 @@ fn printStamp(cat: Category) void {
 /// and a signed value under a width specifier is formatted with an explicit
 /// sign -- producing `[+1:+15:+56.+303]` instead of `[01:15:56.303]`. `@mod`
 /// with a positive divisor is already non-negative, so the casts cannot trap.
-fn formatStamp(buf: []u8, ms: i64) []const u8 {
+pub fn formatStamp(buf: []u8, ms: i64) []const u8 {
     const total_s = @divFloor(ms, std.time.ms_per_s);
     const hours: u32 = @intCast(@mod(@divFloor(total_s, 3600), 24));
     const minutes: u32 = @intCast(@mod(@divFloor(total_s, 60), 60));
@@ -0,0 +1,153 @@
+//! Waking a thread the moment there is something for it to do.
+//!
+//! The pipeline's threads used to nap in fixed slices and look around on each
+//! wake: the sender every 10 ms for a new frame, the poller every 50 ms for a
+//! display entering Blu-ray mode, the cue thread every 50 ms for a new
+//! selection. A frame published just after the sender dozed off waited out
+//! the rest of the slice, and an idle process woke hundreds of times a second
+//! to find nothing had changed.
+//!
+//! An `Event` is a futex word. Whoever changes something a thread waits on
+//! rings it (`notify`) after making the change; the thread reads `seq` before
+//! looking at what it waits on, and then sleeps in `wait` until either its own
+//! next deadline or a ring it has not seen. A ring between the look and the
+//! sleep is not lost: the word has already moved on from `seq`, so the kernel
+//! refuses to put the thread to sleep at all.
+//!
+//! A thread waiting on several sources -- the cue thread, on the selection and
+//! on file changes -- has them forward to one event of its own
+//! (`forwardTo`), since a thread can only sleep on one word at a time.
+
+const std = @import("std");
+const linux = std.os.linux;
+
+pub const Event = struct {
+    /// Moves on with every ring. Only ever compared for equality, so wrapping
+    /// is harmless.
+    word: std.atomic.Value(u32) = .init(0),
+    /// Threads inside `wait`, so a ring nobody is waiting for costs no
+    /// system call -- the common case, since most rings land while the
+    /// waiter is busy.
+    waiters: std.atomic.Value(u32) = .init(0),
+    /// Rung too by every `notify` of this one. See the file doc.
+    forward: std.atomic.Value(?*Event) = .init(null),
+
+    /// Where this event's rings have got to. Read before checking what is
+    /// being waited on, and handed to `wait`.
+    pub fn seq(self: *const Event) u32 {
+        return self.word.load(.acquire);
+    }
+
+    /// Wake every thread waiting on this event (and on the one it forwards
+    /// to), or make their next `wait` return at once.
+    pub fn notify(self: *Event) void {
+        // Both sequentially consistent, mirrored in `wait`: either the waiter
+        // is counted by the time this looks, or the word has moved by the
+        // time the kernel compares it.
+        _ = self.word.fetchAdd(1, .seq_cst);
+        if (self.waiters.load(.seq_cst) != 0) {
+            _ = linux.syscall3(.futex, @intFromPtr(&self.word.raw), FUTEX_WAKE | FUTEX_PRIVATE_FLAG, std.math.maxInt(i32));
+        }
+        if (self.forward.load(.acquire)) |next| next.notify();
+    }
+
+    /// Make every ring of this event ring `target` as well, or stop with
+    /// null. A chain must not loop back on itself.
+    pub fn forwardTo(self: *Event, target: ?*Event) void {
+        self.forward.store(target, .release);
+    }
+
+    /// Sleep until the event is rung past `seen` or `timeout_ms` has passed.
+    /// May return early -- a signal, say -- so callers look again rather
+    /// than assuming either.
+    pub fn wait(self: *Event, seen: u32, timeout_ms: i64) void {
+        if (timeout_ms <= 0) return;
+        const ms = @min(timeout_ms, max_timeout_ms);
+        const timeout: Timespec = .{
+            .sec = @intCast(@divFloor(ms, std.time.ms_per_s)),
+            .nsec = @intCast(@mod(ms, std.time.ms_per_s) * std.time.ns_per_ms),
+        };
+        _ = self.waiters.fetchAdd(1, .seq_cst);
+        defer _ = self.waiters.fetchSub(1, .release);
+        // EAGAIN (already rung), ETIMEDOUT and EINTR all mean the same to
+        // the caller: look again.
+        _ = linux.syscall4(.futex, @intFromPtr(&self.word.raw), FUTEX_WAIT | FUTEX_PRIVATE_FLAG, seen, @intFromPtr(&timeout));
+    }
+};
+
+const FUTEX_WAIT: usize = 0;
+const FUTEX_WAKE: usize = 1;
+/// The word is never shared with another process, which lets the kernel skip
+/// looking up the mapping behind it.
+const FUTEX_PRIVATE_FLAG: usize = 128;
+
+/// The kernel's `struct timespec` for the `futex` call, which uses the
+/// platform's `long` for both fields -- 32-bit on the Pi's 32-bit images.
+const Timespec = extern struct {
+    sec: isize,
+    nsec: isize,
+};
+
+/// Longest single sleep, so the seconds fit a 32-bit `long`. A caller with
+/// nothing due for longer simply waits again.
+const max_timeout_ms: i64 = std.math.maxInt(i32);
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+fn awakeMs(io: std.Io) i64 {
+    return @intCast(@divFloor(std.Io.Timestamp.now(io, .awake).nanoseconds, std.time.ns_per_ms));
+}
+
+test "a ring before the wait is not lost" {
+    var threaded: std.Io.Threaded = .init(testing.allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+
+    var event: Event = .{};
+    const seen = event.seq();
+    event.notify();
+    const started_ms = awakeMs(io);
+    event.wait(seen, 5_000);
+    try testing.expect(awakeMs(io) - started_ms < 1_000);
+}
+
+test "an unrung wait lasts its timeout" {
+    var threaded: std.Io.Threaded = .init(testing.allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+
+    var event: Event = .{};
+    const started_ms = awakeMs(io);
+    event.wait(event.seq(), 20);
+    try testing.expect(awakeMs(io) - started_ms >= 15);
+}
+
+test "a ring wakes a waiting thread, and reaches the event it forwards to" {
+    var threaded: std.Io.Threaded = .init(testing.allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+
+    const Waiter = struct {
+        fn run(event: *Event, seen: u32, woke: *std.atomic.Value(bool)) void {
+            while (event.seq() == seen) event.wait(seen, 5_000);
+            woke.store(true, .release);
+        }
+    };
+    var source: Event = .{};
+    var target: Event = .{};
+    source.forwardTo(&target);
+
+    var woke = std.atomic.Value(bool).init(false);
+    const started_ms = awakeMs(io);
+    const thread = try std.Thread.spawn(.{}, Waiter.run, .{ &target, target.seq(), &woke });
+    // Wait for the waiter to be asleep, so the ring has someone to wake.
+    while (target.waiters.load(.acquire) == 0) std.atomic.spinLoopHint();
+    source.notify();
+    thread.join();
+    try testing.expect(woke.load(.acquire));
+    try testing.expect(awakeMs(io) - started_ms < 1_000);
+}
@@ -0,0 +1,466 @@
+//! One thread watching, through inotify, every file the service re-reads
+//! while it runs: the cue files, `line2_config.jsonc`, and `/etc/localtime`.
+//!
+//! Each of those used to be polled by whichever thread used it -- a `stat` of
+//! the selected cue file every second, the countdown config re-read and
+//! re-parsed on every ten-second redraw, the zone file every ten seconds --
+//! which is filesystem I/O on an otherwise idle service, and still up to a
+//! second late for an edit. Here the kernel says when something changed. The
+//! thread only counts it: each `Topic` has a version number, bumped on every
+//! event that could concern it, and a consumer holds a `Subscription` that
+//! reports whether the version moved since it last looked. Reading the file
+//! and deciding whether it really changed stay with the consumer, which
+//! already knows how.
+//!
+//! Directories are watched rather than the files themselves. Editors save by
+//! writing a temporary and renaming it over the original, and the zone is
+//! changed by re-pointing the `/etc/localtime` link; a watch on the file's
+//! inode would see neither. A directory that cannot be watched -- not there
+//! yet, say -- is retried every few seconds, and if inotify is unavailable
+//! altogether every `Subscription` falls back to the interval its consumer
+//! polled at before.
+
+const std = @import("std");
+const linux = std.os.linux;
+const dbg = @import("debug_log.zig");
+const Event = @import("event.zig").Event;
+
+/// What a consumer can subscribe to.
+pub const Topic = enum { cues, countdown, zone };
+
+const topic_count = @typeInfo(Topic).@"enum".fields.len;
+
+/// Longest directory or file name a `Target` can hold.
+pub const max_path_len: usize = 255;
+
+/// Where a topic's files live.
+pub const Target = struct {
+    dir: []const u8,
+    /// Only events for entries of exactly this name count.
+    name: ?[]const u8 = null,
+    /// Otherwise, only entries with this suffix -- `.vtt` for the cue
+    /// directory, so the `.vttc` caches written beside the cue files do not
+    /// count as edits to them.
+    suffix: ?[]const u8 = null,
+
+    /// The directory holding `path`, watched for `path`'s name alone.
+    pub fn file(path: []const u8) Target {
+        const slash = std.mem.lastIndexOfScalar(u8, path, '/') orelse return .{ .dir = ".", .name = path };
+        return .{ .dir = if (slash == 0) "/" else path[0..slash], .name = path[slash + 1 ..] };
+    }
+};
+
+/// One `Target` per topic; a topic left null is never bumped.
+pub const Targets = struct {
+    cues: ?Target = null,
+    countdown: ?Target = null,
+    zone: ?Target = null,
+
+    fn get(self: Targets, topic: Topic) ?Target {
+        return switch (topic) {
+            .cues => self.cues,
+            .countdown => self.countdown,
+            .zone => self.zone,
+        };
+    }
+};
+
+/// Every event that can mean a watched entry now reads differently: written
+/// and closed, renamed in or out, created (a link made in place), deleted,
+/// touched, or the directory itself going away.
+const watch_mask: u32 = linux.IN.CLOSE_WRITE | linux.IN.MOVED_TO | linux.IN.MOVED_FROM |
+    linux.IN.CREATE | linux.IN.DELETE | linux.IN.ATTRIB | linux.IN.DELETE_SELF |
+    linux.IN.MOVE_SELF | linux.IN.ONLYDIR;
+
+/// How long the thread waits for events in one go. Only bounds how quickly it
+/// notices `stop`.
+const POLL_SLICE_MS: i32 = 250;
+
+/// How many slices pass between attempts to watch a directory that could not
+/// be watched: about five seconds.
+const RETRY_SLICES: u32 = 20;
+
+/// Size of the fixed part of a `struct inotify_event`, before the name.
+const event_header_len = 16;
+
+pub const Watcher = struct {
+    fd: i32 = -1,
+    thread: ?std.Thread = null,
+    stopping: std.atomic.Value(bool) = .init(false),
+    /// Set while the thread is running, and so while versions mean anything.
+    running: std.atomic.Value(bool) = .init(false),
+    /// Start at 1, so a fresh `Subscription` (which has seen 0) reports a
+    /// change the first time it is asked.
+    versions: [topic_count]std.atomic.Value(u64) = [_]std.atomic.Value(u64){.init(1)} ** topic_count,
+    watches: [topic_count]Watch = [_]Watch{.{}} ** topic_count,
+    /// Rung on every bump, and whenever `running` changes, so a consumer
+    /// asleep on it notices a change or the switch to polling at once.
+    changed: Event = .{},
+
+    const Watch = struct {
+        configured: bool = false,
+        /// NUL-terminated, for the syscall.
+        dir_buf: [max_path_len + 1]u8 = undefined,
+        name_buf: [max_path_len]u8 = undefined,
+        name_len: usize = 0,
+        match: enum { any, name, suffix } = .any,
+        /// inotify's descriptor for the directory, or -1 while it is not
+        /// watched. Two topics in one directory share it: the kernel hands
+        /// back the same descriptor for the same inode.
+        wd: i32 = -1,
+
+        fn configure(self: *Watch, target: Target) error{NameTooLong}!void {
+            const filter = target.name orelse target.suffix orelse "";
+            if (target.dir.len > max_path_len or filter.len > max_path_len) return error.NameTooLong;
+            @memcpy(self.dir_buf[0..target.dir.len], target.dir);
+            self.dir_buf[target.dir.len] = 0;
+            @memcpy(self.name_buf[0..filter.len], filter);
+            self.name_len = filter.len;
+            self.match = if (target.name != null) .name else if (target.suffix != null) .suffix else .any;
+            self.configured = true;
+        }
+
+        fn dir(self: *const Watch) [:0]const u8 {
+            return std.mem.sliceTo(self.dir_buf[0..], 0);
+        }
+
+        /// Whether an event naming `entry` concerns this watch. An event on
+        /// the directory itself has no name, and always does.
+        fn wants(self: *const Watch, entry: []const u8) bool {
+            if (entry.len == 0) return true;
+            const filter = self.name_buf[0..self.name_len];
+            return switch (self.match) {
+                .any => true,
+                .name => std.mem.eql(u8, entry, filter),
+                .suffix => std.mem.endsWith(u8, entry, filter),
+            };
+        }
+    };
+
+    /// Watch `targets` from a thread of its own. `self` must not move until
+    /// `stop`.
+    pub fn start(self: *Watcher, targets: Targets) !void {
+        for (&self.watches, 0..) |*w, i| {
+            if (targets.get(@enumFromInt(i))) |target| try w.configure(target);
+        }
+        const rc = linux.inotify_init1(linux.IN.CLOEXEC);
+        if (linux.errno(rc) != .SUCCESS) return error.InotifyUnavailable;
+        self.fd = @intCast(rc);
+        errdefer {
+            _ = linux.close(self.fd);
+            self.fd = -1;
+        }
+        // Watched here as well as on the thread, so an edit made the moment
+        // `start` returns is already seen.
+        self.addMissing();
+        self.stopping.store(false, .release);
+        self.thread = try std.Thread.spawn(.{}, run, .{self});
+        self.running.store(true, .release);
+        self.changed.notify();
+    }
+
+    /// Stop and join the thread. Subscriptions go back to polling.
+    pub fn stop(self: *Watcher) void {
+        self.running.store(false, .release);
+        self.changed.notify();
+        self.stopping.store(true, .release);
+        if (self.thread) |t| t.join();
+        self.thread = null;
+        if (self.fd >= 0) _ = linux.close(self.fd);
+        self.fd = -1;
+    }
+
+    pub fn version(self: *const Watcher, topic: Topic) u64 {
+        return self.versions[@intFromEnum(topic)].load(.acquire);
+    }
+
+    fn bump(self: *Watcher, index: usize) void {
+        _ = self.versions[index].fetchAdd(1, .release);
+        self.changed.notify();
+    }
+
+    fn run(self: *Watcher) void {
+        // Events are read whole or not at all, and one with a name up to
+        // NAME_MAX must fit.
+        var buf: [4096]u8 align(@alignOf(u32)) = undefined;
+        var slices: u32 = 0;
+        while (!self.stopping.load(.acquire)) {
+            slices += 1;
+            if (slices >= RETRY_SLICES) {
+                slices = 0;
+                self.addMissing();
+            }
+
+            var pfd = [1]linux.pollfd{.{ .fd = self.fd, .events = linux.POLL.IN, .revents = 0 }};
+            const ready = linux.poll(&pfd, 1, POLL_SLICE_MS);
+            switch (linux.errno(ready)) {
+                .SUCCESS => if (ready == 0) continue,
+                .INTR => continue,
+                else => |e| {
+                    std.log.err("File watch: poll failed: {s}\n", .{@tagName(e)});
+                    break;
+                },
+            }
+
+            const n = linux.read(self.fd, &buf, buf.len);
+            switch (linux.errno(n)) {
+                .SUCCESS => self.dispatch(buf[0..n]),
+                .INTR, .AGAIN => continue,
+                else => |e| {
+                    std.log.err("File watch: read failed: {s}\n", .{@tagName(e)});
+                    break;
+                },
+            }
+        }
+        // Given up on: let every consumer go back to polling rather than wait
+        // for events that will never come.
+        self.running.store(false, .release);
+        self.changed.notify();
+    }
+
+    /// Watch every configured directory not yet watched. One that appears
+    /// after being missing may have the file in it already, so its topic is
+    /// bumped as well.
+    fn addMissing(self: *Watcher) void {
+        for (&self.watches, 0..) |*w, i| {
+            if (!w.configured or w.wd >= 0) continue;
+            const rc = linux.inotify_add_watch(self.fd, w.dir(), watch_mask);
+            switch (linux.errno(rc)) {
+                .SUCCESS => {
+                    w.wd = @intCast(rc);
+                    self.bump(i);
+                    dbg.print(.config, "File watch: watching {s} for {s}\n", .{ w.dir(), @tagName(@as(Topic, @enumFromInt(i))) });
+                },
+                else => |e| dbg.print(.config, "File watch: cannot watch {s} yet: {s}\n", .{ w.dir(), @tagName(e) }),
+            }
+        }
+    }
+
+    /// Bump the topic of every event in `bytes`, as read from the inotify
+    /// descriptor.
+    fn dispatch(self: *Watcher, bytes: []const u8) void {
+        var offset: usize = 0;
+        while (offset + event_header_len <= bytes.len) {
+            const header = bytes[offset..][0..event_header_len];
+            const wd = std.mem.readInt(i32, header[0..4], .native);
+            const mask = std.mem.readInt(u32, header[4..8], .native);
+            const name_len = std.mem.readInt(u32, header[12..16], .native);
+            const name_end = offset + event_header_len + name_len;
+            if (name_end > bytes.len) break;
+            // NUL-padded by the kernel.
+            const name = std.mem.sliceTo(bytes[offset + event_header_len .. name_end], 0);
+            self.note(wd, mask, name);
+            offset = name_end;
+        }
+    }
+
+    fn note(self: *Watcher, wd: i32, mask: u32, name: []const u8) void {
+        if (mask & linux.IN.Q_OVERFLOW != 0) {
+            // Events were dropped; any of them could have been anyone's.
+            for (0..topic_count) |i| self.bump(i);
+            return;
+        }
+        for (&self.watches, 0..) |*w, i| {
+            if (w.wd != wd) continue;
+            if (mask & linux.IN.IGNORED != 0) {
+                // The directory went away and the watch with it. Watched
+                // again once it is back.
+                w.wd = -1;
+                self.bump(i);
+            } else if (mask & linux.IN.MOVE_SELF != 0) {
+                // Still watching the directory, but no longer at its path.
+                // Dropping the watch raises IN_IGNORED, and the path is
+                // watched afresh from there.
+                _ = linux.inotify_rm_watch(self.fd, wd);
+            } else if (w.wants(name)) {
+                self.bump(i);
+            }
+        }
+    }
+};
+
+/// A consumer's view of one topic.
+pub const Subscription = struct {
+    topic: Topic,
+    /// With no watcher running, `changed` reports a change this often: the
+    /// interval the consumer used to poll at.
+    poll_ms: i64,
+    watcher: *Watcher = &shared,
+    seen: u64 = 0,
+    next_poll_ms: i64 = 0,
+
+    /// Whether the topic may have changed since this last returned true.
+    /// True on the first call.
+    pub fn changed(self: *Subscription, now_ms: i64) bool {
+        if (self.watcher.running.load(.acquire)) {
+            const current = self.watcher.version(self.topic);
+            if (current == self.seen) return false;
+            self.seen = current;
+            return true;
+        }
+        if (now_ms < self.next_poll_ms) return false;
+        self.next_poll_ms = now_ms + self.poll_ms;
+        return true;
+    }
+
+    /// Make the next `changed` true, as for a fresh subscription.
+    pub fn reset(self: *Subscription) void {
+        self.seen = 0;
+        self.next_poll_ms = 0;
+    }
+
+    /// How long a consumer asleep on `forwardTo`'s event can leave it before
+    /// `changed` might be true: until the next poll without a watcher, and
+    /// indefinitely with one, which rings the event itself.
+    pub fn msUntilDue(self: *const Subscription, now_ms: i64) i64 {
+        if (self.watcher.running.load(.acquire)) return std.math.maxInt(i64);
+        return @max(0, self.next_poll_ms - now_ms);
+    }
+
+    /// Ring `target` on every change the watcher sees -- to any topic, so a
+    /// consumer looks at `changed` and may find nothing for it -- or stop,
+    /// with null.
+    pub fn forwardTo(self: *Subscription, target: ?*Event) void {
+        self.watcher.changed.forwardTo(target);
+    }
+};
+
+/// The process's watcher, shared by every `Subscription` that does not name
+/// another.
+var shared: Watcher = .{};
+
+/// Start the process's watcher. Failing to is not fatal: subscriptions poll
+/// instead, as before there was a watcher.
+pub fn start(targets: Targets) void {
+    shared.start(targets) catch |err| {
+        std.log.warn("File watching unavailable ({}); polling for changes instead\n", .{err});
+    };
+}
+
+pub fn stop() void {
+    shared.stop();
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+const Io = std.Io;
+
+test "Target.file splits a path into the directory and the name" {
+    const relative = Target.file("line2_config.jsonc");
+    try testing.expectEqualStrings(".", relative.dir);
+    try testing.expectEqualStrings("line2_config.jsonc", relative.name.?);
+
+    const absolute = Target.file("/etc/localtime");
+    try testing.expectEqualStrings("/etc", absolute.dir);
+    try testing.expectEqualStrings("localtime", absolute.name.?);
+
+    const root = Target.file("/localtime");
+    try testing.expectEqualStrings("/", root.dir);
+}
+
+/// One event as the kernel lays it out, name padded to a multiple of four.
+fn appendEvent(out: *std.ArrayList(u8), wd: i32, mask: u32, name: []const u8) !void {
+    const padded = if (name.len == 0) 0 else std.mem.alignForward(usize, name.len + 1, 4);
+    var header: [event_header_len]u8 = undefined;
+    std.mem.writeInt(i32, header[0..4], wd, .native);
+    std.mem.writeInt(u32, header[4..8], mask, .native);
+    std.mem.writeInt(u32, header[8..12], 0, .native);
+    std.mem.writeInt(u32, header[12..16], @intCast(padded), .native);
+    try out.appendSlice(testing.allocator, &header);
+    try out.appendSlice(testing.allocator, name);
+    try out.appendNTimes(testing.allocator, 0, padded - name.len);
+}
+
+test "events bump only the topics whose entries they name" {
+    var w: Watcher = .{};
+    try w.watches[@intFromEnum(Topic.cues)].configure(.{ .dir = "/cues", .suffix = ".vtt" });
+    try w.watches[@intFromEnum(Topic.countdown)].configure(Target.file("line2_config.jsonc"));
+    try w.watches[@intFromEnum(Topic.zone)].configure(Target.file("/etc/localtime"));
+    // The cue directory and the working directory are the same one here, so
+    // share a descriptor, as the kernel would give them.
+    w.watches[@intFromEnum(Topic.cues)].wd = 1;
+    w.watches[@intFromEnum(Topic.countdown)].wd = 1;
+    w.watches[@intFromEnum(Topic.zone)].wd = 2;
+
+    var events: std.ArrayList(u8) = .empty;
+    defer events.deinit(testing.allocator);
+    try appendEvent(&events, 1, linux.IN.CLOSE_WRITE, "movie.vtt");
+    try appendEvent(&events, 1, linux.IN.MOVED_TO, "movie.vttc"); // our own cache
+    try appendEvent(&events, 1, linux.IN.CLOSE_WRITE, "movie.vttc.tmp");
+    try appendEvent(&events, 2, linux.IN.CLOSE_WRITE, "hosts"); // not the zone
+    w.dispatch(events.items);
+    try testing.expectEqual(@as(u64, 2), w.version(.cues));
+    try testing.expectEqual(@as(u64, 1), w.version(.countdown));
+    try testing.expectEqual(@as(u64, 1), w.version(.zone));
+
+    events.clearRetainingCapacity();
+    try appendEvent(&events, 1, linux.IN.MOVED_TO, "line2_config.jsonc");
+    try appendEvent(&events, 2, linux.IN.CREATE, "localtime");
+    w.dispatch(events.items);
+    try testing.expectEqual(@as(u64, 2), w.version(.cues));
+    try testing.expectEqual(@as(u64, 2), w.version(.countdown));
+    try testing.expectEqual(@as(u64, 2), w.version(.zone));
+
+    // The zone's directory going away drops its watch, to be retried.
+    events.clearRetainingCapacity();
+    try appendEvent(&events, 2, linux.IN.IGNORED, "");
+    w.dispatch(events.items);
+    try testing.expectEqual(@as(u64, 3), w.version(.zone));
+    try testing.expectEqual(@as(i32, -1), w.watches[@intFromEnum(Topic.zone)].wd);
+
+    // A queue overflow could have hidden anything.
+    events.clearRetainingCapacity();
+    try appendEvent(&events, -1, linux.IN.Q_OVERFLOW, "");
+    w.dispatch(events.items);
+    try testing.expectEqual(@as(u64, 3), w.version(.cues));
+    try testing.expectEqual(@as(u64, 3), w.version(.countdown));
+    try testing.expectEqual(@as(u64, 4), w.version(.zone));
+}
+
+test "a Subscription reports each version once, and polls without a watcher" {
+    var w: Watcher = .{};
+    var sub: Subscription = .{ .topic = .countdown, .poll_ms = 10_000, .watcher = &w };
+
+    // Not running: the old polling interval.
+    try testing.expect(sub.changed(0));
+    try testing.expect(!sub.changed(9_999));
+    try testing.expect(sub.changed(10_000));
+
+    w.running.store(true, .release);
+    try testing.expect(sub.changed(10_001)); // version 1 not yet seen
+    try testing.expect(!sub.changed(50_000)); // no polling while watched
+    w.bump(@intFromEnum(Topic.countdown));
+    w.bump(@intFromEnum(Topic.countdown));
+    try testing.expect(sub.changed(50_001)); // two bumps, one report
+    try testing.expect(!sub.changed(50_002));
+    w.bump(@intFromEnum(Topic.cues));
+    try testing.expect(!sub.changed(50_003)); // someone else's topic
+
+    sub.reset();
+    try testing.expect(sub.changed(50_004));
+}
+
+test "a file written in a watched directory is seen" {
+    var threaded: Io.Threaded = .init(testing.allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+
+    const path = "file_watch_probe.txt";
+    defer Io.Dir.cwd().deleteFile(io, path) catch {};
+
+    var w: Watcher = .{};
+    w.start(.{ .countdown = Target.file(path) }) catch return error.SkipZigTest; // no inotify here
+    defer w.stop();
+    var sub: Subscription = .{ .topic = .countdown, .poll_ms = 10_000, .watcher = &w };
+    try testing.expect(sub.changed(0));
+
+    try Io.Dir.cwd().writeFile(io, .{ .sub_path = path, .data = "{}" });
+    var waited_ms: u32 = 0;
+    while (!sub.changed(0)) : (waited_ms += 10) {
+        if (waited_ms >= 2000) return error.TestUnexpectedResult;
+        try io.sleep(.fromMilliseconds(10), .awake);
+    }
+}
@@ -0,0 +1,527 @@
+//! Every `debug_log.print`, kept as a compact binary record in a ring per
+//! thread and formatted later, off the thread that logged it.
+//!
+//! `print` used to format on the spot and write through `std.debug.print`,
+//! which takes the process-wide stderr lock: on the display, sender and poll
+//! threads, in the middle of the timing they were logging. `pll` logs on
+//! every poll, and switching on `serial` or `timing` visibly moved the very
+//! numbers it was switched on to read. So a category could only be on while
+//! someone was watching, and the moment something went wrong was never in
+//! the log unless it had been switched on beforehand.
+//!
+//! Now every call, whatever the config, costs a clock read and a copy of its
+//! arguments into the calling thread's ring -- no lock, no formatting, no
+//! system call:
+//!
+//! - A record is the time, the category, the thread, a pointer to a
+//!   formatter generated for the call site (`Site`), and the arguments'
+//!   bytes. Numbers, enums, errors and other pointer-free values are copied
+//!   as they are; strings are copied, truncated if they would not fit. A call
+//!   site with anything else -- a pointer the string might not outlive --
+//!   is formatted into the record at once instead, which still keeps the
+//!   write off the thread.
+//! - Each ring keeps its thread's last `ring_records` records, overwriting
+//!   the oldest. Rings are never locked: the one thread that writes a ring
+//!   marks each slot as it goes, and readers copy a slot and check the mark
+//!   did not move, the same sequence check as `cell.Cell`.
+//! - The drainer thread (`start`) prints the records of the categories
+//!   switched on in `vorne_config.jsonc`, merged across threads in time
+//!   order, as `print` used to. Before it starts and after it stops -- and in
+//!   tests and `zig build bench`, which never start it -- `print` writes
+//!   synchronously as before.
+//! - The drainer wakes every `drain_period_ms`, or early when a ring reaches
+//!   `high_water` records since the last mark, not for each record: a wake
+//!   per line would put a futex call back on every logging thread.
+//! - `SIGUSR1`, or `GET /trace` on the web server, dumps every ring, every
+//!   category, switched on or not: what each thread was doing in the seconds
+//!   before the question came up.
+//!
+//! Printed lines can trail the unconditional `std.log` lines around them by
+//! up to `drain_period_ms`; their timestamps are when they were recorded, and
+//! are what to read the order from.
+
+const std = @import("std");
+const Io = std.Io;
+const linux = std.os.linux;
+const dbg = @import("debug_log.zig");
+const Event = @import("event.zig").Event;
+
+/// Records kept per thread. At the busiest -- `pll` on every poll, `serial`
+/// and `timing` on every frame -- a few seconds' worth.
+pub const ring_records = 256;
+/// Threads with a ring at once. A thread that has exited gives its ring up to
+/// the next thread that needs one (see `ringForThread`); past that, records
+/// are dropped and counted.
+pub const max_rings = 32;
+/// Argument bytes per record.
+pub const payload_len = 160;
+/// How often the drainer prints what has been recorded. Short enough that a
+/// switched-on category still reads as live on `journalctl -f`.
+pub const drain_period_ms = 100;
+/// Records a ring takes between early wakes of the drainer, so that a burst
+/// is printed before it laps the ring rather than after.
+pub const high_water = ring_records / 2;
+
+/// Formats one record's arguments with its call site's format string.
+const Render = *const fn (w: *Io.Writer, payload: []const u8) Io.Writer.Error!void;
+
+pub const Record = struct {
+    /// Real-time clock, as `debug_log`'s timestamps; 0 before it is set.
+    ts_ns: i64,
+    render: Render,
+    tid: i32,
+    category: dbg.Category,
+    len: u8,
+    payload: [payload_len]u8,
+
+    /// One log line, prefixed as `debug_log.print` prefixes it, and with the
+    /// thread's id too when `with_tid`, for a dump mixing every thread.
+    pub fn write(self: *const Record, w: *Io.Writer, with_tid: bool) Io.Writer.Error!void {
+        var stamp: [16]u8 = undefined;
+        const ms = @divFloor(self.ts_ns, std.time.ns_per_ms);
+        try w.print("[{s} UTC {s}", .{ dbg.formatStamp(&stamp, ms), @tagName(self.category) });
+        if (with_tid) try w.print(" {d}", .{self.tid});
+        try w.writeAll("] ");
+        try self.render(w, self.payload[0..self.len]);
+    }
+};
+
+const Slot = struct {
+    /// `2 * n + 2` once record `n` is complete in this slot; odd while one
+    /// is being written.
+    seq: std.atomic.Value(u64) = .init(0),
+    record: Record = undefined,
+};
+
+const Ring = struct {
+    /// The thread writing this ring; 0 while it is free.
+    owner: std.atomic.Value(i32) = .init(0),
+    /// Records ever written; record `n` is in `slots[n % ring_records]`
+    /// until `n + ring_records` overwrites it.
+    head: std.atomic.Value(u64) = .init(0),
+    slots: [ring_records]Slot = @splat(.{}),
+
+    /// Owner only.
+    fn push(self: *Ring, ts_ns: i64, category: dbg.Category, comptime fmt: []const u8, args: anytype) void {
+        const S = Site(fmt, @TypeOf(args));
+        const n = self.head.load(.monotonic);
+        const slot = &self.slots[@intCast(n % ring_records)];
+        // Odd first. Acquire, so none of the record's stores can be seen
+        // before a reader can see the slot is being written.
+        _ = slot.seq.swap(2 * n + 1, .acquire);
+        slot.record.ts_ns = ts_ns;
+        slot.record.render = S.render;
+        slot.record.tid = self.owner.load(.monotonic);
+        slot.record.category = category;
+        slot.record.len = S.encode(&slot.record.payload, args);
+        slot.seq.store(2 * n + 2, .release);
+        self.head.store(n + 1, .release);
+    }
+
+    /// Copy record `n` into `out`; false if it has been overwritten.
+    fn read(self: *Ring, n: u64, out: *Record) bool {
+        const slot = &self.slots[@intCast(n % ring_records)];
+        const want = 2 * n + 2;
+        if (slot.seq.load(.acquire) != want) return false;
+        out.* = slot.record;
+        // A release read-modify-write, so the copy's loads cannot move past
+        // the re-check -- as in `cell.Cell.readTagged`.
+        return slot.seq.fetchAdd(0, .release) == want;
+    }
+};
+
+var rings: [max_rings]Ring = @splat(.{});
+threadlocal var thread_ring: ?*Ring = null;
+/// Records with no ring to go in.
+var dropped = std.atomic.Value(u64).init(0);
+
+/// Keep a record of one `debug_log.print` call. Called for every call,
+/// whether or not its category is on.
+pub fn record(ts_ns: i64, category: dbg.Category, comptime fmt: []const u8, args: anytype) void {
+    const ring = ringForThread() orelse {
+        _ = dropped.fetchAdd(1, .monotonic);
+        return;
+    };
+    ring.push(ts_ns, category, fmt, args);
+    if (ring.head.load(.monotonic) % high_water == 0 and draining.load(.monotonic)) wake_event.notify();
+}
+
+/// The calling thread's ring: a free one, or failing that the ring of a
+/// thread that has exited -- HTTP connection threads come and go -- whose
+/// records stay readable until the new owner writes over them.
+fn ringForThread() ?*Ring {
+    if (thread_ring) |r| return r;
+    const tid = linux.gettid();
+    for (&rings) |*r| {
+        if (r.owner.cmpxchgStrong(0, tid, .acquire, .monotonic) == null) {
+            thread_ring = r;
+            return r;
+        }
+    }
+    const pid = linux.getpid();
+    for (&rings) |*r| {
+        const owner = r.owner.load(.monotonic);
+        if (linux.errno(linux.tgkill(pid, owner, @enumFromInt(0))) != .SRCH) continue;
+        if (r.owner.cmpxchgStrong(owner, tid, .acquire, .monotonic) == null) {
+            thread_ring = r;
+            return r;
+        }
+    }
+    return null;
+}
+
+// ---- Call sites ------------------------------------------------------------
+
+/// How one argument of a call site is kept.
+const Kind = enum {
+    /// Copied byte for byte and formatted as its own type.
+    bytes,
+    /// A string: its bytes copied, behind a length byte.
+    string,
+    /// A literal number, kept as the widest of its kind.
+    int_literal,
+    float_literal,
+    /// Anything holding a pointer. Its call site is formatted at once.
+    other,
+};
+
+fn kindOf(comptime T: type) Kind {
+    return switch (@typeInfo(T)) {
+        .comptime_int => .int_literal,
+        .comptime_float => .float_literal,
+        .pointer => |p| if ((p.size == .slice and p.child == u8) or
+            (p.size == .one and @typeInfo(p.child) == .array and @typeInfo(p.child).array.child == u8))
+            .string
+        else
+            .other,
+        .array => |a| if (a.child == u8) .string else if (isPlain(T)) .bytes else .other,
+        else => if (isPlain(T)) .bytes else .other,
+    };
+}
+
+/// Whether a copy of a `T`'s bytes means the same as the `T` did: no
+/// pointers anywhere in it.
+fn isPlain(comptime T: type) bool {
+    return switch (@typeInfo(T)) {
+        .int, .float, .bool, .@"enum", .error_set, .void => true,
+        .optional => |o| isPlain(o.child),
+        .error_union => |e| isPlain(e.payload),
+        .array => |a| isPlain(a.child),
+        .@"struct" => |s| for (s.fields) |f| {
+            if (f.is_comptime or !isPlain(f.type)) break false;
+        } else true,
+        .@"union" => |u| u.tag_type != null and for (u.fields) |f| {
+            if (!isPlain(f.type)) break false;
+        } else true,
+        else => false,
+    };
+}
+
+/// What an argument of type `T` is formatted as, once read back.
+fn Stored(comptime T: type) type {
+    return switch (kindOf(T)) {
+        .bytes => T,
+        .string => []const u8,
+        .int_literal => i64,
+        .float_literal => f64,
+        .other => void,
+    };
+}
+
+/// The encoder and formatter for every call with format `fmt` and arguments
+/// of type `Args`.
+fn Site(comptime fmt: []const u8, comptime Args: type) type {
+    const fields = @typeInfo(Args).@"struct".fields;
+    return struct {
+        /// Bytes every argument after the `i`th needs at the least: all of a
+        /// fixed-size one, the length byte of a string.
+        const reserved_after: [fields.len]usize = blk: {
+            var after: [fields.len]usize = undefined;
+            var sum: usize = 0;
+            var i: usize = fields.len;
+            while (i > 0) {
+                i -= 1;
+                after[i] = sum;
+                sum += switch (kindOf(fields[i].type)) {
+                    .string => 1,
+                    else => @sizeOf(Stored(fields[i].type)),
+                };
+            }
+            break :blk after;
+        };
+
+        /// Whether formatting can wait for the drainer. If not, the call
+        /// is formatted into the record as text.
+        const deferred = blk: {
+            var need: usize = 0;
+            for (fields) |f| {
+                switch (kindOf(f.type)) {
+                    .other => break :blk false,
+                    .string => need += 1,
+                    else => need += @sizeOf(Stored(f.type)),
+                }
+            }
+            break :blk need <= payload_len;
+        };
+
+        const StoredArgs = blk: {
+            var types: [fields.len]type = undefined;
+            for (fields, 0..) |f, i| types[i] = Stored(f.type);
+            break :blk @Tuple(&types);
+        };
+
+        fn encode(payload: *[payload_len]u8, args: Args) u8 {
+            if (!deferred) {
+                var w: Io.Writer = .fixed(payload);
+                w.print(fmt, args) catch {}; // truncated; what fits is kept
+                return @intCast(w.end);
+            }
+            var pos: usize = 0;
+            inline for (fields, 0..) |f, i| {
+                switch (comptime kindOf(f.type)) {
+                    .string => {
+                        const text: []const u8 = if (comptime @typeInfo(f.type) == .array)
+                            &@field(args, f.name)
+                        else
+                            @field(args, f.name);
+                        const room = payload_len - pos - 1 - reserved_after[i];
+                        const n = @min(text.len, room, std.math.maxInt(u8));
+                        payload[pos] = @intCast(n);
+                        @memcpy(payload[pos + 1 ..][0..n], text[0..n]);
+                        pos += 1 + n;
+                    },
+                    else => {
+                        const value: Stored(f.type) = @field(args, f.name);
+                        @memcpy(payload[pos..][0..@sizeOf(@TypeOf(value))], std.mem.asBytes(&value));
+                        pos += @sizeOf(@TypeOf(value));
+                    },
+                }
+            }
+            return @intCast(pos);
+        }
+
+        fn render(w: *Io.Writer, payload: []const u8) Io.Writer.Error!void {
+            if (!deferred) return w.writeAll(payload);
+            var args: StoredArgs = undefined;
+            var pos: usize = 0;
+            inline for (fields, 0..) |f, i| {
+                switch (comptime kindOf(f.type)) {
+                    .string => {
+                        const n = payload[pos];
+                        args[i] = payload[pos + 1 ..][0..n];
+                        pos += 1 + n;
+                    },
+                    else => {
+                        const T = Stored(f.type);
+                        var value: T = undefined;
+                        @memcpy(std.mem.asBytes(&value), payload[pos..][0..@sizeOf(T)]);
+                        args[i] = value;
+                        pos += @sizeOf(T);
+                    },
+                }
+            }
+            try w.print(fmt, args);
+        }
+    };
+}
+
+// ---- Reading ---------------------------------------------------------------
+
+/// Every ring's records in time order, from per-ring cursors. Each ring is
+/// already in order, so this only ever compares the next record of each.
+const Merge = struct {
+    cursors: [max_rings]u64 = @splat(0),
+    ends: [max_rings]u64 = @splat(0),
+    peeked: [max_rings]?Record = @splat(null),
+    /// Records overwritten before this got to them.
+    lost: u64 = 0,
+
+    /// Bring every record written so far into view.
+    fn refresh(self: *Merge) void {
+        for (&rings, &self.ends) |*r, *end| end.* = r.head.load(.acquire);
+    }
+
+    /// Start from the oldest record still held.
+    fn rewind(self: *Merge) void {
+        self.refresh();
+        for (&self.cursors, self.ends) |*c, end| c.* = end -| ring_records;
+    }
+
+    fn next(self: *Merge) ?Record {
+        var best: ?usize = null;
+        for (0..max_rings) |i| {
+            if (self.peeked[i] == null) self.peeked[i] = self.peek(i);
+            const rec = self.peeked[i] orelse continue;
+            if (best == null or rec.ts_ns < self.peeked[best.?].?.ts_ns) best = i;
+        }
+        const i = best orelse return null;
+        defer self.peeked[i] = null;
+        return self.peeked[i];
+    }
+
+    fn peek(self: *Merge, i: usize) ?Record {
+        var rec: Record = undefined;
+        while (self.cursors[i] < self.ends[i]) {
+            const oldest = self.ends[i] -| ring_records;
+            if (self.cursors[i] < oldest) {
+                self.lost += oldest - self.cursors[i];
+                self.cursors[i] = oldest;
+            }
+            const n = self.cursors[i];
+            self.cursors[i] += 1;
+            if (rings[i].read(n, &rec)) return rec;
+            self.lost += 1;
+        }
+        return null;
+    }
+};
+
+/// Every record still held, every category, oldest first.
+pub fn dump(w: *Io.Writer) Io.Writer.Error!void {
+    var merge: Merge = .{};
+    merge.rewind();
+    try w.print("---- flight recorder: the last {d} records of each thread ----\n", .{ring_records});
+    while (merge.next()) |rec| try rec.write(w, true);
+    const lost = dropped.load(.monotonic);
+    try w.print("---- end of flight recorder; {d} records found no ring ----\n", .{lost});
+}
+
+// ---- The drainer -----------------------------------------------------------
+
+var drainer: ?std.Thread = null;
+/// Read by `debug_log.print`, so sequentially consistent both ways: see
+/// `stop`.
+var draining = std.atomic.Value(bool).init(false);
+var stopping = std.atomic.Value(bool).init(false);
+var dump_requested = std.atomic.Value(bool).init(false);
+/// Rung for a ring at its high-water mark, a dump or a stop.
+var wake_event: Event = .{};
+/// The drainer's own, so only it touches it once started.
+var drain_merge: Merge = .{};
+
+/// Start printing switched-on categories from a thread of its own. Records
+/// kept before this were printed as they were made, so the drainer starts
+/// after them.
+pub fn start() !void {
+    drain_merge.refresh();
+    drain_merge.cursors = drain_merge.ends;
+    stopping.store(false, .seq_cst);
+    drainer = try std.Thread.spawn(.{}, drain, .{});
+    draining.store(true, .seq_cst);
+}
+
+/// Print whatever is left and stop the drainer. `print` writes for itself
+/// again from here on.
+pub fn stop() void {
+    const thread = drainer orelse return;
+    // Before the drainer's last pass, so a record made by a `print` that
+    // still saw the drainer running is in that pass.
+    draining.store(false, .seq_cst);
+    stopping.store(true, .seq_cst);
+    wake_event.notify();
+    thread.join();
+    drainer = null;
+}
+
+/// Whether a switched-on record will be printed by the drainer, rather than
+/// by the `print` that made it.
+pub fn isDraining() bool {
+    return draining.load(.seq_cst);
+}
+
+/// Dump every ring to stderr from the drainer. Async-signal-safe: for
+/// `SIGUSR1`.
+pub fn requestDump() void {
+    dump_requested.store(true, .release);
+    wake_event.notify();
+}
+
+fn drain() void {
+    var reported_lost: u64 = 0;
+    while (true) {
+        const seen = wake_event.seq();
+        const last_pass = stopping.load(.seq_cst);
+        if (dump_requested.swap(false, .acq_rel)) dumpToStderr();
+
+        drain_merge.refresh();
+        while (drain_merge.next()) |rec| {
+            if (dbg.enabled(rec.category)) printLine(&rec, false);
+        }
+        if (drain_merge.lost != reported_lost) {
+            std.log.warn("Debug log fell {d} records behind; they are lost\n", .{drain_merge.lost - reported_lost});
+            reported_lost = drain_merge.lost;
+        }
+        if (last_pass) return;
+        wake_event.wait(seen, drain_period_ms);
+    }
+}
+
+fn dumpToStderr() void {
+    var merge: Merge = .{};
+    merge.rewind();
+    std.debug.print("---- flight recorder: the last {d} records of each thread ----\n", .{ring_records});
+    while (merge.next()) |rec| printLine(&rec, true);
+    std.debug.print("---- end of flight recorder ----\n", .{});
+}
+
+fn printLine(rec: *const Record, with_tid: bool) void {
+    var buf: [512]u8 = undefined;
+    var w: Io.Writer = .fixed(&buf);
+    rec.write(&w, with_tid) catch {};
+    const line = w.buffered();
+    const newline = if (line.len > 0 and line[line.len - 1] == '\n') "" else "\n";
+    std.debug.print("{s}{s}", .{ line, newline });
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+fn dumped() ![]u8 {
+    var out: Io.Writer.Allocating = .init(testing.allocator);
+    errdefer out.deinit();
+    try dump(&out.writer);
+    return out.toOwnedSlice();
+}
+
+test "a record is formatted from its arguments' bytes when read back" {
+    const Color = enum { red, green };
+    var name_buf = "fr-test-a".*;
+    record(5, .display, "fr-test {s} {d} {d:.1} {} {s} {} {s}\n", .{
+        @as([]const u8, &name_buf), @as(u32, 42), @as(f64, 2.5), true, @tagName(Color.green), @as(anyerror, error.Unplugged), "lit",
+    });
+    // The caller's buffer is free to change once `record` returns.
+    name_buf[0] = 'X';
+
+    const text = try dumped();
+    defer testing.allocator.free(text);
+    try testing.expect(std.mem.indexOf(u8, text, "display ") != null);
+    const at = std.mem.indexOf(u8, text, "] fr-test fr-test-a 42 2.5 true green ").?;
+    const line_end = std.mem.indexOfScalarPos(u8, text, at, '\n').?;
+    try testing.expect(std.mem.endsWith(u8, text[at..line_end], "Unplugged lit"));
+}
+
+test "a thread's ring keeps its latest records" {
+    for (0..ring_records + 10) |i| record(10, .pll, "fr-ring {d}.\n", .{i});
+    const text = try dumped();
+    defer testing.allocator.free(text);
+    try testing.expect(std.mem.indexOf(u8, text, "fr-ring 9.\n") == null);
+    try testing.expect(std.mem.indexOf(u8, text, "fr-ring 10.\n") != null);
+    try testing.expect(std.mem.indexOf(u8, text, std.fmt.comptimePrint("fr-ring {d}.\n", .{ring_records + 9})) != null);
+}
+
+test "a call site with a pointer is formatted at once, and a long string truncated" {
+    try testing.expect(!Site("{*}\n", struct { *const u8 }).deferred);
+    try testing.expect(Site("{s} {d}\n", struct { []const u8, u64 }).deferred);
+
+    const long = "y" ** 400;
+    record(20, .serial, "fr-long {s} {d}\n", .{ long, @as(u8, 7) });
+    const text = try dumped();
+    defer testing.allocator.free(text);
+    // The number after the string survives: the string gives up its tail.
+    const at = std.mem.indexOf(u8, text, "fr-long y").?;
+    const line_end = std.mem.indexOfScalarPos(u8, text, at, '\n').?;
+    try testing.expect(std.mem.endsWith(u8, text[at..line_end], "y 7"));
+}
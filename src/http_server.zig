@@ -0,0 +1,809 @@
+//! The control server: one thread, one `poll` over the listening socket and
+//! every open connection.
+//!
+//! It used to be a thread per connection, spawned and detached on every
+//! accept, reading the request into a 1 KB buffer and closing the connection
+//! after one response -- fine for a person clicking a button, wasteful for a
+//! home-automation poller asking for `/api/status` several times a second:
+//! every poll paid a TCP handshake, a thread's creation and its stack, and a
+//! request too long for the buffer was quietly cut short. Here a connection
+//! stays open between requests (HTTP/1.1 keep-alive), a client may send the
+//! next request before the last has been answered (pipelining), and all of it
+//! is serviced by the one thread, which sleeps in `poll` when there is
+//! nothing to do.
+//!
+//! Everything is bounded up front. There are `max_connections` connection
+//! slots, allocated once by `Server.open`; a request's head may be at most
+//! `max_head_len` and its body `max_body_len`, and one that is not is
+//! answered with an error and the connection closed, rather than buffered
+//! without end. A client that stops reading its responses is not read from
+//! either (`max_pending_output`), so it cannot make the server queue replies
+//! for it forever, and one that goes quiet is closed after
+//! `IDLE_TIMEOUT_MS`.
+//!
+//! The parser takes what this service's clients send -- browsers, `curl`,
+//! pollers -- and no more: requests carry a `Content-Length` if they have a
+//! body at all, and a chunked one is refused with 501.
+//!
+//! A response can instead open a Server-Sent Events stream
+//! (`Response.startEventStream`), which stays open for messages the handler
+//! `broadcast`s to every stream at once. Each stream queues at most
+//! `stream_queue_len` of them: one for a browser that is not keeping up
+//! replaces the oldest it has not been sent yet, so a slow client loses
+//! updates rather than holding up the rest, or whatever produced them. What
+//! produces them wakes the server through `Server.wake_fd`.
+
+const std = @import("std");
+const Io = std.Io;
+const linux = std.os.linux;
+const process_mgmt = @import("process_mgmt.zig");
+
+/// Open connections at once. One more is accepted by closing the one that
+/// has been idle longest, so a page left open in a browser cannot lock a
+/// poller out.
+pub const max_connections = 64;
+
+/// Longest request line and headers, without the blank line ending them.
+pub const max_head_len = 8 * 1024;
+
+/// Longest request body. The forms on the page post a few dozen bytes.
+pub const max_body_len = 8 * 1024;
+
+/// A whole request of the largest size fits one connection's input buffer.
+const in_buf_len = max_head_len + 4 + max_body_len;
+
+/// Responses queued for a client that is not reading them, beyond which
+/// pipelined requests are left unread until it catches up.
+const max_pending_output = 256 * 1024;
+
+/// A connection's output buffer is given back once it has held more than
+/// this -- a `/trace` dump, say -- rather than kept at that size for good.
+const keep_output_capacity = 64 * 1024;
+
+/// How long a connection may go without a byte either way before it is
+/// closed -- or for an event stream, without a byte of what is owed it
+/// going out.
+const IDLE_TIMEOUT_MS: i64 = 30_000;
+
+/// Longest message `Server.broadcast` takes.
+pub const max_message_len = 1024;
+
+/// Messages an event stream holds that its client has not yet been sent,
+/// besides the one going out.
+const stream_queue_len = 4;
+
+/// How long an event stream goes without a message before it is sent a
+/// comment, so that a client gone without a word is noticed, and nothing in
+/// between times the stream out.
+const HEARTBEAT_MS: i64 = 15_000;
+
+/// How long the thread waits in `poll` at most. Bounds how quickly it
+/// notices a shutdown, and how late an idle connection is closed.
+const POLL_SLICE_MS: i32 = 500;
+
+pub const Status = enum(u16) {
+    ok = 200,
+    found = 302,
+    bad_request = 400,
+    not_found = 404,
+    payload_too_large = 413,
+    header_fields_too_large = 431,
+    internal_server_error = 500,
+    not_implemented = 501,
+
+    pub fn phrase(self: Status) []const u8 {
+        return switch (self) {
+            .ok => "OK",
+            .found => "Found",
+            .bad_request => "Bad Request",
+            .not_found => "Not Found",
+            .payload_too_large => "Payload Too Large",
+            .header_fields_too_large => "Request Header Fields Too Large",
+            .internal_server_error => "Internal Server Error",
+            .not_implemented => "Not Implemented",
+        };
+    }
+};
+
+/// One parsed request. Every slice points into the connection's input
+/// buffer, so it lives only until the handler returns.
+pub const Request = struct {
+    method: []const u8,
+    /// The target up to any `?`.
+    path: []const u8,
+    /// What follows the `?`, without it; empty if there is none.
+    query: []const u8,
+    /// The header lines, CRLF-separated, without the request line.
+    headers: []const u8,
+    body: []const u8,
+    /// Whether the connection stays open after the response: HTTP/1.1
+    /// unless the client said `Connection: close`, HTTP/1.0 only if it said
+    /// `Connection: keep-alive`.
+    keep_alive: bool,
+
+    /// The value of the first header called `name`, any case, trimmed.
+    pub fn header(self: *const Request, name: []const u8) ?[]const u8 {
+        var lines = std.mem.splitSequence(u8, self.headers, "\r\n");
+        while (lines.next()) |line| {
+            const colon = std.mem.indexOfScalar(u8, line, ':') orelse continue;
+            if (std.ascii.eqlIgnoreCase(line[0..colon], name)) {
+                return std.mem.trim(u8, line[colon + 1 ..], " \t");
+            }
+        }
+        return null;
+    }
+
+    pub fn is(self: *const Request, method: []const u8, path: []const u8) bool {
+        return std.mem.eql(u8, self.method, method) and std.mem.eql(u8, self.path, path);
+    }
+};
+
+/// What a handler fills in. Content-Length and Connection are added by the
+/// server.
+pub const Response = struct {
+    status: Status = .ok,
+    content_type: []const u8 = "text/plain; charset=utf-8",
+    location: ?[]const u8 = null,
+    /// Written to by the handler; sent once it returns.
+    body: *Io.Writer,
+    /// Keep the connection open as a `text/event-stream` after `body`,
+    /// which is the stream's first messages -- see `startEventStream`.
+    event_stream: bool = false,
+
+    /// Answer a form post by sending the browser back to the page.
+    pub fn redirect(self: *Response, location: []const u8) void {
+        self.status = .found;
+        self.location = location;
+    }
+
+    /// Make this response a Server-Sent Events stream: `body`, then every
+    /// `Server.broadcast` until the client goes. Nothing the client sends
+    /// on the connection afterwards is read as a request.
+    pub fn startEventStream(self: *Response) void {
+        self.event_stream = true;
+        self.content_type = "text/event-stream";
+    }
+};
+
+pub const Parsed = union(enum) {
+    /// Not all of the request has arrived yet.
+    incomplete,
+    /// Cannot be answered: reply with this and close the connection, since
+    /// where the next request would start is not known.
+    invalid: Status,
+    /// A whole request, `len` bytes long.
+    complete: struct { request: Request, len: usize },
+};
+
+/// Parse the request at the start of `buf`, which may hold only part of it,
+/// or more than one.
+pub fn parse(buf: []const u8) Parsed {
+    const head_end = std.mem.indexOf(u8, buf[0..@min(buf.len, max_head_len + 4)], "\r\n\r\n") orelse {
+        return if (buf.len >= max_head_len + 4) .{ .invalid = .header_fields_too_large } else .incomplete;
+    };
+    const head = buf[0..head_end];
+
+    const line_end = std.mem.indexOf(u8, head, "\r\n") orelse head.len;
+    var parts = std.mem.splitScalar(u8, head[0..line_end], ' ');
+    const method = parts.next() orelse return .{ .invalid = .bad_request };
+    const target = parts.next() orelse return .{ .invalid = .bad_request };
+    const version = parts.next() orelse return .{ .invalid = .bad_request };
+    if (parts.next() != null or method.len == 0 or target.len == 0) return .{ .invalid = .bad_request };
+    if (!std.mem.startsWith(u8, version, "HTTP/1.")) return .{ .invalid = .bad_request };
+
+    var request: Request = .{
+        .method = method,
+        .path = target,
+        .query = "",
+        .headers = if (line_end < head.len) head[line_end + 2 ..] else "",
+        .body = "",
+        .keep_alive = !std.mem.eql(u8, version, "HTTP/1.0"),
+    };
+    if (std.mem.indexOfScalar(u8, target, '?')) |q| {
+        request.path = target[0..q];
+        request.query = target[q + 1 ..];
+    }
+
+    var content_length: usize = 0;
+    var lines = std.mem.splitSequence(u8, request.headers, "\r\n");
+    while (lines.next()) |line| {
+        if (line.len == 0) continue;
+        const colon = std.mem.indexOfScalar(u8, line, ':') orelse return .{ .invalid = .bad_request };
+        if (colon == 0) return .{ .invalid = .bad_request };
+        const name = line[0..colon];
+        const value = std.mem.trim(u8, line[colon + 1 ..], " \t");
+        if (std.ascii.eqlIgnoreCase(name, "content-length")) {
+            content_length = std.fmt.parseInt(usize, value, 10) catch return .{ .invalid = .bad_request };
+            if (content_length > max_body_len) return .{ .invalid = .payload_too_large };
+        } else if (std.ascii.eqlIgnoreCase(name, "transfer-encoding")) {
+            return .{ .invalid = .not_implemented };
+        } else if (std.ascii.eqlIgnoreCase(name, "connection")) {
+            if (hasToken(value, "close")) request.keep_alive = false;
+            if (hasToken(value, "keep-alive")) request.keep_alive = true;
+        }
+    }
+
+    const body_start = head_end + 4;
+    const len = body_start + content_length;
+    if (buf.len < len) return .incomplete;
+    request.body = buf[body_start..len];
+    return .{ .complete = .{ .request = request, .len = len } };
+}
+
+/// Whether the comma-separated header `value` lists `token`, any case.
+fn hasToken(value: []const u8, token: []const u8) bool {
+    var items = std.mem.splitScalar(u8, value, ',');
+    while (items.next()) |item| {
+        if (std.ascii.eqlIgnoreCase(std.mem.trim(u8, item, " \t"), token)) return true;
+    }
+    return false;
+}
+
+const Connection = struct {
+    /// -1 while the slot is free.
+    fd: linux.fd_t = -1,
+    in: [in_buf_len]u8 = undefined,
+    in_len: usize = 0,
+    /// Responses not yet sent, from `out_sent` on.
+    out: std.ArrayList(u8) = .empty,
+    out_sent: usize = 0,
+    /// The client has shut its side: answer what it sent, then close.
+    peer_closed: bool = false,
+    /// Close once `out` has gone -- a request asked to, or could not be
+    /// parsed.
+    close_after: bool = false,
+    last_active_ms: i64 = 0,
+    /// An event stream, with no more requests to come.
+    stream: bool = false,
+    /// A stream's broadcasts not yet moved to `out`, oldest first.
+    queued: [stream_queue_len]Message = undefined,
+    queued_head: usize = 0,
+    queued_len: usize = 0,
+
+    const Message = struct {
+        len: usize,
+        bytes: [max_message_len]u8,
+    };
+
+    fn pendingOutput(self: *const Connection) usize {
+        return self.out.items.len - self.out_sent;
+    }
+
+    fn hasOutput(self: *const Connection) bool {
+        return self.pendingOutput() > 0 or self.queued_len > 0;
+    }
+
+    /// Whether there is no request in progress either way, and no stream
+    /// open, so closing it loses nothing.
+    fn idle(self: *const Connection) bool {
+        return !self.stream and self.in_len == 0 and self.pendingOutput() == 0;
+    }
+
+    /// Queue a broadcast, in place of the oldest one still waiting if the
+    /// queue is full.
+    fn enqueue(self: *Connection, message: []const u8) void {
+        if (self.queued_len == stream_queue_len) {
+            self.queued_head = (self.queued_head + 1) % stream_queue_len;
+            self.queued_len -= 1;
+        }
+        const slot = &self.queued[(self.queued_head + self.queued_len) % stream_queue_len];
+        @memcpy(slot.bytes[0..message.len], message);
+        slot.len = message.len;
+        self.queued_len += 1;
+    }
+
+    fn dequeue(self: *Connection) ?*const Message {
+        if (self.queued_len == 0) return null;
+        const message = &self.queued[self.queued_head];
+        self.queued_head = (self.queued_head + 1) % stream_queue_len;
+        self.queued_len -= 1;
+        return message;
+    }
+
+    fn receive(self: *Connection, now_ms: i64) void {
+        const rc = linux.recvfrom(self.fd, self.in[self.in_len..].ptr, self.in.len - self.in_len, 0, null, null);
+        switch (linux.errno(rc)) {
+            .SUCCESS => {
+                if (rc == 0) {
+                    self.peer_closed = true;
+                } else {
+                    self.in_len += rc;
+                    self.last_active_ms = now_ms;
+                }
+            },
+            .INTR, .AGAIN => {},
+            else => self.shut(),
+        }
+    }
+
+    /// Close the socket and free the slot, keeping the output buffer's
+    /// memory for the next connection in it.
+    fn shut(self: *Connection) void {
+        if (self.fd < 0) return;
+        _ = linux.close(self.fd);
+        self.fd = -1;
+        self.in_len = 0;
+        self.out.clearRetainingCapacity();
+        self.out_sent = 0;
+        self.peer_closed = false;
+        self.close_after = false;
+        self.stream = false;
+        self.queued_head = 0;
+        self.queued_len = 0;
+    }
+};
+
+pub const Server = struct {
+    allocator: std.mem.Allocator,
+    listen_fd: linux.fd_t,
+    connections: []Connection,
+    /// Each response's body, reused from one to the next.
+    body: Io.Writer.Allocating,
+    /// An eventfd polled alongside the sockets, or -1. When it is readable
+    /// it is reset and the handler's `wake` called -- for it to `broadcast`
+    /// whatever it was woken for.
+    wake_fd: linux.fd_t = -1,
+    /// How many event streams are open, as last told to the handler.
+    streams: u32 = 0,
+
+    /// Listen on every interface at `port`.
+    pub fn open(allocator: std.mem.Allocator, port: u16) !Server {
+        const fd: linux.fd_t = blk: {
+            const rc = linux.socket(linux.AF.INET, linux.SOCK.STREAM | linux.SOCK.NONBLOCK | linux.SOCK.CLOEXEC, 0);
+            if (linux.errno(rc) != .SUCCESS) return error.SocketCreateFailed;
+            break :blk @intCast(rc);
+        };
+        errdefer _ = linux.close(fd);
+
+        // So a restart can listen again straight away, with the last run's
+        // connections still in TIME_WAIT.
+        try std.posix.setsockopt(fd, std.posix.SOL.SOCKET, std.posix.SO.REUSEADDR, &std.mem.toBytes(@as(c_int, 1)));
+
+        var sa: linux.sockaddr.in = .{
+            .port = std.mem.nativeToBig(u16, port),
+            .addr = 0, // INADDR_ANY
+        };
+        if (linux.errno(linux.bind(fd, @ptrCast(&sa), @sizeOf(linux.sockaddr.in))) != .SUCCESS) {
+            return error.BindFailed;
+        }
+        if (linux.errno(linux.listen(fd, 64)) != .SUCCESS) return error.ListenFailed;
+
+        const connections = try allocator.alloc(Connection, max_connections);
+        for (connections) |*c| c.* = .{};
+        return .{
+            .allocator = allocator,
+            .listen_fd = fd,
+            .connections = connections,
+            .body = .init(allocator),
+        };
+    }
+
+    pub fn close(self: *Server) void {
+        for (self.connections) |*c| {
+            c.shut();
+            c.out.deinit(self.allocator);
+        }
+        self.allocator.free(self.connections);
+        self.body.deinit();
+        _ = linux.close(self.listen_fd);
+    }
+
+    /// Serve until shutdown is requested, calling the handler on this
+    /// thread:
+    ///
+    /// - `handle(*const Request, *Response) !void` for every request.
+    /// - `wake(*Server) void`, if it has one, when `wake_fd` is readable,
+    ///   and when an event stream opens, to catch it up.
+    /// - `watching(u32) void`, if it has one, when the number of open event
+    ///   streams changes.
+    pub fn run(self: *Server, io: Io, handler: anytype) void {
+        const Handler = std.meta.Child(@TypeOf(handler));
+        const first = 2;
+        var fds: [first + max_connections]linux.pollfd = undefined;
+        // Which connection each of `fds[first..]` is.
+        var slots: [first + max_connections]usize = undefined;
+        while (!process_mgmt.shouldShutdown()) {
+            fds[0] = .{ .fd = self.listen_fd, .events = linux.POLL.IN, .revents = 0 };
+            // A negative descriptor is skipped by `poll`.
+            fds[1] = .{ .fd = self.wake_fd, .events = linux.POLL.IN, .revents = 0 };
+            var n: usize = first;
+            var streams: u32 = 0;
+            for (self.connections, 0..) |*c, i| {
+                if (c.fd < 0) continue;
+                if (c.stream) streams += 1;
+                var events: i16 = 0;
+                // Not read while it is owed a backlog of responses, or has
+                // said all it is going to.
+                if (!c.peer_closed and !c.close_after and c.in_len < c.in.len and
+                    c.pendingOutput() < max_pending_output)
+                {
+                    events |= linux.POLL.IN;
+                }
+                if (c.hasOutput()) events |= linux.POLL.OUT;
+                fds[n] = .{ .fd = c.fd, .events = events, .revents = 0 };
+                slots[n] = i;
+                n += 1;
+            }
+            if (streams != self.streams) {
+                const opened = streams > self.streams;
+                self.streams = streams;
+                if (comptime @hasDecl(Handler, "watching")) handler.watching(streams);
+                if (opened) self.wakeHandler(handler, awakeMs(io));
+            }
+
+            const ready = linux.poll(&fds, n, POLL_SLICE_MS);
+            switch (linux.errno(ready)) {
+                .SUCCESS => {},
+                .INTR => continue,
+                else => |e| {
+                    std.log.err("HTTP server: poll failed: {s}\n", .{@tagName(e)});
+                    return;
+                },
+            }
+
+            const now_ms = awakeMs(io);
+            if (fds[1].revents & linux.POLL.IN != 0) {
+                var count: u64 = undefined;
+                _ = linux.read(self.wake_fd, std.mem.asBytes(&count), @sizeOf(u64));
+                self.wakeHandler(handler, now_ms);
+            }
+            for (fds[first..n], slots[first..n]) |pfd, i| {
+                const c = &self.connections[i];
+                if (pfd.revents & linux.POLL.IN != 0) {
+                    c.receive(now_ms);
+                } else if (pfd.revents & (linux.POLL.HUP | linux.POLL.ERR | linux.POLL.NVAL) != 0) {
+                    c.shut();
+                    continue;
+                }
+                if (c.fd >= 0) self.service(c, handler, now_ms);
+            }
+            if (fds[0].revents & linux.POLL.IN != 0) self.acceptAll(now_ms);
+            for (self.connections) |*c| {
+                if (c.fd < 0) continue;
+                const quiet_ms = now_ms - c.last_active_ms;
+                if (!c.stream or c.hasOutput()) {
+                    if (quiet_ms > IDLE_TIMEOUT_MS) c.shut();
+                } else if (quiet_ms > HEARTBEAT_MS) {
+                    c.enqueue(": heartbeat\n\n");
+                }
+            }
+        }
+    }
+
+    /// Queue `message` -- whole Server-Sent Events lines -- on every open
+    /// event stream. It is sent when the stream's client is ready for it;
+    /// one falling behind loses its oldest unsent message for it.
+    pub fn broadcast(self: *Server, message: []const u8) error{MessageTooLong}!void {
+        if (message.len > max_message_len) return error.MessageTooLong;
+        for (self.connections) |*c| {
+            if (c.fd >= 0 and c.stream and !c.close_after) c.enqueue(message);
+        }
+    }
+
+    /// Call the handler's `wake`, and start sending what it broadcast.
+    fn wakeHandler(self: *Server, handler: anytype, now_ms: i64) void {
+        if (comptime !@hasDecl(std.meta.Child(@TypeOf(handler)), "wake")) return;
+        handler.wake(self);
+        for (self.connections) |*c| {
+            if (c.fd >= 0 and c.stream and c.pendingOutput() == 0) self.send(c, now_ms);
+        }
+    }
+
+    fn acceptAll(self: *Server, now_ms: i64) void {
+        while (true) {
+            const rc = linux.accept4(self.listen_fd, null, null, linux.SOCK.NONBLOCK | linux.SOCK.CLOEXEC);
+            switch (linux.errno(rc)) {
+                .SUCCESS => {},
+                .INTR, .CONNABORTED => continue,
+                .AGAIN => return,
+                else => |e| {
+                    // Out of descriptors, most likely. What is queued waits
+                    // for the next pass.
+                    std.log.warn("HTTP server: accept failed: {s}\n", .{@tagName(e)});
+                    return;
+                },
+            }
+            const fd: linux.fd_t = @intCast(rc);
+            const c = self.freeSlot() orelse {
+                _ = linux.close(fd);
+                continue;
+            };
+            c.fd = fd;
+            c.last_active_ms = now_ms;
+        }
+    }
+
+    /// A free connection slot, making one of the idlest open connection if
+    /// there is none; null if every connection is mid-request.
+    fn freeSlot(self: *Server) ?*Connection {
+        var idlest: ?*Connection = null;
+        for (self.connections) |*c| {
+            if (c.fd < 0) return c;
+            if (!c.idle()) continue;
+            if (idlest == null or c.last_active_ms < idlest.?.last_active_ms) idlest = c;
+        }
+        const c = idlest orelse return null;
+        c.shut();
+        return c;
+    }
+
+    /// Answer whatever whole requests `c` has buffered and send what it can
+    /// of the answers.
+    fn service(self: *Server, c: *Connection, handler: anytype, now_ms: i64) void {
+        while (c.fd >= 0) {
+            self.answer(c, handler) catch {
+                c.shut();
+                return;
+            };
+            const backed_up = c.pendingOutput() >= max_pending_output;
+            self.send(c, now_ms);
+            // A backlog that held up pipelined requests has gone, so answer
+            // those too.
+            if (!backed_up or c.fd < 0 or c.pendingOutput() > 0) return;
+        }
+    }
+
+    /// Parse and answer every whole request in `c.in`, until its output is
+    /// backed up.
+    fn answer(self: *Server, c: *Connection, handler: anytype) !void {
+        if (c.stream) {
+            // Only read to notice the client going.
+            c.in_len = 0;
+            if (c.peer_closed) c.close_after = true;
+            return;
+        }
+        var consumed: usize = 0;
+        defer {
+            std.mem.copyForwards(u8, c.in[0 .. c.in_len - consumed], c.in[consumed..c.in_len]);
+            c.in_len -= consumed;
+            // Anything left after the client's last byte is a request it
+            // will never finish.
+            if (c.peer_closed) c.close_after = true;
+        }
+        while (!c.close_after and !c.stream and c.pendingOutput() < max_pending_output) {
+            switch (parse(c.in[consumed..c.in_len])) {
+                .incomplete => return,
+                .invalid => |status| {
+                    c.close_after = true;
+                    self.body.clearRetainingCapacity();
+                    try self.body.writer.print("{s}\n", .{status.phrase()});
+                    var res: Response = .{ .status = status, .body = &self.body.writer };
+                    try self.queue(c, &res, false);
+                    return;
+                },
+                .complete => |parsed| {
+                    consumed += parsed.len;
+                    self.body.clearRetainingCapacity();
+                    var res: Response = .{ .body = &self.body.writer };
+                    handler.handle(&parsed.request, &res) catch |err| {
+                        std.log.err("HTTP server: {s} {s} failed: {}\n", .{ parsed.request.method, parsed.request.path, err });
+                        self.body.clearRetainingCapacity();
+                        res = .{ .status = .internal_server_error, .body = &self.body.writer };
+                    };
+                    if (!parsed.request.keep_alive and !res.event_stream) c.close_after = true;
+                    try self.queue(c, &res, parsed.request.keep_alive);
+                },
+            }
+        }
+    }
+
+    /// Append the response `res` (its body being `self.body`) to `c.out`.
+    fn queue(self: *Server, c: *Connection, res: *const Response, keep_alive: bool) error{OutOfMemory}!void {
+        const body = self.body.written();
+        if (res.event_stream) {
+            // No length: the body goes on for as long as the connection.
+            c.stream = true;
+            try c.out.print(self.allocator, "HTTP/1.1 200 OK\r\nContent-Type: {s}\r\nCache-Control: no-store\r\nConnection: keep-alive\r\n\r\n", .{res.content_type});
+            try c.out.appendSlice(self.allocator, body);
+            return;
+        }
+        try c.out.print(self.allocator, "HTTP/1.1 {d} {s}\r\nContent-Type: {s}\r\nContent-Length: {d}\r\nConnection: {s}\r\n", .{
+            @intFromEnum(res.status),
+            res.status.phrase(),
+            res.content_type,
+            body.len,
+            if (keep_alive) "keep-alive" else "close",
+        });
+        if (res.location) |location| try c.out.print(self.allocator, "Location: {s}\r\n", .{location});
+        try c.out.appendSlice(self.allocator, "\r\n");
+        try c.out.appendSlice(self.allocator, body);
+    }
+
+    fn send(self: *Server, c: *Connection, now_ms: i64) void {
+        while (true) {
+            if (c.pendingOutput() == 0) {
+                if (c.out.capacity > keep_output_capacity) {
+                    c.out.clearAndFree(self.allocator);
+                } else {
+                    c.out.clearRetainingCapacity();
+                }
+                c.out_sent = 0;
+                const message = c.dequeue() orelse break;
+                c.out.appendSlice(self.allocator, message.bytes[0..message.len]) catch {
+                    c.shut();
+                    return;
+                };
+            }
+            const rest = c.out.items[c.out_sent..];
+            const rc = linux.sendto(c.fd, rest.ptr, rest.len, linux.MSG.NOSIGNAL | linux.MSG.DONTWAIT, null, 0);
+            switch (linux.errno(rc)) {
+                .SUCCESS => {
+                    c.out_sent += rc;
+                    c.last_active_ms = now_ms;
+                },
+                .INTR => continue,
+                .AGAIN => return,
+                else => {
+                    c.shut();
+                    return;
+                },
+            }
+        }
+        if (c.close_after) c.shut();
+    }
+};
+
+fn awakeMs(io: Io) i64 {
+    return @intCast(@divFloor(Io.Timestamp.now(io, .awake).nanoseconds, std.time.ns_per_ms));
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+test "parse takes a request only once all of it has arrived" {
+    const raw = "POST /mode?x=1 HTTP/1.1\r\nHost: vorne\r\nContent-Length: 11\r\n\r\nmode=clocks";
+    for (0..raw.len) |n| {
+        try testing.expect(parse(raw[0..n]) == .incomplete);
+    }
+    const parsed = parse(raw).complete;
+    try testing.expectEqual(raw.len, parsed.len);
+    try testing.expectEqualStrings("POST", parsed.request.method);
+    try testing.expectEqualStrings("/mode", parsed.request.path);
+    try testing.expectEqualStrings("x=1", parsed.request.query);
+    try testing.expectEqualStrings("mode=clocks", parsed.request.body);
+    try testing.expectEqualStrings("vorne", parsed.request.header("HOST").?);
+    try testing.expect(parsed.request.keep_alive);
+}
+
+test "parse finds where a pipelined request ends" {
+    const first = "GET /api/status HTTP/1.1\r\n\r\n";
+    const second = "GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n";
+    const third = "GET / HTTP/1.1\r\nConnection: close\r\n\r\n";
+    const buf = first ++ second ++ third;
+
+    const a = parse(buf).complete;
+    try testing.expectEqual(first.len, a.len);
+    const b = parse(buf[a.len..]).complete;
+    try testing.expectEqual(second.len, b.len);
+    try testing.expect(b.request.keep_alive);
+    const c = parse(buf[a.len + b.len ..]).complete;
+    try testing.expect(!c.request.keep_alive);
+    try testing.expect(!parse("GET / HTTP/1.0\r\n\r\n").complete.request.keep_alive);
+}
+
+test "parse refuses what it will not buffer or cannot frame" {
+    try testing.expectEqual(Status.bad_request, parse("GET /\r\n\r\n").invalid);
+    try testing.expectEqual(Status.bad_request, parse("GET / SPDY/3\r\n\r\n").invalid);
+    try testing.expectEqual(Status.bad_request, parse("GET / HTTP/1.1\r\nno colon\r\n\r\n").invalid);
+    try testing.expectEqual(Status.bad_request, parse("POST / HTTP/1.1\r\nContent-Length: x\r\n\r\n").invalid);
+    try testing.expectEqual(Status.payload_too_large, parse("POST / HTTP/1.1\r\nContent-Length: 999999\r\n\r\n").invalid);
+    try testing.expectEqual(Status.not_implemented, parse("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n").invalid);
+
+    const long_head = "GET / HTTP/1.1\r\nX: " ++ "a" ** max_head_len;
+    try testing.expectEqual(Status.header_fields_too_large, parse(long_head).invalid);
+}
+
+const EchoHandler = struct {
+    calls: usize = 0,
+
+    pub fn handle(self: *EchoHandler, req: *const Request, res: *Response) !void {
+        self.calls += 1;
+        if (req.is("POST", "/form")) {
+            res.redirect("/");
+            return;
+        }
+        try res.body.writeAll(req.path);
+    }
+};
+
+test "a connection answers every pipelined request in order and stays open" {
+    var no_connections: [0]Connection = .{};
+    var server: Server = .{
+        .allocator = testing.allocator,
+        .listen_fd = -1,
+        .connections = &no_connections,
+        .body = .init(testing.allocator),
+    };
+    defer server.body.deinit();
+    var c: Connection = .{};
+    defer c.out.deinit(testing.allocator);
+
+    const buf = "GET /a HTTP/1.1\r\n\r\nPOST /form HTTP/1.1\r\nContent-Length: 3\r\n\r\nx=1GET /b";
+    @memcpy(c.in[0..buf.len], buf);
+    c.in_len = buf.len;
+
+    var handler: EchoHandler = .{};
+    try server.answer(&c, &handler);
+    try testing.expectEqual(@as(usize, 2), handler.calls);
+    try testing.expectEqualStrings(
+        "HTTP/1.1 200 OK\r\nContent-Type: text/plain; charset=utf-8\r\nContent-Length: 2\r\nConnection: keep-alive\r\n\r\n/a" ++
+            "HTTP/1.1 302 Found\r\nContent-Type: text/plain; charset=utf-8\r\nContent-Length: 0\r\nConnection: keep-alive\r\nLocation: /\r\n\r\n",
+        c.out.items,
+    );
+    // The unfinished third request is kept for when the rest arrives.
+    try testing.expectEqualStrings("GET /b", c.in[0..c.in_len]);
+    try testing.expect(!c.close_after);
+}
+
+test "a request that cannot be parsed is answered and the connection closed" {
+    var no_connections: [0]Connection = .{};
+    var server: Server = .{
+        .allocator = testing.allocator,
+        .listen_fd = -1,
+        .connections = &no_connections,
+        .body = .init(testing.allocator),
+    };
+    defer server.body.deinit();
+    var c: Connection = .{};
+    defer c.out.deinit(testing.allocator);
+
+    const buf = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nGET / HTTP/1.1\r\n\r\n";
+    @memcpy(c.in[0..buf.len], buf);
+    c.in_len = buf.len;
+
+    var handler: EchoHandler = .{};
+    try server.answer(&c, &handler);
+    try testing.expectEqual(@as(usize, 0), handler.calls);
+    try testing.expect(c.close_after);
+    try testing.expect(std.mem.startsWith(u8, c.out.items, "HTTP/1.1 501 Not Implemented\r\n"));
+    try testing.expect(std.mem.indexOf(u8, c.out.items, "Connection: close\r\n") != null);
+}
+
+const StreamHandler = struct {
+    pub fn handle(_: *StreamHandler, _: *const Request, res: *Response) !void {
+        res.startEventStream();
+        try res.body.writeAll("data: hello\n\n");
+    }
+};
+
+test "an event stream keeps only the newest broadcasts its client has not been sent" {
+    var connections: [1]Connection = .{.{}};
+    var server: Server = .{
+        .allocator = testing.allocator,
+        .listen_fd = -1,
+        .connections = &connections,
+        .body = .init(testing.allocator),
+    };
+    defer server.body.deinit();
+    const c = &connections[0];
+    defer c.out.deinit(testing.allocator);
+    // Never sent on or closed: nothing here calls `send` or `shut`.
+    c.fd = 0;
+
+    const buf = "GET /events HTTP/1.1\r\n\r\nGET /ignored HTTP/1.1\r\n\r\n";
+    @memcpy(c.in[0..buf.len], buf);
+    c.in_len = buf.len;
+    var handler: StreamHandler = .{};
+    try server.answer(c, &handler);
+    try testing.expect(c.stream);
+    try testing.expect(std.mem.endsWith(u8, c.out.items, "Content-Type: text/event-stream\r\nCache-Control: no-store\r\nConnection: keep-alive\r\n\r\ndata: hello\n\n"));
+    try testing.expect(std.mem.indexOf(u8, c.out.items, "Content-Length") == null);
+    // Whatever follows is not a request any more.
+    try server.answer(c, &handler);
+    try testing.expectEqual(@as(usize, 0), c.in_len);
+
+    for (0..stream_queue_len + 2) |i| {
+        var message: [16]u8 = undefined;
+        try server.broadcast(try std.fmt.bufPrint(&message, "data: {d}\n\n", .{i}));
+    }
+    // The two oldest gave way to the newest.
+    try testing.expectEqual(@as(usize, stream_queue_len), c.queued_len);
+    const oldest = c.dequeue().?;
+    try testing.expectEqualStrings("data: 2\n\n", oldest.bytes[0..oldest.len]);
+
+    const too_long = [_]u8{'x'} ** (max_message_len + 1);
+    try testing.expectError(error.MessageTooLong, server.broadcast(&too_long));
+}
@@ -0,0 +1,235 @@
+//! Tick-to-glass latency measurement, for `zig build bench`.
+//!
+//! "Latency" here is one specific interval: from the instant a piece of
+//! content became *due* -- the real second ticking over, the play position
+//! crossing a second, a new file name arriving -- to the instant the final
+//! trailer byte of the frame carrying it left the port. That is the whole
+//! delay the program itself adds; what the panel does after the CRC lands is
+//! the panel's business and is identical for every code path.
+//!
+//! Two halves, reported from two places:
+//!
+//! - the mode loops call `contentDue(line, due_ms)` when what a line should
+//!   show changes, naming when it *should* have changed -- which the loop
+//!   knows and nothing downstream does;
+//! - `transport.Transport` calls `frameWritten` around every write, which
+//!   works out which lines the frame touched (from its `ESC <line>;<col>C`
+//!   escapes) and when its last byte left, adding back the wire time a pty
+//!   does not impose (see `serial.wireMicros`).
+//!
+//! A due change that is superseded before any frame carries it -- two clock
+//! ticks while one send was outstanding -- was never visible, so it yields no
+//! sample; it is counted in `superseded` instead, since a skipped second is
+//! a worse outcome than a late one.
+//!
+//! Off unless `install` is called, and the only cost when off is one load of
+//! `active` per call. Installed once, before any mode thread starts, and not
+//! changed while one runs -- the same set-once discipline as
+//! `vorne_config.zig`, which is why `active` itself is unsynchronized.
+
+const std = @import("std");
+const protocol = @import("protocol.zig");
+const panel_emulator = @import("panel_emulator.zig");
+
+var active_recorder: ?*Recorder = null;
+
+pub fn install(recorder: ?*Recorder) void {
+    active_recorder = recorder;
+}
+
+pub fn active() ?*Recorder {
+    return active_recorder;
+}
+
+/// Report that `line` (1-based) should show something new as of `due_ms`.
+pub fn contentDue(line: u8, due_ms: i64) void {
+    if (active_recorder) |r| r.due(line, due_ms * std.time.us_per_ms);
+}
+
+/// Enough for a few minutes of every mode at full tilt. Samples past this are
+/// counted but not kept, so a long run still reports a rate, just from the
+/// first `max_samples` latencies.
+pub const max_samples = 1 << 16;
+
+pub const Summary = struct {
+    samples: usize,
+    p50_us: i64,
+    p99_us: i64,
+    max_us: i64,
+    bytes_per_s: f64,
+    frames_per_s: f64,
+    superseded: u64,
+};
+
+pub const Recorder = struct {
+    baud: u32,
+    started_us: i64,
+
+    /// Spin lock: `due` arrives from the collator thread in Blu-ray mode,
+    /// `frameWritten` from the sender.
+    guard: std.atomic.Value(bool) = .init(false),
+    /// The due instant of each line's newest not-yet-sent content.
+    pending_us: [panel_emulator.lines]?i64 = @splat(null),
+    /// When the line would next be free, so back-to-back frames queue.
+    wire_free_us: i64 = 0,
+    last_left_us: i64 = 0,
+    bytes: u64 = 0,
+    frames: u64 = 0,
+    superseded: u64 = 0,
+    latencies_us: [max_samples]i64 = undefined,
+    n_latencies: usize = 0,
+
+    pub fn init(baud: u32, started_us: i64) Recorder {
+        return .{ .baud = baud, .started_us = started_us };
+    }
+
+    fn acquire(self: *Recorder) void {
+        while (self.guard.cmpxchgWeak(false, true, .acquire, .monotonic) != null) {
+            std.atomic.spinLoopHint();
+        }
+    }
+
+    fn release(self: *Recorder) void {
+        self.guard.store(false, .release);
+    }
+
+    pub fn due(self: *Recorder, line: u8, due_us: i64) void {
+        if (line == 0 or line > panel_emulator.lines) return;
+        self.acquire();
+        defer self.release();
+        if (self.pending_us[line - 1] != null) self.superseded += 1;
+        self.pending_us[line - 1] = due_us;
+    }
+
+    /// Account for `frame` having been handed to the port at `write_start_us`.
+    pub fn frameWritten(self: *Recorder, frame: []const u8, write_start_us: i64) void {
+        const touched = linesTouched(frame);
+        self.acquire();
+        defer self.release();
+        const left_us = @max(write_start_us, self.wire_free_us) + panel_emulator.wireMicros(frame.len, self.baud);
+        self.wire_free_us = left_us;
+        self.last_left_us = left_us;
+        self.bytes += frame.len;
+        self.frames += 1;
+        for (&self.pending_us, 0..) |*pending, i| {
+            if (!touched[i]) continue;
+            const due_us = pending.* orelse continue;
+            pending.* = null;
+            if (self.n_latencies < max_samples) {
+                self.latencies_us[self.n_latencies] = @max(left_us - due_us, 0);
+                self.n_latencies += 1;
+            }
+        }
+    }
+
+    /// Percentiles and rates as of `now_us`. Sorts the samples in place, so
+    /// call once, after the run.
+    pub fn summarize(self: *Recorder, now_us: i64) Summary {
+        self.acquire();
+        defer self.release();
+        const samples = self.latencies_us[0..self.n_latencies];
+        std.mem.sort(i64, samples, {}, std.sort.asc(i64));
+        const elapsed_s = @as(f64, @floatFromInt(@max(now_us - self.started_us, 1))) / std.time.us_per_s;
+        return .{
+            .samples = samples.len,
+            .p50_us = percentile(samples, 50),
+            .p99_us = percentile(samples, 99),
+            .max_us = if (samples.len > 0) samples[samples.len - 1] else 0,
+            .bytes_per_s = @as(f64, @floatFromInt(self.bytes)) / elapsed_s,
+            .frames_per_s = @as(f64, @floatFromInt(self.frames)) / elapsed_s,
+            .superseded = self.superseded,
+        };
+    }
+};
+
+/// Nearest-rank percentile of already-sorted `sorted`.
+fn percentile(sorted: []const i64, p: usize) i64 {
+    if (sorted.len == 0) return 0;
+    const rank = (sorted.len * p + 99) / 100;
+    return sorted[@max(rank, 1) - 1];
+}
+
+/// Which lines a framed display command writes to: any `ESC <line>;<col>C`,
+/// with the line defaulting to 1 as on the panel. A form feed clears the
+/// whole screen, so it counts as touching every line.
+pub fn linesTouched(frame: []const u8) [panel_emulator.lines]bool {
+    var touched: [panel_emulator.lines]bool = @splat(false);
+    const start = (std.mem.indexOf(u8, frame, protocol.display_cmd) orelse return touched) + protocol.display_cmd.len;
+    const end = std.mem.lastIndexOfScalar(u8, frame, protocol.CR[0]) orelse frame.len;
+    if (end <= start) return touched;
+    const payload = frame[start..end];
+
+    var i: usize = 0;
+    while (i < payload.len) : (i += 1) {
+        if (payload[i] == protocol.FF[0]) {
+            touched = @splat(true);
+            continue;
+        }
+        if (payload[i] != protocol.ESC[0]) continue;
+        var line: ?usize = null;
+        var j = i + 1;
+        while (j < payload.len and std.ascii.isDigit(payload[j])) : (j += 1) {
+            line = (line orelse 0) * 10 + (payload[j] - '0');
+        }
+        // Skip any further parameters up to the command letter.
+        while (j < payload.len and (std.ascii.isDigit(payload[j]) or payload[j] == ';')) : (j += 1) {}
+        if (j < payload.len and payload[j] == 'C') {
+            const l = line orelse 1;
+            if (l >= 1 and l <= panel_emulator.lines) touched[l - 1] = true;
+        }
+        i = j;
+    }
+    return touched;
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+test "linesTouched reads the line from each positioning escape" {
+    var builder: protocol.FrameBuilder = undefined;
+    const both = try protocol.unitDisplayCmd(&builder, 1, protocol.ESC ++ "C" ++ "abc" ++ protocol.ESC ++ "2;C" ++ "def");
+    try testing.expectEqual([2]bool{ true, true }, linesTouched(both));
+
+    const two = try protocol.unitDisplayCmd(&builder, 1, protocol.ESC ++ "2;7C" ++ "x");
+    try testing.expectEqual([2]bool{ false, true }, linesTouched(two));
+
+    // Attribute escapes are not positioning, even with a line-like number.
+    const attr = try protocol.unitDisplayCmd(&builder, 1, protocol.ESC ++ "25;-B");
+    try testing.expectEqual([2]bool{ false, false }, linesTouched(attr));
+}
+
+test "a recorder measures from due to the last byte leaving, wire time included" {
+    var builder: protocol.FrameBuilder = undefined;
+    const frame = try protocol.unitDisplayCmd(&builder, 1, protocol.ESC ++ "1;8C4");
+
+    var recorder = Recorder.init(19200, 0);
+    recorder.due(1, 1_000_000);
+    recorder.frameWritten(frame, 1_004_000);
+    const summary = recorder.summarize(2_000_000);
+    try testing.expectEqual(@as(usize, 1), summary.samples);
+    try testing.expectEqual(4_000 + panel_emulator.wireMicros(frame.len, 19200), summary.max_us);
+}
+
+test "a change superseded before it was sent is counted, not sampled" {
+    var builder: protocol.FrameBuilder = undefined;
+    const frame = try protocol.unitDisplayCmd(&builder, 1, protocol.ESC ++ "1;8C4");
+
+    var recorder = Recorder.init(0, 0);
+    recorder.due(1, 1_000_000);
+    recorder.due(1, 2_000_000);
+    recorder.frameWritten(frame, 2_010_000);
+    const summary = recorder.summarize(3_000_000);
+    try testing.expectEqual(@as(usize, 1), summary.samples);
+    try testing.expectEqual(@as(i64, 10_000), summary.p50_us);
+    try testing.expectEqual(@as(u64, 1), summary.superseded);
+}
+
+test "percentile is nearest-rank" {
+    const sorted = [_]i64{ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    try testing.expectEqual(@as(i64, 5), percentile(&sorted, 50));
+    try testing.expectEqual(@as(i64, 10), percentile(&sorted, 99));
+    try testing.expectEqual(@as(i64, 0), percentile(&.{}, 50));
+}
@@ -10,8 +10,18 @@ const bluray = @import("bluray.zig");
 const vlc = @import("vlc.zig");
 const process_mgmt = @import("process_mgmt.zig");
 const cues = @import("cues.zig");
+const file_watch = @import("file_watch.zig");
 const dbg = @import("debug_log.zig");
+const panel_emulator = @import("panel_emulator.zig");
 const vorne_config = @import("vorne_config.zig");
+const bus = @import("bus.zig");
+const realtime = @import("realtime.zig");
+const metrics = @import("metrics.zig");
+const flight_recorder = @import("flight_recorder.zig");
+const http_server = @import("http_server.zig");
+const panel_mirror = @import("panel_mirror.zig");
+const vorne_charset = @import("vorne_charset.zig");
+const str_utils = @import("str_utils.zig");
 // Named to avoid shadowing the `mode` atomic that the loops below pass around.
 const mode_mod = @import("mode.zig");
 const Mode = mode_mod.Mode;
@@ -46,6 +56,18 @@ pub fn main(init: std.process.Init) !void {
     // rest of the program read them with no synchronization.
     vorne_config.load(io, allocator);
 
+    // Before any thread exists, so every one started below is covered by
+    // the memory lock and can take its configured priority. The lateness
+    // summary runs last of all, after every thread has been joined.
+    realtime.configure(vorne_config.realtimeOptions());
+    defer realtime.logLateness();
+
+    // Debug output is printed from here on by the flight recorder's own
+    // thread, off the threads that log it; stopped last, so it has printed
+    // everything by the time the process exits.
+    try flight_recorder.start();
+    defer flight_recorder.stop();
+
     // Make the environment available for the DEBUG_VLC check
     vlc.setEnviron(init.minimal.environ);
 
@@ -57,6 +79,9 @@ pub fn main(init: std.process.Init) !void {
     // Parse command-line arguments for optional modes
     var bluray_flag = false;
     var vlc_flag = false;
+    var device_arg: ?[]const u8 = null;
+    var emulate_flag = false;
+    var emulator_options: panel_emulator.Options = .{};
     var args = init.minimal.args.iterate();
     _ = args.skip(); // argv[0]
     while (args.next()) |arg| {
@@ -64,26 +89,57 @@ pub fn main(init: std.process.Init) !void {
             bluray_flag = true;
         } else if (std.mem.eql(u8, arg, "--vlc")) {
             vlc_flag = true;
+        } else if (std.mem.eql(u8, arg, "--device")) {
+            device_arg = args.next() orelse {
+                std.log.err("--device needs a path\n", .{});
+                return error.InvalidArgument;
+            };
+        } else if (std.mem.eql(u8, arg, "--emulate")) {
+            emulate_flag = true;
+        } else if (std.mem.startsWith(u8, arg, "--emulate-")) {
+            emulate_flag = true;
+            try panel_emulator.parseArg(arg, &emulator_options);
         }
     }
 
-    const ttydev = "/dev/ttyUSB0";
-    std.log.info("Opening {s}...\n", .{ttydev});
-    const port = serial.SerialPort.open(io, ttydev, allocator) catch |err| return err;
-    defer port.close(allocator);
-    std.log.info("Serial port opened and configured successfully.\n", .{});
-
-    protocol.sendUnitFlushCmd(allocator, port, 1) catch |err| return err;
-    _ = protocol.sendUnitDisplayCmd(allocator, port, 1, protocol.ESC ++ "E") catch |err| return err;
-    try io.sleep(.fromSeconds(1), .awake);
-
-    var mode = std.atomic.Value(Mode).init(.Clocks);
+    // Which ports to drive: every entry of `ports` in `vorne_config.jsonc`,
+    // each starting in its own mode, or else the one port named by
+    // `--device` or `serial_device`, starting in the mode the flags chose.
+    var start_mode: Mode = .Clocks;
     if (bluray_flag) {
-        mode.store(.Bluray, .release);
+        start_mode = .Bluray;
     } else if (vlc_flag) {
-        mode.store(.Vlc, .release);
+        start_mode = .Vlc;
+    }
+    var displays: [vorne_config.max_ports]Display = undefined;
+    var n_displays: usize = 0;
+    const configured_ports = vorne_config.ports();
+    if (configured_ports.len > 0 and device_arg == null) {
+        for (configured_ports, 0..) |*p, i| displays[i] = .{ .device = p.device(), .mode = .init(p.mode) };
+        n_displays = configured_ports.len;
+    } else {
+        displays[0] = .{
+            .device = device_arg orelse vorne_config.serialDevice() orelse default_ttydev,
+            .mode = .init(start_mode),
+        };
+        n_displays = 1;
     }
 
+    // `--emulate` swaps each panel for a `panel_emulator` pty of its own, so
+    // every mode can be run and measured on a machine with no panel attached.
+    var n_opened: usize = 0;
+    defer for (displays[0..n_opened]) |*d| d.close(allocator);
+    for (displays[0..n_displays]) |*d| {
+        try d.open(io, allocator, if (emulate_flag) emulator_options else null);
+        n_opened += 1;
+    }
+
+    for (displays[0..n_displays]) |*d| {
+        protocol.sendUnitFlushCmd(d.port, 1) catch |err| return err;
+        _ = protocol.sendUnitDisplayCmd(d.port, 1, protocol.ESC ++ "E") catch |err| return err;
+    }
+    try io.sleep(.fromSeconds(1), .awake);
+
     // Shared mode state
 
     // Resolve which directory holds cue files, and any hand-tuned display lead
@@ -93,34 +149,149 @@ pub fn main(init: std.process.Init) !void {
     cues.configureDirPath(io);
     bluray.configureDisplayLead(io);
 
+    // Everything re-read while running is watched from here on, so the
+    // threads that read it wait to be told rather than polling -- see
+    // `file_watch.zig`.
+    file_watch.start(.{
+        .cues = .{ .dir = cues.dirPath(), .suffix = ".vtt" },
+        .countdown = file_watch.Target.file(config.countdownCfgPath()),
+        .zone = file_watch.Target.file(time.zone_path),
+    });
+    defer file_watch.stop();
+
     // Which cue file line 2 shows in Blu-ray mode, and whether it is armed.
     // Written by the HTTP thread, read by the Blu-ray display loop.
     var cue_state: cues.State = .{};
 
-    // One-shot "force a PLL resync now" signal from the web page, consumed by
-    // `pollLoop`. `swap`-based, so a request cannot be lost or double-fired.
-    var resync_requested = std.atomic.Value(bool).init(false);
+    // The player poller and cue loader, shared by every display in Blu-ray
+    // mode however many ports there are -- see `bluray.Sources`.
+    var sources: bluray.Sources = .init(io, &cue_state);
+    try sources.start(io, allocator);
+    defer sources.deinit();
+
+    // Bumped by each render sender when its panel confirms a frame, for the
+    // web page's live mirror -- see `panel_mirror.zig`. Before any sender
+    // starts, and closed once all of them and the server have stopped.
+    const mirror_fd = try panel_mirror.open();
+    defer panel_mirror.close();
+
+    // Several panels configured: each runs its own mode for good, and the bus
+    // scheduler owns the port instead of a display thread. Built before the
+    // web server starts, since it lists the units.
+    var panel_bus: ?bus.Bus = null;
+    if (vorne_config.panels().len > 0) {
+        if (n_displays == 1) {
+            panel_bus = bus.Bus.init(displays[0].port, vorne_config.panelGroup());
+            for (vorne_config.panels()) |p| _ = try panel_bus.?.addUnit(p.address);
+        } else {
+            std.log.warn("\"panels\" needs a single port, but {d} are configured; ignoring it\n", .{n_displays});
+        }
+    }
+    const units: []const bus.Unit = if (panel_bus) |*b| b.units[0..b.n_units] else &.{};
+
+    // The web page and its API, on a thread of their own. Joined before
+    // anything it reads goes away; the shutdown request is what stops it,
+    // so it is made here too, for a return that is not already shutting down.
+    const server_thread = try std.Thread.spawn(.{}, startHttpServer, .{ io, allocator, displays[0..n_displays], units, &cue_state, &sources, mirror_fd });
+    defer {
+        process_mgmt.requestShutdown();
+        server_thread.join();
+    }
+
+    if (panel_bus) |*b| return runPanels(io, allocator, b, &sources);
+
+    // One display thread per port, each owning its port outright.
+    var threads: [vorne_config.max_ports]std.Thread = undefined;
+    var n_threads: usize = 0;
+    defer for (threads[0..n_threads]) |t| t.join();
+    // A thread that failed to spawn leaves the others running; stop them, or
+    // the join above waits forever.
+    errdefer process_mgmt.requestShutdown();
+    for (displays[0..n_displays]) |*d| {
+        threads[n_threads] = try std.Thread.spawn(.{}, runDisplay, .{ io, allocator, d, &sources });
+        n_threads += 1;
+    }
+
+    while (!process_mgmt.shouldShutdown()) {
+        try io.sleep(.fromMilliseconds(100), .awake);
+    }
+    std.log.info("Main loop received shutdown signal, exiting gracefully...\n", .{});
+    for (threads[0..n_threads]) |t| t.join();
+    n_threads = 0;
+    for (displays[0..n_displays]) |*d| {
+        if (d.failure) |err| return err;
+    }
+}
+
+/// One serial port and the panel on it, driven by its own `runDisplay`
+/// thread in its own mode.
+const Display = struct {
+    device: []const u8,
+    /// Switched from the web page, read by this display's mode loop.
+    mode: std.atomic.Value(Mode),
+    port: *serial.SerialPort = undefined,
+    emulator: panel_emulator.Emulator = undefined,
+    emulated: bool = false,
+    /// Why `runDisplay` stopped, if it was not asked to.
+    failure: ?anyerror = null,
+
+    /// Open the port, or with `emulate`, an emulated panel in its place.
+    /// `self` must not move afterwards: an emulated `device` points into it.
+    fn open(self: *Display, io: Io, allocator: std.mem.Allocator, emulate: ?panel_emulator.Options) !void {
+        errdefer if (self.emulated) {
+            self.emulator.close();
+            self.emulated = false;
+        };
+        if (emulate) |options| {
+            self.emulator = try panel_emulator.Emulator.open(io, options);
+            self.emulated = true;
+            try self.emulator.start();
+            self.device = self.emulator.slavePath();
+        }
+        std.log.info("Opening {s}...\n", .{self.device});
+        self.port = try serial.SerialPort.open(io, self.device, allocator);
+        self.port.transport.options = vorne_config.transportOptions();
+        std.log.info("Serial port {s} opened and configured successfully.\n", .{self.device});
+    }
+
+    fn close(self: *Display, allocator: std.mem.Allocator) void {
+        self.port.close(allocator);
+        if (self.emulated) self.emulator.close();
+    }
+};
 
-    // Start HTTP server in a separate thread
-    const server_thread = try std.Thread.spawn(.{}, startHttpServer, .{ io, allocator, &mode, &cue_state, &resync_requested });
-    server_thread.detach();
+/// One port's mode dispatch loop: the only thread that writes to its port.
+///
+/// A mode loop that fails takes the whole process down, as it did when this
+/// loop ran on the main thread, so that the service manager restarts it.
+fn runDisplay(io: Io, allocator: std.mem.Allocator, display: *Display, sources: *bluray.Sources) void {
+    realtime.enterThread(display.device);
+    dispatch(io, allocator, display, sources) catch |err| {
+        std.log.err("Display on {s} failed: {}\n", .{ display.device, err });
+        display.failure = err;
+        process_mgmt.requestShutdown();
+    };
+}
 
-    // Main display loop
+fn dispatch(io: Io, allocator: std.mem.Allocator, display: *Display, sources: *bluray.Sources) !void {
+    const port = display.port;
+    const mode = &display.mode;
     while (true) {
         // Check for shutdown signal
         if (process_mgmt.shouldShutdown()) {
-            std.log.info("Main loop received shutdown signal, exiting gracefully...\n", .{});
+            std.log.info("Display on {s} received shutdown signal, exiting gracefully...\n", .{display.device});
             return;
         }
 
         const current_mode = mode.load(.acquire);
 
         // Clear any pending re-init request here, where it is about to be
-        // serviced by the init below. Consuming it with `swap` means one click
-        // cannot be serviced twice, and -- since the flag is what made the
-        // mode loop return -- leaving it set would spin this loop.
+        // serviced by the init below. Consuming it means one click cannot be
+        // serviced twice by this display, and -- since the request is what
+        // made the mode loop return -- leaving it pending would spin this
+        // loop. Every other display services the same click on its own.
         if (mode_mod.takeReinitRequest()) {
-            std.log.info("Re-initializing display\n", .{});
+            std.log.info("Re-initializing display on {s}\n", .{display.device});
         }
 
         // Put the panel into a known state on every mode entry: geometry,
@@ -137,93 +308,301 @@ pub fn main(init: std.process.Init) !void {
         //
         // Logged, not propagated: failing to init is not a reason to take the
         // service down, and the next mode change gets another attempt.
-        protocol.sendUnitDefaultInitCmd(allocator, port, 1) catch |err| {
+        protocol.sendUnitDefaultInitCmd(port, 1) catch |err| {
             std.log.err("Failed to initialize display on mode entry: {}\n", .{err});
         };
 
         // No explicit wait here for the mode's first frame to be safe to send:
-        // `sendUnitDefaultInitCmd` above already went through `protocol.send`,
-        // which blocks for the panel's reply (or `protocol.timeout_ms`) before
-        // returning -- see its doc. By the time this line is reached the init
-        // has therefore actually landed (or the wait has already been paid),
-        // so the mode loop's first send below, which is a full redraw, is safe
-        // to fire immediately rather than needing a guessed settle delay of
-        // its own.
+        // `sendUnitDefaultInitCmd` above already went through
+        // `protocol.sendSlow`, which blocks for the panel's reply (or
+        // `protocol.timeout_ms`) before returning -- see `send`'s doc. By the
+        // time this line is reached the init has therefore actually landed (or
+        // the wait has already been paid), so the mode loop's first send
+        // below, which is a full redraw, is safe to fire immediately rather
+        // than needing a guessed settle delay of its own.
 
         if (current_mode == .Clocks) {
-            try clocks.runClocks(io, allocator, port, &mode);
+            try clocks.runClocks(io, allocator, port, mode, null);
         } else if (current_mode == .Bluray) {
-            try bluray.runBlurayClocks(io, allocator, port, &mode, &cue_state, &resync_requested);
+            try bluray.runBlurayClocks(io, allocator, port, mode, sources, null);
         } else if (current_mode == .Vlc) {
-            try vlc.runVlcClocks(io, allocator, port, &mode);
+            try vlc.runVlcClocks(io, allocator, port, mode, null);
         }
     }
 }
 
-fn startHttpServer(
+/// `vorne_config.jsonc`'s `panels`: one render loop per panel, each fixed to
+/// its configured mode and publishing to its `bus.Unit`, and one scheduler
+/// thread putting all of them on the wire -- see `bus.zig`.
+///
+/// The web page's mode buttons have nothing to switch here; its re-init
+/// button still works, serviced by the scheduler, which owns the port.
+fn runPanels(
     io: Io,
     allocator: std.mem.Allocator,
-    mode: *std.atomic.Value(Mode),
-    cue_state: *cues.State,
-    resync_requested: *std.atomic.Value(bool),
+    panel_bus: *bus.Bus,
+    sources: *bluray.Sources,
 ) !void {
-    const address: Io.net.IpAddress = Io.net.IpAddress.parse("0.0.0.0", 8080) catch unreachable;
-    var listener = try address.listen(io, .{ .reuse_address = true });
-    defer listener.deinit(io);
+    // `panel_bus` has a unit for each of these, in the same order.
+    const configured = vorne_config.panels();
+    var modes: [bus.max_units]std.atomic.Value(Mode) = undefined;
+    for (configured, 0..) |p, i| modes[i] = .init(p.mode);
+    panel_bus.initUnits();
 
-    std.log.info("HTTP server listening on port 8080\n", .{});
+    var stop_bus = std.atomic.Value(bool).init(false);
+    const scheduler = try std.Thread.spawn(.{}, bus.Bus.run, .{ panel_bus, io, &stop_bus });
+    defer {
+        stop_bus.store(true, .release);
+        scheduler.join();
+    }
 
-    while (true) {
-        const stream = try listener.accept(io);
-        const thread = try std.Thread.spawn(.{}, handleConnection, .{ io, allocator, stream, mode, cue_state, resync_requested });
-        thread.detach();
+    var producers: [bus.max_units]std.Thread = undefined;
+    var n_producers: usize = 0;
+    defer for (producers[0..n_producers]) |t| t.join();
+    for (configured, 0..) |_, i| {
+        producers[i] = try std.Thread.spawn(.{}, runPanel, .{ io, allocator, panel_bus.port, &modes[i], sources, &panel_bus.units[i] });
+        n_producers += 1;
     }
+
+    while (!process_mgmt.shouldShutdown()) {
+        try io.sleep(.fromMilliseconds(100), .awake);
+    }
+    std.log.info("Panels received shutdown signal, exiting gracefully...\n", .{});
 }
 
-fn handleConnection(
+/// One panel's render loop, re-entered whenever it returns -- after a re-init,
+/// or an error, which is logged rather than taking the other panels down.
+fn runPanel(
     io: Io,
     allocator: std.mem.Allocator,
-    stream: Io.net.Stream,
+    port: *serial.SerialPort,
     mode: *std.atomic.Value(Mode),
+    sources: *bluray.Sources,
+    unit: *bus.Unit,
+) void {
+    realtime.enterThread("panel");
+    while (!process_mgmt.shouldShutdown()) {
+        const result: anyerror!void = switch (mode.load(.acquire)) {
+            .Clocks => clocks.runClocks(io, allocator, port, mode, unit),
+            .Bluray => bluray.runBlurayClocks(io, allocator, port, mode, sources, unit),
+            .Vlc => vlc.runVlcClocks(io, allocator, port, mode, unit),
+        };
+        result catch |err| {
+            std.log.err("Panel {d}: {s} mode failed: {}\n", .{ unit.address, @tagName(mode.load(.acquire)), err });
+            io.sleep(.fromSeconds(1), .awake) catch return;
+        };
+        // Returned for a re-init. The scheduler sends the inits and forgets
+        // what every unit shows; all this thread has to do is mark the
+        // request seen, so the mode loop it re-enters does not return again.
+        _ = mode_mod.takeReinitRequest();
+    }
+}
+
+/// The panel's USB-serial adapter, absent `--device` or `serial_device` in
+/// `vorne_config.jsonc`.
+const default_ttydev = "/dev/ttyUSB0";
+
+/// The port the web page and its API are served on.
+const http_port: u16 = 8080;
+
+/// Serve the web page and `/api/status` until shutdown -- see
+/// `http_server.zig`.
+fn startHttpServer(
+    io: Io,
+    allocator: std.mem.Allocator,
+    displays: []Display,
+    units: []const bus.Unit,
     cue_state: *cues.State,
-    resync_requested: *std.atomic.Value(bool),
+    sources: *bluray.Sources,
+    mirror_fd: std.os.linux.fd_t,
 ) !void {
-    defer stream.close(io);
-
-    var read_buffer: [1024]u8 = undefined;
-    var stream_reader = stream.reader(io, &read_buffer);
-    var write_buffer: [1024]u8 = undefined;
-    var stream_writer = stream.writer(io, &write_buffer);
-    const out = &stream_writer.interface;
-    defer out.flush() catch {};
-
-    // Wait for the first chunk of the request and take whatever arrived. Do not
-    // use `readSliceShort` here: it blocks until the buffer is full, which never
-    // happens for a request smaller than `read_buffer`.
-    const request = stream_reader.interface.peekGreedy(1) catch |err| switch (err) {
-        error.EndOfStream => return,
-        else => return err,
+    var server = try http_server.Server.open(allocator, http_port);
+    defer server.close();
+    server.wake_fd = mirror_fd;
+
+    std.log.info("HTTP server listening on port {d}\n", .{http_port});
+
+    var control: Control = .{
+        .io = io,
+        .allocator = allocator,
+        .displays = displays,
+        .units = units,
+        .cue_state = cue_state,
+        .sources = sources,
     };
+    server.run(io, &control);
+}
 
-    // Simple HTTP request parsing
-    var lines = std.mem.splitSequence(u8, request, "\r\n");
-    const request_line = lines.next() orelse return;
-    var parts = std.mem.splitSequence(u8, request_line, " ");
-    const method = parts.next() orelse return;
-    const path = parts.next() orelse return;
+/// What each request to the web server does. Called on the server's one
+/// thread, so a slow request holds up every other: everything here is an
+/// atomic load, a `cell.Cell` read or a flag for another thread to act on,
+/// bar the page's listing of the cue directory.
+const Control = struct {
+    io: Io,
+    allocator: std.mem.Allocator,
+    displays: []Display,
+    /// The units on the bus in `panels` mode, and none otherwise.
+    units: []const bus.Unit,
+    cue_state: *cues.State,
+    sources: *bluray.Sources,
+    /// Each port's `shown` publication last broadcast -- see `wake`.
+    seen: [vorne_config.max_ports]u64 = @splat(0),
+    /// The same for each unit's `showing`.
+    unit_seen: [bus.max_units]u64 = @splat(0),
 
-    if (std.mem.eql(u8, method, "GET") and std.mem.eql(u8, path, "/")) {
-        const current_mode = mode.load(.acquire);
-        const mode_str = switch (current_mode) {
-            .Clocks => "Clocks",
-            .Bluray => "Blu-Ray",
-            .Vlc => "VLC",
-        };
-        var body: Io.Writer.Allocating = .init(allocator);
-        defer body.deinit();
-        const w = &body.writer;
+    pub fn handle(self: *Control, req: *const http_server.Request, res: *http_server.Response) !void {
+        const w = res.body;
+        if (req.is("GET", "/")) {
+            res.content_type = "text/html; charset=utf-8";
+            try self.writePage(w);
+        } else if (req.is("GET", "/api/status")) {
+            // For pollers: everything the page shows, and what is on the
+            // panels, in one small document.
+            res.content_type = "application/json";
+            try self.writeStatus(w);
+        } else if (req.is("GET", "/api/panel/events")) {
+            // A live mirror of the panels: a `panel` event for each now, and
+            // another each time one confirms a new frame -- see `wake`.
+            res.startEventStream();
+            for (self.displays, 0..) |*d, i| {
+                if (d.port.shown.read()) |lines| try self.writePanelEvent(w, "display", i, &lines);
+            }
+            for (self.units) |*u| {
+                if (u.showing.read()) |lines| try self.writePanelEvent(w, "unit", u.address, &lines);
+            }
+        } else if (req.is("GET", "/metrics")) {
+            // For a Prometheus scraper -- see `metrics.zig`.
+            res.content_type = "text/plain; version=0.0.4; charset=utf-8";
+            try metrics.write(w);
+        } else if (req.is("GET", "/trace")) {
+            // Every thread's recent debug records, every category -- see
+            // `flight_recorder.zig`. The same as `SIGUSR1`, but to the browser.
+            try flight_recorder.dump(w);
+        } else if (req.is("POST", "/control")) {
+            var action: []const u8 = "";
+
+            // Simple form parsing
+            var iter = std.mem.splitSequence(u8, req.body, "&");
+            while (iter.next()) |pair| {
+                if (std.mem.startsWith(u8, pair, "action=")) {
+                    action = pair[7..];
+                }
+            }
+
+            // There was an `action=display` branch here that wrote `text`
+            // straight to the panel. Removed: no form on the page ever posted
+            // it (there is no `text` input), and it was the last place outside
+            // the display thread that touched the serial port -- letting any
+            // POST splice arbitrary bytes, escape sequences included, into
+            // whatever frame the render loop was mid-way through emitting.
+            if (std.mem.eql(u8, action, "init")) {
+                // Deliberately does not touch the port: only the display
+                // thread may write to it (see `mode.requestReinit`). This
+                // hands the job to the running mode loop, which stops so the
+                // dispatch loop can init and repaint on the display thread.
+                mode_mod.requestReinit();
+                std.log.info("Display re-init requested from the web page\n", .{});
+            }
+
+            // Redirect back to main page
+            res.redirect("/");
+        } else if (req.is("POST", "/mode")) {
+            var new_mode: []const u8 = "";
+            // Which port's display to switch. Absent (an old bookmark, a
+            // script) means the first, which with one port is the only one.
+            var port_index: usize = 0;
+
+            // Simple form parsing
+            var iter = std.mem.splitSequence(u8, req.body, "&");
+            while (iter.next()) |pair| {
+                if (std.mem.startsWith(u8, pair, "mode=")) {
+                    new_mode = pair[5..];
+                } else if (std.mem.startsWith(u8, pair, "port=")) {
+                    port_index = std.fmt.parseInt(usize, pair[5..], 10) catch self.displays.len;
+                }
+            }
+            if (port_index >= self.displays.len) {
+                res.status = .bad_request;
+                return;
+            }
+            const mode = &self.displays[port_index].mode;
+
+            // Deliberately does NOT touch the serial port. Re-initialising the
+            // panel used to happen here, on the HTTP thread -- but the outgoing
+            // mode's render loop is still running and still writing to the same
+            // fd at this moment, and nothing serializes the two. The interleaved
+            // bytes corrupt whichever frame they land in, and
+            // `unitDefaultInitCmd` carries a window-geometry command
+            // (`ESC 0;0;119;15w`): a mangled one leaves later writes addressing
+            // somewhere off-screen, so the panel goes blank and *stays* blank,
+            // since a redraw repaints content but never re-sends the geometry.
+            // The mode dispatch loop in `main` now does the init instead, on the
+            // display thread, after the switch has taken effect.
+            if (std.mem.eql(u8, new_mode, "clocks")) {
+                mode.store(.Clocks, .release);
+            } else if (std.mem.eql(u8, new_mode, "bluray")) {
+                mode.store(.Bluray, .release);
+            } else if (std.mem.eql(u8, new_mode, "vlc")) {
+                mode.store(.Vlc, .release);
+            }
+
+            // Redirect back to main page
+            res.redirect("/");
+        } else if (req.is("POST", "/cues")) {
+            var iter = std.mem.splitSequence(u8, req.body, "&");
+            while (iter.next()) |pair| {
+                const eq = std.mem.indexOfScalar(u8, pair, '=') orelse continue;
+                const key = pair[0..eq];
+                // File names routinely contain spaces and parentheses, so the
+                // value has to be properly form-decoded rather than just
+                // un-plussed.
+                const value = formDecode(self.allocator, pair[eq + 1 ..]) catch continue;
+                defer self.allocator.free(value);
+
+                if (std.mem.eql(u8, key, "file")) {
+                    if (value.len == 0) {
+                        self.cue_state.clear();
+                    } else if (!self.cue_state.select(value)) {
+                        std.log.warn("Rejected cue file selection: {s}\n", .{value});
+                    }
+                } else if (std.mem.eql(u8, key, "arm")) {
+                    self.cue_state.setArmed(std.mem.eql(u8, value, "on"));
+                }
+            }
+
+            // Redirect back to main page
+            res.redirect("/");
+        } else if (req.is("POST", "/display-lead")) {
+            var iter = std.mem.splitSequence(u8, req.body, "&");
+            while (iter.next()) |pair| {
+                if (!std.mem.startsWith(u8, pair, "lead=")) continue;
+                const raw_value = formDecode(self.allocator, pair[5..]) catch continue;
+                defer self.allocator.free(raw_value);
+
+                if (bluray.parseDisplayLeadConfig(raw_value)) |value| {
+                    // Applies to the running process immediately and persists
+                    // to bluray_display_lead_ms.txt so it survives a restart
+                    // too.
+                    bluray.setDisplayLead(self.io, value);
+                } else {
+                    std.log.warn("Rejected display lead value: {s}\n", .{raw_value});
+                }
+            }
+
+            // Redirect back to main page
+            res.redirect("/");
+        } else if (req.is("POST", "/resync")) {
+            // No body to parse: this is a single one-shot signal -- see
+            // `bluray.Sources.requestResync`.
+            self.sources.requestResync();
+            res.redirect("/");
+        } else {
+            res.status = .not_found;
+        }
+    }
 
-        w.print(
+    fn writePage(self: *Control, w: *Io.Writer) !void {
+        try w.writeAll(
             \\<!DOCTYPE html>
             \\<html>
             \\<head>
@@ -231,22 +610,57 @@ fn handleConnection(
             \\</head>
             \\<body>
             \\<h1>Serial Display Control</h1>
-            \\<p>Current Mode: {s}</p>
-            \\<form action="/mode" method="post">
-            \\<button type="submit" name="mode" value="clocks">Switch to Clocks</button>
-            \\<button type="submit" name="mode" value="bluray">Switch to Blu-Ray</button>
-            \\<button type="submit" name="mode" value="vlc">Switch to VLC</button>
-            \\</form>
+            \\
+        );
+
+        // One mode switch per port, each naming its port so the form says
+        // which display it switches. With one port the page looks as it
+        // always has.
+        for (self.displays, 0..) |*d, i| {
+            if (self.displays.len > 1) {
+                try w.writeAll("<h2>");
+                try writeHtmlEscaped(w, d.device);
+                try w.writeAll("</h2>\n");
+            }
+            const mode_str = switch (d.mode.load(.acquire)) {
+                .Clocks => "Clocks",
+                .Bluray => "Blu-Ray",
+                .Vlc => "VLC",
+            };
+            // Filled in, and kept up to date, by the script at the bottom.
+            try w.print(
+                \\<pre id="panel-{d}" style="display:inline-block;min-width:20ch;padding:0.3em;background:#000;color:#fa0"></pre>
+                \\<p>Current Mode: {s}</p>
+                \\<form action="/mode" method="post">
+                \\<input type="hidden" name="port" value="{d}">
+                \\<button type="submit" name="mode" value="clocks">Switch to Clocks</button>
+                \\<button type="submit" name="mode" value="bluray">Switch to Blu-Ray</button>
+                \\<button type="submit" name="mode" value="vlc">Switch to VLC</button>
+                \\</form>
+                \\
+            , .{ i, mode_str, i });
+        }
+
+        // In `panels` mode, each unit on the bus, in the mode it keeps.
+        for (self.units, vorne_config.panels()[0..self.units.len]) |*u, p| {
+            try w.print(
+                \\<h2>Unit {d}: {s}</h2>
+                \\<pre id="unit-{d}" style="display:inline-block;min-width:20ch;padding:0.3em;background:#000;color:#fa0"></pre>
+                \\
+            , .{ u.address, modeName(p.mode), u.address });
+        }
+
+        try w.writeAll(
             \\<form action="/control" method="post">
             \\<button type="submit" name="action" value="init">Init</button>
             \\</form>
             \\
-        , .{mode_str}) catch return;
+        );
 
-        writeCuesSection(io, allocator, w, cue_state) catch return;
-        writeDisplayLeadSection(w) catch return;
+        try writeCuesSection(self.io, self.allocator, w, self.cue_state);
+        try writeDisplayLeadSection(w);
 
-        w.writeAll(
+        try w.writeAll(
             \\<h2>Blu-Ray Sync</h2>
             \\<p>Re-hunts the phase lock immediately instead of waiting for its
             \\own periodic re-sync. The clock keeps running while it re-locks.</p>
@@ -254,177 +668,150 @@ fn handleConnection(
             \\<button type="submit">Force PLL Resync</button>
             \\</form>
             \\
-        ) catch return;
+        );
 
-        w.writeAll(
+        // Each panel as it is now, from what it last confirmed.
+        try w.writeAll(
+            \\<script>
+            \\new EventSource("/api/panel/events").addEventListener("panel", (e) => {
+            \\  const panel = JSON.parse(e.data);
+            \\  const id = panel.unit !== undefined ? "unit-" + panel.unit : "panel-" + panel.display;
+            \\  const pre = document.getElementById(id);
+            \\  if (pre) pre.textContent = panel.lines.join("\n");
+            \\});
+            \\</script>
             \\</body>
             \\</html>
-        ) catch return;
-
-        const html_body = body.written();
-        const headers = std.fmt.allocPrint(allocator, "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: {d}\r\n\r\n", .{html_body.len}) catch return;
-        defer allocator.free(headers);
-        try out.writeAll(headers);
-        try out.writeAll(html_body);
-    } else if (std.mem.eql(u8, method, "POST") and std.mem.eql(u8, path, "/control")) {
-        // Find the body
-        var body_start: usize = 0;
-        while (lines.next()) |line| {
-            if (std.mem.eql(u8, line, "")) {
-                body_start = @intFromPtr(line.ptr) - @intFromPtr(request.ptr) + line.len + 2;
-                break;
-            }
+        );
+    }
+
+    /// A port's panel or a bus unit has confirmed a frame, or an event
+    /// stream has opened: send every panel that changed since the last time
+    /// to every stream. Only the latest frame of each is sent, however many
+    /// were confirmed in between, as a mirror has no use for the rest.
+    pub fn wake(self: *Control, server: *http_server.Server) void {
+        for (self.displays, 0..) |*d, i| {
+            const taken = d.port.shown.take(&self.seen[i]) orelse continue;
+            self.broadcastPanel(server, "display", i, taken);
         }
-        const body = request[body_start..];
+        for (self.units, 0..) |*u, i| {
+            const taken = u.showing.take(&self.unit_seen[i]) orelse continue;
+            self.broadcastPanel(server, "unit", u.address, taken);
+        }
+    }
 
-        var action: []const u8 = "";
+    fn broadcastPanel(self: *Control, server: *http_server.Server, comptime key: []const u8, id: usize, taken: ?[2][str_utils.maxbufsz]u8) void {
+        const lines = taken orelse return;
+        var buf: [http_server.max_message_len]u8 = undefined;
+        var message: Io.Writer = .fixed(&buf);
+        self.writePanelEvent(&message, key, id, &lines) catch return;
+        server.broadcast(message.buffered()) catch return;
+    }
 
-        // Simple form parsing
-        var iter = std.mem.splitSequence(u8, body, "&");
-        while (iter.next()) |pair| {
-            if (std.mem.startsWith(u8, pair, "action=")) {
-                action = pair[7..];
-            }
-        }
+    /// How many event streams are open: with none, the senders need not
+    /// wake the server at all.
+    pub fn watching(_: *Control, count: u32) void {
+        panel_mirror.setWatchers(count);
+    }
 
-        // There was an `action=display` branch here that wrote `text`
-        // straight to the panel. Removed: no form on the page ever posted it
-        // (there is no `text` input), and it was the last place outside the
-        // display thread that touched the serial port -- letting any POST
-        // splice arbitrary bytes, escape sequences included, into whatever
-        // frame the render loop was mid-way through emitting.
-        if (std.mem.eql(u8, action, "init")) {
-            // Deliberately does not touch the port: only the display thread
-            // may write to it (see `mode.requestReinit`). This hands the job
-            // to the running mode loop, which stops so the dispatch loop can
-            // init and repaint on the display thread.
-            mode_mod.requestReinit();
-            std.log.info("Display re-init requested from the web page\n", .{});
-        }
+    /// One `panel` event: which panel -- a `display` by its index, as
+    /// `/mode`'s `port` takes it, or a bus `unit` by its address -- and both
+    /// its lines.
+    fn writePanelEvent(self: *Control, w: *Io.Writer, comptime key: []const u8, id: usize, lines: *const [2][str_utils.maxbufsz]u8) !void {
+        try w.print("event: panel\ndata: {{\"" ++ key ++ "\":{d},\"lines\":", .{id});
+        try self.writePanelLines(w, lines);
+        try w.writeAll("}\n\n");
+    }
 
-        // Redirect back to main page
-        const response = "HTTP/1.1 302 Found\r\nLocation: /\r\n\r\n";
-        try out.writeAll(response);
-    } else if (std.mem.eql(u8, method, "POST") and std.mem.eql(u8, path, "/mode")) {
-        // Find the body
-        var body_start: usize = 0;
-        while (lines.next()) |line| {
-            if (std.mem.eql(u8, line, "")) {
-                body_start = @intFromPtr(line.ptr) - @intFromPtr(request.ptr) + line.len + 2;
-                break;
-            }
+    /// Both lines as a JSON array, or null for a panel with none yet.
+    fn writePanelLines(self: *Control, w: *Io.Writer, maybe_lines: ?*const [2][str_utils.maxbufsz]u8) !void {
+        const lines = maybe_lines orelse return w.writeAll("null");
+        try w.writeByte('[');
+        for (lines, 0..) |*line, n| {
+            if (n > 0) try w.writeByte(',');
+            try self.writePanelText(w, std.mem.sliceTo(line, 0));
         }
-        const body = request[body_start..];
+        try w.writeByte(']');
+    }
 
-        var new_mode: []const u8 = "";
+    /// `/api/status`: per display, its mode and what its panel last
+    /// confirmed, and the same per unit in `panels` mode; the Blu-ray player
+    /// as the poller last saw it, and the phase lock on it; and the cue
+    /// selection and the cue at the play position. Panel text is converted
+    /// from the panel's character set to UTF-8.
+    fn writeStatus(self: *Control, w: *Io.Writer) !void {
+        const now_ms = time.nowMillis(self.io);
 
-        // Simple form parsing
-        var iter = std.mem.splitSequence(u8, body, "&");
-        while (iter.next()) |pair| {
-            if (std.mem.startsWith(u8, pair, "mode=")) {
-                new_mode = pair[5..];
-            }
+        try w.writeAll("{\"displays\":[");
+        for (self.displays, 0..) |*d, i| {
+            if (i > 0) try w.writeByte(',');
+            try w.writeAll("{\"device\":");
+            try writeJsonString(w, d.device);
+            try w.print(",\"mode\":\"{s}\",\"panel\":", .{modeName(d.mode.load(.acquire))});
+            // Null until the panel has confirmed both lines, and always in
+            // `panels` mode, where the bus scheduler draws instead: see
+            // `units`.
+            const shown = d.port.shown.read();
+            try self.writePanelLines(w, if (shown) |*lines| lines else null);
+            try w.writeByte('}');
         }
 
-        // Deliberately does NOT touch the serial port. Re-initialising the
-        // panel used to happen here, on the HTTP thread -- but the outgoing
-        // mode's render loop is still running and still writing to the same
-        // fd at this moment, and nothing serializes the two. The interleaved
-        // bytes corrupt whichever frame they land in, and
-        // `unitDefaultInitCmd` carries a window-geometry command
-        // (`ESC 0;0;119;15w`): a mangled one leaves later writes addressing
-        // somewhere off-screen, so the panel goes blank and *stays* blank,
-        // since a redraw repaints content but never re-sends the geometry.
-        // The mode dispatch loop in `main` now does the init instead, on the
-        // display thread, after the switch has taken effect.
-        if (std.mem.eql(u8, new_mode, "clocks")) {
-            mode.store(.Clocks, .release);
-        } else if (std.mem.eql(u8, new_mode, "bluray")) {
-            mode.store(.Bluray, .release);
-        } else if (std.mem.eql(u8, new_mode, "vlc")) {
-            mode.store(.Vlc, .release);
+        // Each keeps the mode it was configured with for good.
+        try w.writeAll("],\"units\":[");
+        for (self.units, vorne_config.panels()[0..self.units.len], 0..) |*u, p, i| {
+            if (i > 0) try w.writeByte(',');
+            try w.print("{{\"address\":{d},\"mode\":\"{s}\",\"panel\":", .{ u.address, modeName(p.mode) });
+            const shown = u.showing.read();
+            try self.writePanelLines(w, if (shown) |*lines| lines else null);
+            try w.writeByte('}');
         }
+        try w.writeByte(']');
 
-        // Redirect back to main page
-        const response = "HTTP/1.1 302 Found\r\nLocation: /\r\n\r\n";
-        try out.writeAll(response);
-    } else if (std.mem.eql(u8, method, "POST") and std.mem.eql(u8, path, "/cues")) {
-        // Find the body
-        var body_start: usize = 0;
-        while (lines.next()) |line| {
-            if (std.mem.eql(u8, line, "")) {
-                body_start = @intFromPtr(line.ptr) - @intFromPtr(request.ptr) + line.len + 2;
-                break;
-            }
-        }
-        const body = request[body_start..];
-
-        var iter = std.mem.splitSequence(u8, body, "&");
-        while (iter.next()) |pair| {
-            const eq = std.mem.indexOfScalar(u8, pair, '=') orelse continue;
-            const key = pair[0..eq];
-            // File names routinely contain spaces and parentheses, so the value
-            // has to be properly form-decoded rather than just un-plussed.
-            const value = formDecode(allocator, pair[eq + 1 ..]) catch continue;
-            defer allocator.free(value);
-
-            if (std.mem.eql(u8, key, "file")) {
-                if (value.len == 0) {
-                    cue_state.clear();
-                } else if (!cue_state.select(value)) {
-                    std.log.warn("Rejected cue file selection: {s}\n", .{value});
-                }
-            } else if (std.mem.eql(u8, key, "arm")) {
-                cue_state.setArmed(std.mem.eql(u8, value, "on"));
-            }
-        }
+        // Only polled while a display is in Blu-ray mode; `sampled_ms` says
+        // how old it is.
+        const snap = self.sources.snapshot.read();
+        const run_status = switch (snap.run_status) {
+            .Stopped => "stopped",
+            .Playing => "playing",
+            .Paused => "paused",
+        };
+        try w.print(
+            ",\"bluray\":{{\"status\":\"{s}\",\"position_ms\":{d},\"anchored\":{},\"locked\":{},\"sampled_ms\":{d},\"display_lead_ms\":{d}}}",
+            .{
+                run_status,
+                snap.playTimeMillis(now_ms),
+                snap.has_anchor,
+                snap.locked,
+                snap.sampled_ms,
+                bluray.display_lead_ms.load(.acquire),
+            },
+        );
 
-        // Redirect back to main page
-        const response = "HTTP/1.1 302 Found\r\nLocation: /\r\n\r\n";
-        try out.writeAll(response);
-    } else if (std.mem.eql(u8, method, "POST") and std.mem.eql(u8, path, "/display-lead")) {
-        // Find the body
-        var body_start: usize = 0;
-        while (lines.next()) |line| {
-            if (std.mem.eql(u8, line, "")) {
-                body_start = @intFromPtr(line.ptr) - @intFromPtr(request.ptr) + line.len + 2;
-                break;
-            }
-        }
-        const body = request[body_start..];
-
-        var iter = std.mem.splitSequence(u8, body, "&");
-        while (iter.next()) |pair| {
-            if (!std.mem.startsWith(u8, pair, "lead=")) continue;
-            const raw_value = formDecode(allocator, pair[5..]) catch continue;
-            defer allocator.free(raw_value);
-
-            if (bluray.parseDisplayLeadConfig(raw_value)) |value| {
-                // Applies to the running process immediately and persists to
-                // bluray_display_lead_ms.txt so it survives a restart too.
-                bluray.setDisplayLead(io, value);
-            } else {
-                std.log.warn("Rejected display lead value: {s}\n", .{raw_value});
-            }
-        }
+        var name_buf: [cues.max_name_len]u8 = undefined;
+        try w.writeAll(",\"cues\":{\"file\":");
+        if (self.cue_state.currentName(&name_buf)) |name| try writeJsonString(w, name) else try w.writeAll("null");
+        try w.print(",\"armed\":{},\"current\":", .{self.cue_state.isArmed()});
+        var cue_buf: [256]u8 = undefined;
+        if (self.sources.cueAt(now_ms, &cue_buf)) |text| try self.writePanelText(w, text) else try w.writeAll("null");
+        try w.writeAll("}}");
+    }
 
-        // Redirect back to main page
-        const response = "HTTP/1.1 302 Found\r\nLocation: /\r\n\r\n";
-        try out.writeAll(response);
-    } else if (std.mem.eql(u8, method, "POST") and std.mem.eql(u8, path, "/resync")) {
-        // No body to parse: this is a single one-shot signal, picked up by
-        // `pollLoop` and consumed via `swap` so a request can never be lost or
-        // fire twice. Setting it while not in Blu-ray mode is harmless -- the
-        // next time that mode starts, a freshly initialized phase lock has
-        // nothing to resync anyway.
-        resync_requested.store(true, .release);
-
-        const response = "HTTP/1.1 302 Found\r\nLocation: /\r\n\r\n";
-        try out.writeAll(response);
-    } else {
-        const response = "HTTP/1.1 404 Not Found\r\n\r\n";
-        try out.writeAll(response);
+    /// `text`, in the panel's character set, as a JSON string.
+    fn writePanelText(self: *Control, w: *Io.Writer, text: []const u8) !void {
+        var utf8: std.ArrayList(u8) = .empty;
+        defer utf8.deinit(self.allocator);
+        try vorne_charset.decodeToUtf8(self.allocator, &utf8, text);
+        try writeJsonString(w, utf8.items);
     }
+};
+
+/// A mode as `/mode` takes it.
+fn modeName(mode: Mode) []const u8 {
+    return switch (mode) {
+        .Clocks => "clocks",
+        .Bluray => "bluray",
+        .Vlc => "vlc",
+    };
 }
 
 /// Render the Blu-ray cue controls: which file line 2 draws from, and whether
@@ -504,6 +891,23 @@ fn writeDisplayLeadSection(w: *Io.Writer) !void {
     , .{current});
 }
 
+/// Write `text` as a JSON string. UTF-8 passes through as it is.
+fn writeJsonString(w: *Io.Writer, text: []const u8) !void {
+    try w.writeByte('"');
+    for (text) |c| {
+        switch (c) {
+            '"' => try w.writeAll("\\\""),
+            '\\' => try w.writeAll("\\\\"),
+            '\n' => try w.writeAll("\\n"),
+            '\r' => try w.writeAll("\\r"),
+            '\t' => try w.writeAll("\\t"),
+            0...0x08, 0x0b, 0x0c, 0x0e...0x1f, 0x7f => try w.print("\\u{x:0>4}", .{c}),
+            else => try w.writeByte(c),
+        }
+    }
+    try w.writeByte('"');
+}
+
 /// Escape text for interpolation into HTML. File names come from the
 /// filesystem, so they are not guaranteed to be free of markup characters.
 fn writeHtmlEscaped(w: *Io.Writer, text: []const u8) !void {
@@ -575,6 +979,13 @@ test "writeHtmlEscaped neutralizes markup in file names" {
     try std.testing.expectEqualStrings("a&lt;b&gt;&amp;&quot;c&quot;.vtt", body.written());
 }
 
+test "writeJsonString escapes what JSON needs and nothing else" {
+    var body: Io.Writer.Allocating = .init(std.testing.allocator);
+    defer body.deinit();
+    try writeJsonString(&body.writer, "say \"hi\"\\\n\x01 caf\u{e9}");
+    try std.testing.expectEqualStrings("\"say \\\"hi\\\"\\\\\\n\\u0001 caf\u{e9}\"", body.written());
+}
+
 // Pull every module's `test` blocks into the test binary.
 //
 // `zig build test` builds a single test executable rooted at this file, and
@@ -586,20 +997,36 @@ test "writeHtmlEscaped neutralizes markup in file names" {
 // nasty because it looks exactly like a green suite.
 test {
     _ = @import("bluray.zig");
+    _ = @import("bus.zig");
+    _ = @import("cell.zig");
+    _ = @import("clock_sync.zig");
     _ = @import("clocks.zig");
     _ = @import("config.zig");
+    _ = @import("cue_cache.zig");
     _ = @import("cues.zig");
     _ = @import("debug_log.zig");
+    _ = @import("event.zig");
+    _ = @import("file_watch.zig");
+    _ = @import("flight_recorder.zig");
     _ = @import("frame_timer.zig");
+    _ = @import("http_server.zig");
     _ = @import("jsonc.zig");
+    _ = @import("latency_probe.zig");
     _ = @import("marquee.zig");
+    _ = @import("metrics.zig");
     _ = @import("mode.zig");
+    _ = @import("panel_emulator.zig");
+    _ = @import("panel_mirror.zig");
     _ = @import("phase_lock.zig");
     _ = @import("process_mgmt.zig");
     _ = @import("protocol.zig");
+    _ = @import("realtime.zig");
+    _ = @import("render.zig");
     _ = @import("serial.zig");
     _ = @import("str_utils.zig");
     _ = @import("time.zig");
+    _ = @import("transport.zig");
+    _ = @import("tzif.zig");
     _ = @import("vlc.zig");
     _ = @import("vorne_charset.zig");
     _ = @import("vorne_config.zig");
@@ -0,0 +1,270 @@
+//! Counters and latency histograms for every hot path, served as `/metrics`
+//! in Prometheus's text exposition format.
+//!
+//! The timing this program cares about used to exist only as log lines: the
+//! sender's "serial comm slow" warning, a display pass reported late, the
+//! `rtt=` on every `pll:` line. Enough to notice a bad moment in the journal,
+//! but nothing to graph a week of, or alert on. Each of those places now also
+//! counts what it sees here, always on:
+//!
+//! - the wire (`transport.Transport`): frames and bytes written, how long
+//!   each write took, and how each frame was answered -- confirmed, rejected
+//!   or given up on -- with the reply latency of the answered ones;
+//! - the sender (`render.senderLoop`): frames sent as a column diff, and
+//!   full redraws by `render.RedrawReason`;
+//! - the Blu-ray poller: each status request's round trip, and every time
+//!   the phase lock gains or loses lock;
+//! - cue files (`cues.load`): how long a load took, from its cache or by
+//!   parsing;
+//! - every display, sender and bus thread's wake lateness, kept by
+//!   `realtime.zig` and exported from its histograms as they are.
+//!
+//! Each metric is one module-level variable made of atomics, recorded with a
+//! relaxed add or two and no lock, so a hot path pays a few nanoseconds for
+//! it. Totals are process-wide: with several ports, the wire metrics add up
+//! every port's traffic. A scrape reads each atomic on its own, so a bucket
+//! may already count a sample whose `_sum` has not caught up -- harmless at
+//! any scrape interval worth having.
+
+const std = @import("std");
+const Io = std.Io;
+const render = @import("render.zig");
+const phase_lock = @import("phase_lock.zig");
+const realtime = @import("realtime.zig");
+
+pub const Counter = struct {
+    value: std.atomic.Value(u64) = .init(0),
+
+    pub fn inc(self: *Counter) void {
+        self.add(1);
+    }
+
+    pub fn add(self: *Counter, n: u64) void {
+        _ = self.value.fetchAdd(n, .monotonic);
+    }
+
+    pub fn get(self: *const Counter) u64 {
+        return self.value.load(.monotonic);
+    }
+};
+
+/// A fixed-bucket histogram of durations, kept in microseconds and exported
+/// in seconds. `bounds_us` are the buckets' upper bounds, ascending; one more
+/// bucket takes everything past the last.
+pub fn Histogram(comptime bounds_us: []const i64) type {
+    return struct {
+        const Self = @This();
+        pub const bounds = bounds_us;
+
+        counts: [bounds_us.len + 1]std.atomic.Value(u64) = [_]std.atomic.Value(u64){.init(0)} ** (bounds_us.len + 1),
+        sum_us: std.atomic.Value(u64) = .init(0),
+
+        /// One sample of `us`; a negative one, from a clock stepped
+        /// backwards, counts as zero.
+        pub fn observe(self: *Self, us: i64) void {
+            const clamped: u64 = @intCast(@max(us, 0));
+            var i: usize = 0;
+            while (i < bounds_us.len and us > bounds_us[i]) : (i += 1) {}
+            _ = self.counts[i].fetchAdd(1, .monotonic);
+            _ = self.sum_us.fetchAdd(clamped, .monotonic);
+        }
+
+        /// One sample of the time from `start_ns` (`time.nowNanos`) to now.
+        pub fn observeSince(self: *Self, io: Io, start_ns: i128) void {
+            const elapsed_ns = Io.Timestamp.now(io, .real).nanoseconds - start_ns;
+            self.observe(@intCast(@divFloor(elapsed_ns, std.time.ns_per_us)));
+        }
+    };
+}
+
+/// One `V` -- a counter or a histogram -- per value of the enum `E`,
+/// exported as one metric labelled by the value's name.
+pub fn Labeled(comptime E: type, comptime V: type) type {
+    return struct {
+        const Self = @This();
+        const fields = @typeInfo(E).@"enum".fields;
+
+        values: [fields.len]V = @splat(.{}),
+
+        pub fn of(self: *Self, e: E) *V {
+            return &self.values[@intFromEnum(e)];
+        }
+    };
+}
+
+// ---- The metrics themselves -----------------------------------------------
+
+/// How long a frame took to write to the port. Next to nothing unless the
+/// kernel's buffer is full -- a USB adapter falling behind.
+const write_bounds_us = [_]i64{ 50, 100, 250, 500, 1_000, 2_500, 5_000, 10_000, 50_000 };
+/// From a frame's last byte landing to the panel's answer. Typically tens of
+/// milliseconds; `render.SEND_SLOW_ABSOLUTE_MS` and the transport's timeout
+/// sit inside the top buckets.
+const reply_bounds_us = [_]i64{ 5_000, 10_000, 20_000, 30_000, 50_000, 75_000, 100_000, 150_000, 250_000, 500_000 };
+/// A Blu-ray status request, over the LAN to a player that is not quick.
+const poll_bounds_us = [_]i64{ 10_000, 20_000, 50_000, 100_000, 200_000, 500_000, 1_000_000, 2_000_000, 5_000_000 };
+/// A cue file, from its cache (well under a millisecond) to a large parse.
+const cue_load_bounds_us = [_]i64{ 100, 500, 1_000, 5_000, 10_000, 50_000, 100_000, 500_000, 1_000_000 };
+
+pub const Answer = enum { confirmed, rejected, timed_out };
+pub const CueSource = enum { cache, parse };
+
+pub var frames_written: Counter = .{};
+/// Group frames on a bus (`transport.Transport.broadcast`), which nothing
+/// answers; also counted in `frames_written`.
+pub var group_frames_written: Counter = .{};
+pub var bytes_written: Counter = .{};
+pub var write_time: Histogram(&write_bounds_us) = .{};
+pub var answers: Labeled(Answer, Counter) = .{};
+pub var reply_time: Histogram(&reply_bounds_us) = .{};
+
+/// Frames the sender built as a column diff.
+pub var diff_frames: Counter = .{};
+/// And the ones it built as a full redraw, by why.
+pub var full_redraws: Labeled(render.RedrawReason, Counter) = .{};
+
+pub var poll_time: Histogram(&poll_bounds_us) = .{};
+/// Entries into each phase: a rising `locked` count is a lock that keeps
+/// being lost and regained.
+pub var lock_transitions: Labeled(phase_lock.Phase, Counter) = .{};
+
+pub var cue_load_time: Labeled(CueSource, Histogram(&cue_load_bounds_us)) = .{};
+
+// ---- Exposition ------------------------------------------------------------
+
+/// Every metric, in the text exposition format.
+pub fn write(w: *Io.Writer) Io.Writer.Error!void {
+    try family(w, "vorne_serial_frames_written_total", "counter", "Frames written to the panel port.");
+    try w.print("vorne_serial_frames_written_total {d}\n", .{frames_written.get()});
+    try family(w, "vorne_serial_group_frames_written_total", "counter", "Group frames written to a bus, which nothing answers.");
+    try w.print("vorne_serial_group_frames_written_total {d}\n", .{group_frames_written.get()});
+    try family(w, "vorne_serial_bytes_written_total", "counter", "Bytes written to the panel port.");
+    try w.print("vorne_serial_bytes_written_total {d}\n", .{bytes_written.get()});
+    try family(w, "vorne_serial_write_seconds", "histogram", "Time to write one frame to the port.");
+    try writeHistogram(w, "vorne_serial_write_seconds", "", &write_time);
+    try family(w, "vorne_serial_answers_total", "counter", "Frames by how the panel answered them.");
+    try writeLabeledCounters(w, "vorne_serial_answers_total", "answer", Answer, &answers);
+    try family(w, "vorne_serial_reply_seconds", "histogram", "From a frame landing to the panel's reply.");
+    try writeHistogram(w, "vorne_serial_reply_seconds", "", &reply_time);
+
+    try family(w, "vorne_display_frames_total", "counter", "Frames the sender built, by full-redraw reason, or none for a column diff.");
+    try w.print("vorne_display_frames_total{{redraw=\"none\"}} {d}\n", .{diff_frames.get()});
+    try writeLabeledCounters(w, "vorne_display_frames_total", "redraw", render.RedrawReason, &full_redraws);
+
+    try family(w, "vorne_bluray_poll_seconds", "histogram", "Round trip of one Blu-ray player status request.");
+    try writeHistogram(w, "vorne_bluray_poll_seconds", "", &poll_time);
+    try family(w, "vorne_bluray_lock_transitions_total", "counter", "Phase lock entries into each phase.");
+    try writeLabeledCounters(w, "vorne_bluray_lock_transitions_total", "phase", phase_lock.Phase, &lock_transitions);
+
+    try family(w, "vorne_cue_load_seconds", "histogram", "Time to load one cue file, from its cache or by parsing it.");
+    inline for (@typeInfo(CueSource).@"enum".fields) |f| {
+        try writeHistogram(w, "vorne_cue_load_seconds", "source=\"" ++ f.name ++ "\"", cue_load_time.of(@enumFromInt(f.value)));
+    }
+
+    try family(w, "vorne_wake_lateness_seconds", "histogram", "How late each port's threads woke for their deadlines.");
+    try writeLateness(w);
+}
+
+fn family(w: *Io.Writer, name: []const u8, kind: []const u8, help: []const u8) Io.Writer.Error!void {
+    try w.print("# HELP {s} {s}\n# TYPE {s} {s}\n", .{ name, help, name, kind });
+}
+
+fn writeLabeledCounters(w: *Io.Writer, name: []const u8, label: []const u8, comptime E: type, counters: anytype) Io.Writer.Error!void {
+    inline for (@typeInfo(E).@"enum".fields) |f| {
+        try w.print("{s}{{{s}=\"{s}\"}} {d}\n", .{ name, label, f.name, counters.of(@enumFromInt(f.value)).get() });
+    }
+}
+
+/// `labels` go inside the braces ahead of `le`: empty, or `key="value"`.
+fn writeHistogram(w: *Io.Writer, name: []const u8, labels: []const u8, h: anytype) Io.Writer.Error!void {
+    var counts: [h.counts.len]u64 = undefined;
+    for (&counts, &h.counts) |*c, *a| c.* = a.load(.monotonic);
+    try writeBuckets(w, name, labels, @TypeOf(h.*).bounds, &counts, h.sum_us.load(.monotonic));
+}
+
+fn writeLateness(w: *Io.Writer) Io.Writer.Error!void {
+    for (realtime.all()) |*l| {
+        const s = l.summary();
+        var unit_buf: [3]u8 = undefined;
+        const unit = if (l.unit) |u| std.fmt.bufPrint(&unit_buf, "{d}", .{u}) catch unreachable else "";
+        var labels_buf: [256]u8 = undefined;
+        const labels = std.fmt.bufPrint(&labels_buf, "device=\"{s}\",unit=\"{s}\",role=\"{s}\"", .{ l.device(), unit, @tagName(l.role) }) catch continue;
+        try writeBuckets(w, "vorne_wake_lateness_seconds", labels, &realtime.bucket_bounds_us, &s.counts, s.sum_us);
+    }
+}
+
+/// One histogram's `_bucket` lines, cumulative as the format has them, then
+/// its `_sum` and `_count`.
+fn writeBuckets(w: *Io.Writer, name: []const u8, labels: []const u8, bounds_us: []const i64, counts: []const u64, sum_us: u64) Io.Writer.Error!void {
+    const sep = if (labels.len > 0) "," else "";
+    var total: u64 = 0;
+    for (counts, 0..) |c, i| {
+        total += c;
+        try w.print("{s}_bucket{{{s}{s}le=\"", .{ name, labels, sep });
+        if (i < bounds_us.len) try writeSeconds(w, @intCast(bounds_us[i])) else try w.writeAll("+Inf");
+        try w.print("\"}} {d}\n", .{total});
+    }
+    const open = if (labels.len > 0) "{" else "";
+    const close = if (labels.len > 0) "}" else "";
+    try w.print("{s}_sum{s}{s}{s} ", .{ name, open, labels, close });
+    try writeSeconds(w, sum_us);
+    try w.print("\n{s}_count{s}{s}{s} {d}\n", .{ name, open, labels, close, total });
+}
+
+/// Microseconds as decimal seconds, exactly: no float rounding a bucket
+/// bound into a different bucket's label.
+fn writeSeconds(w: *Io.Writer, us: u64) Io.Writer.Error!void {
+    try w.print("{d}.{d:0>6}", .{ us / std.time.us_per_s, us % std.time.us_per_s });
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+test "a histogram counts each sample in the first bucket bounding it" {
+    var h: Histogram(&[_]i64{ 10, 100 }) = .{};
+    h.observe(10);
+    h.observe(11);
+    h.observe(5_000);
+    h.observe(-3);
+    try testing.expectEqual(@as(u64, 2), h.counts[0].load(.monotonic));
+    try testing.expectEqual(@as(u64, 1), h.counts[1].load(.monotonic));
+    try testing.expectEqual(@as(u64, 1), h.counts[2].load(.monotonic));
+    try testing.expectEqual(@as(u64, 5_021), h.sum_us.load(.monotonic));
+}
+
+test "histograms are exposed cumulatively, in seconds" {
+    var h: Histogram(&[_]i64{ 500, 1_500_000 }) = .{};
+    h.observe(200);
+    h.observe(1_000);
+
+    var buf: [512]u8 = undefined;
+    var w: Io.Writer = .fixed(&buf);
+    try writeHistogram(&w, "t", "port=\"a\"", &h);
+    try testing.expectEqualStrings(
+        \\t_bucket{port="a",le="0.000500"} 1
+        \\t_bucket{port="a",le="1.500000"} 2
+        \\t_bucket{port="a",le="+Inf"} 2
+        \\t_sum{port="a"} 0.001200
+        \\t_count{port="a"} 2
+        \\
+    , w.buffered());
+}
+
+test "the exposition covers every family" {
+    full_redraws.of(.periodic).inc();
+    lock_transitions.of(.locked).inc();
+    cue_load_time.of(.parse).observe(2_000);
+
+    var out: Io.Writer.Allocating = .init(testing.allocator);
+    defer out.deinit();
+    try write(&out.writer);
+    const text = out.written();
+    try testing.expect(std.mem.indexOf(u8, text, "# TYPE vorne_serial_reply_seconds histogram\n") != null);
+    try testing.expect(std.mem.indexOf(u8, text, "vorne_display_frames_total{redraw=\"periodic\"} ") != null);
+    try testing.expect(std.mem.indexOf(u8, text, "vorne_bluray_lock_transitions_total{phase=\"locked\"} ") != null);
+    try testing.expect(std.mem.indexOf(u8, text, "vorne_cue_load_seconds_bucket{source=\"parse\",le=\"+Inf\"} ") != null);
+    try testing.expect(std.mem.indexOf(u8, text, "vorne_serial_write_seconds_count ") != null);
+}
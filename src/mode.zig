@@ -26,11 +26,18 @@ pub const Mode = enum(u8) {
 /// A module-level atomic rather than a parameter threaded through every mode
 /// loop, since all three already import this module and none of them needs to
 /// do anything with it beyond noticing.
-var reinit_requested = std.atomic.Value(bool).init(false);
+///
+/// A count of requests rather than a flag, because with several serial ports
+/// there are several dispatch loops and one click must reach every one of
+/// them. Each display thread records which request it last serviced in
+/// `serviced_generation`; a mode loop runs on its dispatch loop's thread, so
+/// both see the same record without either passing it around.
+var reinit_generation = std.atomic.Value(u64).init(0);
+threadlocal var serviced_generation: u64 = 0;
 
 /// Ask for a re-init. Safe to call from any thread.
 pub fn requestReinit() void {
-    reinit_requested.store(true, .release);
+    _ = reinit_generation.fetchAdd(1, .release);
 }
 
 /// Whether a re-init is pending, without consuming it.
@@ -39,15 +46,18 @@ pub fn requestReinit() void {
 /// deliberately does not consume: the loop only needs to stop, and the
 /// dispatch loop that actually performs the init is what clears the flag.
 pub fn reinitPending() bool {
-    return reinit_requested.load(.acquire);
+    return reinit_generation.load(.acquire) != serviced_generation;
 }
 
 /// Consume a pending re-init request, reporting whether there was one.
 ///
-/// `swap` rather than load-then-store so a request arriving between the two
-/// cannot be lost, and so a single click cannot be serviced twice.
+/// Several requests arriving before a take are serviced once, and one arriving
+/// after the load is left pending for the next take rather than lost.
 pub fn takeReinitRequest() bool {
-    return reinit_requested.swap(false, .acq_rel);
+    const generation = reinit_generation.load(.acquire);
+    if (generation == serviced_generation) return false;
+    serviced_generation = generation;
+    return true;
 }
 
 // ---------------------------------------------------------------------------
@@ -83,3 +93,28 @@ test "repeated requests before a take collapse into one" {
     try testing.expect(takeReinitRequest());
     try testing.expect(!takeReinitRequest());
 }
+
+test "every display thread services a request once" {
+    _ = takeReinitRequest();
+
+    const Display = struct {
+        fn run(ready: *std.atomic.Value(bool), seen: *[2]bool) void {
+            // A fresh thread has serviced nothing, so catch up first, as the
+            // dispatch loop does on its first pass.
+            _ = takeReinitRequest();
+            ready.store(true, .release);
+            while (!reinitPending()) std.atomic.spinLoopHint();
+            seen[0] = takeReinitRequest();
+            seen[1] = takeReinitRequest();
+        }
+    };
+    var ready = std.atomic.Value(bool).init(false);
+    var seen: [2]bool = .{ false, true };
+    const thread = try std.Thread.spawn(.{}, Display.run, .{ &ready, &seen });
+    while (!ready.load(.acquire)) std.atomic.spinLoopHint();
+    requestReinit();
+    thread.join();
+    try testing.expectEqual([2]bool{ true, false }, seen);
+    // ...and this thread, another display, gets its own copy of it.
+    try testing.expect(takeReinitRequest());
+}
@@ -0,0 +1,937 @@
+//! A software Vorne M1000 on a pseudo-terminal.
+//!
+//! Everything that decides how fast a change reaches the panel -- the column
+//! diffing, the sender's pacing, the frame timer -- could until now only be
+//! judged on real hardware, by eye, on the one machine that has the panel
+//! wired to `/dev/ttyUSB0`. This stands in for that panel: it opens a pty,
+//! hands its slave path to `serial.SerialPort.open` exactly as if it were the
+//! USB adapter, and on the master side parses the same SPP frames
+//! `protocol.zig` produces, renders them into a 2x20 framebuffer, and answers
+//! the way `protocol.send` waits for.
+//!
+//! ## What is modelled, and what is not
+//!
+//! - **Framing.** `SOH`, the packet type (`S`/`T`/`U`, lower case for group
+//!   addressing), the decimal address, `:D`/`:F`, the payload up to `CR`, and
+//!   the checksum-8 or CRC16 trailer. A frame whose trailer does not match is
+//!   discarded without a reply, which is what makes a spliced or truncated
+//!   frame show up here the same way it does on hardware: as a send that
+//!   `protocol.send` reports unconfirmed.
+//! - **The commands this program actually sends.** `ESC <line>;<col>C`
+//!   (either parameter may be omitted and defaults to 1), a form feed (clear),
+//!   and the `ESC x0;y0;x1;y1w` window geometry from the init sequence. Every
+//!   other escape -- attributes, fonts, the `-g`/`-B`/`-b` switches -- is
+//!   parsed far enough to be skipped and otherwise ignored. Positioning does
+//!   not clear the rest of the line: the Blu-ray sender relies on that when it
+//!   rewrites a single digit.
+//! - **The wire.** A pty moves bytes instantly, so the time a frame would take
+//!   to arrive at `Options.baud` is added back: a frame lands on the
+//!   framebuffer when its last trailer byte would have, not when the write
+//!   returned. Without this, a full two-line redraw and a one-digit update
+//!   would look equally cheap, which is precisely the distinction the
+//!   benchmarks exist to measure.
+//! - **The panel's own turnaround.** `reply_latency_ms`, plus up to
+//!   `reply_jitter_ms` either way, between the panel taking a frame up and
+//!   its reply. It works on one frame at a time: a frame that lands while it
+//!   is busy waits in its input buffer, `input_buffer_bytes` long, and one
+//!   that lands on a buffer too full to take it is lost -- which is what
+//!   pipelining more than the buffer holds (`transport.zig`'s window) costs
+//!   on hardware, and so what a window setting can be tried against here.
+//!   `drop_rate` is the probability a well-formed frame is silently lost --
+//!   no render, no reply -- the failure the sender's "what has the panel been
+//!   shown" record and its periodic redraw exist to recover from.
+//!
+//! Every answered frame gets a single `ACK`. `transport.zig` does read the
+//! reply -- it tells `ACK` from `NAK` from anything else -- but only `ACK` is
+//! modelled: a frame that fails its trailer is discarded unanswered, as
+//! above, rather than `NAK`ed. Only unit frames addressed to
+//! `Options.address` are answered; group frames are rendered but never
+//! answered, since on a shared RS-485 bus every unit answering at once would
+//! collide.
+//!
+//! The frame parser and framebuffer are free of I/O, so they are tested
+//! directly; `Emulator` wraps them in the pty and a thread.
+
+const std = @import("std");
+const Io = std.Io;
+const linux = std.os.linux;
+const protocol = @import("protocol.zig");
+const serial = @import("serial.zig");
+const str_utils = @import("str_utils.zig");
+const time = @import("time.zig");
+const dbg = @import("debug_log.zig");
+
+pub const lines = 2;
+pub const cols = str_utils.maxchars;
+
+/// The panel's pixel cell, for translating the `w` window command (given in
+/// pixels) into lines and columns: `ESC 0;0;119;15w` is 120x16 pixels, which
+/// is 20 columns of 2 lines.
+const char_width_px = 6;
+const char_height_px = 8;
+
+/// What every answered frame gets back -- see the file doc.
+pub const reply = "\x06";
+
+/// Longest frame accepted, SOH through trailer: the most `protocol` can
+/// build. Anything beyond this is far more likely a lost CR than a real
+/// frame, and is discarded rather than swallowing whatever follows it.
+pub const max_frame_bytes = protocol.max_frame_len;
+
+const SOH = protocol.SOH[0];
+const ESC = protocol.ESC[0];
+const CR = protocol.CR[0];
+const LF = protocol.LF[0];
+const FF = protocol.FF[0];
+const DLE = protocol.DLE[0];
+
+pub const Options = struct {
+    /// Unit address answered to, as in `protocol.sendUnitDisplayCmd(.., 1, ..)`.
+    address: u8 = 1,
+    /// Group address whose frames are rendered (never answered).
+    group: u8 = 0,
+    /// Time between the panel taking a frame up and its reply.
+    reply_latency_ms: u32 = 15,
+    /// Uniform spread applied to `reply_latency_ms`, in either direction.
+    reply_jitter_ms: u32 = 0,
+    /// Probability, 0 to 1, that a well-formed frame is lost outright.
+    drop_rate: f32 = 0,
+    /// Bytes of frames the panel holds while it is busy with another -- the
+    /// transport's default window, which assumes no more. Zero is unbounded.
+    input_buffer_bytes: u32 = 64,
+    /// Line rate to emulate, 8N1 (ten bits a byte). Zero disables wire timing.
+    baud: u32 = 19200,
+    /// Seeds the jitter and drop draws, so a benchmark run is repeatable.
+    seed: u64 = 0x4d31303030,
+};
+
+/// How long the panel would take to clock `bytes` in at `baud`, in
+/// microseconds -- the same arithmetic as "a 20-column line is about 18 ms"
+/// in `protocol.appendChangedColsToFrame`'s doc. The transport uses it too,
+/// so it lives with the port.
+pub const wireMicros = serial.wireMicros;
+
+// ---------------------------------------------------------------------------
+// Framebuffer
+// ---------------------------------------------------------------------------
+
+/// One column: a plain byte (second byte 0) or a DLE pair.
+pub const Glyph = [2]u8;
+
+const blank_glyph: Glyph = .{ ' ', 0 };
+
+/// What the panel is showing, in the panel's own encoding.
+///
+/// Stored per column rather than as byte strings because the protocol
+/// addresses columns, and a DLE-escaped glyph is two bytes in one of them --
+/// the same distinction `str_utils.idxChar2Str` exists for.
+pub const Framebuffer = struct {
+    cells: [lines][cols]Glyph = @splat(@splat(blank_glyph)),
+    /// Where the next text byte lands, 0-based.
+    cursor_line: u8 = 0,
+    cursor_col: u8 = 0,
+    /// The visible window from the last `w` command. Text outside it is
+    /// dropped, as on the panel -- which is why a mangled geometry command
+    /// leaves the panel blank (see `mode.zig`'s reinit doc).
+    window_lines: u8 = lines,
+    window_cols: u8 = cols,
+
+    pub fn clear(self: *Framebuffer) void {
+        self.cells = @splat(@splat(blank_glyph));
+        self.cursor_line = 0;
+        self.cursor_col = 0;
+    }
+
+    /// Interpret one frame's payload (everything between `:D` and `CR`).
+    pub fn apply(self: *Framebuffer, payload: []const u8) void {
+        var i: usize = 0;
+        while (i < payload.len) {
+            const b = payload[i];
+            switch (b) {
+                ESC => i = self.applyEscape(payload, i + 1),
+                FF => {
+                    self.clear();
+                    i += 1;
+                },
+                CR, LF => i += 1,
+                DLE => {
+                    // A DLE with nothing after it is a truncated glyph; it
+                    // occupies no column.
+                    if (i + 1 < payload.len) self.put(.{ DLE, payload[i + 1] });
+                    i += 2;
+                },
+                else => {
+                    if (b >= 0x20) self.put(.{ b, 0 });
+                    i += 1;
+                },
+            }
+        }
+    }
+
+    /// Parse the escape whose parameters start at `start`, returning the
+    /// index just past its command letter.
+    fn applyEscape(self: *Framebuffer, payload: []const u8, start: usize) usize {
+        var params: [4]?u16 = @splat(null);
+        var n_params: usize = 0;
+        var modified = false;
+        var i = start;
+        while (i < payload.len) : (i += 1) {
+            const c = payload[i];
+            switch (c) {
+                '0'...'9' => {
+                    if (n_params < params.len) {
+                        const prev = params[n_params] orelse 0;
+                        params[n_params] = prev *| 10 +| (c - '0');
+                    }
+                },
+                ';' => n_params += 1,
+                '-', '+' => modified = true,
+                else => break,
+            }
+        }
+        if (i >= payload.len) return payload.len;
+
+        switch (payload[i]) {
+            'C' => if (!modified) {
+                const line = params[0] orelse 1;
+                const col = params[1] orelse 1;
+                self.cursor_line = @intCast(std.math.clamp(line, 1, lines) - 1);
+                self.cursor_col = @intCast(std.math.clamp(col, 1, cols) - 1);
+            },
+            'w' => if (n_params == 3) {
+                const x0 = params[0] orelse 0;
+                const y0 = params[1] orelse 0;
+                const x1 = params[2] orelse 0;
+                const y1 = params[3] orelse 0;
+                if (x1 >= x0 and y1 >= y0) {
+                    self.window_cols = @intCast(@min((x1 - x0 + 1) / char_width_px, cols));
+                    self.window_lines = @intCast(@min((y1 - y0 + 1) / char_height_px, lines));
+                }
+            },
+            else => {},
+        }
+        return i + 1;
+    }
+
+    fn put(self: *Framebuffer, glyph: Glyph) void {
+        if (self.cursor_line < self.window_lines and self.cursor_col < self.window_cols) {
+            self.cells[self.cursor_line][self.cursor_col] = glyph;
+        }
+        // No wrap: text past the right edge is lost, not carried to the next
+        // line.
+        if (self.cursor_col < cols) self.cursor_col += 1;
+    }
+
+    /// Line `line` (1-based) in the panel's encoding, DLE pairs intact --
+    /// the same shape as the `[maxbufsz]u8` line buffers the mode loops
+    /// build, so the two can be compared directly.
+    pub fn lineText(self: *const Framebuffer, line: usize, out: *[str_utils.maxbufsz]u8) []const u8 {
+        var n: usize = 0;
+        for (self.cells[line - 1]) |g| {
+            out[n] = g[0];
+            n += 1;
+            if (g[1] != 0) {
+                out[n] = g[1];
+                n += 1;
+            }
+        }
+        return out[0..n];
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Frame parser
+// ---------------------------------------------------------------------------
+
+pub const Check = enum { none, checksum8, crc16 };
+
+pub const Frame = struct {
+    group: bool,
+    check: Check,
+    address: u16,
+    /// `D` or `F`.
+    command: u8,
+    /// Borrowed from the parser; valid until its next `feed`.
+    payload: []const u8,
+    /// Bytes on the wire, SOH through trailer.
+    wire_len: usize,
+};
+
+pub const Event = union(enum) {
+    frame: Frame,
+    /// Trailer did not match the frame.
+    bad_check,
+    /// Not a frame this protocol can produce: unknown packet type, no
+    /// address, no `:`.
+    malformed,
+    /// A new SOH arrived before the previous frame finished.
+    truncated,
+    /// No CR within `max_frame_bytes`.
+    overflow,
+};
+
+/// Byte-at-a-time SPP frame decoder.
+///
+/// Resynchronizes on every SOH, which can never appear inside a valid frame
+/// (graphic characters below the space are DLE-escaped precisely so that no
+/// raw control byte goes down the wire). The trailer covers everything from
+/// SOH through CR, as `protocol.FrameBuilder` computes it.
+pub const FrameParser = struct {
+    buf: [max_frame_bytes]u8 = undefined,
+    len: usize = 0,
+    /// Where the trailer starts in `buf`, once CR has been seen.
+    body_len: usize = 0,
+    trailer_len: usize = 0,
+    state: enum { idle, body, trailer } = .idle,
+
+    pub fn feed(self: *FrameParser, byte: u8) ?Event {
+        if (byte == SOH) {
+            const was_mid_frame = self.state != .idle;
+            self.state = .body;
+            self.buf[0] = byte;
+            self.len = 1;
+            return if (was_mid_frame) .truncated else null;
+        }
+        switch (self.state) {
+            .idle => return null,
+            .body, .trailer => {
+                if (self.len == self.buf.len) {
+                    self.state = .idle;
+                    return .overflow;
+                }
+                self.buf[self.len] = byte;
+                self.len += 1;
+            },
+        }
+
+        if (self.state == .body) {
+            if (byte != CR) return null;
+            self.body_len = self.len;
+            self.trailer_len = switch (if (self.len > 1) self.buf[1] else 0) {
+                'S', 's' => 0,
+                'T', 't' => 2,
+                'U', 'u' => 4,
+                else => {
+                    self.state = .idle;
+                    return .malformed;
+                },
+            };
+            self.state = .trailer;
+        }
+        if (self.len - self.body_len < self.trailer_len) return null;
+
+        self.state = .idle;
+        return self.finish();
+    }
+
+    fn finish(self: *FrameParser) Event {
+        const body = self.buf[0..self.body_len];
+        const trailer = self.buf[self.body_len..self.len];
+        const check: Check = switch (trailer.len) {
+            0 => .none,
+            2 => .checksum8,
+            else => .crc16,
+        };
+        switch (check) {
+            .none => {},
+            .checksum8 => {
+                var sum: u8 = 0;
+                for (body) |b| sum +%= b;
+                const got = std.fmt.parseInt(u8, trailer, 16) catch return .bad_check;
+                if (got != (~sum) +% 1) return .bad_check;
+            },
+            .crc16 => {
+                const got = std.fmt.parseInt(u16, trailer, 16) catch return .bad_check;
+                if (got != protocol.calculateXmodemCrc16(body)) return .bad_check;
+            },
+        }
+
+        // SOH, type, address digits, ':', command, payload..., CR
+        var i: usize = 2;
+        var address: u16 = 0;
+        while (i < body.len and std.ascii.isDigit(body[i])) : (i += 1) {
+            address = address *| 10 +| (body[i] - '0');
+        }
+        if (i == 2 or i + 2 > body.len - 1 or body[i] != ':') return .malformed;
+
+        return .{ .frame = .{
+            .group = std.ascii.isLower(body[1]),
+            .check = check,
+            .address = address,
+            .command = body[i + 1],
+            .payload = body[i + 2 .. body.len - 1],
+            .wire_len = self.len,
+        } };
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Input buffer
+// ---------------------------------------------------------------------------
+
+/// Frames tracked from their parse to their reply. One past this many -- far
+/// more than any input buffer holds -- is lost as an overflow whatever
+/// `Options.input_buffer_bytes` says.
+const max_queued = 32;
+
+/// A frame on its way through the panel.
+pub const Queued = struct {
+    group: bool,
+    command: u8,
+    payload_buf: [max_frame_bytes]u8,
+    payload_len: usize,
+    wire_len: usize,
+    /// When its last byte lands.
+    landed_us: i64,
+    /// From being taken up to being answered.
+    turnaround_us: i64,
+    /// Landed on a full buffer.
+    lost: bool = false,
+
+    pub fn payload(self: *const Queued) []const u8 {
+        return self.payload_buf[0..self.payload_len];
+    }
+};
+
+/// The panel behind the wire: a frame at a time, with the ones that land
+/// meanwhile held in a buffer of `capacity_bytes`, and the ones that do not
+/// fit lost. Free of I/O, like the parser -- `step` is told the time and
+/// says what happens by then, one thing at a time and in the order it
+/// happens, and the caller renders, answers and counts.
+pub const InputQueue = struct {
+    /// Zero is unbounded.
+    capacity_bytes: usize,
+    frames: [max_queued]Queued = undefined,
+    head: usize = 0,
+    count: usize = 0,
+    /// The first `landed` of `frames` have landed, the first of them in
+    /// service if `in_service`.
+    landed: usize = 0,
+    in_service: bool = false,
+    /// When the frame in service is answered.
+    done_us: i64 = 0,
+    /// When the panel last finished a frame.
+    free_us: i64 = 0,
+    /// Landed and waiting, not counting the frame in service.
+    buffered_bytes: usize = 0,
+
+    pub const Step = union(enum) {
+        /// Taken up: render it.
+        render: *const Queued,
+        /// Finished with: answer it, unless it is a group frame.
+        finish: *const Queued,
+        /// Landed on a full buffer, and lost.
+        overflow: *const Queued,
+    };
+
+    fn at(self: *InputQueue, i: usize) *Queued {
+        return &self.frames[(self.head + i) % max_queued];
+    }
+
+    fn pop(self: *InputQueue) void {
+        self.head = (self.head + 1) % max_queued;
+        self.count -= 1;
+        self.landed -= 1;
+    }
+
+    /// A frame whose last byte lands at `landed_us`, no earlier than the
+    /// last one pushed. False if there is no slot to track it in.
+    pub fn push(self: *InputQueue, frame: Frame, landed_us: i64, turnaround_us: i64) bool {
+        if (self.count == max_queued) return false;
+        const slot = self.at(self.count);
+        slot.* = .{
+            .group = frame.group,
+            .command = frame.command,
+            .payload_buf = undefined,
+            .payload_len = frame.payload.len,
+            .wire_len = frame.wire_len,
+            .landed_us = landed_us,
+            .turnaround_us = turnaround_us,
+        };
+        @memcpy(slot.payload_buf[0..frame.payload.len], frame.payload);
+        self.count += 1;
+        return true;
+    }
+
+    /// The next thing to happen by `now_us`, if anything does. What it
+    /// points to is valid until the next `push`.
+    pub fn step(self: *InputQueue, now_us: i64) ?Step {
+        while (true) {
+            while (!self.in_service and self.landed > 0 and self.at(0).lost) self.pop();
+            const landing_us: ?i64 = if (self.landed < self.count) self.at(self.landed).landed_us else null;
+
+            if (self.in_service) {
+                // A frame answered at the same moment another lands makes
+                // room for it first.
+                if (self.done_us <= now_us and (landing_us == null or self.done_us <= landing_us.?)) {
+                    const done = self.at(0);
+                    self.pop();
+                    self.in_service = false;
+                    self.free_us = self.done_us;
+                    return .{ .finish = done };
+                }
+            } else if (self.landed > 0) {
+                const next = self.at(0);
+                self.buffered_bytes -= next.wire_len;
+                self.in_service = true;
+                self.done_us = @max(next.landed_us, self.free_us) + next.turnaround_us;
+                return .{ .render = next };
+            }
+
+            const landed_us = landing_us orelse return null;
+            if (landed_us > now_us) return null;
+            const next = self.at(self.landed);
+            self.landed += 1;
+            // A frame landing on an idle panel is taken up at once, however
+            // long it is.
+            const waits = self.in_service or self.landed > 1;
+            if (waits and self.capacity_bytes > 0 and self.buffered_bytes + next.wire_len > self.capacity_bytes) {
+                next.lost = true;
+                return .{ .overflow = next };
+            }
+            self.buffered_bytes += next.wire_len;
+        }
+    }
+
+    /// When `step` next has something to say, if ever.
+    pub fn nextDueUs(self: *InputQueue) ?i64 {
+        var due: ?i64 = if (self.landed < self.count) self.at(self.landed).landed_us else null;
+        if (self.in_service) due = if (due) |d| @min(d, self.done_us) else self.done_us;
+        return due;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// The emulator proper
+// ---------------------------------------------------------------------------
+
+/// How long the emulator thread waits for input before re-checking `stop`.
+const POLL_SLICE_MS = 50;
+
+pub const Stats = struct {
+    bytes_received: std.atomic.Value(u64) = .init(0),
+    frames_rendered: std.atomic.Value(u64) = .init(0),
+    frames_answered: std.atomic.Value(u64) = .init(0),
+    /// Lost on purpose, to `Options.drop_rate`.
+    frames_dropped: std.atomic.Value(u64) = .init(0),
+    /// Lost to a full input buffer.
+    frames_overflowed: std.atomic.Value(u64) = .init(0),
+    /// Failed their trailer, or could not be parsed at all.
+    frames_rejected: std.atomic.Value(u64) = .init(0),
+};
+
+pub const Emulator = struct {
+    io: Io,
+    options: Options,
+    master: linux.fd_t,
+    slave_path_buf: [32]u8 = undefined,
+    slave_path_len: usize = 0,
+
+    stop: std.atomic.Value(bool) = .init(false),
+    thread: ?std.Thread = null,
+    stats: Stats = .{},
+
+    /// Guards `screen` -- a spin lock, since the critical section is a copy
+    /// of 80 glyphs and nothing with a deadline reads it.
+    guard: std.atomic.Value(bool) = .init(false),
+    screen: Framebuffer = .{},
+    /// Bumped every time a frame is rendered, so a reader can tell a fresh
+    /// snapshot from the one it already has.
+    screen_version: u64 = 0,
+
+    /// Allocate the pty. The slave is not opened here: the program under test
+    /// opens it through `serial.SerialPort.open`, like any other tty.
+    pub fn open(io: Io, options: Options) !Emulator {
+        const rc = linux.open("/dev/ptmx", .{ .ACCMODE = .RDWR, .NOCTTY = true, .CLOEXEC = true }, 0);
+        const signed: isize = @bitCast(rc);
+        if (signed < 0) {
+            std.log.err("Could not open /dev/ptmx for the panel emulator\n", .{});
+            return error.PtyOpenFailed;
+        }
+        const master: linux.fd_t = @intCast(signed);
+        errdefer _ = linux.close(master);
+
+        var unlock: c_int = 0;
+        if (@as(isize, @bitCast(linux.ioctl(master, linux.T.IOCSPTLCK, @intFromPtr(&unlock)))) < 0) {
+            return error.PtyUnlockFailed;
+        }
+        var pty_number: c_uint = 0;
+        if (@as(isize, @bitCast(linux.ioctl(master, linux.T.IOCGPTN, @intFromPtr(&pty_number)))) < 0) {
+            return error.PtyNameFailed;
+        }
+
+        // Raw from the start, so nothing is echoed back as a bogus "reply" in
+        // the window before `SerialPort.configure` gets to the slave.
+        var termios: linux.termios = undefined;
+        if (linux.tcgetattr(master, &termios) == 0) {
+            termios.lflag = .{};
+            termios.oflag = .{};
+            termios.iflag = .{};
+            _ = linux.tcsetattr(master, linux.TCSA.NOW, &termios);
+        }
+
+        var self: Emulator = .{ .io = io, .options = options, .master = master };
+        const path = std.fmt.bufPrint(&self.slave_path_buf, "/dev/pts/{d}", .{pty_number}) catch unreachable;
+        self.slave_path_len = path.len;
+        return self;
+    }
+
+    /// What to hand `serial.SerialPort.open` in place of `/dev/ttyUSB0`.
+    pub fn slavePath(self: *const Emulator) []const u8 {
+        return self.slave_path_buf[0..self.slave_path_len];
+    }
+
+    /// Start answering. `self` must not move afterwards.
+    pub fn start(self: *Emulator) !void {
+        self.thread = try std.Thread.spawn(.{}, run, .{self});
+        std.log.info(
+            "Panel emulator on {s}: latency {d}+/-{d} ms, drop {d:.1}%, {d} baud\n",
+            .{
+                self.slavePath(),
+                self.options.reply_latency_ms,
+                self.options.reply_jitter_ms,
+                self.options.drop_rate * 100,
+                self.options.baud,
+            },
+        );
+    }
+
+    pub fn close(self: *Emulator) void {
+        self.stop.store(true, .release);
+        if (self.thread) |t| t.join();
+        self.thread = null;
+        _ = linux.close(self.master);
+    }
+
+    /// A copy of what the panel is showing, and its version.
+    pub fn snapshot(self: *Emulator) struct { Framebuffer, u64 } {
+        self.acquire();
+        defer self.release();
+        return .{ self.screen, self.screen_version };
+    }
+
+    fn acquire(self: *Emulator) void {
+        while (self.guard.cmpxchgWeak(false, true, .acquire, .monotonic) != null) {
+            std.atomic.spinLoopHint();
+        }
+    }
+
+    fn release(self: *Emulator) void {
+        self.guard.store(false, .release);
+    }
+
+    fn nowMicros(self: *const Emulator) i64 {
+        return @intCast(@divFloor(time.nowNanos(self.io), std.time.ns_per_us));
+    }
+
+    fn run(self: *Emulator) void {
+        var parser: FrameParser = .{};
+        var prng = std.Random.DefaultPrng.init(self.options.seed);
+        const random = prng.random();
+        const byte_us = wireMicros(1, self.options.baud);
+        // When the last byte read so far would have finished arriving on a
+        // real line. Bytes that arrive while the "line" is still busy queue
+        // behind it, as they would in the adapter's transmit buffer.
+        var wire_free_us: i64 = 0;
+        // Replies are written when they fall due, between reads, so the
+        // thread never sleeps through input the way a panel busy with one
+        // frame still takes in the next.
+        var queue: InputQueue = .{ .capacity_bytes = self.options.input_buffer_bytes };
+
+        var buf: [256]u8 = undefined;
+        while (!self.stop.load(.acquire)) {
+            const now_us = self.nowMicros();
+            while (queue.step(now_us)) |step| self.handleStep(step);
+
+            var timeout_ms: i32 = POLL_SLICE_MS;
+            if (queue.nextDueUs()) |due_us| {
+                const wait_ms = std.math.divCeil(i64, @max(due_us - now_us, 0), std.time.us_per_ms) catch 0;
+                timeout_ms = @intCast(@min(wait_ms, POLL_SLICE_MS));
+            }
+            var poll_fd = linux.pollfd{
+                .fd = self.master,
+                .events = linux.POLL.IN,
+                .revents = 0,
+            };
+            const poll_result: isize = @bitCast(linux.poll(@ptrCast(&poll_fd), 1, timeout_ms));
+            if (poll_result <= 0) continue;
+            if (poll_fd.revents & linux.POLL.IN == 0) {
+                // POLLHUP: nothing has the slave open (yet, or any more).
+                // Poll reports that immediately and forever, so wait here
+                // rather than spin -- no longer than the next reply is due.
+                self.io.sleep(.fromMilliseconds(@max(timeout_ms, 1)), .awake) catch return;
+                continue;
+            }
+            const read_result: isize = @bitCast(linux.read(self.master, &buf, buf.len));
+            if (read_result <= 0) continue;
+            const chunk = buf[0..@intCast(read_result)];
+            _ = self.stats.bytes_received.fetchAdd(chunk.len, .monotonic);
+
+            const arrived_us = self.nowMicros();
+            for (chunk) |byte| {
+                wire_free_us = @max(wire_free_us, arrived_us) + byte_us;
+                const event = parser.feed(byte) orelse continue;
+                switch (event) {
+                    .frame => |frame| self.arrive(&queue, frame, wire_free_us, random),
+                    else => |e| {
+                        _ = self.stats.frames_rejected.fetchAdd(1, .monotonic);
+                        dbg.print(.serial, "emulator: rejected frame ({s})\n", .{@tagName(e)});
+                    },
+                }
+            }
+        }
+    }
+
+    /// A frame for this panel, or not, whose last byte lands at `landed_us`.
+    fn arrive(self: *Emulator, queue: *InputQueue, frame: Frame, landed_us: i64, random: std.Random) void {
+        const mine = if (frame.group) frame.address == self.options.group else frame.address == self.options.address;
+        if (!mine) return;
+
+        if (self.options.drop_rate > 0 and random.float(f32) < self.options.drop_rate) {
+            _ = self.stats.frames_dropped.fetchAdd(1, .monotonic);
+            return;
+        }
+
+        var delay_ms: i64 = self.options.reply_latency_ms;
+        const jitter: i64 = self.options.reply_jitter_ms;
+        if (jitter > 0) delay_ms += random.intRangeAtMost(i64, -jitter, jitter);
+        if (!queue.push(frame, landed_us, @max(delay_ms, 0) * std.time.us_per_ms)) {
+            _ = self.stats.frames_overflowed.fetchAdd(1, .monotonic);
+            dbg.print(.serial, "emulator: more frames in flight than tracked\n", .{});
+        }
+    }
+
+    fn handleStep(self: *Emulator, step: InputQueue.Step) void {
+        switch (step) {
+            .render => |frame| {
+                if (frame.command == 'D') {
+                    self.acquire();
+                    self.screen.apply(frame.payload());
+                    self.screen_version += 1;
+                    self.release();
+                }
+                _ = self.stats.frames_rendered.fetchAdd(1, .monotonic);
+            },
+            .finish => |frame| if (!frame.group) {
+                // Failure here means the far end closed; the next poll
+                // notices.
+                _ = linux.write(self.master, reply.ptr, reply.len);
+                _ = self.stats.frames_answered.fetchAdd(1, .monotonic);
+            },
+            .overflow => |frame| {
+                _ = self.stats.frames_overflowed.fetchAdd(1, .monotonic);
+                dbg.print(.serial, "emulator: input buffer full, lost a {d}-byte frame\n", .{frame.wire_len});
+            },
+        }
+    }
+};
+
+/// Apply one `--emulate-<knob>=<value>` command-line argument -- shared by
+/// `main` and the benchmark runner. Unknown knobs and bad values
+/// are refused outright rather than ignored: a benchmark quietly run at the
+/// default latency instead of the one asked for produces numbers that look
+/// valid and are not.
+pub fn parseArg(arg: []const u8, options: *Options) !void {
+    const eq = std.mem.indexOfScalar(u8, arg, '=') orelse {
+        std.log.err("{s} needs a value, as {s}=<n>\n", .{ arg, arg });
+        return error.InvalidArgument;
+    };
+    const knob = arg["--emulate-".len..eq];
+    const value = arg[eq + 1 ..];
+    if (std.mem.eql(u8, knob, "latency")) {
+        options.reply_latency_ms = std.fmt.parseInt(u32, value, 10) catch return badArg(arg);
+    } else if (std.mem.eql(u8, knob, "jitter")) {
+        options.reply_jitter_ms = std.fmt.parseInt(u32, value, 10) catch return badArg(arg);
+    } else if (std.mem.eql(u8, knob, "drop")) {
+        // A percentage on the command line, a probability in `Options`.
+        const percent = std.fmt.parseFloat(f32, value) catch return badArg(arg);
+        if (percent < 0 or percent > 100) return badArg(arg);
+        options.drop_rate = percent / 100;
+    } else if (std.mem.eql(u8, knob, "baud")) {
+        options.baud = std.fmt.parseInt(u32, value, 10) catch return badArg(arg);
+    } else if (std.mem.eql(u8, knob, "buffer")) {
+        options.input_buffer_bytes = std.fmt.parseInt(u32, value, 10) catch return badArg(arg);
+    } else {
+        return badArg(arg);
+    }
+}
+
+fn badArg(arg: []const u8) error{InvalidArgument} {
+    std.log.err("Unrecognized emulator option {s}\n", .{arg});
+    return error.InvalidArgument;
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+fn feedAll(parser: *FrameParser, bytes: []const u8) ?Event {
+    var last: ?Event = null;
+    for (bytes) |b| {
+        if (parser.feed(b)) |e| last = e;
+    }
+    return last;
+}
+
+test "the parser accepts exactly what protocol.zig builds" {
+    var builder: protocol.FrameBuilder = undefined;
+    const cmd = try protocol.unitDisplayCmd(&builder, 1, protocol.ESC ++ "1;8C4");
+
+    var parser: FrameParser = .{};
+    const event = feedAll(&parser, cmd).?;
+    const frame = event.frame;
+    try testing.expect(!frame.group);
+    try testing.expectEqual(Check.crc16, frame.check);
+    try testing.expectEqual(@as(u16, 1), frame.address);
+    try testing.expectEqual(@as(u8, 'D'), frame.command);
+    try testing.expectEqualStrings(protocol.ESC ++ "1;8C4", frame.payload);
+    try testing.expectEqual(cmd.len, frame.wire_len);
+}
+
+test "the parser rejects a frame whose CRC does not match" {
+    var builder: protocol.FrameBuilder = undefined;
+    const cmd = try protocol.unitDisplayCmd(&builder, 1, "hello");
+    builder.buf[cmd.len - 6] = 'j';
+
+    var parser: FrameParser = .{};
+    try testing.expectEqual(Event.bad_check, feedAll(&parser, cmd).?);
+}
+
+test "the parser resynchronizes on SOH after a truncated frame" {
+    // Captured on hardware: a frame cut off mid-payload, immediately followed
+    // by a complete flush. The flush must still be recognized.
+    var parser: FrameParser = .{};
+    for ("\x01u0:D\x1b0;0;31;1") |b| try testing.expectEqual(@as(?Event, null), parser.feed(b));
+    try testing.expectEqual(@as(?Event, .truncated), parser.feed(SOH));
+    const frame = feedAll(&parser, "u0:F\r233B").?.frame;
+    try testing.expect(frame.group);
+    try testing.expectEqual(@as(u16, 0), frame.address);
+    try testing.expectEqual(@as(u8, 'F'), frame.command);
+}
+
+test "the parser verifies a checksum-8 trailer" {
+    var builder: protocol.FrameBuilder = .init(protocol.single_chksum, 1, protocol.display_cmd);
+    try builder.append("hi");
+    const framed = builder.finish();
+
+    var parser: FrameParser = .{};
+    const frame = feedAll(&parser, framed).?.frame;
+    try testing.expectEqual(Check.checksum8, frame.check);
+    try testing.expectEqualStrings("hi", frame.payload);
+}
+
+test "the init sequence clears the panel and sets a 20x2 window" {
+    var fb: Framebuffer = .{};
+    fb.apply("junk");
+    fb.apply(protocol.ESC ++ "-g" ++ protocol.ESC ++ "0;3H" ++ protocol.ESC ++ "0i" ++ protocol.ESC ++ "0;0;119;15w" ++ protocol.ESC ++ "-B" ++ protocol.ESC ++ "-b" ++ protocol.FF);
+    try testing.expectEqual(@as(u8, 20), fb.window_cols);
+    try testing.expectEqual(@as(u8, 2), fb.window_lines);
+
+    var out: [str_utils.maxbufsz]u8 = undefined;
+    try testing.expectEqualStrings(" " ** cols, fb.lineText(1, &out));
+}
+
+test "positioned writes land in place and leave the rest of the line alone" {
+    var fb: Framebuffer = .{};
+    fb.apply(protocol.ESC ++ "C" ++ "20:37:13");
+    fb.apply(protocol.ESC ++ "1;8C4");
+    fb.apply(protocol.ESC ++ "2;C" ++ "line two");
+
+    var out: [str_utils.maxbufsz]u8 = undefined;
+    try testing.expectEqualStrings("20:37:14" ++ " " ** 12, fb.lineText(1, &out));
+    try testing.expectEqualStrings("line two" ++ " " ** 12, fb.lineText(2, &out));
+}
+
+test "a DLE pair occupies one column and text past the edge is lost" {
+    var fb: Framebuffer = .{};
+    fb.apply(protocol.ESC ++ "1;19C" ++ "\x10PXYZ");
+
+    var out: [str_utils.maxbufsz]u8 = undefined;
+    try testing.expectEqualStrings(" " ** 18 ++ "\x10PX", fb.lineText(1, &out));
+}
+
+test "wireMicros matches 19200 8N1" {
+    // 35 bytes, the framed full line from `appendChangedColsToFrame`'s doc:
+    // about 18 ms.
+    try testing.expectEqual(@as(i64, 18_229), wireMicros(35, 19200));
+    try testing.expectEqual(@as(i64, 0), wireMicros(35, 0));
+}
+
+fn testFrame(payload: []const u8, wire_len: usize) Frame {
+    return .{ .group = false, .check = .crc16, .address = 1, .command = 'D', .payload = payload, .wire_len = wire_len };
+}
+
+test "frames landing while the panel is busy wait in its buffer, and overflow it" {
+    var queue: InputQueue = .{ .capacity_bytes = 30 };
+    // Four 14-byte frames a millisecond apart, each taking the panel 10 ms.
+    for ([_][]const u8{ "a", "b", "c", "d" }, 1..) |payload, i| {
+        try testing.expect(queue.push(testFrame(payload, 14), 1_000 * @as(i64, @intCast(i)), 10_000));
+    }
+
+    try testing.expectEqual(@as(?InputQueue.Step, null), queue.step(0));
+    try testing.expectEqualStrings("a", queue.step(1_000).?.render.payload());
+    // b and c fit the buffer behind it; d does not.
+    const lost = queue.step(4_000).?.overflow;
+    try testing.expectEqualStrings("d", lost.payload());
+    try testing.expectEqual(@as(?InputQueue.Step, null), queue.step(4_000));
+    try testing.expectEqual(@as(?i64, 11_000), queue.nextDueUs());
+
+    // Each is taken up as the one before is answered.
+    try testing.expectEqualStrings("a", queue.step(11_000).?.finish.payload());
+    try testing.expectEqualStrings("b", queue.step(11_000).?.render.payload());
+    try testing.expectEqualStrings("b", queue.step(30_000).?.finish.payload());
+    try testing.expectEqualStrings("c", queue.step(30_000).?.render.payload());
+    try testing.expectEqualStrings("c", queue.step(31_000).?.finish.payload());
+    try testing.expectEqual(@as(?InputQueue.Step, null), queue.step(40_000));
+    try testing.expectEqual(@as(?i64, null), queue.nextDueUs());
+}
+
+test "a frame landing on an idle panel is taken up whatever its length" {
+    var queue: InputQueue = .{ .capacity_bytes = 30 };
+    try testing.expect(queue.push(testFrame("long", 100), 0, 5_000));
+    try testing.expectEqualStrings("long", queue.step(0).?.render.payload());
+    try testing.expectEqualStrings("long", queue.step(5_000).?.finish.payload());
+}
+
+test "a serial port on the emulator's pty gets frames rendered and answered" {
+    var threaded: Io.Threaded = .init(testing.allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+
+    var emulator = try Emulator.open(io, .{ .reply_latency_ms = 1 });
+    try emulator.start();
+    defer emulator.close();
+
+    const port = try serial.SerialPort.open(io, emulator.slavePath(), testing.allocator);
+    defer port.close(testing.allocator);
+
+    try testing.expect(try protocol.sendUnitDisplayCmd(port, 1, protocol.ESC ++ "1;1C" ++ "hello"));
+    // Another unit's frame is neither rendered nor answered.
+    var builder: protocol.FrameBuilder = undefined;
+    const other = try protocol.unitDisplayCmd(&builder, 2, protocol.ESC ++ "1;1C" ++ "nope");
+    try port.write(other);
+    // Frames are taken in order, so once this one is answered the emulator
+    // has been through the other unit's too.
+    try testing.expect(try protocol.sendUnitDisplayCmd(port, 1, protocol.ESC ++ "2;1C" ++ "world"));
+
+    const screen, const version = emulator.snapshot();
+    var out: [str_utils.maxbufsz]u8 = undefined;
+    try testing.expectEqualStrings("hello" ++ " " ** 15, screen.lineText(1, &out));
+    try testing.expectEqualStrings("world" ++ " " ** 15, screen.lineText(2, &out));
+    try testing.expectEqual(@as(u64, 2), version);
+    try testing.expectEqual(@as(u64, 2), emulator.stats.frames_answered.load(.monotonic));
+}
+
+test "parseArg takes the drop rate as a percentage and refuses unknown knobs" {
+    var options: Options = .{};
+    try parseArg("--emulate-latency=40", &options);
+    try parseArg("--emulate-drop=2.5", &options);
+    try testing.expectEqual(@as(u32, 40), options.reply_latency_ms);
+    try testing.expectApproxEqAbs(@as(f32, 0.025), options.drop_rate, 1e-6);
+
+    try testing.expectError(error.InvalidArgument, parseArg("--emulate-latency", &options));
+    try testing.expectError(error.InvalidArgument, parseArg("--emulate-speed=9", &options));
+    try testing.expectError(error.InvalidArgument, parseArg("--emulate-drop=150", &options));
+}
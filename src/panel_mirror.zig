@@ -0,0 +1,76 @@
+//! How the web server learns a panel has confirmed a new frame, without the
+//! render sender that saw the confirmation ever waiting on the web server.
+//!
+//! What the panel shows is published by each sender to its port's `shown`
+//! cell (`serial.SerialPort.shown`), or in `panels` mode by the bus scheduler
+//! to each unit's (`bus.Unit.showing`), which never waits on a reader. What is
+//! missing is the wake: the web server sleeps in `poll` on its sockets, and a
+//! `cell.Cell`'s futex `Event` is not something `poll` can watch. So a sender
+//! also bumps an eventfd here, which the server polls alongside its sockets
+//! and, once woken, reads each port's cell itself. The write never blocks --
+//! the counter would need 2^64 frames to fill -- and is skipped altogether
+//! while nobody is watching, so with no browser on `/api/panel/events` a
+//! confirmed frame costs the sender one atomic load and nothing else.
+
+const std = @import("std");
+const linux = std.os.linux;
+
+/// The eventfd, -1 until `open`. Set before any sender starts and cleared
+/// after the last has stopped, so read without synchronization.
+var wake_fd: linux.fd_t = -1;
+
+/// How many clients are watching -- kept up to date by the web server.
+var watchers: std.atomic.Value(u32) = .init(0);
+
+/// Create the eventfd, for the web server to poll. Call before any thread
+/// that calls `notify` starts.
+pub fn open() !linux.fd_t {
+    const rc = linux.eventfd(0, linux.EFD.CLOEXEC | linux.EFD.NONBLOCK);
+    if (linux.errno(rc) != .SUCCESS) return error.EventFdUnavailable;
+    wake_fd = @intCast(rc);
+    return wake_fd;
+}
+
+/// Only once every thread that calls `notify` has stopped.
+pub fn close() void {
+    if (wake_fd >= 0) _ = linux.close(wake_fd);
+    wake_fd = -1;
+}
+
+pub fn setWatchers(count: u32) void {
+    watchers.store(count, .release);
+}
+
+/// A port's `shown` cell has just been published: wake the web server, if
+/// anyone is watching. Safe from any thread, and never waits.
+pub fn notify() void {
+    if (wake_fd < 0 or watchers.load(.acquire) == 0) return;
+    const one: u64 = 1;
+    _ = linux.write(wake_fd, std.mem.asBytes(&one), @sizeOf(u64));
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+test "a notify wakes the poller only while someone is watching" {
+    const fd = try open();
+    defer close();
+    defer setWatchers(0);
+
+    var pfd = [1]linux.pollfd{.{ .fd = fd, .events = linux.POLL.IN, .revents = 0 }};
+    notify();
+    try testing.expectEqual(@as(usize, 0), linux.poll(&pfd, 1, 0));
+
+    setWatchers(1);
+    notify();
+    notify();
+    try testing.expectEqual(@as(usize, 1), linux.poll(&pfd, 1, 0));
+    // One read takes every notify since the last, as the web server's does.
+    var count: u64 = undefined;
+    _ = linux.read(fd, std.mem.asBytes(&count), @sizeOf(u64));
+    try testing.expectEqual(@as(u64, 2), count);
+    try testing.expectEqual(@as(usize, 0), linux.poll(&pfd, 1, 0));
+}
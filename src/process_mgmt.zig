@@ -1,5 +1,6 @@
 const std = @import("std");
 const dbg = @import("debug_log.zig");
+const flight_recorder = @import("flight_recorder.zig");
 const Io = std.Io;
 
 const PID_FILE_PATH = "/tmp/zig_vorne_m1000.pid";
@@ -13,6 +14,12 @@ fn signalHandler(sig: std.os.linux.SIG) callconv(.c) void {
     requestShutdown();
 }
 
+/// `SIGUSR1`: dump the flight recorder to the log -- see `flight_recorder.zig`.
+fn dumpSignalHandler(sig: std.os.linux.SIG) callconv(.c) void {
+    _ = sig;
+    flight_recorder.requestDump();
+}
+
 /// Manual shutdown trigger (can be called by signal handlers or other mechanisms)
 pub fn requestShutdown() void {
     should_shutdown.store(true, .release);
@@ -65,6 +72,13 @@ pub fn setup() !void {
 
     _ = std.os.linux.sigaction(.TERM, &sa, null);
     _ = std.os.linux.sigaction(.INT, &sa, null);
+
+    var dump_sa = std.os.linux.Sigaction{
+        .handler = .{ .handler = dumpSignalHandler },
+        .mask = std.os.linux.sigemptyset(),
+        .flags = std.os.linux.SA.RESTART,
+    };
+    _ = std.os.linux.sigaction(.USR1, &dump_sa, null);
 }
 
 /// Check for existing instance and handle it
@@ -1,7 +1,7 @@
 const std = @import("std");
-const dbg = @import("debug_log.zig");
 const serial = @import("serial.zig");
 const str_utils = @import("str_utils.zig");
+const transport = @import("transport.zig");
 const vorne_charset = @import("vorne_charset.zig");
 
 const maxbufsz = str_utils.maxbufsz;
@@ -26,10 +26,12 @@ pub const group_nochk = SOH ++ "s";
 pub const group_chksum = SOH ++ "t";
 pub const group_crc16 = SOH ++ "u";
 
-pub const timeout_ms: u32 = 2000;
+/// The longest `send` ever waits for a reply. Usually far less: see
+/// `transport.zig` for how the wait adapts to the panel.
+pub const timeout_ms: u32 = transport.default_max_timeout_ms;
 
-/// Send a command and wait for the panel's reply, up to `timeout_ms`. Returns
-/// whether a reply actually arrived.
+/// Send a command and wait for the panel's reply to it. Returns whether a
+/// reply actually arrived.
 ///
 /// This is the pacing mechanism between commands, and deliberately not a
 /// fixed delay. The panel has no flow control and a small input buffer, so a
@@ -41,10 +43,13 @@ pub const timeout_ms: u32 = 2000;
 /// (the initialisation sequence, which clears the screen and sets the display
 /// window, most of all) is not raced.
 ///
-/// Nothing here interprets the reply's *content* -- only its arrival matters.
-/// `timeout_ms` (2 s) bounds the wait for the case where the panel does not
-/// answer at all, so a disconnected or wedged unit cannot hang this call
-/// forever; on that path a diagnostic is worth logging; `try port.write`
+/// The port's `transport.Transport` matches the reply to this frame and
+/// bounds the wait by an adaptive timeout -- a few times the panel's recent
+/// turnaround, never more than `timeout_ms` -- so a disconnected or wedged
+/// unit cannot hang this call, and a single lost reply costs tens of
+/// milliseconds rather than two seconds. This is the stop-and-wait form; a
+/// caller that can keep several frames in flight submits to the transport
+/// directly, as `render.zig`'s `senderLoop` does. `try port.write`
 /// still propagates a genuine write failure (a short or failed send, or the
 /// port itself timing out -- see `SerialPort.write`), which is a different
 /// and more serious condition than the unit simply not replying.
@@ -52,7 +57,7 @@ pub const timeout_ms: u32 = 2000;
 /// The `bool` -- not folded into an error -- is what lets a timeout stay a
 /// non-fatal outcome for most callers (they simply discard it, unchanged from
 /// when this returned `!void`) while still letting a caller that keeps a
-/// "what has the panel actually been shown" record, like `bluray.zig`'s
+/// "what has the panel actually been shown" record, like `render.zig`'s
 /// `senderLoop`, tell a confirmed send apart from an unconfirmed one. Before
 /// this returned the distinction, *every* successful call to `port.write`
 /// looked identical to a caller regardless of whether the panel ever actually
@@ -67,246 +72,228 @@ pub const timeout_ms: u32 = 2000;
 /// reads exactly like a bug in the column-diffing itself, but the diffing was
 /// always correct; it was being fed a premise that wasn't true.
 pub fn send(port: *serial.SerialPort, msg: []const u8) !bool {
-    try port.write(msg);
-
-    var buffer: [128]u8 = undefined;
-    const received = port.readWithTimeout(&buffer, timeout_ms) catch |err| switch (err) {
-        error.PollError => {
-            dbg.print(.serial, "Error polling for a reply.\n", .{});
-            return false;
-        },
-    };
-    if (received == 0) {
-        dbg.print(.serial, "No response after {d} ms.\n", .{timeout_ms});
-        return false;
-    }
-    return true;
+    return port.transport.roundTrip(msg);
+}
+
+/// `send` for a frame the panel takes longer over than drawing text -- the
+/// init sequence, a flush. Its reply is waited for at least
+/// `transport.slow_min_timeout_ms`, however quick the panel has been with
+/// text, so that it is not given up on while the panel is still busy with
+/// it (see "Timing out" in `transport.zig`).
+pub fn sendSlow(port: *serial.SerialPort, msg: []const u8) !bool {
+    return port.transport.roundTripAtLeast(msg, transport.slow_min_timeout_ms);
+}
+
+/// Send a group frame. Nothing answers one, so nothing is waited for beyond
+/// the transport's window.
+pub fn broadcast(port: *serial.SerialPort, msg: []const u8) !void {
+    try port.transport.broadcast(msg);
 }
 
-pub fn sendVerbose(port: *serial.SerialPort, address: u8, msg: []const u8, allocator: std.mem.Allocator) !void {
-    try port.write(msg);
+/// Longest frame this module will build: SOH through trailer. A full two-line
+/// redraw of DLE-heavy text is a little over 100 bytes, and nothing else this
+/// program sends comes close.
+pub const max_frame_len = 256;
 
-    // Print hex representation to see actual bytes. A successful write() now
-    // always means the whole message went out -- see its own doc -- so the
-    // count is just msg.len, not something read back from the write itself.
-    dbg.print(.serial, "Sent {d} bytes to address {d}: ", .{ msg.len, address });
+/// Room kept back for the `CR` and the longest trailer (four hex digits), so
+/// that once a payload has been accepted, `finish` cannot fail.
+const trailer_reserve = 1 + 4;
 
-    for (msg) |byte| {
-        dbg.print(.serial, "{X:0>2} ", .{byte});
+/// Builds one SPP frame, in place, in a fixed buffer the caller owns -- on its
+/// stack, usually.
+///
+/// Every frame used to be assembled by `genCmdStr` (an `ArrayList` and a
+/// `toOwnedSlice`), copied again by `appendCrc16` to make room for the
+/// trailer, and freed by the caller: three heap operations per frame, on the
+/// render path, against `main`'s `page_allocator` -- where each of them can
+/// be an mmap or munmap. None of it was needed: a frame has a hard upper size
+/// and a lifetime of exactly one `send`.
+///
+/// The trailer is accumulated as bytes are appended, so building a frame is a
+/// single pass over it: header, payload, `CR`, trailer, with no second walk
+/// to checksum what was just written. Which trailer is determined by the
+/// packet type, as on the wire (`U`/`u` CRC16, `T`/`t` checksum-8, `S`/`s`
+/// none).
+pub const FrameBuilder = struct {
+    buf: [max_frame_len]u8 = undefined,
+    len: usize = 0,
+    /// Where the payload starts, just past `:D`/`:F`.
+    payload_start: usize = 0,
+    trailer: Trailer = .crc16,
+    crc: u16 = 0,
+    sum: u8 = 0,
+    /// The running trailer state at `payload_start`, so `resetPayload` can
+    /// rewind without re-walking the header.
+    header_crc: u16 = 0,
+    header_sum: u8 = 0,
+
+    pub const Trailer = enum { none, checksum8, crc16 };
+
+    /// Start a frame: `packet` is one of `single_crc16` .. `group_nochk`,
+    /// `command` is `display_cmd` or `flush_cmd`.
+    pub fn init(packet: []const u8, address: u8, command: []const u8) FrameBuilder {
+        var self: FrameBuilder = .{
+            .trailer = switch (packet[1]) {
+                'S', 's' => .none,
+                'T', 't' => .checksum8,
+                else => .crc16,
+            },
+        };
+        var digits: [3]u8 = undefined;
+        const addr_str = std.fmt.bufPrint(&digits, "{d}", .{address}) catch unreachable;
+        // A header is at most 7 bytes; it always fits.
+        self.append(packet) catch unreachable;
+        self.append(addr_str) catch unreachable;
+        self.append(command) catch unreachable;
+        self.payload_start = self.len;
+        self.header_crc = self.crc;
+        self.header_sum = self.sum;
+        return self;
     }
-    dbg.print(.serial, "\n", .{});
-
-    // Also print string with escaped characters shown
-    const escaped_msg = try formatWithControlChars(allocator, msg);
-    defer allocator.free(escaped_msg);
-    dbg.print(.serial, "Message: {s}\n", .{escaped_msg});
-
-    var buffer: [128]u8 = undefined;
-    const received = port.readWithTimeout(&buffer, timeout_ms) catch |err| switch (err) {
-        error.PollError => {
-            std.debug.print("Error polling for data.\n", .{});
-            return;
-        },
-    };
-
-    if (received > 0) {
-        const recvbuf = try formatWithControlChars(allocator, buffer[0..received]);
-        dbg.print(.serial, "Received {d} bytes: {s}\n", .{ received, recvbuf });
-    } else {
-        const timeout_seconds: f64 = @as(f64, @floatFromInt(timeout_ms)) / 1000.0;
-        dbg.print(.serial, "No response (timeout after {d:.3} seconds).\n", .{timeout_seconds});
+
+    /// Append payload bytes. Fails, appending nothing, if the frame would
+    /// no longer fit.
+    pub fn append(self: *FrameBuilder, bytes: []const u8) error{FrameTooLong}!void {
+        if (self.len + bytes.len + trailer_reserve > max_frame_len) return error.FrameTooLong;
+        @memcpy(self.buf[self.len..][0..bytes.len], bytes);
+        self.absorb(bytes.len);
     }
-}
 
-pub fn genCmdStr(
-    allocator: std.mem.Allocator,
-    addr_cmd: []const u8,
-    address: u8,
-    type_cmd: []const u8,
-    data_no_cr: ?[]const u8,
-) ![]u8 {
-    var buf: [3]u8 = undefined;
-    const addr_str = std.fmt.bufPrint(&buf, "{d}", .{address}) catch unreachable;
-
-    // Build the command string dynamically
-    var cmd_parts = std.ArrayList(u8).empty;
-    defer cmd_parts.deinit(allocator);
-
-    try cmd_parts.appendSlice(allocator, addr_cmd);
-    try cmd_parts.appendSlice(allocator, addr_str);
-    try cmd_parts.appendSlice(allocator, type_cmd);
-    if (data_no_cr) |data| {
-        if (data.len > 0) {
-            try cmd_parts.appendSlice(allocator, data);
+    /// Append formatted payload, written straight into the frame.
+    pub fn print(self: *FrameBuilder, comptime fmt: []const u8, args: anytype) error{FrameTooLong}!void {
+        const out = std.fmt.bufPrint(self.buf[self.len .. max_frame_len - trailer_reserve], fmt, args) catch
+            return error.FrameTooLong;
+        self.absorb(out.len);
+    }
+
+    /// Fold the `n` bytes just written at `len` into the trailer state.
+    fn absorb(self: *FrameBuilder, n: usize) void {
+        for (self.buf[self.len..][0..n]) |b| {
+            self.crc = crc16Step(self.crc, b);
+            self.sum +%= b;
+        }
+        self.len += n;
+    }
+
+    /// The payload appended so far.
+    pub fn payload(self: *const FrameBuilder) []const u8 {
+        return self.buf[self.payload_start..self.len];
+    }
+
+    /// Discard the payload, keeping the header, to build another frame to
+    /// the same address.
+    pub fn resetPayload(self: *FrameBuilder) void {
+        self.len = self.payload_start;
+        self.crc = self.header_crc;
+        self.sum = self.header_sum;
+    }
+
+    /// Terminate the frame and return it, ready for `send`. Space for this
+    /// was reserved by every append, so it cannot fail.
+    pub fn finish(self: *FrameBuilder) []const u8 {
+        self.buf[self.len] = CR[0];
+        self.absorb(1);
+        switch (self.trailer) {
+            .none => {},
+            .checksum8 => {
+                const checksum = (~self.sum) +% 1; // Two's complement
+                _ = std.fmt.bufPrint(self.buf[self.len..][0..2], "{X:0>2}", .{checksum}) catch unreachable;
+                self.len += 2;
+            },
+            .crc16 => {
+                _ = std.fmt.bufPrint(self.buf[self.len..][0..4], "{X:0>4}", .{self.crc}) catch unreachable;
+                self.len += 4;
+            },
         }
+        return self.buf[0..self.len];
     }
-    try cmd_parts.appendSlice(allocator, CR);
+};
 
-    return try cmd_parts.toOwnedSlice(allocator);
+/// Finish `frame` and send it -- see `send`.
+pub fn sendFrame(port: *serial.SerialPort, frame: *FrameBuilder) !bool {
+    return send(port, frame.finish());
 }
 
 // Generate single flush command
-pub fn unitFlushCmd(
-    allocator: std.mem.Allocator,
-    address: u8,
-) ![]u8 {
-    const cmd = try genCmdStr(allocator, single_crc16, address, flush_cmd, null);
-    defer allocator.free(cmd);
-    return appendCrc16(allocator, cmd);
+pub fn unitFlushCmd(frame: *FrameBuilder, address: u8) []const u8 {
+    frame.* = .init(single_crc16, address, flush_cmd);
+    return frame.finish();
 }
 
-pub fn sendUnitFlushCmd(
-    allocator: std.mem.Allocator,
-    port: *serial.SerialPort,
-    address: u8,
-) !void {
-    const cmd = try unitFlushCmd(allocator, address);
-    defer allocator.free(cmd);
+pub fn sendUnitFlushCmd(port: *serial.SerialPort, address: u8) !void {
+    var frame: FrameBuilder = undefined;
     // Whether the panel confirmed this one doesn't matter here -- a flush
     // command has nothing to diff against on the next pass.
-    _ = try send(port, cmd);
-    // sendVerbose(port, address, cmd, allocator) catch |err| {
-    //     std.debug.print("Failed to send flush command: {}\n", .{err});
-    //     return err;
-    // };
+    _ = try sendSlow(port, unitFlushCmd(&frame, address));
 }
 
 // Generate group flush command
-pub fn grpFlushCmd(
-    allocator: std.mem.Allocator,
-    address: u8,
-) ![]u8 {
-    const cmd = try genCmdStr(allocator, group_crc16, address, flush_cmd, null);
-    defer allocator.free(cmd);
-    return appendCrc16(allocator, cmd);
+pub fn grpFlushCmd(frame: *FrameBuilder, address: u8) []const u8 {
+    frame.* = .init(group_crc16, address, flush_cmd);
+    return frame.finish();
 }
 
-pub fn sendGrpFlushCmd(
-    allocator: std.mem.Allocator,
-    port: *serial.SerialPort,
-    address: u8,
-) !void {
-    const cmd = try grpFlushCmd(allocator, address);
-    defer allocator.free(cmd);
-    _ = try send(port, cmd);
-    // sendVerbose(port, address, cmd, allocator) catch |err| {
-    //     std.debug.print("Failed to send group flush command: {}\n", .{err});
-    //     return err;
-    // };
+pub fn sendGrpFlushCmd(port: *serial.SerialPort, address: u8) !void {
+    var frame: FrameBuilder = undefined;
+    try broadcast(port, grpFlushCmd(&frame, address));
 }
 
-// Generate group display command
-pub fn unitDisplayCmd(
-    allocator: std.mem.Allocator,
-    address: u8,
-    input_no_cr: []const u8,
-) ![]u8 {
-    const cmd = try genCmdStr(allocator, single_crc16, address, display_cmd, input_no_cr);
-    defer allocator.free(cmd);
-    return appendCrc16(allocator, cmd);
-}
-
-/// Returns whether the panel actually confirmed the frame -- see `send`'s
-/// doc. Most callers (the ones with nothing to diff against, like the
-/// startup/mode-entry init or `clocks.zig`'s fire-and-forget style) can
-/// discard it exactly as if this still returned `!void`; `bluray.zig`'s
-/// `senderLoop` is the one caller that must not, since it is the one caller
-/// that keeps a "what has the panel actually been shown" record.
-pub fn sendUnitDisplayCmd(
-    allocator: std.mem.Allocator,
-    port: *serial.SerialPort,
-    address: u8,
-    input_no_cr: []const u8,
-) !bool {
-    const cmd = try unitDisplayCmd(allocator, address, input_no_cr);
-    defer allocator.free(cmd);
-    return send(port, cmd);
-    // sendVerbose(port, address, cmd, allocator) catch |err| {
-    //     std.debug.print("Failed to send display command: {}\n", .{err});
-    //     return err;
-    // };
+// Generate single display command
+pub fn unitDisplayCmd(frame: *FrameBuilder, address: u8, input_no_cr: []const u8) ![]const u8 {
+    frame.* = .init(single_crc16, address, display_cmd);
+    try frame.append(input_no_cr);
+    return frame.finish();
+}
+
+/// Returns whether the panel actually confirmed the frame (see `send`'s doc),
+/// which a caller keeping no record of what the panel shows, like the
+/// startup and mode-entry init, can discard.
+pub fn sendUnitDisplayCmd(port: *serial.SerialPort, address: u8, input_no_cr: []const u8) !bool {
+    var frame: FrameBuilder = undefined;
+    return send(port, try unitDisplayCmd(&frame, address, input_no_cr));
 }
 
 // Generate group display command
-pub fn grpDisplayCmd(
-    allocator: std.mem.Allocator,
-    address: u8,
-    input_no_cr: []const u8,
-) ![]u8 {
-    const cmd = try genCmdStr(allocator, group_crc16, address, display_cmd, input_no_cr);
-    defer allocator.free(cmd);
-    return appendCrc16(allocator, cmd);
+pub fn grpDisplayCmd(frame: *FrameBuilder, address: u8, input_no_cr: []const u8) ![]const u8 {
+    frame.* = .init(group_crc16, address, display_cmd);
+    try frame.append(input_no_cr);
+    return frame.finish();
 }
 
-pub fn sendGrpDisplayCmd(
-    allocator: std.mem.Allocator,
-    port: *serial.SerialPort,
-    address: u8,
-    input_no_cr: []const u8,
-) !void {
-    const cmd = try grpDisplayCmd(allocator, address, input_no_cr);
-    defer allocator.free(cmd);
-    _ = try send(port, cmd);
-    // sendVerbose(port, address, cmd, allocator) catch |err| {
-    //     std.debug.print("Failed to send group display command: {}\n", .{err});
-    //     return err;
-    // };
+pub fn sendGrpDisplayCmd(port: *serial.SerialPort, address: u8, input_no_cr: []const u8) !void {
+    var frame: FrameBuilder = undefined;
+    try broadcast(port, try grpDisplayCmd(&frame, address, input_no_cr));
 }
 
-pub fn unitDefaultInitCmd(
-    allocator: std.mem.Allocator,
-    address: u8,
-) ![]u8 {
-    return unitDisplayCmd(allocator, address, ESC ++ "-g" ++ ESC ++ "0;3H" ++ ESC ++ "0i" ++ ESC ++ "0;0;119;15w" ++ ESC ++ "-B" ++ ESC ++ "-b" ++ FF);
+const default_init_payload = ESC ++ "-g" ++ ESC ++ "0;3H" ++ ESC ++ "0i" ++ ESC ++ "0;0;119;15w" ++ ESC ++ "-B" ++ ESC ++ "-b" ++ FF;
+
+pub fn unitDefaultInitCmd(frame: *FrameBuilder, address: u8) []const u8 {
+    return unitDisplayCmd(frame, address, default_init_payload) catch unreachable;
 }
 
-pub fn sendUnitDefaultInitCmd(
-    allocator: std.mem.Allocator,
-    port: *serial.SerialPort,
-    address: u8,
-) !void {
-    const cmd = try unitDefaultInitCmd(allocator, address);
-    defer allocator.free(cmd);
-    _ = try send(port, cmd);
-    // sendVerbose(port, address, cmd, allocator) catch |err| {
-    //     std.debug.print("Failed to send clear command: {}\n", .{err});
-    //     return err;
-    // };
+pub fn sendUnitDefaultInitCmd(port: *serial.SerialPort, address: u8) !void {
+    var frame: FrameBuilder = undefined;
+    _ = try sendSlow(port, unitDefaultInitCmd(&frame, address));
 }
 
-pub fn grpDefaultInitCmd(
-    allocator: std.mem.Allocator,
-    address: u8,
-) ![]u8 {
-    return grpDisplayCmd(allocator, address, ESC ++ "-g" ++ ESC ++ "0;3H" ++ ESC ++ "0i" ++ ESC ++ "0;0;119;15w" ++ ESC ++ "-B" ++ ESC ++ "-b" ++ FF);
+pub fn grpDefaultInitCmd(frame: *FrameBuilder, address: u8) []const u8 {
+    return grpDisplayCmd(frame, address, default_init_payload) catch unreachable;
 }
 
-pub fn sendGrpDefaultInitCmd(
-    allocator: std.mem.Allocator,
-    port: *serial.SerialPort,
-    address: u8,
-) !void {
-    const cmd = try grpDefaultInitCmd(allocator, address);
-    defer allocator.free(cmd);
-    _ = try send(port, cmd);
-    // sendVerbose(port, address, cmd, allocator) catch |err| {
-    //     std.debug.print("Failed to send group clear command: {}\n", .{err});
-    //     return err;
-    // };
-}
-
-pub fn appendStrToCmdList(
-    allocator: std.mem.Allocator,
-    cmd_parts: *std.ArrayList(u8),
+pub fn sendGrpDefaultInitCmd(port: *serial.SerialPort, address: u8) !void {
+    var frame: FrameBuilder = undefined;
+    try broadcast(port, grpDefaultInitCmd(&frame, address));
+}
+
+pub fn appendStrToFrame(
+    frame: *FrameBuilder,
     line: u8,
     column: u8,
     text: []const u8,
 ) !void {
-    var line_buf: [2 * maxbufsz]u8 = undefined;
     // Trim null characters from the text if present
     const trimmed_text = std.mem.sliceTo(text, 0);
-    const line_cmd = std.fmt.bufPrint(&line_buf, "{s}{d};{d}C{s}", .{ ESC, line, column, trimmed_text }) catch unreachable;
-    try cmd_parts.appendSlice(allocator, line_cmd);
+    try frame.print("{s}{d};{d}C{s}", .{ ESC, line, column, trimmed_text });
 }
 
 /// Append only the columns that actually differ between `prev` and `next`.
@@ -336,9 +323,8 @@ pub fn appendStrToCmdList(
 /// Falls back to a whole-line write when the two differ in width, since there
 /// is then no column-for-column correspondence to diff. Appends nothing at all
 /// when they are identical.
-pub fn appendChangedColsToCmdList(
-    allocator: std.mem.Allocator,
-    cmd_parts: *std.ArrayList(u8),
+pub fn appendChangedColsToFrame(
+    frame: *FrameBuilder,
     line: u8,
     prev: []const u8,
     next: []const u8,
@@ -346,7 +332,7 @@ pub fn appendChangedColsToCmdList(
     const prev_cols = (str_utils.strlensz(prev) catch unreachable)[0];
     const next_cols = (str_utils.strlensz(next) catch unreachable)[0];
     if (prev_cols != next_cols) {
-        return appendStrToCmdList(allocator, cmd_parts, line, 1, next);
+        return appendStrToFrame(frame, line, 1, next);
     }
 
     var first: ?usize = null;
@@ -367,7 +353,7 @@ pub fn appendChangedColsToCmdList(
     const start = str_utils.idxChar2Str(next, from) catch unreachable;
     const end = str_utils.idxChar2Str(next, last + 1) catch unreachable;
     // Columns are 1-based in the escape sequence.
-    try appendStrToCmdList(allocator, cmd_parts, line, @intCast(from + 1), next[start..end]);
+    try appendStrToFrame(frame, line, @intCast(from + 1), next[start..end]);
 }
 
 // Update a single character at specified line and column
@@ -381,7 +367,6 @@ pub fn unitUpdateChar(
 }
 
 pub fn sendUnitUpdateChar(
-    allocator: std.mem.Allocator,
     port: *serial.SerialPort,
     address: u8,
     line: u8,
@@ -390,167 +375,167 @@ pub fn sendUnitUpdateChar(
 ) !void {
     // Build the command string: "<ESC><line>;<col>C<newchar>"
     var cmd_buf: [2 * maxbufsz]u8 = undefined;
-    const update_cmd = unitUpdateChar(&cmd_buf, line, column, new_char);
+    const update_cmd = try unitUpdateChar(&cmd_buf, line, column, new_char);
 
     // Send the command using unitDisplayCmd
-    _ = try sendUnitDisplayCmd(allocator, port, address, update_cmd);
+    _ = try sendUnitDisplayCmd(port, address, update_cmd);
 }
 
-test "appendChangedColsToCmdList sends only the digits a clock tick moved" {
+test "appendChangedColsToFrame sends only the digits a clock tick moved" {
     const testing = std.testing;
-    var parts = std.ArrayList(u8).empty;
-    defer parts.deinit(testing.allocator);
+    var frame: FrameBuilder = .init(single_crc16, 1, display_cmd);
 
     // The overwhelmingly common case: one seconds digit. Redrawing the line
     // would be 20 columns of payload; this is one.
-    try appendChangedColsToCmdList(testing.allocator, &parts, 1, "20:37:13", "20:37:14");
-    try testing.expectEqualStrings(ESC ++ "1;8C4", parts.items);
+    try appendChangedColsToFrame(&frame, 1, "20:37:13", "20:37:14");
+    try testing.expectEqualStrings(ESC ++ "1;8C4", frame.payload());
 }
 
-test "appendChangedColsToCmdList spans from the first change to the last" {
+test "appendChangedColsToFrame spans from the first change to the last" {
     const testing = std.testing;
-    var parts = std.ArrayList(u8).empty;
-    defer parts.deinit(testing.allocator);
+    var frame: FrameBuilder = .init(single_crc16, 1, display_cmd);
 
     // A minute rollover moves several digits at once, and the span covers them
     // in one escape rather than one escape per run.
-    try appendChangedColsToCmdList(testing.allocator, &parts, 1, "20:37:59", "20:38:00");
-    try testing.expectEqualStrings(ESC ++ "1;5C8:00", parts.items);
+    try appendChangedColsToFrame(&frame, 1, "20:37:59", "20:38:00");
+    try testing.expectEqualStrings(ESC ++ "1;5C8:00", frame.payload());
 }
 
-test "appendChangedColsToCmdList appends nothing when the line is unchanged" {
+test "appendChangedColsToFrame appends nothing when the line is unchanged" {
     const testing = std.testing;
-    var parts = std.ArrayList(u8).empty;
-    defer parts.deinit(testing.allocator);
+    var frame: FrameBuilder = .init(single_crc16, 1, display_cmd);
 
-    try appendChangedColsToCmdList(testing.allocator, &parts, 1, "20:37:13", "20:37:13");
-    try testing.expectEqual(@as(usize, 0), parts.items.len);
+    try appendChangedColsToFrame(&frame, 1, "20:37:13", "20:37:13");
+    try testing.expectEqual(@as(usize, 0), frame.payload().len);
 }
 
-test "appendChangedColsToCmdList redraws the whole line when the width changes" {
+test "appendChangedColsToFrame redraws the whole line when the width changes" {
     const testing = std.testing;
-    var parts = std.ArrayList(u8).empty;
-    defer parts.deinit(testing.allocator);
+    var frame: FrameBuilder = .init(single_crc16, 1, display_cmd);
 
     // No column-for-column correspondence to diff against, so this must not
     // try to compute a span.
-    try appendChangedColsToCmdList(testing.allocator, &parts, 2, "59:59", "1:00:00");
-    try testing.expectEqualStrings(ESC ++ "2;1C1:00:00", parts.items);
+    try appendChangedColsToFrame(&frame, 2, "59:59", "1:00:00");
+    try testing.expectEqualStrings(ESC ++ "2;1C1:00:00", frame.payload());
 }
 
-test "appendChangedColsToCmdList counts a DLE pair as one column" {
+test "appendChangedColsToFrame counts a DLE pair as one column" {
     const testing = std.testing;
-    var parts = std.ArrayList(u8).empty;
-    defer parts.deinit(testing.allocator);
+    var frame: FrameBuilder = .init(single_crc16, 1, display_cmd);
 
     // "\x10P" and "\x10Q" are one column each (the transport glyph, as line 1
     // carries at its right-hand end). The change is in the last column, column
     // 3 -- not column 4, which is where a byte count would put it, and not a
     // slice that splits the pair.
-    try appendChangedColsToCmdList(testing.allocator, &parts, 1, "AB\x10P", "AB\x10Q");
-    try testing.expectEqualStrings(ESC ++ "1;3C\x10Q", parts.items);
+    try appendChangedColsToFrame(&frame, 1, "AB\x10P", "AB\x10Q");
+    try testing.expectEqualStrings(ESC ++ "1;3C\x10Q", frame.payload());
 }
 
-test "appendChangedColsToCmdList offsets correctly past an earlier DLE pair" {
+test "appendChangedColsToFrame offsets correctly past an earlier DLE pair" {
     const testing = std.testing;
-    var parts = std.ArrayList(u8).empty;
-    defer parts.deinit(testing.allocator);
+    var frame: FrameBuilder = .init(single_crc16, 1, display_cmd);
 
     // The DLE pair sits in column 1, so the changed 'C' is column 3 even
     // though it is byte 3 -- and the payload must not re-send the pair.
-    try appendChangedColsToCmdList(testing.allocator, &parts, 1, "\x10PBC", "\x10PBD");
-    try testing.expectEqualStrings(ESC ++ "1;3CD", parts.items);
-}
-
-// Calculate 8-bit checksum (two's complement) and append as uppercase hex
-pub fn appendChecksum8(allocator: std.mem.Allocator, input: []const u8) ![]u8 {
-    var sum: u8 = 0;
-    for (input) |byte| {
-        sum = sum +% byte; // Wrapping addition to handle overflow
+    try appendChangedColsToFrame(&frame, 1, "\x10PBC", "\x10PBD");
+    try testing.expectEqualStrings(ESC ++ "1;3CD", frame.payload());
+}
+
+/// XMODEM CRC16 (polynomial 0x1021), one byte at a time from a 256-entry
+/// table built at compile time, rather than eight shift-and-test steps per
+/// byte. Every byte of every frame goes through this.
+const crc16_table: [256]u16 = blk: {
+    @setEvalBranchQuota(256 * 8 * 4);
+    var table: [256]u16 = undefined;
+    for (&table, 0..) |*entry, i| {
+        var crc: u16 = @as(u16, i) << 8;
+        for (0..8) |_| {
+            crc = if (crc & 0x8000 != 0) (crc << 1) ^ 0x1021 else crc << 1;
+        }
+        entry.* = crc;
     }
-    const checksum = (~sum) +% 1; // Two's complement
+    break :blk table;
+};
 
-    var result = try allocator.alloc(u8, input.len + 2);
-    @memcpy(result[0..input.len], input);
-    _ = std.fmt.bufPrint(result[input.len..], "{X:0>2}", .{checksum}) catch unreachable;
-
-    return result;
+fn crc16Step(crc: u16, byte: u8) u16 {
+    return (crc << 8) ^ crc16_table[@as(u8, @truncate(crc >> 8)) ^ byte];
 }
 
-test "appendChecksum8" {
-    const testing = std.testing;
-
-    const test_data = "Hello World";
-    const result = try appendChecksum8(testing.allocator, test_data);
-    defer testing.allocator.free(result);
-
-    // Test that result starts with original data
-    try testing.expect(std.mem.startsWith(u8, result, test_data));
-    // Test that result is 2 characters longer (original + 2 hex chars)
-    try testing.expectEqual(test_data.len + 2, result.len);
-
-    std.debug.print("Checksum8 test: '{s}' -> '{s}'\n", .{ test_data, result });
+// Xmodem CRC16 calculation (polynomial 0x1021). Public so the panel emulator
+// can verify the trailers this module writes.
+pub fn calculateXmodemCrc16(data: []const u8) u16 {
+    var crc: u16 = 0;
+    for (data) |byte| crc = crc16Step(crc, byte);
+    return crc;
 }
 
-// Calculate Xmodem CRC16 and append as uppercase hex
-pub fn appendCrc16(allocator: std.mem.Allocator, input: []const u8) ![]u8 {
-    const crc = calculateXmodemCrc16(input);
-
-    var result = try allocator.alloc(u8, input.len + 4);
-    @memcpy(result[0..input.len], input);
-    _ = std.fmt.bufPrint(result[input.len..], "{X:0>4}", .{crc}) catch unreachable;
-
-    return result;
+/// 8-bit checksum (two's complement of the byte sum). Summed wide and
+/// truncated once, which leaves the loop free of carries for the compiler to
+/// vectorize; only the low byte matters either way.
+pub fn calculateChecksum8(data: []const u8) u8 {
+    var sum: usize = 0;
+    for (data) |byte| sum += byte;
+    return (~@as(u8, @truncate(sum))) +% 1;
 }
 
-test "appendCrc16" {
+test "the table-driven CRC matches the bitwise definition" {
     const testing = std.testing;
+    var bytes: [300]u8 = undefined;
+    for (&bytes, 0..) |*b, i| b.* = @truncate(i *% 37 +% 11);
 
-    const test_data = "Hello World";
-    const result = try appendCrc16(testing.allocator, test_data);
-    defer testing.allocator.free(result);
-
-    // Test that result starts with original data
-    try testing.expect(std.mem.startsWith(u8, result, test_data));
-    // Test that result is 4 characters longer (original + 4 hex chars)
-    try testing.expectEqual(test_data.len + 4, result.len);
-
-    std.debug.print("CRC16 test: '{s}' -> '{s}'\n", .{ test_data, result });
-}
-
-// Xmodem CRC16 calculation (polynomial 0x1021)
-fn calculateXmodemCrc16(data: []const u8) u16 {
     var crc: u16 = 0;
-
-    for (data) |byte| {
+    for (bytes) |byte| {
         crc ^= @as(u16, byte) << 8;
-
-        var i: u8 = 0;
-        while (i < 8) : (i += 1) {
-            if (crc & 0x8000 != 0) {
-                crc = (crc << 1) ^ 0x1021;
-            } else {
-                crc = crc << 1;
-            }
+        for (0..8) |_| {
+            crc = if (crc & 0x8000 != 0) (crc << 1) ^ 0x1021 else crc << 1;
         }
     }
-
-    return crc;
+    try testing.expectEqual(crc, calculateXmodemCrc16(&bytes));
+    // The standard check value for CRC-16/XMODEM.
+    try testing.expectEqual(@as(u16, 0x31C3), calculateXmodemCrc16("123456789"));
 }
 
-test "checksum and crc calculations" {
+test "calculateChecksum8 is the two's complement of the byte sum" {
     const testing = std.testing;
+    var bytes: [100]u8 = undefined;
+    for (&bytes, 0..) |*b, i| b.* = @truncate(i * 7 + 3);
+    var sum: u8 = 0;
+    for (bytes) |b| sum +%= b;
+    try testing.expectEqual((~sum) +% 1, calculateChecksum8(&bytes));
+    try testing.expectEqual(@as(u8, 0), calculateChecksum8(""));
+}
 
-    // Test with known values
-    const simple_data = "A";
+test "FrameBuilder reproduces frames captured from the vendor software" {
+    const testing = std.testing;
+    // Both from reference/sniff.txt: a group flush and the init sequence.
+    var frame: FrameBuilder = undefined;
+    try testing.expectEqualStrings("\x01u0:F\r233B", grpFlushCmd(&frame, 0));
+    try testing.expectEqualStrings("\x01u0:D" ++ default_init_payload ++ "\rA965", grpDefaultInitCmd(&frame, 0));
+}
 
-    const checksum_result = try appendChecksum8(testing.allocator, simple_data);
-    defer testing.allocator.free(checksum_result);
+test "FrameBuilder trailers follow the packet type" {
+    const testing = std.testing;
+    var frame: FrameBuilder = .init(single_chksum, 1, display_cmd);
+    try frame.append("hi");
+    const with_sum = frame.finish();
+    try testing.expectEqual(calculateChecksum8(with_sum[0 .. with_sum.len - 2]), try std.fmt.parseInt(u8, with_sum[with_sum.len - 2 ..], 16));
 
-    const crc_result = try appendCrc16(testing.allocator, simple_data);
-    defer testing.allocator.free(crc_result);
+    frame = .init(single_nochk, 1, display_cmd);
+    try frame.append("hi");
+    try testing.expectEqualStrings("\x01S1:Dhi\r", frame.finish());
+}
 
-    std.debug.print("Simple test: '{s}' -> checksum: '{s}', crc: '{s}'\n", .{ simple_data, checksum_result, crc_result });
+test "FrameBuilder rejects a payload that would not fit, and can be rewound" {
+    const testing = std.testing;
+    var frame: FrameBuilder = .init(single_crc16, 1, display_cmd);
+    try testing.expectError(error.FrameTooLong, frame.append(&([_]u8{'x'} ** max_frame_len)));
+    try testing.expectEqual(@as(usize, 0), frame.payload().len);
+
+    try frame.append("first");
+    frame.resetPayload();
+    try frame.print("{s}{d}", .{ "second", 2 });
+    var expected: FrameBuilder = undefined;
+    try testing.expectEqualStrings(try unitDisplayCmd(&expected, 1, "second2"), frame.finish());
 }
 
 // Format data with control character representations for display
@@ -0,0 +1,332 @@
+//! Opt-in real-time scheduling for the threads that put frames on the panel,
+//! and a record of how late each of them wakes.
+//!
+//! The display loops are written as real-time tasks -- `render.Deadline`
+//! reports any pass that starts late -- but under the default scheduler a
+//! busy box delays them anyway: a compile or a backup takes its time slices
+//! regardless of a frame being due. With `"realtime"` in
+//! `vorne_config.jsonc`, each display, sender and bus thread instead
+//!
+//! - runs `SCHED_FIFO` at the configured priority, so nothing outside the
+//!   real-time class runs while one of them is ready;
+//! - is pinned to the configured core, if any, so it never waits for a
+//!   migration or a cold cache on another;
+//! - has its stack faulted in, and every page the process touches locked in
+//!   memory, so a wake never waits on a page fault either.
+//!
+//! Off by default. A thread at real-time priority that spins starves
+//! everything beneath it, so this is for a box where that risk is worth a
+//! display that keeps time under load; `LimitRTPRIO` and `LimitMEMLOCK` in
+//! `zig-vorne-m1000.service` allow it without running as root.
+//!
+//! Whether or not it is on, every deadline a display, sender or bus thread
+//! sleeps to is timed, and how late the wake came recorded in a histogram
+//! per port and role (`lateness`). `logLateness` prints them on the way out,
+//! and `zig build bench` after each mode: the evidence that real-time mode
+//! does what it is for, and how often a wake is late without it.
+//!
+//! Configured once, before any thread starts -- the set-once discipline of
+//! `vorne_config.zig` -- so `options` is unsynchronized.
+
+const std = @import("std");
+const linux = std.os.linux;
+
+pub const Options = struct {
+    /// `SCHED_FIFO` priority, 1 to 99; 0 leaves scheduling alone.
+    priority: u8 = 0,
+    /// Core to pin the real-time threads to, or null to let them run on any.
+    cpu: ?u16 = null,
+
+    pub fn enabled(self: Options) bool {
+        return self.priority != 0;
+    }
+};
+
+pub const max_priority = 99;
+/// `cpu_set_t`'s size in glibc, and far more cores than a Pi has.
+pub const max_cpus = 1024;
+
+var options: Options = .{};
+
+/// Apply `opts` for the threads that start from here on, and lock the
+/// process's memory if they ask for real time. Call once from `main`, before
+/// starting any thread.
+pub fn configure(opts: Options) void {
+    options = opts;
+    if (!opts.enabled()) return;
+
+    // On fault rather than all at once: locking every thread's whole stack
+    // reservation up front would pin megabytes nobody touches. What the
+    // real-time threads do touch is faulted in by `enterThread` instead.
+    const rc = linux.syscall1(.mlockall, MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT);
+    switch (linux.errno(rc)) {
+        .SUCCESS => std.log.info("Real-time: memory locked\n", .{}),
+        else => |e| std.log.warn("Real-time: cannot lock memory ({s}); raise LimitMEMLOCK\n", .{@tagName(e)}),
+    }
+}
+
+/// Make the calling thread real-time as configured; `name` is for the log.
+/// Does nothing with real-time mode off. A thread that cannot be made
+/// real-time carries on as before, with a warning, rather than failing.
+pub fn enterThread(name: []const u8) void {
+    if (!options.enabled()) return;
+    prefaultStack();
+
+    if (options.cpu) |cpu| {
+        var set: CpuSet = @splat(0);
+        set[cpu / @bitSizeOf(usize)] |= @as(usize, 1) << @intCast(cpu % @bitSizeOf(usize));
+        const rc = linux.syscall3(.sched_setaffinity, 0, @sizeOf(CpuSet), @intFromPtr(&set));
+        switch (linux.errno(rc)) {
+            .SUCCESS => {},
+            else => |e| std.log.warn("Real-time: cannot pin {s} to CPU {d} ({s})\n", .{ name, cpu, @tagName(e) }),
+        }
+    }
+
+    const param: SchedParam = .{ .priority = options.priority };
+    const rc = linux.syscall3(.sched_setscheduler, 0, SCHED_FIFO, @intFromPtr(&param));
+    switch (linux.errno(rc)) {
+        .SUCCESS => std.log.info("Real-time: {s} at FIFO priority {d}\n", .{ name, options.priority }),
+        else => |e| std.log.warn("Real-time: cannot raise {s} to FIFO priority {d} ({s}); raise LimitRTPRIO\n", .{ name, options.priority, @tagName(e) }),
+    }
+}
+
+/// How much of a real-time thread's stack to fault in. Far more than any
+/// loop here uses; what matters is that a wake never stops for a fault.
+const prefault_bytes = 256 * 1024;
+
+noinline fn prefaultStack() void {
+    var buf: [prefault_bytes]u8 = undefined;
+    @memset(&buf, 0);
+    std.mem.doNotOptimizeAway(&buf);
+}
+
+const MCL_CURRENT: usize = 1;
+const MCL_FUTURE: usize = 2;
+const MCL_ONFAULT: usize = 4;
+const SCHED_FIFO: usize = 1;
+
+const SchedParam = extern struct {
+    priority: i32,
+};
+
+const CpuSet = [max_cpus / @bitSizeOf(usize)]usize;
+
+/// Which of a mode's threads a histogram is for.
+pub const Role = enum {
+    /// The mode's collator: `render.Deadline`'s sleeps.
+    display,
+    /// Its `render.senderLoop`: the periodic refresh it sleeps to.
+    sender,
+    /// The bus scheduler, on a shared RS-485 line.
+    bus,
+};
+
+/// Upper bounds of the histogram's buckets, in microseconds; one more bucket
+/// takes everything later. Fine below a few milliseconds, where real-time
+/// mode should keep every wake, and coarse above, where it should keep none.
+pub const bucket_bounds_us = [_]i64{ 50, 100, 200, 500, 1_000, 2_000, 5_000, 10_000, 20_000, 50_000 };
+pub const bucket_count = bucket_bounds_us.len + 1;
+
+/// How late one thread's wakes have been. Recorded by its thread, read from
+/// any -- every field is an atomic, and a reader may see a wake counted in a
+/// bucket before `max_us` catches up, which is harmless.
+pub const Lateness = struct {
+    device_buf: [max_device_len]u8 = undefined,
+    device_len: usize = 0,
+    /// On a bus, the unit whose collator this is; null for a port's own
+    /// threads and for the bus scheduler.
+    unit: ?u8 = null,
+    role: Role = .display,
+    counts: [bucket_count]std.atomic.Value(u64) = [_]std.atomic.Value(u64){.init(0)} ** bucket_count,
+    max_us: std.atomic.Value(i64) = .init(0),
+    /// For `metrics.zig`'s export, which wants a total alongside the buckets.
+    sum_us: std.atomic.Value(u64) = .init(0),
+
+    /// The serial device the thread drives, as configured.
+    pub fn device(self: *const Lateness) []const u8 {
+        return self.device_buf[0..self.device_len];
+    }
+
+    /// A wake `late_us` after it was due. Early wakes count as on time.
+    pub fn record(self: *Lateness, late_us: i64) void {
+        const late = @max(late_us, 0);
+        _ = self.counts[bucketOf(late)].fetchAdd(1, .monotonic);
+        _ = self.max_us.fetchMax(late, .monotonic);
+        _ = self.sum_us.fetchAdd(@intCast(late), .monotonic);
+    }
+
+    /// A wake now, for a deadline of `due_ms` on the real-time clock --
+    /// `time.nowMillis`'s, which every loop here schedules on.
+    pub fn recordWake(self: *Lateness, io: std.Io, due_ms: i64) void {
+        const now_us: i64 = @intCast(@divFloor(std.Io.Timestamp.now(io, .real).nanoseconds, std.time.ns_per_us));
+        self.record(now_us - due_ms * std.time.us_per_ms);
+    }
+
+    pub fn summary(self: *const Lateness) Summary {
+        var s: Summary = .{ .max_us = self.max_us.load(.monotonic), .sum_us = self.sum_us.load(.monotonic) };
+        for (&self.counts, 0..) |*c, i| {
+            s.counts[i] = c.load(.monotonic);
+            s.wakes += s.counts[i];
+        }
+        return s;
+    }
+};
+
+pub const Summary = struct {
+    counts: [bucket_count]u64 = @splat(0),
+    wakes: u64 = 0,
+    max_us: i64 = 0,
+    sum_us: u64 = 0,
+
+    /// The bound of the bucket holding the `p`th percentile wake: "99% were
+    /// no later than this". Null past the last bound, or with no wakes.
+    pub fn percentileUs(self: Summary, p: f64) ?i64 {
+        if (self.wakes == 0) return null;
+        const rank: u64 = @intFromFloat(@ceil(@as(f64, @floatFromInt(self.wakes)) * p / 100.0));
+        var seen: u64 = 0;
+        for (self.counts, 0..) |count, i| {
+            seen += count;
+            if (seen >= rank) return if (i < bucket_bounds_us.len) bucket_bounds_us[i] else null;
+        }
+        return null;
+    }
+
+    /// Wakes no later than `bound_us`, which must be one of
+    /// `bucket_bounds_us`.
+    pub fn within(self: Summary, bound_us: i64) u64 {
+        var n: u64 = 0;
+        for (bucket_bounds_us, 0..) |b, i| {
+            if (b > bound_us) break;
+            n += self.counts[i];
+        }
+        return n;
+    }
+};
+
+fn bucketOf(late_us: i64) usize {
+    for (bucket_bounds_us, 0..) |b, i| {
+        if (late_us <= b) return i;
+    }
+    return bucket_bounds_us.len;
+}
+
+/// Room for a `/dev/serial/by-id/...` path, which names the adapter's make and
+/// serial number and so runs well past 50 bytes.
+const max_device_len = 128;
+/// A display and a sender for each of a few ports, or a bus and a display for
+/// each of its units, and room over.
+const max_histograms = 32;
+
+var histograms: [max_histograms]Lateness = @splat(.{});
+var n_histograms = std.atomic.Value(usize).init(0);
+/// Serializes registration only -- rare, once per thread per key. Reading
+/// needs nothing: an entry is complete before `n_histograms` counts it.
+var registering = std.atomic.Value(bool).init(false);
+/// Shared by everything registered once the table is full, so recording
+/// never fails. Never reported.
+var overflow: Lateness = .{};
+
+/// The histogram for the `role` thread driving `device` -- or, on a bus,
+/// `unit` on it -- created on first use. Keyed by where the thread sends
+/// rather than by mode, so two ports in one mode are told apart, and one
+/// port's history carries across a mode switch.
+pub fn lateness(device: []const u8, unit: ?u8, role: Role) *Lateness {
+    const short = device[0..@min(device.len, max_device_len)];
+    if (find(short, unit, role)) |h| return h;
+
+    while (registering.cmpxchgWeak(false, true, .acquire, .monotonic) != null) {
+        std.atomic.spinLoopHint();
+    }
+    defer registering.store(false, .release);
+    if (find(short, unit, role)) |h| return h;
+    const n = n_histograms.load(.monotonic);
+    if (n == max_histograms) return &overflow;
+    const h = &histograms[n];
+    @memcpy(h.device_buf[0..short.len], short);
+    h.device_len = short.len;
+    h.unit = unit;
+    h.role = role;
+    n_histograms.store(n + 1, .release);
+    return h;
+}
+
+fn find(device: []const u8, unit: ?u8, role: Role) ?*Lateness {
+    for (histograms[0..n_histograms.load(.acquire)]) |*h| {
+        if (h.role == role and h.unit == unit and std.mem.eql(u8, h.device(), device)) return h;
+    }
+    return null;
+}
+
+/// Every histogram registered so far.
+pub fn all() []Lateness {
+    return histograms[0..n_histograms.load(.acquire)];
+}
+
+/// One line per port and role: how many wakes, how many within 1 and 2 ms,
+/// the 99th percentile and the worst.
+pub fn logLateness() void {
+    for (all()) |*h| {
+        const s = h.summary();
+        if (s.wakes == 0) continue;
+        var p99_buf: [24]u8 = undefined;
+        const p99 = if (s.percentileUs(99)) |us|
+            std.fmt.bufPrint(&p99_buf, "<= {d} us", .{us}) catch "?"
+        else
+            "over 50 ms";
+        var unit_buf: [16]u8 = undefined;
+        const unit = if (h.unit) |u| std.fmt.bufPrint(&unit_buf, " unit {d}", .{u}) catch "" else "";
+        std.log.info(
+            "Wake lateness, {s}{s} {s}: {d} wakes, {d:.2}% within 1 ms, {d:.2}% within 2 ms, p99 {s}, worst {d} us\n",
+            .{ h.device(), unit, @tagName(h.role), s.wakes, percent(s.within(1_000), s.wakes), percent(s.within(2_000), s.wakes), p99, s.max_us },
+        );
+    }
+}
+
+fn percent(part: u64, whole: u64) f64 {
+    return @as(f64, @floatFromInt(part)) * 100.0 / @as(f64, @floatFromInt(whole));
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+test "wakes land in the bucket bounding them, and percentiles read them back" {
+    var h: Lateness = .{};
+    for (0..98) |_| h.record(30); // on time
+    h.record(1_500);
+    h.record(-200); // early counts as on time
+    h.record(70_000);
+
+    const s = h.summary();
+    try testing.expectEqual(@as(u64, 101), s.wakes);
+    try testing.expectEqual(@as(u64, 99), s.counts[0]);
+    try testing.expectEqual(@as(u64, 1), s.counts[bucketOf(1_500)]);
+    try testing.expectEqual(@as(u64, 1), s.counts[bucket_count - 1]);
+    try testing.expectEqual(@as(i64, 70_000), s.max_us);
+
+    try testing.expectEqual(@as(?i64, 50), s.percentileUs(50));
+    try testing.expectEqual(@as(?i64, 2_000), s.percentileUs(99));
+    try testing.expectEqual(@as(?i64, null), s.percentileUs(100));
+    try testing.expectEqual(@as(u64, 99), s.within(1_000));
+    try testing.expectEqual(@as(u64, 100), s.within(2_000));
+}
+
+test "a port, unit and role get one histogram, however often asked for" {
+    const a = lateness("/dev/test-rt", null, .display);
+    const b = lateness("/dev/test-rt", null, .display);
+    const c = lateness("/dev/test-rt", null, .sender);
+    const d = lateness("/dev/test-rt", 3, .display);
+    const e = lateness("/dev/test-rt-2", null, .display);
+    try testing.expectEqual(a, b);
+    try testing.expect(a != c);
+    try testing.expect(a != d);
+    try testing.expect(a != e);
+    try testing.expectEqualStrings("/dev/test-rt", a.device());
+    try testing.expectEqual(Role.sender, c.role);
+    try testing.expectEqual(@as(?u8, 3), d.unit);
+
+    const long = "/dev/serial/by-id/usb-FTDI_FT232R_USB_UART_A50285BI-if00-port0";
+    try testing.expectEqualStrings(long, lateness(long, null, .sender).device());
+}
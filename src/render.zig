@@ -0,0 +1,818 @@
+//! The display pipeline every mode runs on: source, collator, sender.
+//!
+//! - The **source** is whatever a mode shows -- the player's play position,
+//!   VLC's status, the time of day -- gathered on whatever thread suits it.
+//! - The **collator** is the mode's own loop. It builds both lines whole for
+//!   the instant it wakes at, hands them to `Pipeline.publish`, and sleeps to
+//!   the next instant something is due (`Deadline`). It never touches the
+//!   port, so a slow panel reply cannot delay a tick.
+//! - The **sender** (`senderLoop`) owns the port. It diffs what was published
+//!   against what the panel was last sent and puts one frame on the wire per
+//!   pass: only the columns that moved, line 1 before line 2, and a full
+//!   redraw when the record is missing, stale, or asked for.
+//!
+//! Blu-ray mode was built this way first; this is that design, lifted out so
+//! that Clocks and VLC modes get the same diffing and the same reply
+//! handling rather than each sending whole frames inline.
+//!
+//! On a bus (`bus.zig`) there is no sender: `Pipeline.start` is given the
+//! mode's `bus.Unit`, publishes go straight to it, and the bus scheduler does
+//! the diffing for every unit at once.
+
+const std = @import("std");
+const Io = std.Io;
+const protocol = @import("protocol.zig");
+const time = @import("time.zig");
+const str_utils = @import("str_utils.zig");
+const vorne_charset = @import("vorne_charset.zig");
+const dbg = @import("debug_log.zig");
+const bus = @import("bus.zig");
+const Cell = @import("cell.zig").Cell;
+const realtime = @import("realtime.zig");
+const metrics = @import("metrics.zig");
+const panel_mirror = @import("panel_mirror.zig");
+const transport = @import("transport.zig");
+const Event = @import("event.zig").Event;
+
+const maxbufsz = str_utils.maxbufsz;
+
+pub const Line = [maxbufsz]u8;
+
+/// A render pass later than this past its scheduled wake is reported.
+///
+/// The display loop is treated as a real-time task: every wake exists because
+/// something is due on screen at that instant, so being late is a defect rather
+/// than a slow frame. Nothing on the loop should be able to cause one -- all
+/// file, network, *and* serial I/O is on other threads (the serial write and
+/// its wait for the panel's reply live on `senderLoop`) -- which makes a
+/// report here a genuine real-time-scheduling anomaly (OS jitter, a starved
+/// thread) rather than, as it could be before the collator/sender split,
+/// evidence of nothing more than the panel being slow to answer.
+pub const DEADLINE_SLACK_MS: i64 = 12;
+
+/// How often both lines are redrawn in full even though nothing changed.
+///
+/// Two things make this necessary, and either alone would be enough.
+///
+/// Redraw suppression (see `last_line1`/`last_line2`) assumes a byte written to
+/// the port is a byte the panel rendered. Nothing in this protocol guarantees
+/// that: there is no flow control, and the unit's reply is drained without ever
+/// being inspected, so a frame the panel misses is indistinguishable from one it
+/// drew. Suppression then makes that permanent -- the content has not changed,
+/// so it is never sent again, and the line stays stale until something unrelated
+/// alters it.
+///
+/// Incremental column updates (`protocol.appendChangedColsToFrame`) make it
+/// sharper still: in the steady state *only the columns that moved* are ever
+/// transmitted, so nothing repaints the rest of the line. Anything the panel
+/// loses -- a dropped frame, arriving here from another display mode, a glitch
+/// on the wire -- stays lost. Observed on hardware as a blank line with only
+/// the seconds digits ticking, those being the only columns still being sent.
+///
+/// So this redraw covers *both* lines, in full, bypassing the diff. Scoping it
+/// to line 2 alone (an earlier version did) is wrong: the reasoning that line 1
+/// rewrites itself every second holds only while it is written whole.
+pub const FORCE_REFRESH_MS: i64 = 3000;
+
+/// How long after entering a mode to keep forcing a full redraw on
+/// every pass, rather than trusting `have_last1`/`have_last2` after the very
+/// first one.
+///
+/// The first pass's full redraw is sent right behind the mode-entry init.
+/// `protocol.send` waits for the panel's reply before either call returns,
+/// which is a much stronger guarantee than a fixed delay -- but it is still
+/// evidence the panel answered *something*, not proof the frame it just
+/// received rendered correctly. If that one frame is lost anyway,
+/// `have_last1`/`have_last2` are still marked true, since the write itself
+/// succeeded, and every following pass reverts to an incremental diff against
+/// a record of content the panel never actually showed -- so the panel can
+/// stay blank for the full `FORCE_REFRESH_MS` before anything forces a
+/// resend. Repeating the full redraw for a few seconds right after entry
+/// means a lost frame self-heals on the very next
+/// pass instead.
+pub const ENTRY_FULL_REDRAW_MS: i64 = 3000;
+
+/// Why a pass redraws both lines whole rather than diffing columns.
+///
+/// Named explicitly, rather than folded straight into a bool, so the reason
+/// can be logged on change -- the same "log on change" discipline
+/// `bluray.zig`'s `seen_line2_source` uses. Without this, "why did the panel
+/// just repaint whole" was invisible in the log; only the fact that a frame
+/// went out was.
+pub const RedrawReason = enum {
+    /// Nothing has ever been sent, or the last send's line wasn't recorded --
+    /// there is no known-good record to diff against.
+    missing_record,
+    /// Still inside `ENTRY_FULL_REDRAW_MS` of entering the mode -- see its doc.
+    entry_window,
+    /// The mode asked for one -- Blu-ray mode does, when a cue's start or end
+    /// marker is crossed. See `Pipeline.requestRedraw`.
+    requested,
+    /// `FORCE_REFRESH_MS` has elapsed since the last full redraw.
+    periodic,
+};
+
+/// One mode's pipeline: the cell its collator publishes to and the sender
+/// thread draining it. Lives on the collator's stack for as long as the mode
+/// runs.
+pub const Pipeline = struct {
+    /// Prefixes the sender's log lines, so it is clear which mode they are
+    /// about.
+    name: []const u8,
+    draw: DrawCell = .{},
+    /// A one-shot request for a full redraw, distinct from the published
+    /// content itself -- `draw` is "latest wins" (see its doc), so a request
+    /// folded into a frame could be superseded before the sender ever looked.
+    redraw_requested: std.atomic.Value(bool) = .init(false),
+    stopping: std.atomic.Value(bool) = .init(false),
+    sender: ?std.Thread = null,
+    unit: ?*bus.Unit = null,
+    /// The port's device path, from `start`: with `unit`, what the threads
+    /// publishing here file their wake lateness under.
+    device: []const u8 = "",
+    /// The sender's running average of a confirmed frame's round trip, from
+    /// being handed to the port to the panel's reply: near enough how long
+    /// published content takes to reach the glass. 0 until the first reply,
+    /// and on a bus, where the scheduler sends.
+    reply_avg_ms: std.atomic.Value(i64) = .init(0),
+
+    /// Start the sender on `port`, or with a `unit`, send nothing: publishes
+    /// go to the unit and the bus scheduler owns the port. `self` must not
+    /// move until `stop`.
+    pub fn start(self: *Pipeline, io: Io, allocator: std.mem.Allocator, port: anytype, unit: ?*bus.Unit) !void {
+        self.unit = unit;
+        self.device = port.device;
+        if (unit == null) {
+            self.sender = try std.Thread.spawn(.{}, senderLoop, .{ io, allocator, port, self });
+        }
+    }
+
+    pub fn stop(self: *Pipeline) void {
+        self.stopping.store(true, .release);
+        self.draw.frames.changed.notify();
+        if (self.sender) |t| t.join();
+        self.sender = null;
+    }
+
+    /// What the panel should show now. A copy of two small buffers into a
+    /// cell, never a write to the port.
+    pub fn publish(self: *Pipeline, line1: *const Line, line2: *const Line) void {
+        if (self.unit) |u| u.publish(line1, line2) else self.draw.publish(line1, line2);
+    }
+
+    /// Ask for the next frame to redraw both lines whole.
+    pub fn requestRedraw(self: *Pipeline) void {
+        if (self.unit) |u| {
+            u.requestRedraw();
+        } else {
+            self.redraw_requested.store(true, .release);
+            self.draw.frames.changed.notify();
+        }
+    }
+
+    /// The collator's schedule, its wakes counted against this port -- or
+    /// this unit, on a bus. After `start`.
+    pub fn deadline(self: *const Pipeline) Deadline {
+        return .{ .name = self.name, .lateness = self.lateness(.display) };
+    }
+
+    /// The `role` thread's histogram for wherever this pipeline sends.
+    fn lateness(self: *const Pipeline, role: realtime.Role) *realtime.Lateness {
+        return realtime.lateness(self.device, if (self.unit) |u| u.address else null, role);
+    }
+
+    /// How far ahead of the instant it should appear to publish content, so
+    /// it lands on time: `reply_avg_ms`, capped at `MAX_SEND_LEAD_MS`.
+    pub fn sendLeadMs(self: *const Pipeline) i64 {
+        return @min(self.reply_avg_ms.load(.monotonic), MAX_SEND_LEAD_MS);
+    }
+};
+
+/// Ceiling on `Pipeline.sendLeadMs`. A reply average past this is a panel
+/// or wire in trouble (see `SEND_SLOW_ABSOLUTE_MS`), and publishing further
+/// ahead would only show content early once it recovers.
+pub const MAX_SEND_LEAD_MS: i64 = 75;
+
+/// A collator's schedule: sleeps to each instant something is due on screen,
+/// and reports a pass that started late for it.
+///
+/// The report is unconditional, not a debug category: a late pass is a frame
+/// shown late, and there is no catching up afterwards.
+pub const Deadline = struct {
+    /// Names the mode in the late-pass warning.
+    name: []const u8,
+    /// The instant the current pass was scheduled for; 0 before the first
+    /// sleep.
+    due_ms: i64 = 0,
+    late_passes: u32 = 0,
+    /// Every timed wake, to the microsecond; see `realtime.zig`.
+    lateness: *realtime.Lateness,
+
+    /// When the current pass's content became due: the instant it was
+    /// scheduled for, or `now_ms` on the first pass.
+    pub fn dueOr(self: *const Deadline, now_ms: i64) i64 {
+        return if (self.due_ms != 0) self.due_ms else now_ms;
+    }
+
+    fn report(self: *Deadline, now_ms: i64) void {
+        if (self.due_ms != 0 and now_ms - self.due_ms > DEADLINE_SLACK_MS) {
+            self.late_passes += 1;
+            std.log.warn(
+                "{s}: display pass {d} ms late (deadline {d}, {d} so far)\n",
+                .{ self.name, now_ms - self.due_ms, self.due_ms, self.late_passes },
+            );
+        }
+    }
+
+    /// Report the pass that began at `now_ms` if it started more than
+    /// `DEADLINE_SLACK_MS` after it was due, then sleep until `wake_ms`.
+    pub fn sleepUntil(self: *Deadline, io: Io, now_ms: i64, wake_ms: i64) Io.Cancelable!void {
+        self.report(now_ms);
+        self.due_ms = wake_ms;
+
+        const sleep_ms = wake_ms - time.nowMillis(io);
+        if (sleep_ms > 0) {
+            try io.sleep(.fromMilliseconds(sleep_ms), .awake);
+            self.lateness.recordWake(io, wake_ms);
+        }
+    }
+
+    /// `sleepUntil`, but woken early by a ring of `event` past `seen` --
+    /// new input for the pass, which is then due the moment it woke rather
+    /// than at `wake_ms`.
+    pub fn waitUntil(self: *Deadline, io: Io, now_ms: i64, wake_ms: i64, event: *Event, seen: u32) void {
+        self.report(now_ms);
+        self.due_ms = wake_ms;
+
+        const sleep_ms = wake_ms - time.nowMillis(io);
+        event.wait(seen, sleep_ms);
+        // A wake by the event was not due at any set time, so only one that
+        // ran to `wake_ms` says anything about lateness.
+        if (sleep_ms > 0 and event.seq() == seen) self.lateness.recordWake(io, wake_ms);
+        self.due_ms = @min(self.due_ms, time.nowMillis(io));
+    }
+};
+
+/// Hands the collator's freshly built frame to `senderLoop`: a `cell.Cell`,
+/// so neither a publish nor a read ever waits on the other thread.
+///
+/// Deliberately "latest wins," not a queue: the sender only ever cares what
+/// should be on screen *right now*. A publish the sender has not yet picked
+/// up is simply overwritten by the next one rather than queued behind it --
+/// nothing is lost by that, since an intermediate scroll-step frame the
+/// sender never saw was already superseded by the one it does see.
+pub const DrawCell = struct {
+    /// Null until the collator has published anything -- `senderLoop` has
+    /// nothing to send before the first pass runs.
+    frames: Cell(?Frame) = .init(null),
+
+    pub const Frame = struct { line1: [maxbufsz]u8, line2: [maxbufsz]u8 };
+
+    pub fn publish(self: *DrawCell, line1: *const [maxbufsz]u8, line2: *const [maxbufsz]u8) void {
+        self.frames.publish(.{ .line1 = line1.*, .line2 = line2.* });
+    }
+
+    /// The most recently published frame, or null before the collator has
+    /// published anything at all.
+    pub fn read(self: *const DrawCell) ?Frame {
+        return self.frames.read();
+    }
+};
+
+/// Longest `senderLoop` waits for a reply before checking `DrawCell` again
+/// while frames are in flight. With nothing in flight it sleeps on the cell
+/// instead, and a publish wakes it at once; this only matters with a window
+/// (`serial_window_frames`), where a fresh frame may be sendable before the
+/// last one is answered. Stop-and-wait has to wait for the reply regardless.
+const SENDER_IDLE_SLICE_MS: u32 = 10;
+
+/// How far above the recent-average round trip (`senderLoop`'s
+/// `send_ewma_ms`) a single confirmed send's wait for the panel's reply has
+/// to be before it is logged as slow.
+///
+/// A multiple of the *rolling* average rather than a fixed number of
+/// milliseconds, because what counts as "slow" depends on this panel and this
+/// wiring -- a deployment that normally sees 20 ms replies and one that
+/// normally sees 150 ms are both fine right up until either one roughly
+/// triples. This exists because the collator/sender split (see `senderLoop`'s
+/// own doc) moved the one thing that can genuinely stall a pass -- the
+/// blocking wait for the panel's reply -- off the collator entirely. That
+/// fixed the collator's own `DEADLINE_SLACK_MS` report being a false signal
+/// for ordinary serial latency, but it also means a slow *reply* no longer
+/// shows up anywhere unless something says so explicitly: a stall here
+/// previously surfaced as a late collator pass, which was the wrong
+/// attribution (it blamed the render loop for the wire), but at least it
+/// surfaced. This is that signal, correctly attributed.
+const SEND_SLOW_MULTIPLE: i64 = 3;
+
+/// Absolute floor added on top of `SEND_SLOW_MULTIPLE`'s comparison, so a
+/// very fast, very tight baseline (a handful of ms) doesn't make ordinary
+/// jitter look like an anomaly.
+const SEND_SLOW_MARGIN_MS: i64 = 50;
+
+/// A reply taking longer than this is flagged regardless of the adaptive
+/// baseline above -- not a multiple of anything, a hard ceiling.
+///
+/// The relative check (`SEND_SLOW_MULTIPLE`) has a blind spot: a *sustained*
+/// degradation, not a single spike, ratchets the average up one sample at a
+/// time, each one individually landing just under threshold relative to
+/// wherever the average had already climbed to from the sample before it --
+/// observed on hardware as a ~3.5 s stretch of 100-176 ms replies where only
+/// the first sample got flagged and the rest rode the rising average under
+/// the radar. An adaptive-only check can never catch that, because nothing
+/// about it is a spike relative to its own immediate history.
+///
+/// This is the backstop: the protocol has a hard physical ceiling on what a
+/// reply *should* cost, independent of any baseline. The largest frame this
+/// code ever sends is a full two-line redraw, documented (CLAUDE.md, "One
+/// frame per pass, and line 1 wins") at roughly 31 ms of wire time at 19200
+/// baud. A reply taking more than double that is not "a bigger frame" -- it
+/// is added latency, full stop, no matter how the recent average has
+/// drifted.
+const SEND_SLOW_ABSOLUTE_MS: i64 = 75;
+
+/// Owns the serial port and turns whatever the collator last published into
+/// frames on the wire.
+///
+/// Split out from the collator so the two are never coupled by a blocking
+/// call. Before this split, one thread did both jobs: build the draw buffers,
+/// diff them, and send -- all in the same pass. The diffing itself was always
+/// correct and immediate (a fresh `now_ms` and a `memcmp`, every pass), but it
+/// could not *run* while that same thread was blocked inside `protocol.send`
+/// waiting for the panel's reply. A line-2 scroll-step send starting shortly
+/// before a real-time tick came due would still be in flight when it did, so
+/// the tick was not even looked at until the pass after -- by which point a
+/// second real second had often already ticked over. That produced the clock
+/// visibly skipping a second while the marquee was scrolling. A round-trip
+/// estimate was tried first, predicting whether a line-2 send would still be
+/// outstanding by the next tick and skipping it if so -- a real improvement,
+/// but only probabilistic: it depended on the estimate being right.
+///
+/// This is the structural fix instead: the collator never touches the port,
+/// so it is never blocked and always holds the true current state; this
+/// thread continuously sends whatever `draw.read()` says is *latest*, gated
+/// only by however long the panel actually takes to answer. Because it always
+/// re-reads fresh after every send completes, a tick that landed mid-send is
+/// simply reflected the moment it checks again -- no prediction needed.
+///
+/// Owns every piece of "what has the panel actually been sent" bookkeeping --
+/// `last_line1`/`last_line2`/`have_last1`/`have_last2`, the redraw-reason
+/// timers (`FORCE_REFRESH_MS`, `ENTRY_FULL_REDRAW_MS`) -- since it is the only
+/// thread that knows what actually went out. The collator does not, and must
+/// not: it only knows what *should* be shown.
+///
+/// One frame per send, and line 1 preferred over line 2 when both are due --
+/// unchanged from the single-thread version, and for the same reason: nothing
+/// renders until a frame's CRC arrives, so a frame carrying both lines costs
+/// roughly 31 ms against 18 ms for one alone, and two frames back to back with
+/// no gap is what makes the panel drop the second one once its small input
+/// buffer is full (no flow control). Deferring line 2 to the next send costs
+/// it at most one round trip of latency and cannot starve, since line 1
+/// changes only a couple of times a second.
+///
+/// Frames are submitted to the port's `transport.Transport` rather than sent
+/// stop-and-wait: each goes out as soon as the panel's input buffer has room
+/// for it, and its outcome is collected on a later pass. The line records
+/// are therefore written when a frame is *submitted*, and both are dropped
+/// the moment any frame goes unconfirmed -- see the two places that touch
+/// them.
+fn senderLoop(io: Io, allocator: std.mem.Allocator, port: anytype, pipeline: *Pipeline) void {
+    const name = pipeline.name;
+    realtime.enterThread(name);
+    const lateness = pipeline.lateness(.sender);
+    // Every frame is built in place here and handed straight to the port --
+    // see `protocol.FrameBuilder` -- so a steady-state pass touches the heap
+    // not at all. The header never changes; only the payload is rewound.
+    var cmd: protocol.FrameBuilder = .init(protocol.single_crc16, 1, protocol.display_cmd);
+
+    // Last content actually put on the wire, so only a line that changed is
+    // re-clocked out. A flag per line: the two are sent in separate passes,
+    // so a single shared flag would mark one line's record valid on the
+    // strength of the *other* line having gone out.
+    var last_line1: [maxbufsz]u8 = undefined;
+    var last_line2: [maxbufsz]u8 = undefined;
+    var have_last1 = false;
+    var have_last2 = false;
+    // What the panel shows once each frame in flight is in, for
+    // `port.shown`, which only ever holds what the panel has confirmed.
+    var in_flight: InFlight = .{};
+    // See `FORCE_REFRESH_MS`.
+    var last_refresh_ms: i64 = 0;
+    // See `ENTRY_FULL_REDRAW_MS`. This thread's own start is mode entry, so
+    // there is no need for the lazy "set from the first pass" `?i64` the
+    // collator used to need before it had a `now_ms` to seed from.
+    const entry_ms = time.nowMillis(io);
+    // For "log only on change" -- see `RedrawReason`.
+    var seen_redraw_reason: ?RedrawReason = null;
+    // Rolling average of how long a *confirmed* send's wait for the panel's
+    // reply actually takes -- see `SEND_SLOW_MULTIPLE`'s doc. Seeded with a
+    // plausible guess so the first few sends, before a real sample exists,
+    // are not compared against zero.
+    var send_ewma_ms: i64 = 150;
+    var slow_sends: u32 = 0;
+    // The same average, but seeded from the first real reply rather than a
+    // guess, for `Pipeline.sendLeadMs`: a collator aiming its content at an
+    // instant wants the panel as it is, not as it might be.
+    var reply_avg_ms: ?i64 = null;
+
+    while (true) {
+        // Taken before anything this pass looks at, so a publish, redraw
+        // request or stop landing after the look still wakes the idle wait.
+        const seen = pipeline.draw.frames.changed.seq();
+        if (pipeline.stopping.load(.acquire)) break;
+
+        // Settle whatever the panel has answered (or been given up on) since
+        // the last pass, oldest first.
+        while (port.transport.takeCompletion()) |done| {
+            if (in_flight.settle(done)) |lines| {
+                port.shown.publish(lines);
+                panel_mirror.notify();
+            }
+            if (!done.confirmed) {
+                // The records already include this frame's content -- see
+                // where they are written, below -- and maybe that of frames
+                // diffed against it since. Neither can be trusted now, so
+                // drop both, which makes the next pass a full redraw
+                // (`missing_record`). Unconditional, like the write-failure
+                // report: recovery only works if this is visible.
+                have_last1 = false;
+                have_last2 = false;
+                std.log.warn("{s}: display did not confirm frame {d}; redrawing\n", .{ name, done.seq });
+                continue;
+            }
+            const reply_ms = @divFloor(done.latency_us, std.time.us_per_ms);
+            // Unconditional (like the collator's own "Display pass late"
+            // report), and deliberately worded to lay blame on the
+            // wire/panel rather than the render loop: the collator cannot
+            // stall on the panel at all (see this function's own doc), so a
+            // slow reply would otherwise show up nowhere except as exactly
+            // the kind of periodic stutter a full `FORCE_REFRESH_MS` redraw
+            // (a bigger frame, so a bigger target for the panel to be slow
+            // answering) would produce with no accompanying warning.
+            if (reply_ms > send_ewma_ms * SEND_SLOW_MULTIPLE + SEND_SLOW_MARGIN_MS or
+                reply_ms > SEND_SLOW_ABSOLUTE_MS)
+            {
+                slow_sends += 1;
+                std.log.warn(
+                    "{s}: serial comm slow: panel took {d} ms to reply (usually ~{d} ms), {d} so far -- this is the wire/panel, not the render loop\n",
+                    .{ name, reply_ms, send_ewma_ms, slow_sends },
+                );
+            } else {
+                // Fed from *ordinary* confirmed replies only -- flagged ones
+                // excluded, not just timeouts. A cluster of consecutive slow
+                // replies would otherwise drag the baseline up after the
+                // first one, raising the very threshold meant to catch the
+                // rest of the cluster -- observed on hardware as a 96 ms
+                // reply warning, immediately followed by a 108 ms reply that
+                // stayed silent because the first spike had already pushed
+                // the average up enough to swallow the second.
+                send_ewma_ms = @divFloor(send_ewma_ms * 3 + reply_ms, 4);
+                const avg = if (reply_avg_ms) |prev| @divFloor(prev * 3 + reply_ms, 4) else reply_ms;
+                reply_avg_ms = avg;
+                pipeline.reply_avg_ms.store(avg, .monotonic);
+            }
+        }
+
+        const frame = pipeline.draw.read() orelse {
+            senderIdle(io, port, pipeline, seen, null, lateness);
+            continue;
+        };
+        const linebuf = frame.line1;
+        const line2buf = frame.line2;
+
+        const now_ms = time.nowMillis(io);
+        // One-shot: `swap` both reads and clears it, so a request made
+        // between this check and the last cannot be lost or double-counted.
+        const requested = pipeline.redraw_requested.swap(false, .acq_rel);
+        // See `.timing`'s own doc. Gated behind `enabled` for the same
+        // reason as the collator's equivalent: cheap, but not free, and this
+        // loop runs on every publish.
+        const timing_on = dbg.enabled(.timing);
+
+        cmd.resetPayload();
+        const line1_changed = !have_last1 or !std.mem.eql(u8, &linebuf, &last_line1);
+        // Whether the *content* changed, kept separate from whether it gets
+        // sent: a periodic refresh re-sends identical content, and reporting
+        // that as a line-2 update every few seconds would bury the
+        // transitions actually worth reading in the log.
+        const line2_changed = !have_last2 or !std.mem.eql(u8, &line2buf, &last_line2);
+
+        // A full redraw of *both* lines, periodically and whenever what is on
+        // the panel is unknown -- entering the mode, or after a failed
+        // send. Not optional once line updates are incremental: a column diff
+        // rewrites only the columns that moved, so nothing in the steady
+        // state ever repaints the rest of a line the panel lost to a dropped
+        // frame or a glitch on the wire.
+        const in_entry_window = now_ms - entry_ms < ENTRY_FULL_REDRAW_MS;
+
+        const redraw_reason: ?RedrawReason = if (!have_last1 or !have_last2)
+            .missing_record
+        else if (in_entry_window)
+            .entry_window
+        else if (requested)
+            .requested
+        else if (now_ms - last_refresh_ms >= FORCE_REFRESH_MS)
+            .periodic
+        else
+            null;
+        const full_redraw = redraw_reason != null;
+
+        if (redraw_reason != seen_redraw_reason) {
+            seen_redraw_reason = redraw_reason;
+            if (redraw_reason) |reason| {
+                dbg.print(.redraw, "{s}: full redraw -> {s}\n", .{ name, @tagName(reason) });
+            }
+        }
+
+        // Which lines this send actually carried, so the records are updated
+        // for exactly those and no others.
+        var sent_line1 = false;
+        var sent_line2 = false;
+
+        // Two full lines are well inside `protocol.max_frame_len`, so a
+        // frame that does not fit means a line buffer has come through
+        // without its terminator. Skipped rather than crashing this thread:
+        // `continue` re-reads `draw` next iteration, so a bad frame just
+        // costs one send's worth of latency, same as any other skipped pass.
+        if (full_redraw) {
+            last_refresh_ms = now_ms;
+            protocol.appendStrToFrame(&cmd, 1, 1, &linebuf) catch |err| {
+                std.log.err("{s}: failed to build display frame: {}\n", .{ name, err });
+                continue;
+            };
+            protocol.appendStrToFrame(&cmd, 2, 1, &line2buf) catch |err| {
+                std.log.err("{s}: failed to build display frame: {}\n", .{ name, err });
+                continue;
+            };
+            sent_line1 = true;
+            sent_line2 = true;
+        } else if (line1_changed) {
+            // Send only the columns that moved -- see `appendChangedColsToFrame`.
+            protocol.appendChangedColsToFrame(&cmd, 1, &last_line1, &linebuf) catch |err| {
+                std.log.err("{s}: failed to build display frame: {}\n", .{ name, err });
+                continue;
+            };
+            sent_line1 = true;
+        } else if (line2_changed) {
+            // Line 2 yields to line 1 -- see this function's own doc.
+            protocol.appendChangedColsToFrame(&cmd, 2, &last_line2, &line2buf) catch |err| {
+                std.log.err("{s}: failed to build display frame: {}\n", .{ name, err });
+                continue;
+            };
+            sent_line2 = true;
+        }
+
+        // Covers everything above: reading `draw`, the diff, and building
+        // `cmd` -- all arithmetic and `memcmp`, so this should read
+        // close to zero. Read unconditionally (not gated on `timing_on`, the
+        // way `.timing`'s own breakdown line is) since it also feeds the
+        // slow-send warning below, which has to stay on regardless of debug
+        // config -- a send only happens when there is actually something to
+        // send, so this is not the same cost as reading the clock on every
+        // idle poll.
+        const t_built_ms: i64 = time.nowMillis(io);
+
+        if (cmd.payload().len > 0) {
+            // Logged on every attempt, not just failures -- this is the one
+            // point that can confirm or rule out the send path itself when the
+            // panel and the `cue -> ...`/`line2 source -> ...` logs disagree
+            // about what should be on screen.
+            if (sent_line2 and line2_changed and dbg.enabled(.serial)) {
+                var readable: std.ArrayList(u8) = .empty;
+                defer readable.deinit(allocator);
+                vorne_charset.decodeToUtf8(allocator, &readable, &line2buf) catch {};
+                dbg.print(.serial, "{s}: sending line 2: \"{s}\"\n", .{ name, readable.items });
+            }
+
+            // Returns as soon as the transport's window has room -- at once,
+            // if the panel's input buffer can take this frame on top of
+            // whatever is still in flight.
+            const submitted = port.transport.submit(cmd.finish());
+            const t_sent_ms = time.nowMillis(io);
+            if (timing_on) {
+                dbg.print(
+                    .timing,
+                    "{s} sender: build={d}ms window_wait={d}ms total={d}ms line1={} line2={} full={}\n",
+                    .{
+                        name,
+                        t_built_ms - now_ms,
+                        t_sent_ms - t_built_ms,
+                        t_sent_ms - now_ms,
+                        sent_line1,
+                        sent_line2,
+                        full_redraw,
+                    },
+                );
+            }
+            if (submitted) |seq| {
+                // Recorded as shown now, before the panel has answered, so
+                // the next frame can be diffed and sent without waiting for
+                // it. Safe only because a frame the panel does *not* confirm
+                // throws both records away (see the completions handled at
+                // the top of this loop) -- the next pass then redraws in
+                // full, and nothing is ever diffed against content the panel
+                // may not have.
+                if (sent_line1) {
+                    last_line1 = linebuf;
+                    have_last1 = true;
+                }
+                if (sent_line2) {
+                    last_line2 = line2buf;
+                    have_last2 = true;
+                }
+                if (have_last1 and have_last2) in_flight.push(.{
+                    .seq = seq,
+                    .lines = .{ last_line1, last_line2 },
+                    .whole = full_redraw,
+                });
+                if (redraw_reason) |reason| metrics.full_redraws.of(reason).inc() else metrics.diff_frames.inc();
+            } else |err| {
+                // Unconditional: a frame that did not reach the panel is an
+                // operational fault, not diagnostic chatter, and suppressing
+                // it because `serial` happens to be switched off would hide
+                // the single most useful line in the log.
+                std.log.err("{s}: failed to send display frame: {}\n", .{ name, err });
+            }
+        } else {
+            // Nothing changed, so nothing to send -- wait for a reply or a
+            // publish before checking `draw` again, rather than busy-looping.
+            // When something *was* sent, loop straight back around instead:
+            // the transport already paced the wire, and checking immediately
+            // is what lets a tick that landed mid-send be picked up the
+            // instant there is room for it.
+            senderIdle(io, port, pipeline, seen, last_refresh_ms + FORCE_REFRESH_MS, lateness);
+        }
+    }
+}
+
+/// The frames `senderLoop` has in flight, oldest first, each with both lines
+/// as the panel shows them once it is in -- so that the web page's mirror is
+/// of what the panel confirmed, not of what was merely sent.
+const InFlight = struct {
+    entries: [transport.max_in_flight]Entry = undefined,
+    head: usize = 0,
+    len: usize = 0,
+
+    const Entry = struct {
+        seq: u32,
+        lines: [2][maxbufsz]u8,
+        /// A full redraw, which does not depend on any frame before it.
+        whole: bool,
+    };
+
+    fn push(self: *InFlight, entry: Entry) void {
+        // The transport drops an outcome nobody collected once it holds
+        // `max_in_flight` of them, and so does this.
+        if (self.len == self.entries.len) self.pop();
+        self.entries[(self.head + self.len) % self.entries.len] = entry;
+        self.len += 1;
+    }
+
+    fn pop(self: *InFlight) void {
+        self.head = (self.head + 1) % self.entries.len;
+        self.len -= 1;
+    }
+
+    /// What the panel shows now that `done` is in, or null if that is not
+    /// known: it was not confirmed, or not tracked.
+    fn settle(self: *InFlight, done: transport.Completion) ?[2][maxbufsz]u8 {
+        while (self.len > 0) {
+            const entry = self.entries[self.head];
+            // Submitted before both lines were known, so never pushed.
+            if (entry.seq > done.seq) return null;
+            self.pop();
+            // An outcome the transport dropped uncollected, if not `done`.
+            if (entry.seq < done.seq) continue;
+            if (done.confirmed) return entry.lines;
+            // Every diff still in flight was built on this frame's content,
+            // so what the panel makes of it is anyone's guess. Only full
+            // redraws keep their meaning.
+            var kept: usize = 0;
+            for (0..self.len) |i| {
+                const later = self.entries[(self.head + i) % self.entries.len];
+                if (!later.whole) continue;
+                self.entries[(self.head + kept) % self.entries.len] = later;
+                kept += 1;
+            }
+            self.len = kept;
+            return null;
+        }
+        return null;
+    }
+};
+
+/// Wait for whatever `senderLoop` has to do next: a reply, while frames are
+/// in flight, and otherwise a ring of the draw cell (`seen` being the last
+/// one looked at) or `refresh_ms`, when the periodic full redraw is due --
+/// the one wake with a set time, so the one `lateness` records.
+fn senderIdle(io: Io, port: anytype, pipeline: *Pipeline, seen: u32, refresh_ms: ?i64, lateness: *realtime.Lateness) void {
+    if (port.transport.pending > 0) {
+        port.transport.pump(SENDER_IDLE_SLICE_MS);
+        return;
+    }
+    // Settle anything that arrived since -- a straggler from a frame given
+    // up on -- before sleeping where the port is not being read.
+    port.transport.pump(0);
+    const wake_ms = refresh_ms orelse std.math.maxInt(i64);
+    const changed = &pipeline.draw.frames.changed;
+    const sleep_ms = wake_ms -| time.nowMillis(io);
+    changed.wait(seen, sleep_ms);
+    if (refresh_ms != null and sleep_ms > 0 and changed.seq() == seen) lateness.recordWake(io, wake_ms);
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+test "the sender puts each publish on the panel" {
+    var threaded: Io.Threaded = .init(testing.allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+
+    const panel_emulator = @import("panel_emulator.zig");
+    const serial = @import("serial.zig");
+    var emulator = try panel_emulator.Emulator.open(io, .{ .reply_latency_ms = 2 });
+    try emulator.start();
+    defer emulator.close();
+    const port = try serial.SerialPort.open(io, emulator.slavePath(), testing.allocator);
+    defer port.close(testing.allocator);
+
+    var line1: Line = undefined;
+    var line2: Line = undefined;
+    try str_utils.clearVorneLineBuf(&line1);
+    try str_utils.clearVorneLineBuf(&line2);
+    try str_utils.copyLeftJustify(&line1, "12:00:00", 8, null);
+    try str_utils.copyLeftJustify(&line2, "two", 3, null);
+
+    var pipeline: Pipeline = .{ .name = "test" };
+    try pipeline.start(io, testing.allocator, port, null);
+    defer pipeline.stop();
+    pipeline.publish(&line1, &line2);
+    try expectShown(io, &emulator, 1, "12:00:00");
+    try expectShown(io, &emulator, 2, "two");
+
+    // Only the latest publish matters; the one before it may never be sent.
+    line1[7] = '1';
+    pipeline.publish(&line1, &line2);
+    line1[7] = '2';
+    pipeline.publish(&line1, &line2);
+    try expectShown(io, &emulator, 1, "12:00:02");
+
+    // Mirrored once the panel has confirmed it.
+    for (0..200) |_| {
+        if (port.shown.read()) |lines| {
+            if (std.mem.eql(u8, &lines[0], &line1) and std.mem.eql(u8, &lines[1], &line2)) break;
+        }
+        try io.sleep(.fromMilliseconds(10), .awake);
+    } else return error.TestExpectedEqual;
+}
+
+test "only a confirmed frame's content is taken as shown" {
+    var in_flight: InFlight = .{};
+    var a: [2][maxbufsz]u8 = undefined;
+    @memset(&a[0], 'a');
+    @memset(&a[1], 'a');
+    var b = a;
+    b[0][0] = 'b';
+    var c = a;
+    c[0][0] = 'c';
+
+    in_flight.push(.{ .seq = 1, .lines = a, .whole = true });
+    in_flight.push(.{ .seq = 2, .lines = b, .whole = false });
+    in_flight.push(.{ .seq = 3, .lines = c, .whole = true });
+    in_flight.push(.{ .seq = 4, .lines = b, .whole = false });
+    try testing.expectEqual(a, in_flight.settle(.{ .seq = 1, .confirmed = true, .latency_us = 0 }).?);
+    // Frame 2 lost: the diff after it means nothing, the redraw still does.
+    try testing.expectEqual(@as(?[2][maxbufsz]u8, null), in_flight.settle(.{ .seq = 2, .confirmed = false, .latency_us = 0 }));
+    try testing.expectEqual(c, in_flight.settle(.{ .seq = 3, .confirmed = true, .latency_us = 0 }).?);
+    try testing.expectEqual(@as(?[2][maxbufsz]u8, null), in_flight.settle(.{ .seq = 4, .confirmed = true, .latency_us = 0 }));
+    try testing.expectEqual(@as(usize, 0), in_flight.len);
+}
+
+/// Wait up to two seconds for `line` of the emulated panel to read `want`.
+fn expectShown(io: Io, emulator: anytype, line: usize, want: []const u8) !void {
+    var out: Line = undefined;
+    for (0..200) |_| {
+        const screen, _ = emulator.snapshot();
+        if (std.mem.eql(u8, std.mem.trimEnd(u8, screen.lineText(line, &out), " "), want)) return;
+        try io.sleep(.fromMilliseconds(10), .awake);
+    }
+    return error.TestExpectedEqual;
+}
+
+test "a late pass is counted against the deadline it missed" {
+    var threaded: Io.Threaded = .init(testing.allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+
+    var deadline: Deadline = .{ .name = "test", .lateness = realtime.lateness("/dev/test-deadline", null, .display) };
+    try testing.expectEqual(@as(i64, 5), deadline.dueOr(5));
+    const now_ms = time.nowMillis(io);
+    try deadline.sleepUntil(io, now_ms, now_ms);
+    try testing.expectEqual(@as(u32, 0), deadline.late_passes);
+    try deadline.sleepUntil(io, now_ms + DEADLINE_SLACK_MS + 1, now_ms);
+    try testing.expectEqual(@as(u32, 1), deadline.late_passes);
+    try testing.expectEqual(now_ms, deadline.dueOr(0));
+}
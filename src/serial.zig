@@ -1,10 +1,34 @@
 const std = @import("std");
 const Io = std.Io;
 const linux = std.os.linux;
+const transport = @import("transport.zig");
+const str_utils = @import("str_utils.zig");
+const Cell = @import("cell.zig").Cell;
+
+/// The panel's line rate, 8N1 -- see `configure`.
+pub const baud: u32 = 19200;
+
+/// How long `bytes` take to clock out at `rate` (8N1: ten bits a byte), in
+/// microseconds. A 20-column line, framed, is about 35 bytes: 18 ms at 19200.
+pub fn wireMicros(bytes: usize, rate: u32) i64 {
+    if (rate == 0) return 0;
+    return @intCast(@divFloor(@as(u64, bytes) * 10 * std.time.us_per_s, rate));
+}
 
 pub const SerialPort = struct {
     fd: linux.fd_t,
     io: Io,
+    /// Frames written and the replies they are owed -- see `transport.zig`.
+    /// Lives here, with the fd, so it outlives any one display mode.
+    transport: transport.Transport,
+    /// Both lines as the panel shows them, as of the last frame it
+    /// confirmed; null until it has confirmed both. For the web page's
+    /// status API and live mirror -- see `panel_mirror.zig`. Published by
+    /// `render.senderLoop`, the port's one writer; read from any thread.
+    shown: Cell(?[2][str_utils.maxbufsz]u8) = .init(null),
+    /// The path it was opened by: what its wake-lateness histograms are
+    /// filed under (`realtime.lateness`). Owned.
+    device: []const u8,
 
     pub fn open(io: Io, path: []const u8, allocator: std.mem.Allocator) !*SerialPort {
         const file = Io.Dir.openFileAbsolute(io, path, .{ .mode = .read_write }) catch |err| switch (err) {
@@ -20,8 +44,11 @@ pub const SerialPort = struct {
         };
         // std.debug.print("Serial port opened successfully, fd: {}\n", .{file.handle});
 
+        const device = try allocator.dupe(u8, path);
+        errdefer allocator.free(device);
         var self = try allocator.create(SerialPort);
-        self.* = SerialPort{ .fd = file.handle, .io = io };
+        self.* = SerialPort{ .fd = file.handle, .io = io, .transport = undefined, .device = device };
+        self.transport = .init(self);
 
         try self.configure();
         // std.debug.print("Serial port configured successfully\n", .{});
@@ -150,6 +177,7 @@ pub const SerialPort = struct {
 
     pub fn close(self: *SerialPort, allocator: std.mem.Allocator) void {
         _ = linux.close(self.fd);
+        allocator.free(self.device);
         allocator.destroy(self);
     }
 };
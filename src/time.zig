@@ -1,5 +1,7 @@
 const std = @import("std");
 const dbg = @import("debug_log.zig");
+const file_watch = @import("file_watch.zig");
+const tzif = @import("tzif.zig");
 const Io = std.Io;
 
 // 0.16 removed `std.time.timestamp` and friends; wall-clock readings now come
@@ -58,145 +60,44 @@ pub const HmsMs = struct {
     millisecond: u16,
 };
 
-/// Get the local timezone offset in seconds from UTC
-pub fn getTimezoneInfo(io: Io) zoneinfo {
-    // Read timezone info from /etc/localtime symlink
-    if (Io.Dir.cwd().openFile(io, "/etc/localtime", .{})) |file| {
-        defer file.close(io);
-
-        // Try to parse the TZif file for accurate DST information
-        if (parseTZifFile(io, file)) |zi| {
-            return zi;
-        } else {
-            // Fallback to hardcoded mapping if TZif parsing fails
-            std.log.warn("TZif parsing failed, using UTC\n", .{});
-        }
-    } else |err| {
-        std.log.warn("Failed to open /etc/localtime: {}, using UTC\n", .{err});
-    }
+/// The local zone's TZif file, usually a link into /usr/share/zoneinfo.
+pub const zone_path = "/etc/localtime";
 
-    return zoneinfo{ .offset_sec = 0, .is_dst = 0 };
+/// Read the local zone's rules from `zone_path`: UTC, with a warning, if they
+/// cannot be read.
+pub fn loadZone(io: Io) tzif.Zone {
+    var buf: [tzif.max_file_len]u8 = undefined;
+    const bytes = readZoneFile(io, &buf) catch |err| {
+        std.log.warn("Failed to read {s}: {}, using UTC\n", .{ zone_path, err });
+        return .fixed(0);
+    };
+    return tzif.Zone.parse(bytes) catch |err| {
+        std.log.warn("Failed to parse {s}: {}, using UTC\n", .{ zone_path, err });
+        return .fixed(0);
+    };
 }
 
-/// Parse TZif file to get current timezone offset
-fn parseTZifFile(io: Io, file: Io.File) ?zoneinfo {
-    var buf: [1024]u8 = undefined;
-    const utc_timestamp = nowSeconds(io);
-
-    // Now read and parse the TZif file to get actual DST status
+fn readZoneFile(io: Io, buf: []u8) ![]const u8 {
+    const file = try Io.Dir.cwd().openFile(io, zone_path, .{});
+    defer file.close(io);
     var file_reader = file.reader(io, &.{});
-    if (file_reader.seekTo(0)) |_| {
-        if (file_reader.interface.readSliceShort(&buf)) |bytes_read| {
-            // std.debug.print("Read {} bytes from timezone file\n", .{bytes_read});
-
-            // Parse TZif file format
-            if (bytes_read >= 44 and std.mem.eql(u8, buf[0..4], "TZif")) {
-                // std.debug.print("Valid TZif file found\n", .{});
-
-                // TZif header structure (simplified):
-                // 0-3: "TZif" magic
-                // 4: version
-                // 5-19: reserved
-
-                // isutcnt:  A four-octet unsigned integer specifying the number of UT/
-                //     local indicators contained in the data block -- MUST either be
-                //     zero or equal to "typecnt".
-
-                // isstdcnt:  A four-octet unsigned integer specifying the number of
-                //     standard/wall indicators contained in the data block -- MUST
-                //     either be zero or equal to "typecnt".
-
-                // leapcnt:  A four-octet unsigned integer specifying the number of
-                //     leap-second records contained in the data block.
-
-                // timecnt:  A four-octet unsigned integer specifying the number of
-                //     transition times contained in the data block.
-
-                // typecnt:  A four-octet unsigned integer specifying the number of
-                //     local time type records contained in the data block -- MUST NOT be
-                //     zero.  (Although local time type records convey no useful
-                //     information in files that have nonempty TZ strings but no
-                //     transitions, at least one such record is nevertheless required
-                //     because many TZif readers reject files that have zero time types.)
-
-                // charcnt:  A four-octet unsigned integer specifying the total number
-                //     of octets used by the set of time zone designations contained in
-                //     the data block - MUST NOT be zero.  The count includes the
-                //     trailing NUL (0x00) octet at the end of the last time zone
-                //     designation.
-
-                // 20-23: isutcnt (big-endian)
-                // 24-27: isstdcnt (big-endian)
-                // 28-31: leapcnt (big-endian)
-                // 32-35: timecnt (big-endian)
-                // 36-39: typecnt (big-endian)
-                // 40-43: charcnt (big-endian)
-
-                const transition_count = std.mem.readInt(u32, buf[32..][0..4], .big);
-                const type_count = std.mem.readInt(u32, buf[36..][0..4], .big);
-                // std.debug.print("Transitions: {}, Types: {}\n", .{ transition_count, type_count });
-
-                if (transition_count > 0 and type_count > 0 and type_count < 256) {
-                    // Transition times start at offset 44, each is 4 bytes (big-endian)
-                    // Local time types start after transition times
-                    const transitions_size = transition_count * 4;
-                    const types_offset = 44 + transitions_size + transition_count; // +transition_count for type indices
-                    const buf_offset = @max(0, types_offset + (type_count * 6) - 1024);
-
-                    file_reader.seekTo(buf_offset) catch |err| {
-                        std.log.warn("Failed to seek to data: {}\n", .{err});
-                        return null;
-                    };
-                    _ = file_reader.interface.readSliceShort(&buf) catch |err| {
-                        std.log.warn("Failed to read data: {}\n", .{err});
-                        return null;
-                    };
-
-                    // Find the current transition - start from the last type as default
-                    var current_type_idx: u8 = 0;
-
-                    // Find the most recent transition that has passed
-                    var i: u32 = transition_count - 1;
-                    while (i >= 0) : (i -= 1) {
-                        const transition_time = std.mem.readInt(i32, buf[44 + i * 4 - buf_offset ..][0..4], .big);
-                        // std.debug.print("Transition {}: time={}, current_utc={}\n", .{ i, transition_time, utc_timestamp });
-                        if (utc_timestamp >= transition_time) {
-                            current_type_idx = buf[44 + transitions_size + i - buf_offset];
-                            // std.debug.print("Using transition {} with type_idx {}\n", .{ i, current_type_idx });
-                            break;
-                        }
-                    }
-
-                    // Read the current type info (6 bytes per type)
-                    // Offset (4 bytes) + DST flag (1 byte) + Abbreviation index (1 byte)
-                    if (current_type_idx < type_count) {
-                        const type_info_offset = types_offset + current_type_idx * 6;
-                        const offset_seconds = std.mem.readInt(i32, buf[type_info_offset - buf_offset ..][0..4], .big);
-                        const is_dst = buf[type_info_offset + 4 - buf_offset] != 0;
-
-                        // Sanity check: timezone offsets should be reasonable (-12 to +14 hours)
-                        if (offset_seconds >= -12 * 3600 and offset_seconds <= 14 * 3600) {
-                            // std.debug.print("Current timezone offset: {} seconds ({}h), DST: {}\n", .{ offset_seconds, @divFloor(offset_seconds, 3600), is_dst });
-                            // return offset_seconds;
-                            return zoneinfo{ .offset_sec = offset_seconds, .is_dst = if (is_dst) 1 else 0 };
-                        } else {
-                            std.log.warn("Invalid offset {} seconds, using UTC\n", .{offset_seconds});
-                        }
-                    } else {
-                        std.log.warn("Invalid type_idx {}, using UTC\n", .{current_type_idx});
-                    }
-                }
-            } else {
-                std.log.warn("Not a valid TZif file, using UTC\n", .{});
-            }
-        } else |err| {
-            std.log.warn("Failed to read timezone file: {}\n", .{err});
-        }
-    } else |err| {
-        std.log.warn("Failed to seek timezone file: {}\n", .{err});
-    }
+    const n = try file_reader.interface.readSliceShort(buf);
+    // A full buffer means a file longer than any real zone: refuse it rather
+    // than parse the front of it.
+    if (n == buf.len) return error.FileTooBig;
+    return buf[0..n];
+}
 
-    return null;
+/// The local time type as the display wants it.
+pub fn zoneinfoOf(local: tzif.LocalType) zoneinfo {
+    return .{ .offset_sec = local.utoff, .is_dst = @intFromBool(local.is_dst) };
+}
+
+/// The local timezone offset now. Reads and parses the zone file; anything
+/// asking repeatedly wants a `ZoneRefresh`.
+pub fn getTimezoneInfo(io: Io) zoneinfo {
+    const zone = loadZone(io);
+    return zoneinfoOf(zone.at(nowSeconds(io)));
 }
 
 /// A timezone offset shared between a background refresher and a loop that
@@ -204,16 +105,16 @@ fn parseTZifFile(io: Io, file: Io.File) ?zoneinfo {
 ///
 /// `getTimezoneInfo` opens and parses `/etc/localtime`. That is file I/O, and a
 /// render loop with frame deadlines has no business doing it -- but the offset
-/// still has to be re-read periodically or a DST change needs a restart. So a
-/// background thread refreshes this and the render loop only ever does one
-/// atomic load.
+/// still has to change when the zone is changed or a DST transition passes,
+/// or either needs a restart. So a background thread refreshes this (see
+/// `ZoneRefresh`) and the render loop only ever does one atomic load.
 ///
 /// Both fields live in a single atomic word so a reader can never see the
 /// offset from one reading paired with the DST flag from another.
 pub const SharedZone = struct {
     packed_value: std.atomic.Value(u64),
 
-    /// How often the refreshing thread should call `store`.
+    /// How often the zone file is re-read when it cannot be watched.
     pub const refresh_interval_ms: i64 = 10_000;
 
     pub fn init(zi: zoneinfo) SharedZone {
@@ -240,19 +141,50 @@ pub const SharedZone = struct {
     }
 };
 
+/// The local zone's rules, held in memory, and when the offset they give
+/// next changes.
+///
+/// The file is read again only when it changes (`file_watch.zig`); a DST
+/// transition is known in advance from the rules, so the offset is worked out
+/// afresh at exactly that instant without touching the file. Kept by
+/// whichever thread does the reading.
+pub const ZoneRefresh = struct {
+    zone: tzif.Zone = .fixed(0),
+    watch: file_watch.Subscription = .{ .topic = .zone, .poll_ms = SharedZone.refresh_interval_ms },
+    /// When `poll` next has a new offset, Unix seconds.
+    next_change_utc: i64 = 0,
+
+    /// The offset in force at `now_ms`, if it may differ from the one `poll`
+    /// last returned; otherwise null.
+    pub fn poll(self: *ZoneRefresh, io: Io, now_ms: i64) ?zoneinfo {
+        const utc = @divFloor(now_ms, std.time.ms_per_s);
+        if (self.watch.changed(now_ms)) {
+            self.zone = loadZone(io);
+        } else if (utc < self.next_change_utc) {
+            return null;
+        }
+        self.next_change_utc = self.zone.nextTransition(utc) orelse std.math.maxInt(i64);
+        return zoneinfoOf(self.zone.at(utc));
+    }
+
+    /// How long until `poll` next has a new offset, for a caller that wants
+    /// to wake for it. Edits to the zone file are not foreseen, of course.
+    pub fn msUntilChange(self: *const ZoneRefresh, now_ms: i64) i64 {
+        const change_ms = std.math.mul(i64, self.next_change_utc, std.time.ms_per_s) catch return std.math.maxInt(i64);
+        return @max(0, change_ms - now_ms);
+    }
+};
+
 /// Local wall clock, with the zone offset cached.
 ///
 /// `getTimezoneInfo` re-parses `/etc/localtime` on every call, which is far too
-/// expensive to run per frame, but the offset still has to be re-read
-/// occasionally so a DST transition is picked up without a restart. Every mode
-/// that puts the time of day on the display needs that same caching, so it
-/// lives here rather than in any one mode.
+/// expensive to run per frame, but the offset still has to follow the zone's
+/// rules (`ZoneRefresh`) so a DST transition is picked up without a restart.
+/// Every mode that puts the time of day on the display needs that same
+/// caching, so it lives here rather than in any one mode.
 pub const LocalClock = struct {
     zi: zoneinfo,
-    next_refresh_utc: i64,
-
-    /// How often the zone offset is re-read.
-    pub const refresh_interval_sec: i64 = 10;
+    refresh: ZoneRefresh,
 
     /// A clock reading, kept together so callers needing both UTC and local do
     /// not sample twice and risk straddling a second boundary.
@@ -264,18 +196,20 @@ pub const LocalClock = struct {
     };
 
     pub fn init(io: Io) LocalClock {
-        return .{
-            .zi = getTimezoneInfo(io),
-            .next_refresh_utc = nowSeconds(io) + refresh_interval_sec,
-        };
+        var clock: LocalClock = .{ .zi = undefined, .refresh = .{} };
+        clock.zi = clock.refresh.poll(io, nowMillis(io)).?; // a fresh one always answers
+        return clock;
     }
 
     pub fn read(self: *LocalClock, io: Io) Reading {
-        const utc = nowSeconds(io);
-        if (utc >= self.next_refresh_utc) {
-            self.zi = getTimezoneInfo(io);
-            self.next_refresh_utc = utc + refresh_interval_sec;
-        }
+        return self.readAt(io, nowMillis(io));
+    }
+
+    /// The reading at `now_ms` rather than now: for a caller building what
+    /// should be on screen a moment from now.
+    pub fn readAt(self: *LocalClock, io: Io, now_ms: i64) Reading {
+        const utc = @divFloor(now_ms, std.time.ms_per_s);
+        if (self.refresh.poll(io, now_ms)) |zi| self.zi = zi;
         return .{ .utc = utc, .local = utc + self.zi.offset_sec };
     }
 
@@ -323,7 +257,7 @@ pub fn formatRandyTimestamp(timestamp: i64, buf: []u8, zi: ?*const zoneinfo) ![]
     const epoch_day = epoch_seconds.getEpochDay();
     // const year_day = epoch_day.calculateYearDay();
     const weekday_idx: usize = @as(u4, @intCast(@mod(epoch_day.day + 4, 7))); // Jan 1, 1970 was a Thursday (index 4)
-    const zone_idx = if (zi == null or zi.?.offset_sec == 0) 2 else zi.?.is_dst;
+    const zone_idx = clockNameIndex(zi);
 
     // return std.fmt.bufPrint(buf, "{d:0>2}{s}{d:0>2}{s}{d:0>3}/{d:0>2}:{d:0>2}:{d:0>2}{s}", .{
     //     @mod(ymdhms.year, 100),
@@ -350,6 +284,52 @@ pub fn formatRandyTimestamp(timestamp: i64, buf: []u8, zi: ?*const zoneinfo) ![]
     });
 }
 
+/// Which `clock_name` the zone is shown as.
+fn clockNameIndex(zi: ?*const zoneinfo) usize {
+    return if (zi == null or zi.?.offset_sec == 0) 2 else zi.?.is_dst;
+}
+
+/// `formatRandyTimestamp` for a clock that ticks once a second.
+///
+/// The date to the left of the time of day changes only at local midnight,
+/// and the zone name to its right only with the zone, yet working them out is
+/// most of what `formatRandyTimestamp` costs. This keeps the last line it
+/// built and, while the local day and the zone name are unchanged, rewrites
+/// only the eight characters of the time.
+pub const RandyLine = struct {
+    buf: [20]u8 = undefined,
+    len: usize = 0,
+    /// The local day (days since the epoch) and the `clock_name` the date and
+    /// zone parts were built for; null before the first line.
+    day: ?i64 = null,
+    zone_idx: usize = 0,
+
+    /// Where `HH:MM:SS` starts: after `YYMmDDw `, every field fixed-width.
+    const time_col = 8;
+
+    pub fn format(self: *RandyLine, timestamp: i64, zi: ?*const zoneinfo) []const u8 {
+        const day = @divFloor(timestamp, std.time.s_per_day);
+        const zone_idx = clockNameIndex(zi);
+        if (self.day == null or self.day.? != day or self.zone_idx != zone_idx) {
+            self.len = (formatRandyTimestamp(timestamp, &self.buf, zi) catch unreachable).len;
+            self.day = day;
+            self.zone_idx = zone_idx;
+            return self.buf[0..self.len];
+        }
+        const secs: u32 = @intCast(timestamp - day * std.time.s_per_day);
+        const clock = self.buf[time_col..][0..8];
+        writeTwoDigits(clock[0..2], secs / std.time.s_per_hour);
+        writeTwoDigits(clock[3..5], secs / std.time.s_per_min % 60);
+        writeTwoDigits(clock[6..8], secs % 60);
+        return self.buf[0..self.len];
+    }
+
+    fn writeTwoDigits(dest: *[2]u8, value: u32) void {
+        dest[0] = '0' + @as(u8, @intCast(value / 10));
+        dest[1] = '0' + @as(u8, @intCast(value % 10));
+    }
+};
+
 pub const month_2 = [_][]const u8{
     "Ja",
     "Fe",
@@ -435,6 +415,47 @@ pub fn timestampToYmdhms(timestamp: i64) Ymdhms {
     };
 }
 
+test "ZoneRefresh changes the offset at the DST edge, without the file" {
+    var threaded: Io.Threaded = .init(std.testing.allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+
+    // 2024-03-10 07:59:00 UTC, a minute before US DST began in Central time.
+    const before_ms: i64 = 1_710_057_540_000;
+    var watcher: file_watch.Watcher = .{};
+    watcher.running.store(true, .release);
+    var refresh: ZoneRefresh = .{ .watch = .{ .topic = .zone, .poll_ms = SharedZone.refresh_interval_ms, .watcher = &watcher } };
+    refresh.zone.rule = try tzif.Rule.parse("CST6CDT,M3.2.0,M11.1.0");
+    refresh.watch.seen = watcher.version(.zone); // as if just loaded
+
+    try std.testing.expectEqual(@as(i32, -6 * 3600), refresh.poll(io, before_ms).?.offset_sec);
+    try std.testing.expectEqual(@as(?zoneinfo, null), refresh.poll(io, before_ms + 59_999));
+    try std.testing.expectEqual(@as(i64, 1), refresh.msUntilChange(before_ms + 59_999));
+    const after = refresh.poll(io, before_ms + 60_000).?;
+    try std.testing.expectEqual(@as(i32, -5 * 3600), after.offset_sec);
+    try std.testing.expectEqual(@as(u8, 1), after.is_dst);
+    try std.testing.expectEqual(@as(?zoneinfo, null), refresh.poll(io, before_ms + 61_000));
+}
+
+test "RandyLine matches formatRandyTimestamp across midnight and a zone change" {
+    const cst: zoneinfo = .{ .offset_sec = -6 * 3600, .is_dst = 0 };
+    const cdt: zoneinfo = .{ .offset_sec = -5 * 3600, .is_dst = 1 };
+    var line: RandyLine = .{};
+    var expected_buf: [20]u8 = undefined;
+    // 2024-03-09 23:59:00 local, on through midnight, and into CDT at 02:00
+    // the next morning (local times here, so the offset only picks the name).
+    const start: i64 = 1_710_028_740;
+    var t = start;
+    while (t < start + 3 * 3600) : (t += 7) {
+        const zi = if (t - start >= 2 * 3600 + 60) &cdt else &cst;
+        const expected = try formatRandyTimestamp(t, &expected_buf, zi);
+        try std.testing.expectEqualStrings(expected, line.format(t, zi));
+    }
+    // And UTC, named differently again.
+    const expected = try formatRandyTimestamp(t, &expected_buf, null);
+    try std.testing.expectEqualStrings(expected, line.format(t, null));
+}
+
 test "SharedZone round-trips both fields in one atomic word" {
     // Packing exists so a reader cannot pair the offset from one reading with
     // the DST flag from another; the round trip has to be exact for that to be
@@ -0,0 +1,612 @@
+//! Frame delivery to the panel: reply matching, an adaptive reply timeout,
+//! and as many frames in flight as the panel's input buffer will take.
+//!
+//! `protocol.send` used to write one frame and then wait up to two seconds
+//! for *any* byte to come back. That made the link strict stop-and-wait --
+//! the wire idle for the whole of the panel's turnaround on every frame --
+//! and meant a single lost reply froze the display for the full two seconds,
+//! since nothing distinguished "the panel is slow today" from "that reply is
+//! never coming".
+//!
+//! ## Matching
+//!
+//! The panel answers unit-addressed frames in the order they arrive and never
+//! answers group frames, so the n-th reply belongs to the n-th unanswered
+//! frame: a FIFO, with no sequence numbers needed on the wire. `ReplyParser`
+//! turns the incoming bytes into replies -- `ACK`, `NAK`, or a run of anything
+//! else, which counts as an answer exactly as it always has (the panel's own
+//! reply content has never been documented; only its arrival was ever relied
+//! on).
+//!
+//! ## Timing out
+//!
+//! The timeout is the TCP one: a smoothed round trip plus four times its
+//! mean deviation (`ReplyTimer`), clamped to `Options.min_timeout_ms` ..
+//! `Options.max_timeout_ms`, and doubled after each loss until a reply is
+//! timed again. A round trip is measured from when the frame's last byte
+//! would have landed on the panel -- or when the panel answered the frame
+//! before it, if that was later -- to its reply, so time spent queued on the
+//! wire behind other frames is not mistaken for the panel being slow. Until
+//! the first reply has been timed, the ceiling applies, which is the old
+//! fixed two seconds.
+//!
+//! A reply that is merely late would be credited to the *next* frame by FIFO
+//! matching, which is the one mistake this must never make: a frame recorded
+//! as shown that was not is the frozen-digit bug `protocol.send`'s doc
+//! describes. So when the oldest frame times out, every frame still in flight
+//! is given up on with it, and nothing more is written until each of them
+//! has been heard from after all, or the line has been quiet for as long as
+//! a reply could still plausibly be on its way: twice the longest round trip
+//! lately timed (`ReplyTimer.quietUs`), or `Options.max_timeout_ms` before
+//! any has been. Whatever arrives meanwhile is a straggler: discarded,
+//! except that the first one's round trip is learnt, so the timeout grows to
+//! cover a panel that has slowed down. A reply that is only late thus costs
+//! the next frame its lateness, and one lost outright a few round trips. The
+//! caller hears of the loss after one timeout -- tens of milliseconds against
+//! a panel that normally answers in fifteen -- rather than two seconds.
+//!
+//! The timeout is learnt from text frames, which is nearly all the panel
+//! is sent. The few that make it do more -- the init sequence, which clears
+//! the screen and sets the display window, and a flush -- are sent with
+//! `roundTripAtLeast` and a floor of `slow_min_timeout_ms`, so that their
+//! longer turnaround is neither timed out nor, being waited for, learnt.
+//!
+//! ## The window
+//!
+//! The panel has no flow control: a frame that arrives while its input buffer
+//! is full is silently dropped. `Options.window_frames` and
+//! `Options.window_bytes` bound what is written but not yet answered. One
+//! frame -- stop-and-wait, which is all the vendor software was ever seen to
+//! do -- is the default, because the buffer's real size has not been
+//! measured; raise both (`serial_window_frames` / `serial_window_bytes` in
+//! `vorne_config.jsonc`) once it has, and the wire stops idling through the
+//! panel's turnaround.
+//!
+//! One `Transport` per port, owned by `serial.SerialPort`, so frames and
+//! replies stay matched across mode switches: a frame still in flight when
+//! one mode hands the port to another is settled by whichever call touches
+//! the port next.
+
+const std = @import("std");
+const dbg = @import("debug_log.zig");
+const latency_probe = @import("latency_probe.zig");
+const metrics = @import("metrics.zig");
+const serial = @import("serial.zig");
+const time = @import("time.zig");
+
+pub const ACK: u8 = 0x06;
+pub const NAK: u8 = 0x15;
+
+/// The most frames ever tracked at once, answered or not. Also the ceiling on
+/// `Options.window_frames`.
+pub const max_in_flight = 8;
+
+/// The longest a reply is waited for, however slow the panel has been.
+pub const default_max_timeout_ms: u32 = 2000;
+
+/// How long a reply that is neither `ACK` nor `NAK` may pause before it is
+/// taken to be complete. Several byte times at 19200 baud.
+const reply_gap_ms = 3;
+
+/// The shortest a frame sent with `roundTripAtLeast` by `protocol.sendSlow`
+/// is waited for. Nobody has timed the panel clearing its screen, so this
+/// is generous: a quarter of the ceiling.
+pub const slow_min_timeout_ms: u32 = default_max_timeout_ms / 4;
+
+pub const Options = struct {
+    /// Frames written but not yet answered. 1 is stop-and-wait.
+    window_frames: u8 = 1,
+    /// Bytes written but not yet answered -- the panel's input buffer. A
+    /// frame larger than this still goes out, alone.
+    window_bytes: u16 = 64,
+    min_timeout_ms: u32 = 25,
+    max_timeout_ms: u32 = default_max_timeout_ms,
+};
+
+pub const Reply = enum { ack, nak, other };
+
+/// Byte-at-a-time reply decoder.
+pub const ReplyParser = struct {
+    /// Length of a reply in progress that is neither `ACK` nor `NAK`.
+    other_len: usize = 0,
+
+    pub fn feed(self: *ReplyParser, byte: u8) ?Reply {
+        switch (byte) {
+            ACK, NAK => {
+                // A single-byte reply ends anything unrecognized before it;
+                // that fragment is noise, not a reply of its own.
+                self.other_len = 0;
+                return if (byte == ACK) .ack else .nak;
+            },
+            '\r', '\n' => {
+                if (self.other_len == 0) return null;
+                self.other_len = 0;
+                return .other;
+            },
+            else => {
+                self.other_len += 1;
+                return null;
+            },
+        }
+    }
+
+    /// The line has gone quiet: an unterminated reply in progress is complete.
+    pub fn idle(self: *ReplyParser) ?Reply {
+        if (self.other_len == 0) return null;
+        self.other_len = 0;
+        return .other;
+    }
+};
+
+/// Smoothed round trip and its deviation (RFC 6298), in microseconds.
+pub const ReplyTimer = struct {
+    srtt_us: ?i64 = null,
+    rttvar_us: i64 = 0,
+    /// The longest round trip lately: the longest timed, decaying by an
+    /// eighth with every sample after it.
+    peak_us: i64 = 0,
+    /// Doublings since the last timed reply.
+    backoff: u4 = 0,
+
+    pub fn sample(self: *ReplyTimer, rtt_us: i64) void {
+        self.backoff = 0;
+        self.peak_us = @max(rtt_us, self.peak_us - @divTrunc(self.peak_us, 8));
+        if (self.srtt_us) |srtt| {
+            const err = rtt_us - srtt;
+            self.rttvar_us += @divTrunc(@as(i64, @intCast(@abs(err))) - self.rttvar_us, 4);
+            self.srtt_us = srtt + @divTrunc(err, 8);
+        } else {
+            self.srtt_us = rtt_us;
+            self.rttvar_us = @divTrunc(rtt_us, 2);
+        }
+    }
+
+    pub fn lost(self: *ReplyTimer) void {
+        if (self.backoff < 10) self.backoff += 1;
+    }
+
+    pub fn timeoutUs(self: *const ReplyTimer, options: Options) i64 {
+        const max_us: i64 = @as(i64, options.max_timeout_ms) * std.time.us_per_ms;
+        const min_us: i64 = @as(i64, options.min_timeout_ms) * std.time.us_per_ms;
+        const srtt = self.srtt_us orelse return max_us;
+        const base = @max(srtt + 4 * self.rttvar_us, min_us);
+        return @min(base << self.backoff, max_us);
+    }
+
+    /// How long after a frame is given up on its reply may still arrive:
+    /// twice the longer of the recent peak and the timeout's own estimate,
+    /// clamped to the ceiling -- and the ceiling until a reply has been timed.
+    pub fn quietUs(self: *const ReplyTimer, options: Options) i64 {
+        const max_us: i64 = @as(i64, options.max_timeout_ms) * std.time.us_per_ms;
+        const srtt = self.srtt_us orelse return max_us;
+        return @min(2 * @max(self.peak_us, srtt + 4 * self.rttvar_us), max_us);
+    }
+};
+
+/// How one frame turned out, in the order the frames were submitted.
+pub const Completion = struct {
+    seq: u32,
+    /// The panel answered it. False for a `NAK` or a timeout.
+    confirmed: bool,
+    /// The panel's turnaround -- see the file doc. Zero if it never answered.
+    latency_us: i64,
+};
+
+const Entry = struct {
+    seq: u32,
+    len: usize,
+    landed_us: i64,
+    /// The least its reply is waited for -- see `roundTripAtLeast`. Zero
+    /// for a frame timed like any other.
+    min_timeout_us: i64 = 0,
+    state: enum { pending, confirmed, lost },
+    latency_us: i64 = 0,
+};
+
+pub const Transport = struct {
+    port: *serial.SerialPort,
+    options: Options = .{},
+    timer: ReplyTimer = .{},
+    replies: ReplyParser = .{},
+
+    /// Frames in submission order: the answered ones not yet collected by
+    /// `takeCompletion` first, then the `pending` ones.
+    ring: [max_in_flight]Entry = undefined,
+    head: usize = 0,
+    count: usize = 0,
+    pending: usize = 0,
+    pending_bytes: usize = 0,
+    next_seq: u32 = 1,
+
+    /// When the last byte written so far will have left the port.
+    wire_free_us: i64 = 0,
+    /// When the panel last answered, or was last given up on.
+    last_answer_us: i64 = 0,
+    /// Replies arriving before this are stragglers -- see the file doc.
+    quiet_until_us: i64 = 0,
+    /// Replies the frames last given up on still owe.
+    stragglers: usize = 0,
+    /// Whether the next straggler is to be timed, from `given_up_from_us`:
+    /// it is the reply to the first frame given up on, if that was a text
+    /// frame.
+    time_straggler: bool = false,
+    given_up_from_us: i64 = 0,
+    /// Nothing more is written before this: the panels are presumed still busy
+    /// with a group frame nobody will answer -- see `broadcast`.
+    hold_until_us: i64 = 0,
+
+    pub fn init(port: *serial.SerialPort) Transport {
+        return .{ .port = port };
+    }
+
+    fn nowMicros(self: *const Transport) i64 {
+        return @intCast(@divFloor(time.nowNanos(self.port.io), std.time.ns_per_us));
+    }
+
+    fn at(self: *Transport, i: usize) *Entry {
+        return &self.ring[(self.head + i) % max_in_flight];
+    }
+
+    fn hasRoom(self: *const Transport, len: usize, now_us: i64) bool {
+        if (now_us < self.quiet_until_us or now_us < self.hold_until_us) return false;
+        if (self.pending == 0) return true;
+        const frames = @min(@max(self.options.window_frames, 1), max_in_flight);
+        return self.pending < frames and self.pending_bytes + len <= self.options.window_bytes;
+    }
+
+    /// Write `frame` as soon as the window allows, waiting for replies (and
+    /// timing out the overdue) until it does. Returns the frame's sequence
+    /// number, for matching against `takeCompletion`.
+    pub fn submit(self: *Transport, frame: []const u8) !u32 {
+        return self.submitTimed(frame, 0);
+    }
+
+    fn submitTimed(self: *Transport, frame: []const u8, min_timeout_us: i64) !u32 {
+        while (!self.hasRoom(frame.len, self.nowMicros())) self.pump(self.options.max_timeout_ms);
+        if (self.count == max_in_flight) {
+            // Full of outcomes nobody collected; the oldest is of no use to
+            // anyone by now.
+            _ = self.takeCompletion();
+        }
+
+        const start_us = self.nowMicros();
+        try self.port.write(frame);
+        // Benchmarks only -- see `latency_probe.zig`. A single load when off.
+        if (latency_probe.active()) |probe| probe.frameWritten(frame, start_us);
+        countWrite(frame, self.nowMicros() - start_us);
+
+        const landed_us = @max(start_us, self.wire_free_us) + serial.wireMicros(frame.len, serial.baud);
+        self.wire_free_us = landed_us;
+        const seq = self.next_seq;
+        self.next_seq +%= 1;
+        self.at(self.count).* = .{
+            .seq = seq,
+            .len = frame.len,
+            .landed_us = landed_us,
+            .min_timeout_us = min_timeout_us,
+            .state = .pending,
+        };
+        self.count += 1;
+        self.pending += 1;
+        self.pending_bytes += frame.len;
+        return seq;
+    }
+
+    /// Write a frame nothing will answer -- a group frame, which every unit
+    /// on the bus renders and none replies to.
+    ///
+    /// Goes out only once every unit frame before it has been settled, and
+    /// then holds the next write back for the panels' usual turnaround
+    /// (`ReplyTimer`'s smoothed round trip), since no reply will arrive to
+    /// say when they are ready. Without that, a group frame followed at once
+    /// by another frame is exactly the back-to-back pair a panel drops.
+    pub fn broadcast(self: *Transport, frame: []const u8) !void {
+        while (self.pending > 0 or !self.hasRoom(frame.len, self.nowMicros())) self.pump(self.options.max_timeout_ms);
+        const start_us = self.nowMicros();
+        try self.port.write(frame);
+        if (latency_probe.active()) |probe| probe.frameWritten(frame, start_us);
+        countWrite(frame, self.nowMicros() - start_us);
+        metrics.group_frames_written.inc();
+        const landed_us = @max(start_us, self.wire_free_us) + serial.wireMicros(frame.len, serial.baud);
+        self.wire_free_us = landed_us;
+        const turnaround_us = self.timer.srtt_us orelse @as(i64, self.options.min_timeout_ms) * std.time.us_per_ms;
+        self.hold_until_us = landed_us + turnaround_us;
+        self.last_answer_us = self.hold_until_us;
+    }
+
+    /// Count a frame written in `write_us` toward `metrics.zig`'s wire totals.
+    fn countWrite(frame: []const u8, write_us: i64) void {
+        metrics.frames_written.inc();
+        metrics.bytes_written.add(frame.len);
+        metrics.write_time.observe(write_us);
+    }
+
+    /// The outcome of the oldest frame, once it has one.
+    pub fn takeCompletion(self: *Transport) ?Completion {
+        if (self.count == self.pending) return null;
+        const entry = self.at(0);
+        self.head = (self.head + 1) % max_in_flight;
+        self.count -= 1;
+        return .{ .seq = entry.seq, .confirmed = entry.state == .confirmed, .latency_us = entry.latency_us };
+    }
+
+    /// Submit `frame` and wait for its outcome: the stop-and-wait call
+    /// `protocol.send` makes. Outcomes of earlier frames nobody collected are
+    /// discarded along the way.
+    pub fn roundTrip(self: *Transport, frame: []const u8) !bool {
+        return self.roundTripAtLeast(frame, 0);
+    }
+
+    /// `roundTrip` for a frame the panel takes longer over than drawing
+    /// text: its reply is waited for at least `min_timeout_ms`, however
+    /// quick the panel has been lately, and its round trip is not learnt.
+    pub fn roundTripAtLeast(self: *Transport, frame: []const u8, min_timeout_ms: u32) !bool {
+        const seq = try self.submitTimed(frame, @as(i64, min_timeout_ms) * std.time.us_per_ms);
+        while (true) {
+            while (self.takeCompletion()) |done| {
+                if (done.seq == seq) return done.confirmed;
+            }
+            self.pump(self.options.max_timeout_ms);
+        }
+    }
+
+    /// When the oldest unanswered frame is given up on.
+    fn headDeadline(self: *Transport) i64 {
+        const entry = self.at(self.count - self.pending);
+        return @max(entry.landed_us, self.last_answer_us) + self.headTimeoutUs();
+    }
+
+    fn headTimeoutUs(self: *Transport) i64 {
+        const entry = self.at(self.count - self.pending);
+        return @max(self.timer.timeoutUs(self.options), entry.min_timeout_us);
+    }
+
+    /// Wait up to `max_wait_ms` for replies, matching each to the oldest
+    /// unanswered frame, and give up on that frame if its reply is overdue.
+    /// Returns as soon as anything arrives or falls due, so a caller looping
+    /// on it stays responsive.
+    pub fn pump(self: *Transport, max_wait_ms: u32) void {
+        const now_us = self.nowMicros();
+        var wait_us: i64 = @as(i64, max_wait_ms) * std.time.us_per_ms;
+        if (self.pending > 0) wait_us = @min(wait_us, self.headDeadline() - now_us);
+        if (now_us < self.quiet_until_us) wait_us = @min(wait_us, self.quiet_until_us - now_us);
+        if (now_us < self.hold_until_us) wait_us = @min(wait_us, self.hold_until_us - now_us);
+        if (self.replies.other_len > 0) wait_us = @min(wait_us, reply_gap_ms * std.time.us_per_ms);
+        const wait_ms: u32 = @intCast(std.math.divCeil(i64, @max(wait_us, 0), std.time.us_per_ms) catch 0);
+
+        var buf: [64]u8 = undefined;
+        const result = self.port.readWithTimeout(&buf, wait_ms) catch |err| switch (err) {
+            error.PollError => {
+                dbg.print(.serial, "Error polling for a reply.\n", .{});
+                if (self.pending > 0) self.giveUp(self.nowMicros());
+                return;
+            },
+        };
+        const signed: isize = @bitCast(result);
+        const received: usize = if (signed > 0) @intCast(signed) else 0;
+
+        const after_us = self.nowMicros();
+        if (received == 0) {
+            if (self.replies.idle()) |reply| self.answer(reply, after_us);
+        }
+        for (buf[0..received]) |byte| {
+            if (self.replies.feed(byte)) |reply| self.answer(reply, after_us);
+        }
+        if (self.pending > 0 and after_us >= self.headDeadline()) self.giveUp(after_us);
+    }
+
+    fn answer(self: *Transport, reply: Reply, now_us: i64) void {
+        if (now_us < self.quiet_until_us) return self.straggle(reply, now_us);
+        if (self.pending == 0) {
+            dbg.print(.serial, "Discarding a reply ({s}) to no frame.\n", .{@tagName(reply)});
+            return;
+        }
+        const entry = self.at(self.count - self.pending);
+        const latency_us = @max(now_us - @max(entry.landed_us, self.last_answer_us), 0);
+        self.pending -= 1;
+        self.pending_bytes -= entry.len;
+        self.last_answer_us = now_us;
+        if (entry.min_timeout_us == 0) self.timer.sample(latency_us);
+        entry.latency_us = latency_us;
+        entry.state = if (reply == .nak) .lost else .confirmed;
+        if (reply == .nak) dbg.print(.serial, "Panel rejected frame {d}.\n", .{entry.seq});
+        metrics.answers.of(if (reply == .nak) .rejected else .confirmed).inc();
+        metrics.reply_time.observe(latency_us);
+    }
+
+    /// A reply to a frame already given up on.
+    fn straggle(self: *Transport, reply: Reply, now_us: i64) void {
+        dbg.print(.serial, "Discarding a late reply ({s}).\n", .{@tagName(reply)});
+        if (self.stragglers == 0) {
+            // Owed by nothing: noise, or a panel answering twice. Quiet
+            // means quiet, so the wait starts over.
+            self.quiet_until_us = now_us + self.timer.quietUs(self.options);
+            return;
+        }
+        if (self.time_straggler) {
+            // A real round trip, just longer than the timeout allowed for.
+            self.timer.sample(now_us - self.given_up_from_us);
+            self.time_straggler = false;
+        }
+        self.last_answer_us = now_us;
+        self.stragglers -= 1;
+        self.quiet_until_us = if (self.stragglers == 0)
+            now_us
+        else
+            now_us + self.timer.quietUs(self.options);
+    }
+
+    /// The oldest frame's reply is overdue: give up on it and everything
+    /// behind it, and hold the line until their replies have all come in
+    /// late or cannot still be coming.
+    fn giveUp(self: *Transport, now_us: i64) void {
+        const head = self.at(self.count - self.pending);
+        dbg.print(.serial, "No response after {d} ms.\n", .{@divTrunc(self.headTimeoutUs(), std.time.us_per_ms)});
+        // Not a text frame, so not one to learn from either.
+        self.time_straggler = head.min_timeout_us == 0;
+        self.given_up_from_us = @max(head.landed_us, self.last_answer_us);
+        var i = self.count - self.pending;
+        while (i < self.count) : (i += 1) self.at(i).state = .lost;
+        metrics.answers.of(.timed_out).add(self.pending);
+        self.stragglers = self.pending;
+        self.pending = 0;
+        self.pending_bytes = 0;
+        self.timer.lost();
+        self.last_answer_us = now_us;
+        self.quiet_until_us = now_us + self.timer.quietUs(self.options);
+        self.replies = .{};
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+test "ReplyParser: ACK and NAK stand alone, anything else runs to CR" {
+    var parser: ReplyParser = .{};
+    try testing.expectEqual(@as(?Reply, .ack), parser.feed(ACK));
+    try testing.expectEqual(@as(?Reply, .nak), parser.feed(NAK));
+    for ("OK") |b| try testing.expectEqual(@as(?Reply, null), parser.feed(b));
+    try testing.expectEqual(@as(?Reply, .other), parser.feed('\r'));
+    // A bare line ending is not a reply.
+    try testing.expectEqual(@as(?Reply, null), parser.feed('\n'));
+    // Nor is silence.
+    try testing.expectEqual(@as(?Reply, null), parser.idle());
+    _ = parser.feed('?');
+    try testing.expectEqual(@as(?Reply, .other), parser.idle());
+}
+
+test "ReplyTimer starts at the ceiling and converges on the measured round trip" {
+    var timer: ReplyTimer = .{};
+    const options: Options = .{};
+    try testing.expectEqual(@as(i64, default_max_timeout_ms) * std.time.us_per_ms, timer.timeoutUs(options));
+    try testing.expectEqual(@as(i64, default_max_timeout_ms) * std.time.us_per_ms, timer.quietUs(options));
+
+    for (0..50) |_| timer.sample(15_000);
+    // Steady replies: the deviation decays, so the floor is what is left.
+    try testing.expectEqual(@as(i64, options.min_timeout_ms) * std.time.us_per_ms, timer.timeoutUs(options));
+
+    for (0..50) |_| timer.sample(40_000);
+    const settled = timer.timeoutUs(options);
+    try testing.expect(settled >= 40_000 and settled < 60_000);
+
+    // Once timed, a reply is waited out for a few round trips, not the
+    // ceiling.
+    try testing.expect(timer.quietUs(options) >= 80_000 and timer.quietUs(options) < 120_000);
+
+    timer.lost();
+    try testing.expectEqual(settled * 2, timer.timeoutUs(options));
+    timer.sample(40_000);
+    try testing.expect(timer.timeoutUs(options) < settled * 2);
+}
+
+test "frames pipeline up to the window and replies are matched in order" {
+    var threaded: std.Io.Threaded = .init(testing.allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+
+    const panel_emulator = @import("panel_emulator.zig");
+    const protocol = @import("protocol.zig");
+    var emulator = try panel_emulator.Emulator.open(io, .{ .reply_latency_ms = 5 });
+    try emulator.start();
+    defer emulator.close();
+
+    const port = try serial.SerialPort.open(io, emulator.slavePath(), testing.allocator);
+    defer port.close(testing.allocator);
+    port.transport.options = .{ .window_frames = 3, .window_bytes = 255 };
+
+    var frame: protocol.FrameBuilder = undefined;
+    var seqs: [4]u32 = undefined;
+    for (&seqs, 0..) |*seq, i| {
+        var text: [8]u8 = undefined;
+        const payload = try std.fmt.bufPrint(&text, "{s}1;1C{c}", .{ protocol.ESC, 'a' + @as(u8, @intCast(i)) });
+        seq.* = try port.transport.submit(try protocol.unitDisplayCmd(&frame, 1, payload));
+        // Never more than the window outstanding.
+        try testing.expect(port.transport.pending <= 3);
+    }
+
+    var taken: usize = 0;
+    while (taken < seqs.len) {
+        while (port.transport.takeCompletion()) |done| : (taken += 1) {
+            try testing.expectEqual(seqs[taken], done.seq);
+            try testing.expect(done.confirmed);
+        }
+        port.transport.pump(100);
+    }
+
+    const screen, _ = emulator.snapshot();
+    var out: [@import("str_utils.zig").maxbufsz]u8 = undefined;
+    try testing.expectEqual(@as(u8, 'd'), screen.lineText(1, &out)[0]);
+}
+
+test "a dropped frame costs a short timeout once replies have been timed" {
+    var threaded: std.Io.Threaded = .init(testing.allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+
+    const panel_emulator = @import("panel_emulator.zig");
+    const protocol = @import("protocol.zig");
+    var emulator = try panel_emulator.Emulator.open(io, .{ .reply_latency_ms = 2 });
+    try emulator.start();
+    defer emulator.close();
+
+    const port = try serial.SerialPort.open(io, emulator.slavePath(), testing.allocator);
+    defer port.close(testing.allocator);
+
+    // The slowest of these, wire time and all, is what a round trip costs.
+    var frame: protocol.FrameBuilder = undefined;
+    var normal_ms: i64 = 0;
+    for (0..10) |_| {
+        const sent_ms = time.nowMillis(io);
+        try testing.expect(try port.transport.roundTrip(try protocol.unitDisplayCmd(&frame, 1, "x")));
+        normal_ms = @max(normal_ms, time.nowMillis(io) - sent_ms);
+    }
+
+    // Addressed to another unit: written, never answered.
+    const started_ms = time.nowMillis(io);
+    try testing.expect(!try port.transport.roundTrip(try protocol.unitDisplayCmd(&frame, 2, "x")));
+    try testing.expect(time.nowMillis(io) - started_ms < default_max_timeout_ms / 4);
+
+    // And the link is back in step for the next one once no reply can still
+    // be on its way -- a few round trips, not the ceiling.
+    const resumed_ms = time.nowMillis(io);
+    try testing.expect(try port.transport.roundTrip(try protocol.unitDisplayCmd(&frame, 1, "y")));
+    try testing.expect(time.nowMillis(io) - resumed_ms < 5 * @max(normal_ms, 1));
+}
+
+test "a late reply is never credited to the frame after it" {
+    var threaded: std.Io.Threaded = .init(testing.allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+
+    const panel_emulator = @import("panel_emulator.zig");
+    const protocol = @import("protocol.zig");
+    var emulator = try panel_emulator.Emulator.open(io, .{ .reply_latency_ms = 30 });
+    try emulator.start();
+    defer emulator.close();
+
+    const port = try serial.SerialPort.open(io, emulator.slavePath(), testing.allocator);
+    defer port.close(testing.allocator);
+    // A timer that has only ever seen a quicker panel: late replies are
+    // waited out for twice its round trip, which this one's still makes.
+    port.transport.options.min_timeout_ms = 5;
+    port.transport.options.max_timeout_ms = 300;
+    port.transport.timer = .{ .srtt_us = 15_000, .peak_us = 15_000 };
+
+    // With a floor, as the init frame has, the reply is waited for -- and
+    // not learnt from.
+    var frame: protocol.FrameBuilder = undefined;
+    try testing.expect(try port.transport.roundTripAtLeast(try protocol.unitDisplayCmd(&frame, 1, "i"), 100));
+    try testing.expectEqual(@as(?i64, 15_000), port.transport.timer.srtt_us);
+
+    // Without, it is given up on well before it arrives...
+    try testing.expect(!try port.transport.roundTrip(try protocol.unitDisplayCmd(&frame, 1, "a")));
+    // ...and arrives while the next frame, which nothing answers, is held
+    // back, rather than being taken for that frame's reply.
+    try testing.expect(!try port.transport.roundTrip(try protocol.unitDisplayCmd(&frame, 2, "b")));
+    try testing.expect(port.transport.timer.srtt_us.? > 15_000);
+
+    try testing.expect(try port.transport.roundTrip(try protocol.unitDisplayCmd(&frame, 1, "c")));
+}
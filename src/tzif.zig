@@ -0,0 +1,599 @@
+//! TZif zone files (RFC 8536), read whole: the version 1 data, or the 64-bit
+//! data of version 2 and later, and the POSIX TZ string in the footer that
+//! carries the zone's rules past the last listed transition.
+//!
+//! A `Zone` is parsed once and then answers "what is the offset at t" and
+//! "when does it next change after t" from memory, which is what lets the
+//! display keep local time without going back to `/etc/localtime` every few
+//! seconds to find out whether DST has started: it knows to the second when
+//! it will, and reloads the file only when the file itself changes.
+//!
+//! Everything a `Zone` needs is copied into fixed arrays, so it is a plain
+//! value with no allocation or lifetime to manage. Leap-second records, the
+//! standard/wall and UT/local indicators and the abbreviations are skipped:
+//! nothing here displays or needs them.
+
+const std = @import("std");
+
+/// The offset from UTC in force over some stretch of time.
+pub const LocalType = struct {
+    /// Seconds east of UTC.
+    utoff: i32,
+    is_dst: bool,
+};
+
+/// Largest file `parse` is given by its callers; four times the largest zone
+/// in the tz database.
+pub const max_file_len = 16 * 1024;
+
+/// Transitions a `Zone` can hold. The tz database's longest histories have a
+/// few hundred.
+pub const max_transitions = 1024;
+
+/// Local time types a `Zone` can hold: all a one-byte index can name.
+pub const max_types = 256;
+
+pub const Error = error{ NotTZif, Truncated, TooManyTransitions, Invalid };
+
+/// Offsets the RFC allows: within a day, and not the most negative i32.
+const min_utoff = -89_999;
+const max_utoff = 93_599;
+
+pub const Zone = struct {
+    times: [max_transitions]i64 = undefined,
+    /// Into `types`, one per transition: the type in force from then on.
+    type_index: [max_transitions]u8 = undefined,
+    count: usize = 0,
+    /// `types[0]` applies before the first transition.
+    types: [max_types]LocalType = undefined,
+    type_count: usize = 0,
+    /// The footer, for instants from the last transition onwards. Null in a
+    /// version 1 file, or when the footer is empty.
+    rule: ?Rule = null,
+
+    /// A zone that is `utoff` seconds east of UTC, always.
+    pub fn fixed(utoff: i32) Zone {
+        var zone: Zone = .{ .type_count = 1 };
+        zone.types[0] = .{ .utoff = utoff, .is_dst = false };
+        return zone;
+    }
+
+    pub fn parse(bytes: []const u8) Error!Zone {
+        const v1 = try Header.read(bytes, 0);
+        var header = v1;
+        var data_start: usize = Header.len;
+        var time_size: usize = 4;
+        if (v1.version >= '2') {
+            // The version 1 data is there for old readers only; the 64-bit
+            // copy that follows it is the one to use.
+            const second = Header.len + v1.dataLen(4);
+            header = try Header.read(bytes, second);
+            data_start = second + Header.len;
+            time_size = 8;
+        }
+        if (header.timecnt > max_transitions) return error.TooManyTransitions;
+        if (header.typecnt == 0 or header.typecnt > max_types) return error.Invalid;
+        const data_end = data_start + header.dataLen(time_size);
+        if (data_end > bytes.len) return error.Truncated;
+
+        var zone: Zone = .{ .count = header.timecnt, .type_count = header.typecnt };
+        var pos = data_start;
+        for (zone.times[0..zone.count], 0..) |*t, i| {
+            t.* = if (time_size == 8)
+                std.mem.readInt(i64, bytes[pos..][0..8], .big)
+            else
+                std.mem.readInt(i32, bytes[pos..][0..4], .big);
+            pos += time_size;
+            // Strictly ascending, or the binary searches below mean nothing.
+            if (i > 0 and t.* <= zone.times[i - 1]) return error.Invalid;
+        }
+        for (zone.type_index[0..zone.count]) |*index| {
+            index.* = bytes[pos];
+            pos += 1;
+            if (index.* >= zone.type_count) return error.Invalid;
+        }
+        for (zone.types[0..zone.type_count]) |*local| {
+            const utoff = std.mem.readInt(i32, bytes[pos..][0..4], .big);
+            if (utoff < min_utoff or utoff > max_utoff) return error.Invalid;
+            local.* = .{ .utoff = utoff, .is_dst = bytes[pos + 4] != 0 };
+            pos += 6;
+        }
+
+        if (v1.version >= '2') {
+            const footer = bytes[data_end..];
+            if (footer.len < 2 or footer[0] != '\n') return error.Truncated;
+            const end = std.mem.indexOfScalarPos(u8, footer, 1, '\n') orelse return error.Truncated;
+            if (end > 1) zone.rule = try Rule.parse(footer[1..end]);
+        }
+        return zone;
+    }
+
+    /// The type in force at `t`, Unix seconds.
+    pub fn at(self: *const Zone, t: i64) LocalType {
+        if (self.count == 0) {
+            if (self.rule) |rule| return rule.at(t);
+            return self.types[0];
+        }
+        if (t < self.times[0]) return self.types[0];
+        if (t >= self.times[self.count - 1]) {
+            if (self.rule) |rule| return rule.at(t);
+        }
+        const i = upperBound(self.times[0..self.count], t);
+        return self.types[self.type_index[i - 1]];
+    }
+
+    /// The first instant after `t` at which the offset or DST flag changes,
+    /// or null if it never does again. A transition that only renames the
+    /// zone changes neither, and is passed over.
+    pub fn nextTransition(self: *const Zone, t: i64) ?i64 {
+        if (self.count == 0 or t >= self.times[self.count - 1]) {
+            const rule = self.rule orelse return null;
+            return rule.next(t);
+        }
+        var current = self.at(t);
+        var i = upperBound(self.times[0..self.count], t);
+        while (i < self.count) : (i += 1) {
+            const local = self.types[self.type_index[i]];
+            if (!std.meta.eql(local, current)) return self.times[i];
+            current = local;
+        }
+        // Only renames left in the table; the footer takes it from there.
+        const rule = self.rule orelse return null;
+        return rule.next(self.times[self.count - 1]);
+    }
+};
+
+/// Index of the first entry of `times` greater than `t`.
+fn upperBound(times: []const i64, t: i64) usize {
+    var lo: usize = 0;
+    var hi: usize = times.len;
+    while (lo < hi) {
+        const mid = lo + (hi - lo) / 2;
+        if (times[mid] <= t) lo = mid + 1 else hi = mid;
+    }
+    return lo;
+}
+
+const Header = struct {
+    version: u8,
+    isutcnt: usize,
+    isstdcnt: usize,
+    leapcnt: usize,
+    timecnt: usize,
+    typecnt: usize,
+    charcnt: usize,
+
+    const len = 44;
+
+    fn read(bytes: []const u8, offset: usize) Error!Header {
+        if (bytes.len < offset + len) return if (offset == 0) error.NotTZif else error.Truncated;
+        const h = bytes[offset..][0..len];
+        if (!std.mem.eql(u8, h[0..4], "TZif")) return error.NotTZif;
+        const count = struct {
+            fn at(b: *const [len]u8, i: usize) usize {
+                return std.mem.readInt(u32, b[20 + i * 4 ..][0..4], .big);
+            }
+        }.at;
+        return .{
+            .version = h[4],
+            .isutcnt = count(h, 0),
+            .isstdcnt = count(h, 1),
+            .leapcnt = count(h, 2),
+            .timecnt = count(h, 3),
+            .typecnt = count(h, 4),
+            .charcnt = count(h, 5),
+        };
+    }
+
+    /// Length of the data block after this header, with times of `time_size`
+    /// bytes.
+    fn dataLen(self: Header, time_size: usize) usize {
+        return self.timecnt * time_size + self.timecnt + self.typecnt * 6 + self.charcnt +
+            self.leapcnt * (time_size + 4) + self.isstdcnt + self.isutcnt;
+    }
+};
+
+/// A POSIX TZ string, as in a TZif footer: `CST6CDT,M3.2.0,M11.1.0`.
+pub const Rule = struct {
+    /// Seconds east of UTC outside DST. (The string counts west.)
+    std_off: i32,
+    dst: ?Dst = null,
+
+    pub const Dst = struct {
+        off: i32,
+        /// When DST starts, in standard local time.
+        start: Edge,
+        /// When it ends, in DST local time.
+        end: Edge,
+
+        /// Both changes in `year`, as UTC instants.
+        fn changes(self: Dst, std_off: i32, year: i64) [2]Change {
+            return .{
+                .{ .at = self.start.local(year) - std_off, .dst = true },
+                .{ .at = self.end.local(year) - self.off, .dst = false },
+            };
+        }
+    };
+
+    const Change = struct { at: i64, dst: bool };
+
+    /// A day of the year and a time on it.
+    pub const Edge = struct {
+        date: union(enum) {
+            /// `Jn`: 1-365, February 29 never counted.
+            julian: u16,
+            /// `n`: 0-365, February 29 counted.
+            zero_based: u16,
+            /// `Mm.w.d`: weekday `d` (0 = Sunday) of week `w` (5 = the last)
+            /// of month `m`.
+            month: struct { m: u8, w: u8, d: u8 },
+        },
+        /// Seconds after local midnight; RFC 8536 allows -167 to 167 hours.
+        time: i32 = 2 * 3600,
+
+        /// Local seconds since the epoch at which this falls in `year`.
+        fn local(self: Edge, year: i64) i64 {
+            const jan1 = daysFromCivil(year, 1, 1);
+            const day: i64 = switch (self.date) {
+                .julian => |n| jan1 + n - 1 + @intFromBool(isLeap(year) and n >= 60),
+                .zero_based => |n| jan1 + n,
+                .month => |md| blk: {
+                    const first = daysFromCivil(year, md.m, 1);
+                    // 1970-01-01 was a Thursday.
+                    const weekday = @mod(first + 4, 7);
+                    var dom = 1 + @mod(@as(i64, md.d) - weekday, 7) + (@as(i64, md.w) - 1) * 7;
+                    while (dom > monthLength(year, md.m)) dom -= 7;
+                    break :blk first + dom - 1;
+                },
+            };
+            return day * std.time.s_per_day + self.time;
+        }
+    };
+
+    /// What POSIX leaves to the implementation when a DST zone gives no
+    /// dates: the US rules, as glibc uses.
+    const default_start: Edge = .{ .date = .{ .month = .{ .m = 3, .w = 2, .d = 0 } } };
+    const default_end: Edge = .{ .date = .{ .month = .{ .m = 11, .w = 1, .d = 0 } } };
+
+    pub fn parse(s: []const u8) Error!Rule {
+        var p: Parser = .{ .s = s };
+        try p.name();
+        const std_off = -try p.hms(24);
+        if (p.done()) return .{ .std_off = std_off };
+
+        try p.name();
+        var dst: Dst = .{ .off = std_off + 3600, .start = default_start, .end = default_end };
+        if (!p.done() and p.peek() != ',') dst.off = -try p.hms(24);
+        if (!p.done()) {
+            try p.expect(',');
+            dst.start = try p.edge();
+            try p.expect(',');
+            dst.end = try p.edge();
+        }
+        if (!p.done()) return error.Invalid;
+        return .{ .std_off = std_off, .dst = dst };
+    }
+
+    pub fn at(self: Rule, t: i64) LocalType {
+        const standard: LocalType = .{ .utoff = self.std_off, .is_dst = false };
+        const dst = self.dst orelse return standard;
+        // The latest change at or before `t`. Looking a year either side of
+        // an approximate year is simpler than working out the exact one, and
+        // as good.
+        var latest: ?Change = null;
+        const year = approxYear(t);
+        var y = year - 1;
+        while (y <= year + 1) : (y += 1) {
+            for (dst.changes(self.std_off, y)) |c| {
+                if (c.at <= t and (latest == null or c.at > latest.?.at)) latest = c;
+            }
+        }
+        const in_dst = if (latest) |c| c.dst else false;
+        return if (in_dst) .{ .utoff = dst.off, .is_dst = true } else standard;
+    }
+
+    pub fn next(self: Rule, t: i64) ?i64 {
+        const dst = self.dst orelse return null;
+        var soonest: ?i64 = null;
+        const year = approxYear(t);
+        var y = year - 1;
+        while (y <= year + 2) : (y += 1) {
+            for (dst.changes(self.std_off, y)) |c| {
+                if (c.at > t and (soonest == null or c.at < soonest.?)) soonest = c.at;
+            }
+        }
+        return soonest;
+    }
+};
+
+const Parser = struct {
+    s: []const u8,
+    i: usize = 0,
+
+    fn done(self: *const Parser) bool {
+        return self.i >= self.s.len;
+    }
+
+    fn peek(self: *const Parser) u8 {
+        return self.s[self.i];
+    }
+
+    fn expect(self: *Parser, c: u8) Error!void {
+        if (self.done() or self.peek() != c) return error.Invalid;
+        self.i += 1;
+    }
+
+    /// A zone abbreviation, `CST` or `<+0330>`; only skipped.
+    fn name(self: *Parser) Error!void {
+        if (!self.done() and self.peek() == '<') {
+            const close = std.mem.indexOfScalarPos(u8, self.s, self.i, '>') orelse return error.Invalid;
+            if (close == self.i + 1) return error.Invalid;
+            self.i = close + 1;
+            return;
+        }
+        const start = self.i;
+        while (!self.done() and std.ascii.isAlphabetic(self.peek())) self.i += 1;
+        if (self.i - start < 3) return error.Invalid;
+    }
+
+    fn number(self: *Parser, max: u32) Error!u32 {
+        const start = self.i;
+        var value: u32 = 0;
+        while (!self.done() and std.ascii.isDigit(self.peek())) : (self.i += 1) {
+            value = value * 10 + (self.peek() - '0');
+            if (value > max) return error.Invalid;
+        }
+        if (self.i == start) return error.Invalid;
+        return value;
+    }
+
+    /// `[+-]hh[:mm[:ss]]` in seconds.
+    fn hms(self: *Parser, max_hours: u32) Error!i32 {
+        var sign: i32 = 1;
+        if (!self.done() and (self.peek() == '+' or self.peek() == '-')) {
+            if (self.peek() == '-') sign = -1;
+            self.i += 1;
+        }
+        var seconds: i32 = @intCast(try self.number(max_hours) * 3600);
+        if (!self.done() and self.peek() == ':') {
+            self.i += 1;
+            seconds += @intCast(try self.number(59) * 60);
+            if (!self.done() and self.peek() == ':') {
+                self.i += 1;
+                seconds += @intCast(try self.number(59));
+            }
+        }
+        return sign * seconds;
+    }
+
+    fn edge(self: *Parser) Error!Rule.Edge {
+        var e: Rule.Edge = undefined;
+        if (self.done()) return error.Invalid;
+        switch (self.peek()) {
+            'J' => {
+                self.i += 1;
+                const n = try self.number(365);
+                if (n == 0) return error.Invalid;
+                e = .{ .date = .{ .julian = @intCast(n) } };
+            },
+            'M' => {
+                self.i += 1;
+                const m = try self.number(12);
+                try self.expect('.');
+                const w = try self.number(5);
+                try self.expect('.');
+                const d = try self.number(6);
+                if (m == 0 or w == 0) return error.Invalid;
+                e = .{ .date = .{ .month = .{ .m = @intCast(m), .w = @intCast(w), .d = @intCast(d) } } };
+            },
+            else => e = .{ .date = .{ .zero_based = @intCast(try self.number(365)) } },
+        }
+        if (!self.done() and self.peek() == '/') {
+            self.i += 1;
+            e.time = try self.hms(167);
+        }
+        return e;
+    }
+};
+
+/// Days since 1970-01-01 of a proleptic Gregorian date (Howard Hinnant's
+/// `days_from_civil`).
+fn daysFromCivil(year: i64, month: i64, day: i64) i64 {
+    const y = if (month <= 2) year - 1 else year;
+    const era = @divFloor(y, 400);
+    const yoe = y - era * 400;
+    const mp = @mod(month + 9, 12);
+    const doy = @divFloor(153 * mp + 2, 5) + day - 1;
+    const doe = yoe * 365 + @divFloor(yoe, 4) - @divFloor(yoe, 100) + doy;
+    return era * 146097 + doe - 719468;
+}
+
+fn isLeap(year: i64) bool {
+    return @mod(year, 4) == 0 and (@mod(year, 100) != 0 or @mod(year, 400) == 0);
+}
+
+fn monthLength(year: i64, month: u8) i64 {
+    return switch (month) {
+        2 => if (isLeap(year)) 29 else 28,
+        4, 6, 9, 11 => 30,
+        else => 31,
+    };
+}
+
+/// The year `t` falls in, to within a day either side of New Year.
+fn approxYear(t: i64) i64 {
+    return 1970 + @divFloor(t, 31_556_952); // the mean Gregorian year
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+// 2024's US and Australian DST edges, in UTC.
+const chicago_start_2024 = 1_710_057_600; // 03-10 08:00Z, 02:00 CST
+const chicago_end_2024 = 1_730_617_200; // 11-03 07:00Z, 02:00 CDT
+const chicago_start_2025 = 1_741_507_200; // 2025-03-09 08:00Z
+const sydney_end_2024 = 1_712_419_200; // 04-06 16:00Z, 03:00 AEDT
+const sydney_start_2024 = 1_728_144_000; // 10-05 16:00Z, 02:00 AEST
+
+test "a POSIX rule changes at its edges, either hemisphere" {
+    const chicago = try Rule.parse("CST6CDT,M3.2.0,M11.1.0");
+    try testing.expectEqual(@as(i32, -6 * 3600), chicago.at(chicago_start_2024 - 1).utoff);
+    try testing.expectEqual(LocalType{ .utoff = -5 * 3600, .is_dst = true }, chicago.at(chicago_start_2024));
+    try testing.expectEqual(@as(?i64, chicago_start_2024), chicago.next(chicago_start_2024 - 100 * std.time.s_per_day));
+    try testing.expectEqual(@as(?i64, chicago_end_2024), chicago.next(chicago_start_2024));
+    try testing.expectEqual(@as(?i64, chicago_start_2025), chicago.next(chicago_end_2024));
+    try testing.expect(!chicago.at(chicago_end_2024).is_dst);
+
+    // Sydney is in DST across New Year, and its end is given in DST time.
+    const sydney = try Rule.parse("AEST-10AEDT,M10.1.0,M4.1.0/3");
+    try testing.expectEqual(LocalType{ .utoff = 11 * 3600, .is_dst = true }, sydney.at(1_704_067_200)); // 2024-01-01
+    try testing.expectEqual(@as(?i64, sydney_end_2024), sydney.next(1_704_067_200));
+    try testing.expectEqual(@as(i32, 10 * 3600), sydney.at(sydney_end_2024).utoff);
+    try testing.expectEqual(@as(?i64, sydney_start_2024), sydney.next(sydney_end_2024));
+}
+
+test "POSIX rules: defaults, quoted names, and what is refused" {
+    const fixed = try Rule.parse("<+0330>-3:30");
+    try testing.expectEqual(@as(i32, 3 * 3600 + 30 * 60), fixed.std_off);
+    try testing.expectEqual(@as(?i64, null), fixed.next(0));
+
+    // A DST name with no offset or dates: an hour ahead, on the US dates.
+    const bare = try Rule.parse("EST5EDT");
+    try testing.expectEqual(@as(i32, -4 * 3600), bare.dst.?.off);
+    try testing.expectEqual(@as(?i64, chicago_start_2024 - 3600), bare.next(chicago_start_2024 - 100 * std.time.s_per_day));
+
+    const julian = try Rule.parse("XXX0YYY,J60/0,J300/0");
+    // J60 is March 1 whether or not the year is leap.
+    try testing.expectEqual(@as(?i64, 1_709_251_200), julian.next(1_704_067_200)); // 2024-03-01
+
+    for ([_][]const u8{ "", "CST", "C6", "CST6CDT,M13.1.0,M11.1.0", "CST6CDT,M3.2.0", "CST6CDT,J0,J5", "CST6CDT,M3.2.0,M11.1.0x", "<>6" }) |s| {
+        try testing.expectError(error.Invalid, Rule.parse(s));
+    }
+}
+
+/// A TZif file: a version 1 block then, for `version` '2' and up, a 64-bit
+/// block and `footer`.
+fn buildTZif(
+    buf: *std.ArrayList(u8),
+    version: u8,
+    times: []const i64,
+    indices: []const u8,
+    types: []const LocalType,
+    footer: []const u8,
+) !void {
+    const gpa = testing.allocator;
+    const blocks: []const usize = if (version == 0) &.{4} else &.{ 4, 8 };
+    for (blocks) |time_size| {
+        // The version 1 block of a later version may be empty, as zic writes it.
+        const n = if (version != 0 and time_size == 4) 0 else times.len;
+        try buf.appendSlice(gpa, "TZif");
+        try buf.append(gpa, version);
+        try buf.appendNTimes(gpa, 0, 15);
+        for ([_]usize{ 0, 0, 0, n, types.len, 4 }) |count| {
+            var b: [4]u8 = undefined;
+            std.mem.writeInt(u32, &b, @intCast(count), .big);
+            try buf.appendSlice(gpa, &b);
+        }
+        for (times[0..n]) |t| {
+            var b: [8]u8 = undefined;
+            if (time_size == 8) std.mem.writeInt(i64, b[0..8], t, .big) else std.mem.writeInt(i32, b[0..4], @intCast(t), .big);
+            try buf.appendSlice(gpa, b[0..time_size]);
+        }
+        try buf.appendSlice(gpa, indices[0..n]);
+        for (types) |local| {
+            var b: [6]u8 = .{ 0, 0, 0, 0, @intFromBool(local.is_dst), 0 };
+            std.mem.writeInt(i32, b[0..4], local.utoff, .big);
+            try buf.appendSlice(gpa, &b);
+        }
+        try buf.appendSlice(gpa, "XXX\x00");
+    }
+    if (version != 0) {
+        try buf.append(gpa, '\n');
+        try buf.appendSlice(gpa, footer);
+        try buf.append(gpa, '\n');
+    }
+}
+
+const cst: LocalType = .{ .utoff = -6 * 3600, .is_dst = false };
+const cdt: LocalType = .{ .utoff = -5 * 3600, .is_dst = true };
+
+test "a version 2 zone answers from its table, then from its footer" {
+    var buf: std.ArrayList(u8) = .empty;
+    defer buf.deinit(testing.allocator);
+    const table_end = chicago_start_2024;
+    // 2023's edges, a rename that changes nothing, then 2024's start.
+    try buildTZif(&buf, '2', &.{ 1_678_608_000, 1_699_167_600, 1_700_000_000, table_end }, &.{ 1, 0, 2, 1 }, &.{ cst, cdt, cst }, "CST6CDT,M3.2.0,M11.1.0");
+    const zone = try Zone.parse(buf.items);
+    try testing.expectEqual(@as(usize, 4), zone.count);
+
+    try testing.expectEqual(cst, zone.at(0)); // before the first, type 0
+    try testing.expectEqual(cdt, zone.at(1_678_608_000));
+    try testing.expectEqual(cst, zone.at(1_699_167_600));
+    try testing.expectEqual(cdt, zone.at(table_end)); // from the footer on
+    try testing.expectEqual(cst, zone.at(chicago_end_2024));
+
+    try testing.expectEqual(@as(?i64, 1_678_608_000), zone.nextTransition(0));
+    // The rename is passed over.
+    try testing.expectEqual(@as(?i64, table_end), zone.nextTransition(1_699_167_600));
+    try testing.expectEqual(@as(?i64, chicago_end_2024), zone.nextTransition(table_end));
+    try testing.expectEqual(@as(?i64, chicago_start_2025), zone.nextTransition(chicago_end_2024));
+}
+
+test "a version 1 zone, and the fixed ones" {
+    var buf: std.ArrayList(u8) = .empty;
+    defer buf.deinit(testing.allocator);
+    try buildTZif(&buf, 0, &.{ 1_678_608_000, 1_699_167_600 }, &.{ 1, 0 }, &.{ cst, cdt }, "");
+    const zone = try Zone.parse(buf.items);
+    try testing.expectEqual(cdt, zone.at(1_690_000_000));
+    try testing.expectEqual(cst, zone.at(chicago_start_2024)); // no footer: the last type holds
+    try testing.expectEqual(@as(?i64, null), zone.nextTransition(1_699_167_600));
+
+    buf.clearRetainingCapacity();
+    try buildTZif(&buf, '2', &.{}, &.{}, &.{.{ .utoff = 0, .is_dst = false }}, "UTC0");
+    const utc = try Zone.parse(buf.items);
+    try testing.expectEqual(@as(i32, 0), utc.at(chicago_start_2024).utoff);
+    try testing.expectEqual(@as(?i64, null), utc.nextTransition(0));
+
+    try testing.expectEqual(@as(i32, 3600), Zone.fixed(3600).at(123).utoff);
+}
+
+test "damaged files are refused" {
+    var buf: std.ArrayList(u8) = .empty;
+    defer buf.deinit(testing.allocator);
+    try buildTZif(&buf, '2', &.{ 1_678_608_000, 1_699_167_600 }, &.{ 1, 0 }, &.{ cst, cdt }, "CST6CDT,M3.2.0,M11.1.0");
+
+    try testing.expectError(error.NotTZif, Zone.parse("not a zone file"));
+    try testing.expectError(error.Truncated, Zone.parse(buf.items[0 .. buf.items.len - 30]));
+    // Footer without its closing newline.
+    try testing.expectError(error.Truncated, Zone.parse(buf.items[0 .. buf.items.len - 1]));
+
+    // A type index past the types.
+    const bad_index = try testing.allocator.dupe(u8, buf.items);
+    defer testing.allocator.free(bad_index);
+    // After the version 1 block (no times, two types, four bytes of names),
+    // the second header and two times.
+    const index_pos = Header.len + (2 * 6 + 4) + Header.len + 2 * 8;
+    bad_index[index_pos] = 7;
+    try testing.expectError(error.Invalid, Zone.parse(bad_index));
+
+    // Times out of order.
+    buf.clearRetainingCapacity();
+    try buildTZif(&buf, '2', &.{ 1_699_167_600, 1_678_608_000 }, &.{ 1, 0 }, &.{ cst, cdt }, "");
+    try testing.expectError(error.Invalid, Zone.parse(buf.items));
+}
+
+test "the system's own zone files parse, where there are any" {
+    var threaded: std.Io.Threaded = .init(testing.allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+
+    const bytes = std.Io.Dir.cwd().readFileAlloc(io, "/usr/share/zoneinfo/America/Chicago", testing.allocator, .limited(max_file_len)) catch return error.SkipZigTest;
+    defer testing.allocator.free(bytes);
+    const zone = try Zone.parse(bytes);
+    try testing.expectEqual(cst, zone.at(chicago_start_2024 - 1));
+    try testing.expectEqual(cdt, zone.at(chicago_start_2024));
+    try testing.expectEqual(@as(?i64, chicago_end_2024), zone.nextTransition(chicago_start_2024));
+}
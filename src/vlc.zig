@@ -5,9 +5,13 @@ const protocol = @import("protocol.zig");
 const config = @import("config.zig");
 const time = @import("time.zig");
 const process_mgmt = @import("process_mgmt.zig");
+const bus = @import("bus.zig");
+const render = @import("render.zig");
 const str_utils = @import("str_utils.zig");
-const frame_timer = @import("frame_timer.zig");
+const clock_sync = @import("clock_sync.zig");
 const mode_mod = @import("mode.zig");
+const latency_probe = @import("latency_probe.zig");
+const Cell = @import("cell.zig").Cell;
 const Mode = mode_mod.Mode;
 
 const Writer = std.Io.Writer;
@@ -17,6 +21,12 @@ pub const PLAYCHAR = protocol.DLE ++ "P"; // ►
 pub const PAUSECHAR = "\xba"; // ║
 pub const STOPCHAR = protocol.DLE ++ "G"; // ■
 
+/// Ceiling on how long the display loop sleeps when no second is about to
+/// flip. A status from the receiver -- a pause, a seek, a new file -- wakes
+/// it at once (`StatusCell`'s `changed`); this only bounds how soon it
+/// notices a mode change, a re-init or shutdown, as in Blu-ray mode.
+const DISPLAY_IDLE_SLICE_MS: i64 = 100;
+
 // 0.16 removed the process-global environment accessors; the environment block
 // is handed to `main` instead. `setEnviron` records it so the debug check below
 // keeps working without an allocator.
@@ -45,28 +55,46 @@ fn debugPrint(comptime fmt: []const u8, args: anytype) void {
     }
 }
 
-pub fn runVlcClocks(io: Io, allocator: std.mem.Allocator, port: anytype, mode: *std.atomic.Value(Mode)) !void {
+/// The collator half of a `render.Pipeline`: each frame builds both lines and
+/// publishes them once, and the pipeline's sender -- or, with a `unit`,
+/// `bus.zig`'s scheduler -- sends only the columns that moved. The file name
+/// on line 1 is therefore sent when it changes rather than every frame.
+///
+/// Nothing here touches the network: the status server's datagrams are
+/// received and parsed on `Receiver`'s own thread, and each frame only reads
+/// the latest result. A frame is a cell read, some formatting and a publish.
+///
+/// Passes are scheduled the way Blu-ray mode schedules them: for the instant
+/// the play position next crosses a whole second, as `clock_sync.Timeline`
+/// predicts it on this host's clock, so the displayed second flips on the
+/// millisecond VLC's does rather than up to a frame later.
+pub fn runVlcClocks(io: Io, allocator: std.mem.Allocator, port: anytype, mode: *std.atomic.Value(Mode), unit: ?*bus.Unit) !void {
     dbg.print(.vlc, "Starting VLC run mode...\n", .{});
 
-    // Build the command string dynamically
-    var cmd_parts = std.ArrayList(u8).empty;
-    defer cmd_parts.deinit(allocator);
+    var pipeline: render.Pipeline = .{ .name = "vlc" };
+    try pipeline.start(io, allocator, port, unit);
+    defer pipeline.stop();
 
     var playtime_buf: [maxbufsz]u8 = undefined;
     var linebuf: [maxbufsz]u8 = undefined;
-    var playtime_ms: u64 = 0;
-    var filename: []const u8 = "(No media)";
 
-    // Initialize frame timer for real-time operation
-    var timer = frame_timer.FrameTimer.init(io, 4.0); // 5 FPS target to match server
+    var deadline = pipeline.deadline();
+    // Keeps a correction to the timeline from showing a second twice.
+    var guard: clock_sync.Monotonic = .{};
 
-    // Initialize VLC player
-    var player = VlcPlayer.init(io, allocator);
-    defer player.deinit();
+    var receiver: Receiver = .{};
+    try receiver.start(io);
+    defer receiver.stop();
+
+    // What the previous pass showed, for the benchmark probe only -- see
+    // `latency_probe.zig`.
+    var probe_line1: ?[maxbufsz]u8 = null;
+    var probe_second: ?u64 = null;
 
     while (true) {
-        // Start frame timing
-        timer.frameStart();
+        // Taken before this pass reads the status, so a publish landing
+        // after the read still cuts the sleep below short.
+        const status_seen = receiver.status.changed.seq();
 
         // Check for shutdown signal
         if (process_mgmt.shouldShutdown()) {
@@ -91,34 +119,23 @@ pub fn runVlcClocks(io: Io, allocator: std.mem.Allocator, port: anytype, mode: *
         }
 
         playtime_buf = undefined;
-        cmd_parts.clearAndFree(allocator);
-        try str_utils.clearVorneLineBuf(&linebuf);
 
-        // Get current local timestamp
-        // const utc_timestamp = std.time.timestamp();
-
-        // Update VLC state
-        player.updateState() catch |err| {
-            std.log.err("Failed to update VLC state: {}\n", .{err});
-        };
-
-        // Interpolate play time if playing
-        if (player.state.run_status == .Playing and player.last_message_time > 0) {
-            const now = time.nowMillis(io);
-            const last_msg_i64: i64 = @intCast(player.last_message_time);
-            const elapsed = now - last_msg_i64;
-            const elapsed_u: u64 = if (elapsed > 0) @intCast(elapsed) else 0;
-            player.state.play_time_ms = player.last_vlc_time + elapsed_u;
+        const status = receiver.status.read();
+        const now_ms = time.nowMillis(io);
+        const now_local_us = clock_sync.localMicros(io);
+        // Off the timeline once the receiver has one; until then, off the
+        // wall clocks, on the assumption that the two hosts agree.
+        var playtime_ms = status.playTimeMillis(now_ms);
+        if (status.timeline.valid) {
+            const content_us = guard.apply(&status.timeline, status.timeline.contentMicros(now_local_us));
+            playtime_ms = @intCast(@divFloor(content_us, std.time.us_per_ms));
         }
 
-        playtime_ms = player.state.play_time_ms;
-        filename = player.state.filename;
-
         const playtime_sec = @divFloor(playtime_ms, 1000);
         const playtime_sec_i64: i64 = @intCast(playtime_sec);
         const playtime_hms = time.timedeltaToHms(playtime_sec_i64);
         const playtime_str = time.formatHms(playtime_hms, &playtime_buf) catch unreachable;
-        const runstatus_str = switch (player.state.run_status) {
+        const runstatus_str = switch (status.run_status) {
             .Stopped => STOPCHAR,
             .Playing => PLAYCHAR,
             .Paused => PAUSECHAR,
@@ -126,25 +143,36 @@ pub fn runVlcClocks(io: Io, allocator: std.mem.Allocator, port: anytype, mode: *
 
         // Display filename on first line
         try str_utils.clearVorneLineBuf(&linebuf);
-        try str_utils.copyLeftJustify(&linebuf, filename, 20, null);
-        cmd_parts.clearAndFree(allocator);
-        try protocol.appendStrToCmdList(allocator, &cmd_parts, 1, 1, &linebuf);
-        const cmd1_slice = try cmd_parts.toOwnedSlice(allocator);
-        defer allocator.free(cmd1_slice);
-        _ = protocol.sendUnitDisplayCmd(allocator, port, 1, cmd1_slice) catch |err| return err;
+        try str_utils.copyLeftJustify(&linebuf, status.name(), 20, null);
+        if (latency_probe.active() != null) {
+            if (probe_line1 == null or !std.mem.eql(u8, &probe_line1.?, &linebuf)) latency_probe.contentDue(1, now_ms);
+            probe_line1 = linebuf;
+            // The play position crossed into this second `ms into it` ago.
+            if (probe_second != playtime_sec) {
+                probe_second = playtime_sec;
+                latency_probe.contentDue(2, now_ms - @as(i64, @intCast(playtime_ms % 1000)));
+            }
+        }
+        const line1 = linebuf;
 
         // Display time on second line
         try str_utils.clearVorneLineBuf(&linebuf);
         try str_utils.copyLeftJustify(&linebuf, playtime_str, 20 - runstatus_str.len, null);
         try str_utils.copyRightJustify(&linebuf, runstatus_str, 1, 0);
-        cmd_parts.clearAndFree(allocator);
-        try protocol.appendStrToCmdList(allocator, &cmd_parts, 2, 1, &linebuf);
-        const cmd2_slice = try cmd_parts.toOwnedSlice(allocator);
-        defer allocator.free(cmd2_slice);
-        _ = protocol.sendUnitDisplayCmd(allocator, port, 1, cmd2_slice) catch |err| return err;
-
-        // Handle frame timing and sleep
-        try timer.frameEnd();
+        pipeline.publish(&line1, &linebuf);
+
+        // Sleep until the play position next crosses a second, converted
+        // from the timeline's monotonic clock to the wall clock `Deadline`
+        // keeps, and rounded up: a millisecond late flips the right second,
+        // a millisecond early would redraw the old one and wait another
+        // whole second for the next. A new status cuts it short.
+        var wake_ms = now_ms + DISPLAY_IDLE_SLICE_MS;
+        if (status.timeline.valid) {
+            if (status.timeline.nextSecondAt(now_local_us)) |edge_us| {
+                wake_ms = @min(wake_ms, now_ms + @divFloor(edge_us - now_local_us + std.time.us_per_ms - 1, std.time.us_per_ms));
+            }
+        }
+        deadline.waitUntil(io, now_ms, wake_ms, &receiver.status.changed, status_seen);
     }
 }
 
@@ -154,175 +182,575 @@ pub const VlcPlayerRunStatus = enum {
     Paused,
 };
 
-pub const VlcPlayerState = struct {
-    play_time_ms: u64,
-    run_status: VlcPlayerRunStatus,
-    filename: []const u8,
-    length_ms: u64,
-
-    pub fn init(allocator: std.mem.Allocator) VlcPlayerState {
-        return VlcPlayerState{
-            .play_time_ms = 0,
-            .run_status = .Stopped,
-            .filename = std.fmt.allocPrint(allocator, "No media", .{}) catch unreachable,
-            .length_ms = 0,
-        };
+/// Longest title or file name kept from a datagram, in bytes. Far more than
+/// the 20 columns line 1 can show; anything past it is dropped.
+pub const max_name_len = 128;
+
+/// One status datagram from the VLC status server, parsed in place by
+/// `parseDatagram`. Plain data with no pointers into the datagram, so it can be
+/// copied through `StatusCell` and outlive the buffer it came from.
+pub const Status = struct {
+    /// When the server sent it, on the server's clock; 0 if it did not say.
+    server_ts_ms: i64 = 0,
+    /// The server's monotonic clock when it sent it, and the packet's place
+    /// in the server's sequence. Binary packets only; 0 from JSON.
+    server_mono_us: u64 = 0,
+    seq: u32 = 0,
+    /// The play position when it was sent.
+    time_ms: u64 = 0,
+    duration_ms: u64 = 0,
+    run_status: VlcPlayerRunStatus = .Stopped,
+    /// The title if the media has one, else the file name.
+    name_buf: [max_name_len]u8 = initialName("No media"),
+    name_len: usize = "No media".len,
+    /// The play position against this host's clock, as `Receiver` had
+    /// estimated it when it published this status; not part of the datagram,
+    /// so invalid straight out of the parser.
+    timeline: clock_sync.Timeline = .{},
+
+    pub fn name(self: *const Status) []const u8 {
+        return self.name_buf[0..self.name_len];
     }
 
-    pub fn deinit(self: *VlcPlayerState, allocator: std.mem.Allocator) void {
-        allocator.free(self.filename);
+    /// When it was sent, in microseconds on the server's clock: the
+    /// monotonic one if the packet carried it, since that never steps, else
+    /// the wall clock. Null if it carried neither.
+    pub fn serverMicros(self: *const Status) ?i64 {
+        if (self.server_mono_us != 0) return @intCast(self.server_mono_us);
+        if (self.server_ts_ms > 0) return self.server_ts_ms * std.time.us_per_ms;
+        return null;
+    }
+
+    /// The play position as of `now_ms`: the reported one, plus the time
+    /// since it was reported while playing. Only right to the extent the
+    /// two hosts' wall clocks agree; the display uses `timeline` instead once
+    /// there is one.
+    pub fn playTimeMillis(self: *const Status, now_ms: i64) u64 {
+        if (self.run_status != .Playing or self.server_ts_ms <= 0) return self.time_ms;
+        const elapsed = now_ms - self.server_ts_ms;
+        return self.time_ms + if (elapsed > 0) @as(u64, @intCast(elapsed)) else 0;
+    }
+
+    fn initialName(comptime text: []const u8) [max_name_len]u8 {
+        var buf: [max_name_len]u8 = @splat(0);
+        @memcpy(buf[0..text.len], text);
+        return buf;
     }
 };
 
-pub const VlcPlayer = struct {
-    io: Io,
-    allocator: std.mem.Allocator,
-    state: VlcPlayerState,
-    socket: ?Io.net.Socket,
-    last_update_time: i64,
-    last_processed_ts: u64,
-    last_vlc_time: u64,
-    last_message_time: u64,
-
-    const Self = @This();
-    const MULTICAST_ADDR = "239.255.0.100";
-    const MULTICAST_PORT = 8888;
-    /// How long to wait for a datagram before concluding none are pending.
-    const RECV_TIMEOUT: Io.Timeout = .{ .duration = .{ .raw = .fromMilliseconds(100), .clock = .awake } };
-
-    /// Initialize a new VlcPlayer instance
-    pub fn init(io: Io, allocator: std.mem.Allocator) Self {
-        return Self{
-            .io = io,
-            .allocator = allocator,
-            .state = VlcPlayerState.init(allocator),
-            .socket = null,
-            .last_update_time = 0,
-            .last_processed_ts = 0,
-            .last_vlc_time = 0,
-            .last_message_time = 0,
-        };
+/// Parse one status datagram in either of the server's formats (its
+/// `--format`): a binary packet, or JSON. Null if it is neither.
+pub fn parseDatagram(datagram: []const u8) ?Status {
+    if (std.mem.startsWith(u8, datagram, packet_magic)) return parseStatusPacket(datagram);
+    return parseStatus(datagram);
+}
+
+/// The binary status packet, version 1 -- see `vlc/server/src/network.h`
+/// for the layout, which this must match. Every field is little-endian and
+/// at a fixed offset, so parsing it is a handful of loads: no scanning, no
+/// escapes, nothing to allocate.
+const packet_magic = "VLCS";
+const packet_version = 1;
+/// Where the fixed fields end in version 1. A packet may say its header is
+/// longer -- a later version's extra fields -- and the name then starts
+/// wherever it says.
+const packet_header_len = 48;
+
+const PacketFlags = packed struct(u8) {
+    playing: bool,
+    paused: bool,
+    stopped: bool,
+    loading: bool,
+    name_is_title: bool,
+    _: u3,
+};
+
+/// Parse a binary status packet, or return null if it is malformed or from an
+/// incompatible version.
+pub fn parseStatusPacket(packet: []const u8) ?Status {
+    if (packet.len < packet_header_len) return null;
+    if (!std.mem.eql(u8, packet[0..4], packet_magic)) return null;
+    if (packet[4] != packet_version) return null;
+    const flags: PacketFlags = @bitCast(packet[5]);
+    const name_len = std.mem.readInt(u16, packet[6..8], .little);
+    const header_len = std.mem.readInt(u16, packet[12..14], .little);
+    if (header_len < packet_header_len or packet.len < @as(usize, header_len) + name_len) return null;
+
+    var status: Status = .{
+        .seq = std.mem.readInt(u32, packet[8..12], .little),
+        .server_ts_ms = std.mem.readInt(i64, packet[16..24], .little),
+        .server_mono_us = std.mem.readInt(u64, packet[24..32], .little),
+        .time_ms = std.math.cast(u64, std.mem.readInt(i64, packet[32..40], .little)) orelse 0,
+        .duration_ms = std.math.cast(u64, std.mem.readInt(i64, packet[40..48], .little)) orelse 0,
+        .run_status = if (flags.playing) .Playing else if (flags.stopped) .Stopped else .Paused,
+    };
+    var name = packet[header_len..][0..name_len];
+    if (name.len > max_name_len) {
+        // Cut at the start of a character, as `StatusParser.string` does.
+        var cut: usize = max_name_len;
+        while (cut > 0 and name[cut] & 0xc0 == 0x80) cut -= 1;
+        name = name[0..cut];
     }
+    @memcpy(status.name_buf[0..name.len], name);
+    status.name_len = name.len;
+    return status;
+}
+
+/// Parse one JSON status datagram, or return null if it is not one.
+///
+/// The schema is fixed and flat, so this walks the bytes once and writes
+/// straight into a `Status`: no allocation, no intermediate
+/// `std.json.Value` tree, and strings decoded directly into `name_buf`.
+/// Keys it does not know are skipped, whatever their value.
+///
+/// Both shapes the server has used are accepted: the current flat one
+/// (`time_ms`, `duration_ms`, `is_playing`/`is_paused`/`is_stopped`), and
+/// the older one with the player's fields nested under `vlc_data` (`time`,
+/// `duration`, `is_playing` alone). A nested object's fields are read as if
+/// they were at the top level.
+pub fn parseStatus(datagram: []const u8) ?Status {
+    var parser: StatusParser = .{ .src = datagram };
+    var status: Status = .{};
+    var flags: StatusParser.Flags = .{};
+    parser.skipWhitespace();
+    parser.object(&status, &flags, 0) catch return null;
+    parser.skipWhitespace();
+    if (parser.pos != datagram.len) return null;
+
+    status.run_status = if (flags.playing)
+        .Playing
+    else if (flags.stopped)
+        .Stopped
+    else
+        // `is_playing: false` with nothing else said -- the older shape --
+        // was always shown as paused.
+        .Paused;
+    return status;
+}
 
-    /// Cleanup resources
-    pub fn deinit(self: *Self) void {
-        self.state.deinit(self.allocator);
-        if (self.socket) |sock| {
-            sock.close(self.io);
+const StatusParser = struct {
+    src: []const u8,
+    pos: usize = 0,
+
+    const Error = error{Malformed};
+    /// Deeper than any datagram the server sends; bounds the recursion on
+    /// one that is not.
+    const max_depth = 4;
+
+    const Flags = struct {
+        playing: bool = false,
+        stopped: bool = false,
+        have_title: bool = false,
+    };
+
+    fn object(self: *StatusParser, status: *Status, flags: *Flags, depth: u8) Error!void {
+        if (depth > max_depth) return error.Malformed;
+        try self.expect('{');
+        self.skipWhitespace();
+        if (self.eat('}')) return;
+        while (true) {
+            self.skipWhitespace();
+            var key_buf: [32]u8 = undefined;
+            const key = try self.string(&key_buf);
+            self.skipWhitespace();
+            try self.expect(':');
+            self.skipWhitespace();
+
+            if (self.peek() == '{') {
+                try self.object(status, flags, depth + 1);
+            } else if (std.mem.eql(u8, key, "server_timestamp")) {
+                status.server_ts_ms = try self.integer();
+            } else if (std.mem.eql(u8, key, "time_ms") or std.mem.eql(u8, key, "time")) {
+                status.time_ms = std.math.cast(u64, try self.integer()) orelse 0;
+            } else if (std.mem.eql(u8, key, "duration_ms") or std.mem.eql(u8, key, "duration")) {
+                status.duration_ms = std.math.cast(u64, try self.integer()) orelse 0;
+            } else if (std.mem.eql(u8, key, "is_playing")) {
+                flags.playing = try self.boolean();
+            } else if (std.mem.eql(u8, key, "is_stopped")) {
+                flags.stopped = try self.boolean();
+            } else if (std.mem.eql(u8, key, "title")) {
+                // Decoded in place over whatever is there; kept only if it
+                // turns out non-empty.
+                var title_buf: [max_name_len]u8 = undefined;
+                const title = try self.string(&title_buf);
+                if (title.len > 0) {
+                    @memcpy(status.name_buf[0..title.len], title);
+                    status.name_len = title.len;
+                    flags.have_title = true;
+                }
+            } else if (std.mem.eql(u8, key, "filename") and !flags.have_title) {
+                status.name_len = (try self.string(&status.name_buf)).len;
+            } else {
+                try self.skipValue(depth + 1);
+            }
+
+            self.skipWhitespace();
+            if (self.eat(',')) continue;
+            try self.expect('}');
+            return;
         }
     }
 
-    /// Update player state from multicast messages
-    pub fn updateState(self: *Self) !void {
-        if (self.socket == null) {
-            try self.connectMulticast();
+    fn peek(self: *const StatusParser) ?u8 {
+        return if (self.pos < self.src.len) self.src[self.pos] else null;
+    }
+
+    fn eat(self: *StatusParser, c: u8) bool {
+        if (self.peek() != c) return false;
+        self.pos += 1;
+        return true;
+    }
+
+    fn expect(self: *StatusParser, c: u8) Error!void {
+        if (!self.eat(c)) return error.Malformed;
+    }
+
+    fn skipWhitespace(self: *StatusParser) void {
+        while (self.peek()) |c| : (self.pos += 1) {
+            if (c != ' ' and c != '\t' and c != '\r' and c != '\n') return;
         }
+    }
+
+    fn literal(self: *StatusParser, word: []const u8) bool {
+        if (!std.mem.startsWith(u8, self.src[self.pos..], word)) return false;
+        self.pos += word.len;
+        return true;
+    }
+
+    fn boolean(self: *StatusParser) Error!bool {
+        if (self.literal("true")) return true;
+        if (self.literal("false")) return false;
+        return error.Malformed;
+    }
 
-        // Receive all available messages, keeping only the latest
-        var latest_message: ?[]const u8 = null;
-        var latest_server_ts_ms: ?i64 = null;
-        var latest_bytes: usize = 0;
+    /// A JSON number, truncated to an integer: any fraction or exponent is
+    /// consumed and ignored.
+    fn integer(self: *StatusParser) Error!i64 {
+        const negative = self.eat('-');
+        var value: i64 = 0;
+        var digits: usize = 0;
+        while (self.peek()) |c| : (self.pos += 1) {
+            if (!std.ascii.isDigit(c)) break;
+            value = std.math.mul(i64, value, 10) catch return error.Malformed;
+            value = std.math.add(i64, value, c - '0') catch return error.Malformed;
+            digits += 1;
+        }
+        if (digits == 0) return error.Malformed;
+        while (self.peek()) |c| : (self.pos += 1) {
+            switch (c) {
+                '0'...'9', '.', 'e', 'E', '+', '-' => {},
+                else => break,
+            }
+        }
+        return if (negative) -value else value;
+    }
 
+    /// Decode a JSON string into `out`, returning the part of `out` used.
+    /// Text past `out.len` is consumed and dropped, never split mid-character.
+    fn string(self: *StatusParser, out: []u8) Error![]const u8 {
+        try self.expect('"');
+        var len: usize = 0;
+        var full = false;
         while (true) {
-            var buffer: [1024]u8 = undefined;
+            const c = self.peek() orelse return error.Malformed;
+            self.pos += 1;
+            var utf8: [4]u8 = undefined;
+            const bytes: []const u8 = switch (c) {
+                '"' => return out[0..len],
+                '\\' => blk: {
+                    const e = self.peek() orelse return error.Malformed;
+                    self.pos += 1;
+                    break :blk switch (e) {
+                        '"', '\\', '/' => self.src[self.pos - 1 .. self.pos],
+                        'b' => "\x08",
+                        'f' => "\x0c",
+                        'n' => "\n",
+                        'r' => "\r",
+                        't' => "\t",
+                        'u' => utf8[0 .. std.unicode.utf8Encode(try self.codepoint(), &utf8) catch unreachable],
+                        else => return error.Malformed,
+                    };
+                },
+                0...0x1f => return error.Malformed,
+                else => self.src[self.pos - 1 .. self.pos],
+            };
+            // Once full, keep scanning to the closing quote, copying nothing.
+            if (full) continue;
+            // Unescaped text arrives a byte at a time, so a character's lead
+            // byte is only copied if the whole character will fit; its
+            // continuation bytes then always do.
+            const need = if (bytes.len == 1 and bytes[0] >= 0xc0)
+                std.unicode.utf8ByteSequenceLength(bytes[0]) catch 1
+            else
+                bytes.len;
+            if (len + need > out.len) {
+                full = true;
+                continue;
+            }
+            @memcpy(out[len..][0..bytes.len], bytes);
+            len += bytes.len;
+        }
+    }
 
-            const result = self.socket.?.receiveTimeout(self.io, &buffer, Self.RECV_TIMEOUT);
+    /// The code point of a `\uXXXX` escape, following a surrogate pair to its
+    /// second half. An unpaired surrogate decodes as U+FFFD.
+    fn codepoint(self: *StatusParser) Error!u21 {
+        const first = try self.hex4();
+        if (first < 0xd800 or first > 0xdfff) return first;
+        if (first > 0xdbff or !self.literal("\\u")) return 0xfffd;
+        const second = try self.hex4();
+        if (second < 0xdc00 or second > 0xdfff) return 0xfffd;
+        return 0x10000 + ((@as(u21, first) - 0xd800) << 10) + (second - 0xdc00);
+    }
 
-            if (result) |incoming| {
-                const bytes_read = incoming.data.len;
-                const message = self.allocator.dupe(u8, incoming.data) catch {
-                    std.log.err("VLC: Failed to allocate memory for message\n", .{});
-                    continue;
-                };
+    fn hex4(self: *StatusParser) Error!u16 {
+        if (self.src.len - self.pos < 4) return error.Malformed;
+        const value = std.fmt.parseInt(u16, self.src[self.pos..][0..4], 16) catch return error.Malformed;
+        self.pos += 4;
+        return value;
+    }
 
-                // Parse server_timestamp to compare
-                var json = std.json.parseFromSlice(std.json.Value, self.allocator, message, .{}) catch {
-                    std.log.warn("VLC: JSON parse error\n", .{});
-                    self.allocator.free(message);
-                    continue;
-                };
-                defer json.deinit();
-
-                var server_ts_ms: ?i64 = null;
-                if (json.value == .object) {
-                    const obj = &json.value.object;
-                    if (obj.get("server_timestamp")) |ts_val| {
-                        if (ts_val == .integer) {
-                            server_ts_ms = ts_val.integer;
-                        }
+    fn skipValue(self: *StatusParser, depth: u8) Error!void {
+        if (depth > max_depth) return error.Malformed;
+        var discard: [0]u8 = .{};
+        switch (self.peek() orelse return error.Malformed) {
+            '"' => _ = try self.string(&discard),
+            '{', '[' => |open| {
+                const close: u8 = if (open == '{') '}' else ']';
+                self.pos += 1;
+                self.skipWhitespace();
+                if (self.eat(close)) return;
+                while (true) {
+                    self.skipWhitespace();
+                    if (open == '{') {
+                        _ = try self.string(&discard);
+                        self.skipWhitespace();
+                        try self.expect(':');
+                        self.skipWhitespace();
                     }
+                    try self.skipValue(depth + 1);
+                    self.skipWhitespace();
+                    if (self.eat(',')) continue;
+                    try self.expect(close);
+                    return;
                 }
+            },
+            't', 'f' => _ = try self.boolean(),
+            'n' => if (!self.literal("null")) return error.Malformed,
+            else => _ = try self.integer(),
+        }
+    }
+};
 
-                // Keep the latest message
-                if (latest_message) |old_msg| {
-                    self.allocator.free(old_msg);
-                }
-                latest_message = message;
-                latest_server_ts_ms = server_ts_ms;
-                latest_bytes = bytes_read;
-            } else |err| switch (err) {
-                error.Timeout => {
-                    // No more messages
-                    break;
-                },
-                else => {
-                    std.log.err("VLC: Socket error: {}\n", .{err});
-                    if (latest_message) |msg| self.allocator.free(msg);
-                    return err;
-                },
-            }
+/// Hands the receiver thread's latest `Status` to the display loop: a
+/// `cell.Cell`, so the display never waits on the receiver, nor on a receiver
+/// descheduled halfway through a publish.
+pub const StatusCell = Cell(Status);
+
+/// Which statuses are new enough to publish: those sent after the last one
+/// published, by `Status.serverMicros`, so a datagram delayed behind a later
+/// one is never shown. That is the server's monotonic clock where the packet
+/// carries it, which never steps; where it does not, it is the wall clock,
+/// which can -- and a wall clock stepped back would otherwise have every
+/// datagram after it discarded as old, freezing the display for the size of
+/// the step. So the order starts over whenever `clock_sync.ClockSync` sees
+/// the server's clock step or restart.
+const SendOrder = struct {
+    last_us: ?i64 = null,
+    /// `ClockSync.resets` as of `last_us`.
+    resets: u32 = 0,
+
+    /// Whether a status sent at `server_us` -- null if it did not say -- is
+    /// to be published, given the clock's `resets` so far.
+    fn accept(self: *SendOrder, server_us: ?i64, resets: u32) bool {
+        if (resets != self.resets) {
+            self.resets = resets;
+            self.last_us = null;
         }
+        const us = server_us orelse return true;
+        if (self.last_us) |last| {
+            if (us <= last) return false;
+        }
+        self.last_us = us;
+        return true;
+    }
+};
 
-        // Process the latest message if any
-        if (latest_message) |message| {
-            defer self.allocator.free(message);
+/// Receives the status server's multicast datagrams on a thread of its own.
+///
+/// The display loop used to drain the socket itself, every frame, with a
+/// 100 ms receive timeout to notice the socket was empty -- most of a 250 ms
+/// frame spent waiting for nothing, then a heap copy and two full JSON parses
+/// of the message it kept. Here the thread blocks in `poll` until something
+/// arrives, takes whatever burst is queued in one `recvmmsg`, parses each --
+/// cheaply, see `parseDatagram` -- and publishes the newest to `status`. The
+/// display reads `status` and never touches the socket.
+///
+/// Every datagram's server timestamp, against the instant it was taken off
+/// the socket, is also a sample of how the server's clock runs against ours;
+/// see `clock_sync.zig`. Each published status carries the resulting
+/// `clock_sync.Timeline`.
+pub const Receiver = struct {
+    status: StatusCell = .init(.{}),
+    stopping: std.atomic.Value(bool) = .init(false),
+    thread: ?std.Thread = null,
+
+    /// Where the status server sends: `MULTICAST_IP` and `MULTICAST_PORT`
+    /// in vlc/server/src/network.h, which must match.
+    const MULTICAST_ADDR = "239.255.0.100";
+    const MULTICAST_PORT = 8888;
+    /// How long `poll` waits before checking `stopping` again. Only bounds
+    /// how long `stop` takes; a datagram wakes the thread at once.
+    const RECEIVE_SLICE_MS = 200;
+    /// How long to wait before trying again after the socket could not be
+    /// set up, or failed.
+    const RETRY_MS = 1000;
+    /// Datagrams taken per `recvmmsg`. The server sends a burst of four on
+    /// each change and a heartbeat otherwise, so more queued than this means
+    /// the thread was starved; the rest are taken on the next call.
+    const batch_len = 8;
+    /// The largest JSON datagram the server sends: both names at their
+    /// longest with every byte escaped. A binary packet is at most 303 bytes.
+    const max_datagram = 4096;
+
+    /// `self` must not move until `stop`.
+    pub fn start(self: *Receiver, io: Io) !void {
+        self.thread = try std.Thread.spawn(.{}, receiveLoop, .{ self, io });
+    }
 
-            const now_ms = time.nowMillis(self.io);
+    pub fn stop(self: *Receiver) void {
+        self.stopping.store(true, .release);
+        if (self.thread) |t| t.join();
+        self.thread = null;
+    }
 
-            // Parse and process the latest message
-            var json = std.json.parseFromSlice(std.json.Value, self.allocator, message, .{}) catch {
-                std.log.warn("VLC: JSON parse error\n", .{});
-                return;
+    fn receiveLoop(self: *Receiver, io: Io) void {
+        const linux = std.os.linux;
+
+        var buffers: [batch_len][max_datagram]u8 = undefined;
+        var iovecs: [batch_len]std.posix.iovec = undefined;
+        var messages: [batch_len]linux.mmsghdr = undefined;
+        for (&buffers, &iovecs, &messages) |*buf, *iov, *msg| {
+            iov.* = .{ .base = buf, .len = buf.len };
+            msg.* = .{
+                .hdr = .{
+                    .name = null,
+                    .namelen = 0,
+                    .iov = @ptrCast(iov),
+                    .iovlen = 1,
+                    .control = null,
+                    .controllen = 0,
+                    .flags = 0,
+                },
+                .len = 0,
             };
-            defer json.deinit();
-
-            var server_ts_ms: ?i64 = null;
-            if (json.value == .object) {
-                const obj = &json.value.object;
-                if (obj.get("server_timestamp")) |ts_val| {
-                    if (ts_val == .integer) {
-                        server_ts_ms = ts_val.integer;
-                    }
-                }
+        }
+
+        var socket: ?std.posix.socket_t = null;
+        defer if (socket) |open_fd| {
+            _ = linux.close(open_fd);
+        };
+        var order: SendOrder = .{};
+        var sync: clock_sync.ClockSync = .{};
+        var play: clock_sync.PlayClock = .{};
+
+        while (!self.stopping.load(.acquire)) {
+            const fd = socket orelse blk: {
+                const opened = openMulticast() catch |err| {
+                    std.log.err("VLC: cannot join status multicast: {}\n", .{err});
+                    io.sleep(.fromMilliseconds(RETRY_MS), .awake) catch return;
+                    continue;
+                };
+                socket = opened;
+                break :blk opened;
+            };
+
+            var pfd = [1]linux.pollfd{.{ .fd = fd, .events = linux.POLL.IN, .revents = 0 }};
+            const ready = linux.poll(&pfd, 1, RECEIVE_SLICE_MS);
+            switch (linux.errno(ready)) {
+                .SUCCESS => if (ready == 0) continue,
+                .INTR => continue,
+                else => |e| {
+                    std.log.err("VLC: poll failed: {s}\n", .{@tagName(e)});
+                    io.sleep(.fromMilliseconds(RETRY_MS), .awake) catch return;
+                    continue;
+                },
             }
 
-            var delta_ms: ?i64 = null;
-            if (server_ts_ms) |ts_ms| {
-                delta_ms = now_ms - ts_ms;
-                // Discard if message is older than last processed
-                if (ts_ms <= self.last_processed_ts) {
-                    debugPrint("VLC: Discarding old message (server_ts: {}, last_processed: {})\n", .{ ts_ms, self.last_processed_ts });
-                    return;
+            const received = linux.recvmmsg(fd, &messages, batch_len, linux.MSG.DONTWAIT, null);
+            switch (linux.errno(received)) {
+                .SUCCESS => {},
+                .AGAIN, .INTR => continue,
+                else => |e| {
+                    // Start over with a fresh socket rather than spin on a
+                    // broken one.
+                    std.log.err("VLC: socket error: {s}\n", .{@tagName(e)});
+                    _ = linux.close(fd);
+                    socket = null;
+                    io.sleep(.fromMilliseconds(RETRY_MS), .awake) catch return;
+                    continue;
+                },
+            }
+
+            // One arrival time for the whole batch, taken as soon as it is
+            // off the socket. Any but the last may have queued a while
+            // first, which to `ClockSync` looks like a delayed packet and is
+            // filtered out as one.
+            const arrived_us = clock_sync.localMicros(io);
+
+            // Every datagram is parsed, since each timestamp is a sample for
+            // `sync`, but only the newest of the burst is published -- and
+            // "newest" is the server's say, not arrival order.
+            var newest: ?Status = null;
+            var newest_us: ?i64 = null;
+            for (messages[0..received], buffers[0..received]) |msg, *buf| {
+                const datagram = buf[0..msg.len];
+                const status = parseDatagram(datagram) orelse {
+                    std.log.warn("VLC: ignoring a malformed status datagram ({d} bytes)\n", .{datagram.len});
+                    continue;
+                };
+                debugPrint("VLC: Received {} bytes. Server ts: {}\n", .{ datagram.len, status.server_ts_ms });
+                const server_us = status.serverMicros();
+                if (server_us) |us| {
+                    const resets = sync.resets;
+                    sync.sample(us, arrived_us);
+                    if (sync.resets != resets) {
+                        std.log.info("VLC: status server clock stepped or restarted, resynchronising\n", .{});
+                        // What came before the step does not compare with
+                        // what comes after it.
+                        newest = null;
+                    }
                 }
-                self.last_processed_ts = std.math.cast(u64, ts_ms) orelse 0;
+                if (newest == null or server_us == null or newest_us == null or server_us.? >= newest_us.?) {
+                    newest = status;
+                    newest_us = server_us;
+                }
+            }
+            var status = newest orelse continue;
+            if (!order.accept(newest_us, sync.resets)) {
+                debugPrint("VLC: Discarding old message (server us: {?d}, last published: {?d})\n", .{ newest_us, order.last_us });
+                continue;
             }
-            debugPrint("VLC: Received {} bytes. Server ts: {any}, Local ts: {}, Delta: {any} ms\n", .{ latest_bytes, latest_server_ts_ms, now_ms, delta_ms });
-            try self.parseMessage(message);
-            if (server_ts_ms) |ts_ms| {
-                self.last_message_time = std.math.cast(u64, ts_ms) orelse 0;
+            if (newest_us) |server_us| {
+                play.sample(server_us, status.time_ms, status.run_status == .Playing);
+                status.timeline = .compose(&sync, &play);
+                debugPrint("VLC: skew {d:.1} ppm, play clock {s}\n", .{ sync.skewPpm(), @tagName(play.phase) });
             }
+            self.status.publish(status);
         }
     }
 
-    /// Connect to multicast group
-    fn connectMulticast(self: *Self) !void {
+    /// A UDP socket bound to the status port and joined to the status group.
+    ///
+    /// `IpAddress.bind` would create and bind the socket in one step, but it
+    /// offers no way to set SO_REUSEADDR/SO_REUSEPORT, which must be applied
+    /// *before* bind so several receivers -- one per display in VLC mode --
+    /// can share the multicast port. So the socket is made by hand, and kept
+    /// as a raw descriptor since `recvmmsg` and `poll` want one anyway.
+    fn openMulticast() !std.posix.socket_t {
+        const linux = std.os.linux;
         dbg.print(.vlc, "Creating UDP socket for VLC status multicast...\n", .{});
 
-        // `IpAddress.bind` would create and bind the socket in one step, but it
-        // offers no way to set SO_REUSEADDR/SO_REUSEPORT, which must be applied
-        // *before* bind so several receivers can share the multicast port. So
-        // create the socket by hand and wrap the fd in an `Io.net.Socket`.
-        const linux = std.os.linux;
         const sock_fd: std.posix.socket_t = blk: {
             const rc = linux.socket(linux.AF.INET, linux.SOCK.DGRAM | linux.SOCK.CLOEXEC, 0);
             if (linux.errno(rc) != .SUCCESS) return error.SocketCreateFailed;
@@ -330,31 +758,21 @@ pub const VlcPlayer = struct {
         };
         errdefer _ = linux.close(sock_fd);
 
-        dbg.print(.vlc, "VLC: Socket created successfully\n", .{});
-
         // Allow multiple sockets to bind to the same port
         try std.posix.setsockopt(sock_fd, std.posix.SOL.SOCKET, std.posix.SO.REUSEADDR, &std.mem.toBytes(@as(c_int, 1)));
         try std.posix.setsockopt(sock_fd, std.posix.SOL.SOCKET, std.posix.SO.REUSEPORT, &std.mem.toBytes(@as(c_int, 1)));
 
-        // Bind to the multicast port
-        const bind_address: Io.net.IpAddress = try .parse("0.0.0.0", Self.MULTICAST_PORT);
         var sa: linux.sockaddr.in = .{
-            .port = std.mem.nativeToBig(u16, Self.MULTICAST_PORT),
+            .port = std.mem.nativeToBig(u16, MULTICAST_PORT),
             .addr = 0, // INADDR_ANY
         };
         if (linux.errno(linux.bind(sock_fd, @ptrCast(&sa), @sizeOf(linux.sockaddr.in))) != .SUCCESS) {
             return error.BindFailed;
         }
-
-        // The receive timeout that used to be set via SO_RCVTIMEO is now passed
-        // per-call to `receiveTimeout`.
-        const sock: Io.net.Socket = .{ .handle = sock_fd, .address = bind_address };
-        self.socket = sock;
-
-        dbg.print(.vlc, "VLC: Bound to 0.0.0.0:{}\n", .{Self.MULTICAST_PORT});
+        dbg.print(.vlc, "VLC: Bound to 0.0.0.0:{}\n", .{MULTICAST_PORT});
 
         // Join the multicast group using raw socket options
-        const multicast_addr: Io.net.IpAddress = try .parse(Self.MULTICAST_ADDR, Self.MULTICAST_PORT);
+        const multicast_addr: Io.net.IpAddress = try .parse(MULTICAST_ADDR, MULTICAST_PORT);
 
         // Create the ip_mreq structure manually
         var mreq: [8]u8 = undefined; // ip_mreq is 8 bytes
@@ -363,100 +781,120 @@ pub const VlcPlayer = struct {
         // imr_interface (next 4 bytes) - interface address (INADDR_ANY)
         @memset(mreq[4..8], 0);
 
-        try std.posix.setsockopt(sock.handle, std.posix.IPPROTO.IP, std.os.linux.IP.ADD_MEMBERSHIP, &mreq);
+        try std.posix.setsockopt(sock_fd, std.posix.IPPROTO.IP, std.os.linux.IP.ADD_MEMBERSHIP, &mreq);
 
-        dbg.print(.vlc, "VLC: Joined multicast group {s}\n", .{Self.MULTICAST_ADDR});
+        dbg.print(.vlc, "VLC: Joined multicast group {s}\n", .{MULTICAST_ADDR});
+        return sock_fd;
     }
+};
 
-    /// Parse JSON message from VLC extension
-    fn parseMessage(self: *Self, message: []const u8) !void {
-        debugPrint("VLC: Parsing message: {s}\n", .{message});
-
-        // Parse the new JSON format from C server: {"server_timestamp":<ms>,"server_id":"...","vlc_data":{...}}
-        var json = std.json.parseFromSlice(std.json.Value, self.allocator, message, .{}) catch {
-            std.log.warn("VLC: JSON parse error\n", .{});
-            return;
-        };
-        defer json.deinit();
-
-        if (json.value != .object) {
-            std.log.warn("VLC: Root is not an object\n", .{});
-            return;
-        }
-
-        const obj = &json.value.object;
-
-        // Get the vlc_data object
-        const vlc_data = obj.get("vlc_data") orelse {
-            std.log.warn("VLC: No vlc_data found in message\n", .{});
-            return;
-        };
-
-        if (vlc_data != .object) {
-            std.log.warn("VLC: vlc_data is not an object\n", .{});
-            return;
-        }
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+
+const testing = std.testing;
+
+test "parseStatus reads the server's datagram without allocating" {
+    const status = parseStatus(
+        \\{"server_timestamp": 1700000000123,"state": "Playing","is_playing": true,"is_paused": false,
+        \\"is_stopped": false,"is_loading": false,"media_status": "Loaded","time_ms": 61500,
+        \\"duration_ms": 7200000,"title": "","filename": "movie.mkv"}
+    ).?;
+    try testing.expectEqual(@as(i64, 1700000000123), status.server_ts_ms);
+    try testing.expectEqual(@as(u64, 61500), status.time_ms);
+    try testing.expectEqual(@as(u64, 7200000), status.duration_ms);
+    try testing.expectEqual(VlcPlayerRunStatus.Playing, status.run_status);
+    try testing.expectEqualStrings("movie.mkv", status.name());
+    try testing.expectEqual(@as(u64, 62000), status.playTimeMillis(1700000000623));
+}
 
-        const data_obj = &vlc_data.object;
+test "parseStatus prefers a title and reads the older nested shape" {
+    const status = parseStatus(
+        \\{"server_timestamp":5,"server_id":"x","vlc_data":{"filename":"a.mkv","title":"Caf\u00e9 \"Noir\"",
+        \\"time":1000,"duration":2000,"is_playing":false,"extra":[1,{"b":null}]}}
+    ).?;
+    try testing.expectEqualStrings("Caf\u{e9} \"Noir\"", status.name());
+    try testing.expectEqual(@as(u64, 1000), status.time_ms);
+    try testing.expectEqual(VlcPlayerRunStatus.Paused, status.run_status);
+    // Not playing, so not advanced.
+    try testing.expectEqual(@as(u64, 1000), status.playTimeMillis(1_000_000));
+}
 
-        // Parse title or filename
-        var new_display_name: ?[]const u8 = null;
-        if (data_obj.get("title")) |title_val| {
-            if (title_val == .string and title_val.string.len > 0) {
-                new_display_name = title_val.string;
-                debugPrint("VLC: Parsed title: {s}\n", .{title_val.string});
-            }
-        }
-        if (new_display_name == null) {
-            if (data_obj.get("filename")) |filename_val| {
-                if (filename_val == .string) {
-                    new_display_name = filename_val.string;
-                    debugPrint("VLC: Parsed filename: {s}\n", .{filename_val.string});
-                }
-            }
-        }
-        if (new_display_name) |name| {
-            // Free old filename and allocate new one
-            self.allocator.free(self.state.filename);
-            self.state.filename = try self.allocator.dupe(u8, name);
-        }
+test "parseStatus rejects what is not a status datagram" {
+    try testing.expect(null == parseStatus(""));
+    try testing.expect(null == parseStatus("{\"time_ms\": }"));
+    try testing.expect(null == parseStatus("{\"title\": \"unterminated}"));
+    try testing.expect(null == parseStatus("{} trailing"));
+    try testing.expect(null == parseStatus("{\"a\":{\"b\":{\"c\":{\"d\":{\"e\":{}}}}}}"));
+}
 
-        // Parse duration (in milliseconds)
-        if (data_obj.get("duration")) |duration_val| {
-            if (duration_val == .integer) {
-                self.state.length_ms = std.math.cast(u64, duration_val.integer) orelse 0;
-                debugPrint("VLC: Parsed duration: {} ms\n", .{duration_val.integer});
-            }
-        }
+test "a long name is cut at a character boundary" {
+    var datagram: [max_name_len + 64]u8 = undefined;
+    var w: Writer = .fixed(&datagram);
+    try w.writeAll("{\"filename\":\"");
+    for (0..max_name_len - 1) |_| try w.writeByte('x');
+    try w.writeAll("\u{e9}\u{e9}\"}");
+    const status = parseStatus(w.buffered()).?;
+    try testing.expectEqual(@as(usize, max_name_len - 1), status.name_len);
+    try testing.expect(std.unicode.utf8ValidateSlice(status.name()));
+}
 
-        // Parse time (in milliseconds) - now the primary source of timing
-        if (data_obj.get("time")) |time_val| {
-            if (time_val == .integer) {
-                const time_ms = std.math.cast(u64, time_val.integer) orelse 0;
-                self.state.play_time_ms = time_ms;
-                self.last_vlc_time = time_ms;
-                debugPrint("VLC: Parsed time: {} ms\n", .{time_val.integer});
-            }
-        }
+test "parseStatusPacket reads the server's binary packet" {
+    // As `create_status_packet` builds it: seq 7, playing, "a\"b\\c\n.mkv".
+    const packet = [_]u8{
+        0x56, 0x4c, 0x43, 0x53, 0x01, 0x01, 0x0a, 0x00, 0x07, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00,
+        0x7b, 0x68, 0xe5, 0xcf, 0x8b, 0x01, 0x00, 0x00, 0x4e, 0x61, 0xbc, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x3c, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xdd, 0x6d, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x61, 0x22, 0x62, 0x5c, 0x63, 0x0a, 0x2e, 0x6d, 0x6b, 0x76,
+    };
+    const status = parseDatagram(&packet).?;
+    try testing.expectEqual(@as(u32, 7), status.seq);
+    try testing.expectEqual(@as(i64, 1700000000123), status.server_ts_ms);
+    try testing.expectEqual(@as(u64, 12345678), status.server_mono_us);
+    try testing.expectEqual(@as(u64, 61500), status.time_ms);
+    try testing.expectEqual(@as(u64, 7200000), status.duration_ms);
+    try testing.expectEqual(VlcPlayerRunStatus.Playing, status.run_status);
+    try testing.expectEqualStrings("a\"b\\c\n.mkv", status.name());
+
+    // A name running past the end, or a version this does not know.
+    try testing.expect(null == parseDatagram(packet[0 .. packet.len - 1]));
+    var future = packet;
+    future[4] = 2;
+    try testing.expect(null == parseDatagram(&future));
+}
 
-        // Parse playing state
-        if (data_obj.get("is_playing")) |playing_val| {
-            if (playing_val == .bool) {
-                debugPrint("VLC: Parsed is_playing: {}\n", .{playing_val.bool});
-                if (playing_val.bool) {
-                    self.state.run_status = .Playing;
-                } else {
-                    // Could be paused or stopped, we'll assume paused for now
-                    self.state.run_status = .Paused;
-                }
-            }
-        }
+test "the server's monotonic clock is preferred as its timestamp" {
+    var status: Status = .{ .server_ts_ms = 1_700_000_000_123 };
+    try testing.expectEqual(@as(?i64, 1_700_000_000_123_000), status.serverMicros());
+    status.server_mono_us = 42_000_000;
+    try testing.expectEqual(@as(?i64, 42_000_000), status.serverMicros());
+    try testing.expect(null == (Status{}).serverMicros());
+    try testing.expect(!status.timeline.valid);
+}
 
-        debugPrint("VLC: State updated successfully\n", .{});
-    }
+test "statuses are published in send order, which starts over when the clock steps" {
+    var order: SendOrder = .{};
+    try testing.expect(order.accept(5_000_000, 0));
+    // Delayed behind a later one.
+    try testing.expect(!order.accept(4_000_000, 0));
+    try testing.expect(order.accept(6_000_000, 0));
+    // The wall clock stepped back a minute: `ClockSync` saw it, so the
+    // order is not held to the old clock.
+    try testing.expect(order.accept(6_000_000 - 60_000_000, 1));
+    try testing.expect(!order.accept(6_000_000 - 61_000_000, 1));
+    // A datagram that does not say when it was sent is always taken.
+    try testing.expect(order.accept(null, 1));
+}
 
-    /// Get the current player state (for debugging/monitoring)
-    pub fn getState(self: *Self) VlcPlayerState {
-        return self.state;
-    }
-};
+test "a status cell hands over the latest publish whole" {
+    var cell: StatusCell = .init(.{});
+    try testing.expectEqualStrings("No media", cell.read().name());
+
+    var status = parseStatus("{\"server_timestamp\":1,\"filename\":\"one\"}").?;
+    cell.publish(status);
+    status = parseStatus("{\"server_timestamp\":2,\"filename\":\"two\"}").?;
+    cell.publish(status);
+    const read = cell.read();
+    try testing.expectEqual(@as(i64, 2), read.server_ts_ms);
+    try testing.expectEqualStrings("two", read.name());
+}
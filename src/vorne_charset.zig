@@ -211,7 +211,7 @@ fn entryMatches(entry: []const u8, utf8: []const u8) bool {
 
 /// Characters with no glyph on the panel but an obvious ASCII stand-in. Almost
 /// all of these arrive by pasting a track listing out of a web page.
-const ascii_folds = [_]struct { u21, []const u8 }{
+pub const ascii_folds = [_]struct { u21, []const u8 }{
     .{ 0x2018, "'" }, // left single quote
     .{ 0x2019, "'" }, // right single quote / apostrophe
     .{ 0x201A, "'" },
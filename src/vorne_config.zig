@@ -24,6 +24,10 @@ const std = @import("std");
 const Io = std.Io;
 const jsonc = @import("jsonc.zig");
 const dbg = @import("debug_log.zig");
+const transport = @import("transport.zig");
+const bus = @import("bus.zig");
+const Mode = @import("mode.zig").Mode;
+const realtime = @import("realtime.zig");
 
 pub const path = "/home/emanspeaks/vorne_config.jsonc";
 
@@ -62,6 +66,36 @@ const Setting = struct {
 var cues_dir_setting: Setting = .{};
 var bluray_ip_setting: Setting = .{};
 var line2_config_setting: Setting = .{};
+var serial_device_setting: Setting = .{};
+var transport_options: transport.Options = .{};
+var realtime_options: realtime.Options = .{};
+
+/// One entry of `panels`: a unit address on the bus and what it shows.
+pub const Panel = struct {
+    address: u8,
+    mode: Mode,
+};
+
+/// One entry of `ports`: a serial device with its own panel and mode.
+pub const Port = struct {
+    device_setting: Setting = .{},
+    mode: Mode = .Clocks,
+
+    pub fn device(self: *const Port) []const u8 {
+        return self.device_setting.get().?;
+    }
+};
+
+/// Each port is its own thread and its own panel; more than a handful of
+/// USB-serial adapters on one machine is not a setup worth planning for.
+pub const max_ports = 4;
+
+var port_storage: [max_ports]Port = @splat(.{});
+var n_ports: usize = 0;
+
+var panel_storage: [bus.max_units]Panel = undefined;
+var n_panels: usize = 0;
+var panel_group: u8 = 0;
 
 /// Directory scanned for `*.vtt` cue files. Null to use the built-in default.
 pub fn cuesDir() ?[]const u8 {
@@ -81,6 +115,44 @@ pub fn line2ConfigPath() ?[]const u8 {
     return line2_config_setting.get();
 }
 
+/// The panel's serial device. Null to use the built-in `/dev/ttyUSB0`.
+///
+/// `--device` on the command line overrides this, and `--emulate` overrides
+/// both -- see `main`.
+pub fn serialDevice() ?[]const u8 {
+    return serial_device_setting.get();
+}
+
+/// How many frames, and how many bytes, may be written to the panel ahead
+/// of its replies -- see `transport.zig`. Defaults to stop-and-wait.
+pub fn transportOptions() transport.Options {
+    return transport_options;
+}
+
+/// Real-time scheduling for the display and sender threads -- see
+/// `realtime.zig`. Off unless configured.
+pub fn realtimeOptions() realtime.Options {
+    return realtime_options;
+}
+
+/// The serial ports to drive at once, each with the mode it starts in. Empty
+/// for the single port named by `serialDevice`.
+pub fn ports() []const Port {
+    return port_storage[0..n_ports];
+}
+
+/// The panels sharing the serial line, each driven by its own mode -- see
+/// `bus.zig`. Empty for the ordinary single panel at address 1, switched
+/// between modes from the web page.
+pub fn panels() []const Panel {
+    return panel_storage[0..n_panels];
+}
+
+/// The group address every unit in `panels` answers to.
+pub fn panelGroup() u8 {
+    return panel_group;
+}
+
 /// Read and apply the file. Call once from `main`, before starting any thread.
 ///
 /// A missing or malformed file is reported and then ignored: every setting has
@@ -124,6 +196,13 @@ pub fn load(io: Io, allocator: std.mem.Allocator) void {
     applyString(root, "cues_dir", &cues_dir_setting);
     applyString(root, "bluray_ip", &bluray_ip_setting);
     applyString(root, "line2_config", &line2_config_setting);
+    applyString(root, "serial_device", &serial_device_setting);
+    applyInt(u8, root, "serial_window_frames", 1, transport.max_in_flight, &transport_options.window_frames);
+    applyInt(u16, root, "serial_window_bytes", 1, std.math.maxInt(u16), &transport_options.window_bytes);
+    applyInt(u8, root, "panel_group", 0, 255, &panel_group);
+    n_panels = applyPanels(root, &panel_storage);
+    n_ports = applyPorts(root, &port_storage);
+    realtime_options = applyRealtime(root);
 
     if (root.get("debug")) |debug_value| {
         if (debug_value == .object) {
@@ -148,6 +227,133 @@ fn applyString(root: std.json.ObjectMap, key: []const u8, setting: *Setting) voi
     setting.set(key, value.string);
 }
 
+/// Parse `"panels": [{ "address": 1, "mode": "clocks" }, ...]` into `out`,
+/// returning how many were taken. All or nothing: a list with one bad entry
+/// is ignored whole, since running some of the panels and not others would
+/// look like a wiring fault rather than a typo.
+fn applyPanels(root: std.json.ObjectMap, out: []Panel) usize {
+    const value = root.get("panels") orelse return 0;
+    if (value != .array) {
+        std.log.warn("Config \"panels\" must be a list, ignoring\n", .{});
+        return 0;
+    }
+    const items = value.array.items;
+    if (items.len > out.len) {
+        std.log.warn("Config \"panels\" lists {d} panels, at most {d} are supported; ignoring\n", .{ items.len, out.len });
+        return 0;
+    }
+    for (items, out[0..items.len], 0..) |item, *panel, i| {
+        panel.* = parsePanel(item) orelse {
+            std.log.warn(
+                "Config \"panels\" entry {d} needs an \"address\" from 0 to 255 and a \"mode\" of clocks, bluray or vlc; ignoring the list\n",
+                .{i},
+            );
+            return 0;
+        };
+        for (out[0..i]) |earlier| {
+            if (earlier.address == panel.address) {
+                std.log.warn("Config \"panels\" lists address {d} twice, ignoring the list\n", .{panel.address});
+                return 0;
+            }
+        }
+    }
+    return items.len;
+}
+
+fn parsePanel(item: std.json.Value) ?Panel {
+    if (item != .object) return null;
+    const address = item.object.get("address") orelse return null;
+    if (address != .integer or address.integer < 0 or address.integer > 255) return null;
+    const mode = parseMode(item.object.get("mode") orelse return null) orelse return null;
+    return .{ .address = @intCast(address.integer), .mode = mode };
+}
+
+/// Parse `"ports": [{ "device": "/dev/ttyUSB0", "mode": "clocks" }, ...]`
+/// into `out`, returning how many were taken -- all or nothing, as for
+/// `panels`.
+fn applyPorts(root: std.json.ObjectMap, out: []Port) usize {
+    const value = root.get("ports") orelse return 0;
+    if (value != .array) {
+        std.log.warn("Config \"ports\" must be a list, ignoring\n", .{});
+        return 0;
+    }
+    const items = value.array.items;
+    if (items.len > out.len) {
+        std.log.warn("Config \"ports\" lists {d} ports, at most {d} are supported; ignoring\n", .{ items.len, out.len });
+        return 0;
+    }
+    for (items, out[0..items.len], 0..) |item, *port, i| {
+        port.* = parsePort(item) orelse {
+            std.log.warn(
+                "Config \"ports\" entry {d} needs a \"device\" path, and a \"mode\" of clocks, bluray or vlc if any; ignoring the list\n",
+                .{i},
+            );
+            return 0;
+        };
+        for (out[0..i]) |*earlier| {
+            if (std.mem.eql(u8, earlier.device(), port.device())) {
+                std.log.warn("Config \"ports\" lists {s} twice, ignoring the list\n", .{port.device()});
+                return 0;
+            }
+        }
+    }
+    return items.len;
+}
+
+fn parsePort(item: std.json.Value) ?Port {
+    if (item != .object) return null;
+    const device = item.object.get("device") orelse return null;
+    if (device != .string) return null;
+    var port: Port = .{};
+    port.device_setting.set("ports", device.string);
+    if (port.device_setting.get() == null) return null;
+    if (item.object.get("mode")) |mode| port.mode = parseMode(mode) orelse return null;
+    return port;
+}
+
+/// Parse `"realtime": { "priority": 50, "cpu": 3 }`. A priority is required
+/// to turn it on; `cpu` is optional. Like `panels`, all or nothing.
+fn applyRealtime(root: std.json.ObjectMap) realtime.Options {
+    const value = root.get("realtime") orelse return .{};
+    if (value != .object) {
+        std.log.warn("Config \"realtime\" must be an object, ignoring\n", .{});
+        return .{};
+    }
+    var opts: realtime.Options = .{};
+    applyInt(u8, value.object, "priority", 1, realtime.max_priority, &opts.priority);
+    if (value.object.get("cpu") != null) {
+        var cpu: u16 = std.math.maxInt(u16);
+        applyInt(u16, value.object, "cpu", 0, realtime.max_cpus - 1, &cpu);
+        if (cpu == std.math.maxInt(u16)) return .{};
+        opts.cpu = cpu;
+    }
+    if (!opts.enabled()) {
+        std.log.warn("Config \"realtime\" needs a \"priority\" from 1 to {d}, ignoring\n", .{realtime.max_priority});
+        return .{};
+    }
+    return opts;
+}
+
+/// A mode by name, any case: "clocks", "bluray" or "vlc".
+fn parseMode(value: std.json.Value) ?Mode {
+    if (value != .string) return null;
+    for (std.enums.values(Mode)) |m| {
+        if (std.ascii.eqlIgnoreCase(value.string, @tagName(m))) return m;
+    }
+    return null;
+}
+
+/// Integers are range-checked rather than clamped, for the same reason strings
+/// are not truncated: a value nobody wrote should not quietly take effect.
+fn applyInt(comptime T: type, root: std.json.ObjectMap, key: []const u8, min: T, max: T, out: *T) void {
+    const value = root.get(key) orelse return;
+    if (value != .integer or value.integer < min or value.integer > max) {
+        std.log.warn("Config \"{s}\" must be a whole number from {d} to {d}, ignoring\n", .{ key, min, max });
+        return;
+    }
+    out.* = @intCast(value.integer);
+}
+
 fn reportPaths() void {
     // Unconditional, and worth it: a wrong directory here produces an empty
     // dropdown and a fallback line 2, which looks exactly like a bug. Saying
@@ -156,6 +362,20 @@ fn reportPaths() void {
     if (cuesDir()) |v| std.log.info("Config: cues_dir = {s}\n", .{v});
     if (blurayIp()) |v| std.log.info("Config: bluray_ip = {s}\n", .{v});
     if (line2ConfigPath()) |v| std.log.info("Config: line2_config = {s}\n", .{v});
+    if (serialDevice()) |v| std.log.info("Config: serial_device = {s}\n", .{v});
+    std.log.info(
+        "Config: serial window = {d} frames, {d} bytes\n",
+        .{ transport_options.window_frames, transport_options.window_bytes },
+    );
+    if (realtime_options.enabled()) {
+        std.log.info("Config: real-time priority {d}, CPU {?d}\n", .{ realtime_options.priority, realtime_options.cpu });
+    }
+    for (ports()) |*p| {
+        std.log.info("Config: port {s} starts in {s}\n", .{ p.device(), @tagName(p.mode) });
+    }
+    for (panels()) |p| {
+        std.log.info("Config: panel {d} (group {d}) shows {s}\n", .{ p.address, panel_group, @tagName(p.mode) });
+    }
 }
 
 // ---------------------------------------------------------------------------
@@ -207,3 +427,89 @@ test "applyString takes strings and refuses other JSON types" {
     // A number is not a path; the setting stays unset so the default applies.
     try testing.expectEqual(@as(?[]const u8, null), ip.get());
 }
+
+test "applyPanels reads addresses and modes, and refuses a list with a bad entry" {
+    var parsed = try std.json.parseFromSlice(
+        std.json.Value,
+        testing.allocator,
+        \\{ "panels": [ { "address": 1, "mode": "clocks" }, { "address": 2, "mode": "Bluray" } ] }
+    ,
+        .{},
+    );
+    defer parsed.deinit();
+
+    var out: [bus.max_units]Panel = undefined;
+    try testing.expectEqual(@as(usize, 2), applyPanels(parsed.value.object, &out));
+    try testing.expectEqual(Panel{ .address = 1, .mode = .Clocks }, out[0]);
+    try testing.expectEqual(Panel{ .address = 2, .mode = .Bluray }, out[1]);
+
+    var bad = try std.json.parseFromSlice(
+        std.json.Value,
+        testing.allocator,
+        \\{ "panels": [ { "address": 1, "mode": "clocks" }, { "address": 1, "mode": "vlc" } ] }
+    ,
+        .{},
+    );
+    defer bad.deinit();
+    try testing.expectEqual(@as(usize, 0), applyPanels(bad.value.object, &out));
+}
+
+test "applyPorts reads devices and modes, defaulting the mode to clocks" {
+    var parsed = try std.json.parseFromSlice(
+        std.json.Value,
+        testing.allocator,
+        \\{ "ports": [ { "device": "/dev/ttyUSB0" }, { "device": "/dev/ttyUSB1", "mode": "vlc" } ] }
+    ,
+        .{},
+    );
+    defer parsed.deinit();
+
+    var out: [max_ports]Port = undefined;
+    try testing.expectEqual(@as(usize, 2), applyPorts(parsed.value.object, &out));
+    try testing.expectEqualStrings("/dev/ttyUSB0", out[0].device());
+    try testing.expectEqual(Mode.Clocks, out[0].mode);
+    try testing.expectEqualStrings("/dev/ttyUSB1", out[1].device());
+    try testing.expectEqual(Mode.Vlc, out[1].mode);
+
+    var bad = try std.json.parseFromSlice(
+        std.json.Value,
+        testing.allocator,
+        \\{ "ports": [ { "device": "/dev/ttyUSB0", "mode": "tv" } ] }
+    ,
+        .{},
+    );
+    defer bad.deinit();
+    try testing.expectEqual(@as(usize, 0), applyPorts(bad.value.object, &out));
+}
+
+test "applyRealtime needs a priority, and takes a core if given" {
+    var parsed = try std.json.parseFromSlice(
+        std.json.Value,
+        testing.allocator,
+        \\{ "realtime": { "priority": 50, "cpu": 3 } }
+    ,
+        .{},
+    );
+    defer parsed.deinit();
+    try testing.expectEqual(realtime.Options{ .priority = 50, .cpu = 3 }, applyRealtime(parsed.value.object));
+
+    var no_priority = try std.json.parseFromSlice(
+        std.json.Value,
+        testing.allocator,
+        \\{ "realtime": { "cpu": 3 } }
+    ,
+        .{},
+    );
+    defer no_priority.deinit();
+    try testing.expect(!applyRealtime(no_priority.value.object).enabled());
+
+    var bad_cpu = try std.json.parseFromSlice(
+        std.json.Value,
+        testing.allocator,
+        \\{ "realtime": { "priority": 50, "cpu": -1 } }
+    ,
+        .{},
+    );
+    defer bad_cpu.deinit();
+    try testing.expect(!applyRealtime(bad_cpu.value.object).enabled());
+}
@@ -24,12 +24,23 @@
 
 const std = @import("std");
 const vorne_charset = @import("vorne_charset.zig");
+const str_utils = @import("str_utils.zig");
+
+/// Bumped whenever the same file would parse to different cues: a change to
+/// entity decoding, tag stripping, the `*` rule or how `Cue.cols` is measured.
+/// `cue_cache.zig` refuses a cache compiled under another value. Edits to
+/// `vorne_charset`'s tables need no bump; the cache hashes those itself.
+pub const compile_version: u32 = 1;
 
 pub const Cue = struct {
     start_ms: i64,
     /// Exclusive: a cue covers `[start_ms, end_ms)`.
     end_ms: i64,
     text: []const u8,
+    /// Width of `text` on the panel, in columns: its length less the DLE
+    /// escapes. Measured once here rather than by the display loop on every
+    /// pass.
+    cols: usize,
     /// Whether text too wide for the display may scroll.
     ///
     /// False for a payload written with a leading `*`: a warning line, which
@@ -40,23 +51,63 @@ pub const Cue = struct {
     scroll: bool,
 };
 
-/// A parsed cue file. Every slice inside points into `arena`.
+/// A parsed cue file. Every slice inside points into `arena`, or, for a list
+/// loaded from `cue_cache.zig`'s compiled form, into `mapped`.
 ///
 /// The arena is held by pointer, as `std.json.Parsed` does, so the struct can
 /// be moved and copied freely without invalidating the allocator interface.
 pub const CueList = struct {
     arena: *std.heap.ArenaAllocator,
+    /// The compiled cache file this list reads from, unmapped with it.
+    mapped: ?[]align(std.heap.page_size_min) const u8 = null,
     /// Sorted by `start_ms`.
     cues: []const Cue,
     /// Text following the `WEBVTT` signature, if any. Usable as a label.
     title: []const u8,
+    /// Every instant at which the displayed cue changes, ascending and
+    /// unique. From `boundaries[i]` until `boundaries[i + 1]` the display
+    /// shows `cues[shown[i]]`, or nothing if it is `no_cue`; before the first
+    /// boundary it shows nothing.
+    ///
+    /// Built once by `parse`, overlaps already resolved, so that a lookup is
+    /// a binary search -- or, with a `Cursor`, usually a comparison or two --
+    /// rather than a scan of every cue. A cue file derived from a feature's
+    /// subtitles runs to thousands of cues, and the display loop looks one up
+    /// on every pass.
+    boundaries: []const i64,
+    shown: []const u32,
+    /// What `reparse` needs to re-parse only an edit: the blocks this list
+    /// was parsed from, and the extent and hash of the header before them.
+    /// Empty for a list that was not parsed, such as one from the cache.
+    blocks: []const Block = &.{},
+    header_len: usize = 0,
+    header_hash: u64 = 0,
+    source_len: usize = 0,
+
+    pub const no_cue = std.math.maxInt(u32);
+
+    /// What is on the line at some instant, and until when.
+    pub const Lookup = struct {
+        cue: ?Cue,
+        /// The next instant at which the displayed cue changes: the start of
+        /// the next cue, or the end of the one showing. Null past the last.
+        next_boundary_ms: ?i64,
+    };
 
     pub fn deinit(self: CueList) void {
+        if (self.mapped) |bytes| std.posix.munmap(bytes);
         const child = self.arena.child_allocator;
         self.arena.deinit();
         child.destroy(self.arena);
     }
 
+    /// The cue covering `t_ms` and the next change after it, by binary
+    /// search. A display loop calling this for a steadily advancing position
+    /// should hold a `Cursor` instead.
+    pub fn lookup(self: CueList, t_ms: i64) Lookup {
+        return self.segment(upperBound(self.boundaries, t_ms));
+    }
+
     /// The next instant after `t_ms` at which the displayed cue changes: the
     /// start of the next cue, or the end of one currently showing.
     ///
@@ -66,20 +117,7 @@ pub const CueList = struct {
     /// fixed interval risks stepping straight over one, and a warning that
     /// never appears is worse than one that appears slightly late.
     pub fn nextBoundaryMs(self: CueList, t_ms: i64) ?i64 {
-        var soonest: ?i64 = null;
-        for (self.cues) |cue| {
-            // Sorted by start, so once a cue starts later than the best
-            // candidate so far, neither it nor anything after it can improve.
-            if (soonest) |best| {
-                if (cue.start_ms >= best) break;
-            }
-            if (cue.start_ms > t_ms) {
-                soonest = cue.start_ms;
-            } else if (cue.end_ms > t_ms) {
-                soonest = if (soonest) |best| @min(best, cue.end_ms) else cue.end_ms;
-            }
-        }
-        return soonest;
+        return self.lookup(t_ms).next_boundary_ms;
     }
 
     /// The cue covering `t_ms`, or null when there is none.
@@ -87,19 +125,119 @@ pub const CueList = struct {
     /// Overlapping cues are legal in WebVTT but meaningless on a single line,
     /// so the latest-starting cue that is still open wins.
     pub fn at(self: CueList, t_ms: i64) ?Cue {
-        var found: ?Cue = null;
-        for (self.cues) |cue| {
-            // Sorted by start, so once a cue starts in the future nothing
-            // after it can be active either.
-            if (cue.start_ms > t_ms) break;
-            if (t_ms < cue.end_ms) found = cue;
+        return self.lookup(t_ms).cue;
+    }
+
+    /// The lookup for segment `pos`: the stretch after `pos` boundaries have
+    /// passed.
+    fn segment(self: CueList, pos: usize) Lookup {
+        return .{
+            .cue = if (pos == 0 or self.shown[pos - 1] == no_cue) null else self.cues[self.shown[pos - 1]],
+            .next_boundary_ms = if (pos < self.boundaries.len) self.boundaries[pos] else null,
+        };
+    }
+};
+
+/// A position in one `CueList`, kept between lookups.
+///
+/// Playback only ever moves forward, a pass or a boundary at a time, so the
+/// segment the last lookup landed in -- or the one after it -- is almost
+/// always the answer to the next: one or two comparisons. Anything further,
+/// a seek either way, falls back to the binary search.
+///
+/// Tied to the list it was used with; start a new one, `.{}`, on switching
+/// lists.
+pub const Cursor = struct {
+    /// Boundaries at or before the last position looked up.
+    pos: usize = 0,
+
+    /// How many segments forward to step before giving up and searching.
+    const max_steps = 4;
+
+    pub fn lookup(self: *Cursor, list: CueList, t_ms: i64) CueList.Lookup {
+        const bounds = list.boundaries;
+        if (self.pos > bounds.len or (self.pos > 0 and t_ms < bounds[self.pos - 1])) {
+            self.pos = upperBound(bounds, t_ms);
+        } else {
+            var steps: usize = 0;
+            while (self.pos < bounds.len and bounds[self.pos] <= t_ms) : (steps += 1) {
+                if (steps == max_steps) {
+                    self.pos = self.pos + upperBound(bounds[self.pos..], t_ms);
+                    break;
+                }
+                self.pos += 1;
+            }
         }
-        return found;
+        return list.segment(self.pos);
     }
 };
 
+/// How many of the ascending `bounds` are at or before `t_ms`.
+fn upperBound(bounds: []const i64, t_ms: i64) usize {
+    var lo: usize = 0;
+    var hi: usize = bounds.len;
+    while (lo < hi) {
+        const mid = lo + (hi - lo) / 2;
+        if (bounds[mid] <= t_ms) lo = mid + 1 else hi = mid;
+    }
+    return lo;
+}
+
+/// Resolve the sorted `cues` into `CueList.boundaries` and `CueList.shown`.
+///
+/// One sweep over every start and end in time order. The cue showing is the
+/// latest-starting one still open, which -- the cues being sorted by start --
+/// is the highest-indexed one opened and not yet closed. Opened cues go on a
+/// stack, so that is its top once any that have closed are popped off; one
+/// closed beneath a later cue is only popped when that cue closes too, which
+/// is soon enough, since until then it was not the one showing anyway.
+fn buildIndex(a: std.mem.Allocator, cues: []const Cue) std.mem.Allocator.Error!struct { boundaries: []const i64, shown: []const u32 } {
+    const edges = try a.alloc(i64, cues.len * 2);
+    for (cues, 0..) |cue, i| {
+        edges[2 * i] = cue.start_ms;
+        edges[2 * i + 1] = cue.end_ms;
+    }
+    std.mem.sort(i64, edges, {}, std.sort.asc(i64));
+
+    var boundaries: std.ArrayList(i64) = .empty;
+    var shown: std.ArrayList(u32) = .empty;
+    var open: std.ArrayList(u32) = .empty;
+    var next: usize = 0;
+    var showing: u32 = CueList.no_cue;
+    for (edges, 0..) |t_ms, i| {
+        if (i > 0 and edges[i - 1] == t_ms) continue;
+        while (next < cues.len and cues[next].start_ms <= t_ms) : (next += 1) {
+            try open.append(a, @intCast(next));
+        }
+        while (open.items.len > 0 and cues[open.items[open.items.len - 1]].end_ms <= t_ms) _ = open.pop();
+        const top = if (open.items.len > 0) open.items[open.items.len - 1] else CueList.no_cue;
+        // An edge that changes nothing on the line -- the end of a cue hidden
+        // beneath a later one -- is not a boundary: the display has nothing
+        // to wake for.
+        if (top == showing) continue;
+        showing = top;
+        try boundaries.append(a, t_ms);
+        try shown.append(a, top);
+    }
+    a.free(edges);
+    open.deinit(a);
+    return .{ .boundaries = try boundaries.toOwnedSlice(a), .shown = try shown.toOwnedSlice(a) };
+}
+
 pub const ParseError = error{NotWebVtt} || std.mem.Allocator.Error;
 
+/// One block of a cue file, as `parse` found it: where it lies in the file,
+/// a hash of those bytes, and the cue it produced, if any -- a `NOTE`, a
+/// malformed cue and so on produce none. Blocks tile the file from the end of
+/// the header to the end of the file, each running up to where the next
+/// begins, blank lines included. Kept on the list for `reparse`.
+pub const Block = struct {
+    start: usize,
+    end: usize,
+    hash: u64,
+    cue: ?Cue,
+};
+
 pub fn parse(child_allocator: std.mem.Allocator, source: []const u8) ParseError!CueList {
     const arena = try child_allocator.create(std.heap.ArenaAllocator);
     errdefer child_allocator.destroy(arena);
@@ -107,19 +245,194 @@ pub fn parse(child_allocator: std.mem.Allocator, source: []const u8) ParseError!
     errdefer arena.deinit();
     const a = arena.allocator();
 
-    var lines: LineIter = .{ .rest = stripBom(source) };
+    const body = stripBom(source);
+    var parser: Parser = .{ .a = a, .source = body, .lines = .{ .rest = body } };
 
     // The signature must be the very first line. Anything else is not a WebVTT
     // file, and guessing at it would only produce a display full of noise.
-    const signature = std.mem.trim(u8, lines.next() orelse return error.NotWebVtt, " \t");
+    const signature = std.mem.trim(u8, parser.lines.next() orelse return error.NotWebVtt, " \t");
     const after_signature = blockKeyword(signature, "WEBVTT") orelse return error.NotWebVtt;
     const title = try a.dupe(u8, std.mem.trim(u8, after_signature, " \t"));
+    parser.skipBlankLines();
+    const header_len = parser.offset();
+
+    var blocks: std.ArrayList(Block) = .empty;
+    while (try parser.nextBlock()) |block| try blocks.append(a, block);
 
+    return finish(arena, title, body, header_len, try blocks.toOwnedSlice(a));
+}
+
+/// Parse `source`, a new version of the file `previous` was parsed from,
+/// re-parsing only the part that changed.
+///
+/// Cue files are edited while a disc plays, and every save used to cost a
+/// parse of the whole file -- every payload transcoded again, for a file
+/// whose edit is usually one cue, or a few appended at the end. The blocks
+/// `previous` was built from are matched against the new file by hash from
+/// the front and, allowing for the edit's change in length, from the back;
+/// only what lies between is parsed. The rest keep their cues, whose text is
+/// copied rather than decoded again.
+///
+/// The block just before the change is parsed again too, since where a
+/// payload ends can depend on the line after it: appending a line straight
+/// after the last cue, with no blank line between, extends that cue.
+/// Anything that changes the header, and a `previous` that has no blocks --
+/// one loaded from `cue_cache.zig` -- gets a full parse.
+pub fn reparse(child_allocator: std.mem.Allocator, previous: CueList, source: []const u8) ParseError!CueList {
+    const body = stripBom(source);
+    const old = previous.blocks;
+    if (old.len == 0 or body.len < previous.header_len or
+        std.hash.Wyhash.hash(0, body[0..previous.header_len]) != previous.header_hash)
+    {
+        return parse(child_allocator, source);
+    }
+
+    const arena = try child_allocator.create(std.heap.ArenaAllocator);
+    errdefer child_allocator.destroy(arena);
+    arena.* = .init(child_allocator);
+    errdefer arena.deinit();
+    const a = arena.allocator();
+
+    // Blocks unchanged from the front, less the last, as above. With none
+    // left the parse starts over at the end of the header, not at the first
+    // block: an edit may have put blank lines, or a cue, ahead of it.
+    var keep_front: usize = 0;
+    while (keep_front < old.len and sameBytes(body, old[keep_front], 0)) keep_front += 1;
+    keep_front -|= 1;
+    const resume_at = if (keep_front == 0) previous.header_len else old[keep_front].start;
+
+    // Blocks unchanged from the back, shifted by however much the edit
+    // lengthened or shortened the file, and wholly after `resume_at`.
+    const shift: isize = @as(isize, @intCast(body.len)) - @as(isize, @intCast(previous.source_len));
+    var keep_back = old.len;
+    while (keep_back > keep_front + 1) {
+        const candidate = old[keep_back - 1];
+        if (@as(isize, @intCast(candidate.start)) + shift < @as(isize, @intCast(resume_at))) break;
+        if (!sameBytes(body, candidate, shift)) break;
+        keep_back -= 1;
+    }
+
+    var blocks: std.ArrayList(Block) = .empty;
+    for (old[0..keep_front]) |block| try blocks.append(a, try copyBlock(a, block, 0));
+
+    // Parse from the first changed block until the parse lands on the start
+    // of an unchanged one; everything from there on is as it was.
+    var parser: Parser = .{ .a = a, .source = body, .lines = .{ .rest = body[resume_at..] } };
+    // Restarted from the header, the header now runs to wherever its blank
+    // lines end, as `parse` would have it.
+    var header_len = previous.header_len;
+    if (keep_front == 0) {
+        parser.skipBlankLines();
+        header_len = parser.offset();
+    }
+    var next_kept = keep_back;
+    while (try parser.nextBlock()) |block| {
+        try blocks.append(a, block);
+        const at = parser.offset();
+        while (next_kept < old.len and shifted(old[next_kept].start, shift) < at) next_kept += 1;
+        if (next_kept < old.len and shifted(old[next_kept].start, shift) == at) {
+            for (old[next_kept..]) |kept| try blocks.append(a, try copyBlock(a, kept, shift));
+            break;
+        }
+    }
+
+    return finish(arena, try a.dupe(u8, previous.title), body, header_len, try blocks.toOwnedSlice(a));
+}
+
+fn shifted(offset: usize, shift: isize) usize {
+    return @intCast(@as(isize, @intCast(offset)) + shift);
+}
+
+/// Whether `block`, moved by `shift`, lies within `body` with the same bytes.
+fn sameBytes(body: []const u8, block: Block, shift: isize) bool {
+    const start = @as(isize, @intCast(block.start)) + shift;
+    const end = @as(isize, @intCast(block.end)) + shift;
+    if (start < 0 or end > @as(isize, @intCast(body.len))) return false;
+    return std.hash.Wyhash.hash(0, body[@intCast(start)..@intCast(end)]) == block.hash;
+}
+
+/// `block`, moved by `shift`, with its cue's text copied into `a`.
+fn copyBlock(a: std.mem.Allocator, block: Block, shift: isize) std.mem.Allocator.Error!Block {
+    var copy = block;
+    copy.start = shifted(block.start, shift);
+    copy.end = shifted(block.end, shift);
+    if (copy.cue) |*cue| cue.text = try a.dupe(u8, cue.text);
+    return copy;
+}
+
+/// Sort the blocks' cues and index them: the end of both `parse` and
+/// `reparse`.
+fn finish(arena: *std.heap.ArenaAllocator, title: []const u8, body: []const u8, header_len: usize, blocks: []const Block) ParseError!CueList {
+    const a = arena.allocator();
     var cues: std.ArrayList(Cue) = .empty;
+    for (blocks) |block| {
+        if (block.cue) |cue| try cues.append(a, cue);
+    }
+
+    // Cues are conventionally in order already, but the index relies on it,
+    // so do not take the file's word for it.
+    std.mem.sort(Cue, cues.items, {}, lessThanStart);
+    const sorted = try cues.toOwnedSlice(a);
+    const index = try buildIndex(a, sorted);
+
+    return .{
+        .arena = arena,
+        .cues = sorted,
+        .title = title,
+        .boundaries = index.boundaries,
+        .shown = index.shown,
+        .blocks = blocks,
+        .header_len = header_len,
+        .header_hash = std.hash.Wyhash.hash(0, body[0..header_len]),
+        .source_len = body.len,
+    };
+}
+
+/// The block-at-a-time half of `parse`, so `reparse` can start it anywhere a
+/// block begins.
+const Parser = struct {
+    a: std.mem.Allocator,
+    /// The whole file, which `lines` is a suffix of.
+    source: []const u8,
+    lines: LineIter,
+
+    /// Where the next line `lines` hands out starts, in `source`.
+    fn offset(self: *const Parser) usize {
+        if (self.lines.pending) |line| return @intFromPtr(line.ptr) - @intFromPtr(self.source.ptr);
+        if (self.lines.done) return self.source.len;
+        return self.source.len - self.lines.rest.len;
+    }
 
-    while (lines.next()) |raw| {
-        const line = std.mem.trim(u8, raw, " \t");
-        if (line.len == 0) continue; // blank separator between blocks
+    fn skipBlankLines(self: *Parser) void {
+        while (self.lines.next()) |raw| {
+            if (std.mem.trim(u8, raw, " \t").len != 0) {
+                self.lines.pushBack(raw);
+                return;
+            }
+        }
+    }
+
+    /// The next block, blank lines after it included; null at the end of the
+    /// file.
+    fn nextBlock(self: *Parser) ParseError!?Block {
+        self.skipBlankLines();
+        const start = self.offset();
+        const raw = self.lines.next() orelse return null;
+        const cue = try self.blockCue(std.mem.trim(u8, raw, " \t"));
+        self.skipBlankLines();
+        const end = self.offset();
+        return .{
+            .start = start,
+            .end = end,
+            .hash = std.hash.Wyhash.hash(0, self.source[start..end]),
+            .cue = cue,
+        };
+    }
+
+    /// The rest of the block opened by `line`, and the cue it makes, if any.
+    fn blockCue(self: *Parser, line: []const u8) ParseError!?Cue {
+        const a = self.a;
+        const lines = &self.lines;
 
         // Non-cue blocks. `NOTE` is the comment form; the other two carry CSS
         // and region definitions that have no meaning on a character display.
@@ -128,23 +441,23 @@ pub fn parse(child_allocator: std.mem.Allocator, source: []const u8) ParseError!
             blockKeyword(line, "REGION") != null)
         {
             lines.skipBlock();
-            continue;
+            return null;
         }
 
         // A cue is either a timing line, or an identifier line followed by one.
         var timing = line;
         if (std.mem.indexOf(u8, timing, "-->") == null) {
-            const after_id = lines.next() orelse break;
+            const after_id = lines.next() orelse return null;
             timing = std.mem.trim(u8, after_id, " \t");
             if (std.mem.indexOf(u8, timing, "-->") == null) {
                 lines.skipBlock();
-                continue;
+                return null;
             }
         }
 
         const span = parseTiming(timing) catch {
             lines.skipBlock();
-            continue;
+            return null;
         };
 
         var text: std.ArrayList(u8) = .empty;
@@ -171,24 +484,15 @@ pub fn parse(child_allocator: std.mem.Allocator, source: []const u8) ParseError!
         const cue_text = try text.toOwnedSlice(a);
         const scroll = cue_text.len == 0 or cue_text[0] != '*';
 
-        try cues.append(a, .{
+        return .{
             .start_ms = span.start_ms,
             .end_ms = span.end_ms,
             .text = cue_text,
+            .cols = (str_utils.strlensz(cue_text) catch unreachable)[0],
             .scroll = scroll,
-        });
+        };
     }
-
-    // Cues are conventionally in order already, but `at` relies on it, so
-    // do not take the file's word for it.
-    std.mem.sort(Cue, cues.items, {}, lessThanStart);
-
-    return .{
-        .arena = arena,
-        .cues = try cues.toOwnedSlice(a),
-        .title = title,
-    };
-}
+};
 
 fn lessThanStart(_: void, a: Cue, b: Cue) bool {
     return a.start_ms < b.start_ms;
@@ -696,6 +1000,230 @@ test "transcoding does not disturb entity decoding or tag stripping" {
     try testing.expectEqualStrings("me", text[10..]);
 }
 
+test "overlapping cues resolve to the latest-starting one still open" {
+    const source =
+        "WEBVTT\n\n" ++
+        "00:00:10.000 --> 00:01:00.000\nLONG\n\n" ++
+        "00:00:20.000 --> 00:00:30.000\nINSIDE\n\n" ++
+        "00:00:25.000 --> 00:00:27.000\nINNERMOST\n";
+
+    var list = try parse(testing.allocator, source);
+    defer list.deinit();
+
+    try testing.expectEqualStrings("LONG", list.at(15_000).?.text);
+    try testing.expectEqualStrings("INSIDE", list.at(22_000).?.text);
+    try testing.expectEqualStrings("INNERMOST", list.at(26_000).?.text);
+    try testing.expectEqualStrings("INSIDE", list.at(28_000).?.text);
+    // Back to the outer cue once both inner ones have closed.
+    try testing.expectEqualStrings("LONG", list.at(45_000).?.text);
+    try testing.expectEqual(@as(?i64, 60_000), list.nextBoundaryMs(30_000));
+}
+
+test "an edge that changes nothing on the line is not a boundary" {
+    // SHORT opens and closes entirely beneath LATER, so its end is invisible.
+    const source =
+        "WEBVTT\n\n" ++
+        "00:00:10.000 --> 00:00:15.000\nSHORT\n\n" ++
+        "00:00:12.000 --> 00:00:40.000\nLATER\n";
+
+    var list = try parse(testing.allocator, source);
+    defer list.deinit();
+
+    try testing.expectEqual(@as(?i64, 40_000), list.nextBoundaryMs(12_000));
+    try testing.expectEqual(@as(usize, 3), list.boundaries.len);
+}
+
+test "a cursor agrees with the linear scans through playback and seeks" {
+    // Two thousand cues, some overlapping, some with gaps, as a
+    // subtitle-derived file has.
+    var source: std.ArrayList(u8) = .empty;
+    defer source.deinit(testing.allocator);
+    try source.appendSlice(testing.allocator, "WEBVTT\n\n");
+    var prng: std.Random.DefaultPrng = .init(13);
+    const random = prng.random();
+    var start_ms: i64 = 0;
+    for (0..2000) |i| {
+        start_ms += random.intRangeAtMost(i64, 0, 2_500);
+        const end_ms = start_ms + random.intRangeAtMost(i64, 0, 4_000);
+        var buf: [96]u8 = undefined;
+        const block = try std.fmt.bufPrint(&buf, "{d:0>2}:{d:0>2}.{d:0>3} --> {d:0>2}:{d:0>2}.{d:0>3}\nCUE {d}\n\n", .{
+            @divFloor(start_ms, 60_000), @mod(@divFloor(start_ms, 1000), 60), @mod(start_ms, 1000),
+            @divFloor(end_ms, 60_000),   @mod(@divFloor(end_ms, 1000), 60),   @mod(end_ms, 1000),
+            i,
+        });
+        try source.appendSlice(testing.allocator, block);
+    }
+
+    var list = try parse(testing.allocator, source.items);
+    defer list.deinit();
+    try testing.expectEqual(@as(usize, 2000), list.cues.len);
+
+    var edges: std.ArrayList(i64) = .empty;
+    defer edges.deinit(testing.allocator);
+    for (list.cues) |cue| try edges.appendSlice(testing.allocator, &.{ cue.start_ms, cue.end_ms });
+    std.mem.sort(i64, edges.items, {}, std.sort.asc(i64));
+
+    var cursor: Cursor = .{};
+    var t_ms: i64 = -1_000;
+    for (0..5_000) |step| {
+        // Mostly a pass's worth forward; now and then a seek either way.
+        t_ms += if (step % 200 == 199)
+            random.intRangeAtMost(i64, -1_000_000, 1_000_000)
+        else
+            random.intRangeAtMost(i64, 0, 250);
+        const expected = reference(list, edges.items, t_ms);
+        const got = cursor.lookup(list, t_ms);
+        try testing.expectEqual(expected.next_boundary_ms, got.next_boundary_ms);
+        try testing.expectEqual(expected.cue == null, got.cue == null);
+        if (got.cue) |cue| try testing.expectEqual(expected.cue.?.text.ptr, cue.text.ptr);
+    }
+}
+
+/// What the index replaced, kept to check it against: a scan for the cue
+/// showing at `t_ms`, and a walk along every cue edge after it -- `edges`,
+/// ascending -- to the first at which a different one shows.
+fn reference(list: CueList, edges: []const i64, t_ms: i64) CueList.Lookup {
+    const found = scanAt(list, t_ms);
+    for (edges) |edge| {
+        if (edge <= t_ms) continue;
+        const winner = scanAt(list, edge);
+        const same = if (winner) |w| found != null and w.text.ptr == found.?.text.ptr else found == null;
+        if (!same) return .{ .cue = found, .next_boundary_ms = edge };
+    }
+    return .{ .cue = found, .next_boundary_ms = null };
+}
+
+fn scanAt(list: CueList, t_ms: i64) ?Cue {
+    var found: ?Cue = null;
+    for (list.cues) |cue| {
+        if (cue.start_ms > t_ms) break;
+        if (t_ms < cue.end_ms) found = cue;
+    }
+    return found;
+}
+
+fn expectSameCues(expected: CueList, actual: CueList) !void {
+    try testing.expectEqualStrings(expected.title, actual.title);
+    try testing.expectEqual(expected.cues.len, actual.cues.len);
+    for (expected.cues, actual.cues) |e, a| {
+        try testing.expectEqual(e.start_ms, a.start_ms);
+        try testing.expectEqual(e.end_ms, a.end_ms);
+        try testing.expectEqualStrings(e.text, a.text);
+        try testing.expectEqual(e.cols, a.cols);
+        try testing.expectEqual(e.scroll, a.scroll);
+    }
+    try testing.expectEqualSlices(i64, expected.boundaries, actual.boundaries);
+    try testing.expectEqualSlices(u32, expected.shown, actual.shown);
+    try testing.expectEqual(expected.header_len, actual.header_len);
+    try testing.expectEqual(expected.header_hash, actual.header_hash);
+    try testing.expectEqual(expected.blocks.len, actual.blocks.len);
+    for (expected.blocks, actual.blocks) |e, a| {
+        try testing.expectEqual(e.start, a.start);
+        try testing.expectEqual(e.end, a.end);
+        try testing.expectEqual(e.hash, a.hash);
+    }
+}
+
+fn expectReparseMatches(before: []const u8, after: []const u8) !void {
+    var previous = try parse(testing.allocator, before);
+    defer previous.deinit();
+    var full = try parse(testing.allocator, after);
+    defer full.deinit();
+    var partial = try reparse(testing.allocator, previous, after);
+    defer partial.deinit();
+    try expectSameCues(full, partial);
+}
+
+const reparse_base =
+    "WEBVTT Blade Runner\n\n" ++
+    "NOTE timings from the 2007 cut\n\n" ++
+    "00:00:10.000 --> 00:00:20.000\nFIRST\n\n" ++
+    "opening\n00:00:30.000 --> 00:00:40.000\n<b>SECOND</b> &amp; MORE\n\n" ++
+    "00:00:50.000 --> 00:01:00.000\nTHIRD\n" ++
+    "00:01:00.000 --> 00:01:10.000\n*FOURTH\n";
+
+test "reparse after an append matches a full parse" {
+    try expectReparseMatches(reparse_base, reparse_base ++ "\n00:02:00.000 --> 00:02:10.000\nAPPENDED\n");
+    // Straight after the last payload, no blank line: that cue grows.
+    try expectReparseMatches(reparse_base, reparse_base ++ "MORE OF FOURTH\n");
+    // Straight after, but a timing line: a new cue.
+    try expectReparseMatches(reparse_base, reparse_base ++ "00:02:00.000 --> 00:02:10.000\nRUN ON\n");
+}
+
+test "reparse after an edit in the middle matches a full parse" {
+    const before = reparse_base;
+    const cut = comptime std.mem.indexOf(u8, before, "SECOND").?;
+    try expectReparseMatches(before, before[0..cut] ++ "2ND" ++ before[cut + "SECOND".len ..]);
+    try expectReparseMatches(before, before[0..cut] ++ "SECOND, NOW MUCH LONGER" ++ before[cut + "SECOND".len ..]);
+    // A cue removed outright, and one made malformed.
+    const third = comptime std.mem.indexOf(u8, before, "00:00:50.000").?;
+    const fourth = comptime std.mem.indexOf(u8, before, "00:01:00.000 -->").?;
+    try expectReparseMatches(before, before[0..third] ++ before[fourth..]);
+    try expectReparseMatches(before, before[0..third] ++ "00:00:5x" ++ before[third + 8 ..]);
+}
+
+test "reparse after blank lines below the header, then a cue among them" {
+    const header = "WEBVTT Blade Runner\n\n";
+    const rest = reparse_base[header.len..];
+    const spaced = header ++ "\n\n\n" ++ rest;
+    const filled = header ++ "\n\n\n00:00:01.000 --> 00:00:05.000\nCOLD OPEN\n\n" ++ rest;
+
+    var first = try parse(testing.allocator, reparse_base);
+    defer first.deinit();
+    var second = try reparse(testing.allocator, first, spaced);
+    defer second.deinit();
+    var full_second = try parse(testing.allocator, spaced);
+    defer full_second.deinit();
+    try expectSameCues(full_second, second);
+
+    // Parsed from the header, not from the first block after the gap.
+    var third = try reparse(testing.allocator, second, filled);
+    defer third.deinit();
+    var full_third = try parse(testing.allocator, filled);
+    defer full_third.deinit();
+    try expectSameCues(full_third, third);
+    try testing.expectEqualStrings("COLD OPEN", third.at(2_000).?.text);
+}
+
+test "reparse falls back to a full parse when the header changes" {
+    try expectReparseMatches(reparse_base, "WEBVTT Blade Runner (Final Cut)" ++ reparse_base["WEBVTT Blade Runner".len..]);
+    var previous = try parse(testing.allocator, reparse_base);
+    defer previous.deinit();
+    try testing.expectError(error.NotWebVtt, reparse(testing.allocator, previous, "1\n00:00:01,000 --> 00:00:02,000\nSRT\n"));
+}
+
+test "reparse agrees with a full parse through random edits" {
+    var prng: std.Random.DefaultPrng = .init(15);
+    const random = prng.random();
+    const fragments = [_][]const u8{
+        "\n",                              "\n\n",          "X",       "00:00:01.000 --> 00:00:02.000\n",
+        "00:03:00.000 --> 00:03:01.000\nNEW\n", "NOTE\n",       "&amp;",   "-->",
+        "\r\n",                             "*WARN\n",        " ",       "id\n",
+    };
+
+    var current: std.ArrayList(u8) = .empty;
+    defer current.deinit(testing.allocator);
+    try current.appendSlice(testing.allocator, reparse_base);
+    var previous = try parse(testing.allocator, current.items);
+    defer previous.deinit();
+
+    for (0..300) |_| {
+        // Replace a short run somewhere after the header with a fragment.
+        const header = "WEBVTT Blade Runner\n".len;
+        const at = random.intRangeAtMost(usize, header, current.items.len);
+        const cut = @min(random.intRangeAtMost(usize, 0, 12), current.items.len - at);
+        const fragment = fragments[random.uintLessThan(usize, fragments.len)];
+        try current.replaceRange(testing.allocator, at, cut, fragment);
+
+        var full = try parse(testing.allocator, current.items);
+        defer full.deinit();
+        const partial = try reparse(testing.allocator, previous, current.items);
+        previous.deinit();
+        previous = partial;
+        try expectSameCues(full, partial);
+    }
+}
+
 test "a file without the signature is rejected" {
     try testing.expectError(error.NotWebVtt, parse(testing.allocator, "1\n00:00:01,000 --> 00:00:02,000\nSRT\n"));
     // `WEBVTTX` is not the signature; the keyword must stand alone.
@@ -0,0 +1,309 @@
+#include "vlc_player.h"
+#include "platform.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A player with no media behind it, built in place of vlc_player.c when
+// VLC_STATUS_MOCK_PLAYER is defined. An opened file "plays" by the monotonic
+// clock, on a loop, and the player raises the same events libvlc would -- a
+// position update every VLC_MOCK_TIME_EVENT_MS while playing, and state
+// events for play, pause and open -- from a thread of its own, as libvlc
+// does. The status monitor and everything after it run unchanged, so the
+// server's packet rate, timing and CPU cost can be measured on a machine with
+// no VLC, a CI runner included.
+//
+// VLC_MOCK_CHANGE_MS, if set, scripts a change every that many ms: pause,
+// resume, seek forward a minute, and round again, so bursts are exercised as
+// well as heartbeats.
+
+#define MOCK_DURATION_MS (2LL * 60 * 60 * 1000)
+#define MOCK_SEEK_MS (60LL * 1000)
+#define DEFAULT_TIME_EVENT_MS 250
+
+// External variables (defined in main file)
+extern int debug_mode;
+
+struct mock_player {
+    // Playback, as a position at an instant: while playing, the position now
+    // is anchor_pos_ms plus the time since anchor_us. Only the main thread
+    // touches these.
+    int has_media;
+    int playing;
+    long long anchor_pos_ms;
+    unsigned long long anchor_us;
+
+    // The script: the next change is due at next_change_us, and is step
+    // next_step of the cycle. The event thread reads the schedule to raise a
+    // state event when a change falls due; the main thread makes the change
+    // the next time it looks at the player.
+    unsigned long long change_us;
+    atomic_ullong next_change_us;  // 0 while no script runs
+    int next_step;
+
+    unsigned long long time_event_us;
+    atomic_int playing_now;  // playing, for the event thread
+    atomic_int stopping;
+    platform_thread_t *thread;
+};
+
+static unsigned long long env_ms(const char *name, unsigned long long fallback) {
+    const char *value = getenv(name);
+    if (!value || !*value) {
+        return fallback;
+    }
+    return strtoull(value, NULL, 10);
+}
+
+static void raise_events(vlc_player_t *player, unsigned events) {
+    vlc_player_event_cb cb = player->event_cb;
+    if (cb) {
+        cb(events, player->event_data);
+    }
+}
+
+static long long position_at(const mock_player_t *mock, unsigned long long now_us) {
+    long long pos = mock->anchor_pos_ms;
+    if (mock->playing) {
+        pos += (long long)((now_us - mock->anchor_us) / 1000);
+    }
+    return pos % MOCK_DURATION_MS;  // On a loop
+}
+
+static void set_playing(vlc_player_t *player, int playing, unsigned long long now_us) {
+    mock_player_t *mock = player->mock;
+    mock->anchor_pos_ms = position_at(mock, now_us);
+    mock->anchor_us = now_us;
+    mock->playing = playing;
+    atomic_store(&mock->playing_now, playing);
+}
+
+// Make every scripted change that has fallen due by now_us, each as of the
+// instant it was due.
+static void run_script(vlc_player_t *player, unsigned long long now_us) {
+    mock_player_t *mock = player->mock;
+    unsigned long long due = atomic_load(&mock->next_change_us);
+    while (due != 0 && due <= now_us) {
+        switch (mock->next_step) {
+            case 0:
+                set_playing(player, 0, due);
+                break;
+            case 1:
+                set_playing(player, 1, due);
+                break;
+            default:
+                mock->anchor_pos_ms = (position_at(mock, due) + MOCK_SEEK_MS) % MOCK_DURATION_MS;
+                mock->anchor_us = due;
+                break;
+        }
+        if (debug_mode) {
+            printf("[DEBUG] Mock player: scripted change %d\n", mock->next_step);
+        }
+        mock->next_step = (mock->next_step + 1) % 3;
+        due += mock->change_us;
+    }
+    atomic_store(&mock->next_change_us, due);
+}
+
+// The event thread: a position update per tick while playing, and a state
+// event as each scripted change falls due
+static void event_loop(void *arg) {
+    vlc_player_t *player = (vlc_player_t *)arg;
+    mock_player_t *mock = player->mock;
+    unsigned long long next_tick = getMonotonicTimeUs() + mock->time_event_us;
+    unsigned long long announced = 0;  // The change last raised
+
+    while (!atomic_load(&mock->stopping)) {
+        unsigned long long change = atomic_load(&mock->next_change_us);
+        unsigned long long wake = next_tick;
+        if (change != 0 && change != announced && change < wake) {
+            wake = change;
+        }
+        unsigned long long now = getMonotonicTimeUs();
+        if (wake > now) {
+            platform_sleep_us(wake - now);
+            now = getMonotonicTimeUs();
+        }
+
+        unsigned events = 0;
+        if (change != 0 && change != announced && change <= now) {
+            announced = change;
+            events |= VLC_PLAYER_EVENT_STATE;
+        }
+        if (next_tick <= now) {
+            next_tick += mock->time_event_us;
+            if (next_tick <= now) {
+                next_tick = now + mock->time_event_us;  // Fell behind; skip, as libvlc would
+            }
+            if (atomic_load(&mock->playing_now)) {
+                events |= VLC_PLAYER_EVENT_TIME;
+            }
+        }
+        if (events) {
+            raise_events(player, events);
+        }
+    }
+}
+
+// Create VLC player instance
+vlc_player_t *vlc_player_create() {
+    vlc_player_t *player = (vlc_player_t *)malloc(sizeof(vlc_player_t));
+    if (!player) {
+        return NULL;
+    }
+    memset(player, 0, sizeof(vlc_player_t));
+
+    player->mock = (mock_player_t *)malloc(sizeof(mock_player_t));
+    if (!player->mock) {
+        free(player);
+        return NULL;
+    }
+    memset(player->mock, 0, sizeof(mock_player_t));
+    player->mock->change_us = env_ms("VLC_MOCK_CHANGE_MS", 0) * 1000ULL;
+    player->mock->time_event_us = env_ms("VLC_MOCK_TIME_EVENT_MS", DEFAULT_TIME_EVENT_MS) * 1000ULL;
+    if (player->mock->time_event_us == 0) {
+        player->mock->time_event_us = DEFAULT_TIME_EVENT_MS * 1000ULL;
+    }
+    atomic_init(&player->mock->next_change_us, 0);
+    atomic_init(&player->mock->playing_now, 0);
+    atomic_init(&player->mock->stopping, 0);
+
+    player->initialized = 1;
+    printf("Mock player: position events every %llu ms, scripted changes %s\n",
+           player->mock->time_event_us / 1000, player->mock->change_us ? "on" : "off");
+    return player;
+}
+
+// Destroy VLC player instance
+void vlc_player_destroy(vlc_player_t *player) {
+    if (!player) return;
+    vlc_player_unwatch(player);
+    free(player->mock);
+    free(player);
+}
+
+// Open a media file. Nothing is read; the name is all that is used.
+int vlc_player_open_file(vlc_player_t *player, const char *filepath) {
+    if (!player || !player->initialized || !filepath) {
+        return 0;
+    }
+    mock_player_t *mock = player->mock;
+
+    strncpy(player->current_filepath, filepath, sizeof(player->current_filepath) - 1);
+    player->current_filepath[sizeof(player->current_filepath) - 1] = '\0';
+
+    set_playing(player, 0, getMonotonicTimeUs());
+    mock->anchor_pos_ms = 0;
+    mock->has_media = 1;
+    atomic_store(&mock->next_change_us, 0);
+    raise_events(player, VLC_PLAYER_EVENT_MEDIA);
+    return 1;
+}
+
+// Play media, starting the script if there is one
+int vlc_player_play(vlc_player_t *player) {
+    if (!player || !player->mock->has_media) {
+        return 0;
+    }
+    mock_player_t *mock = player->mock;
+    unsigned long long now = getMonotonicTimeUs();
+    run_script(player, now);
+    set_playing(player, 1, now);
+    if (mock->change_us && atomic_load(&mock->next_change_us) == 0) {
+        mock->next_step = 0;
+        atomic_store(&mock->next_change_us, now + mock->change_us);
+    }
+    player->desired_playing_state = 1;
+    raise_events(player, VLC_PLAYER_EVENT_STATE);
+    return 1;
+}
+
+// Pause media
+int vlc_player_pause(vlc_player_t *player) {
+    if (!player) {
+        return 0;
+    }
+    unsigned long long now = getMonotonicTimeUs();
+    run_script(player, now);
+    set_playing(player, 0, now);
+    player->desired_playing_state = 0;
+    raise_events(player, VLC_PLAYER_EVENT_STATE);
+    return 1;
+}
+
+// Stop media, and the script with it
+int vlc_player_stop(vlc_player_t *player) {
+    if (!player) {
+        return 0;
+    }
+    set_playing(player, 0, getMonotonicTimeUs());
+    player->mock->anchor_pos_ms = 0;
+    atomic_store(&player->mock->next_change_us, 0);
+    player->desired_playing_state = 0;
+    raise_events(player, VLC_PLAYER_EVENT_STATE);
+    return 1;
+}
+
+// Toggle play/pause
+int vlc_player_toggle_play_pause(vlc_player_t *player) {
+    if (!player) {
+        return 0;
+    }
+    run_script(player, getMonotonicTimeUs());
+    return player->mock->playing ? vlc_player_pause(player) : vlc_player_play(player);
+}
+
+int vlc_player_watch(vlc_player_t *player, vlc_player_event_cb cb, void *data) {
+    if (!player || !cb) {
+        return 0;
+    }
+    player->event_cb = cb;
+    player->event_data = data;
+    atomic_store(&player->mock->stopping, 0);
+    player->mock->thread = platform_thread_start(event_loop, player);
+    if (!player->mock->thread) {
+        printf("Mock player: could not start the event thread\n");
+        return 0;
+    }
+    return 1;
+}
+
+void vlc_player_unwatch(vlc_player_t *player) {
+    if (!player || !player->mock->thread) {
+        return;
+    }
+    atomic_store(&player->mock->stopping, 1);
+    platform_thread_join(player->mock->thread);
+    player->mock->thread = NULL;
+    player->event_cb = NULL;
+}
+
+// Query status, as vlc_player.c reports it for the same state
+int query_vlc_status(vlc_player_t *player, vlc_status_t *status) {
+    if (!player || !status) {
+        return 0;
+    }
+    memset(status, 0, sizeof(vlc_status_t));
+    mock_player_t *mock = player->mock;
+
+    if (!mock->has_media) {
+        status->is_stopped = 1;
+        strcpy(status->title, "No media");
+        strcpy(status->filename, "No media");
+        return 1;
+    }
+
+    unsigned long long now = getMonotonicTimeUs();
+    run_script(player, now);
+    status->time = position_at(mock, now);
+    status->duration = MOCK_DURATION_MS;
+    status->is_playing = mock->playing;
+    status->is_paused = !mock->playing;
+
+    const char *filename_only = strrchr(player->current_filepath, '/');
+    if (!filename_only) filename_only = strrchr(player->current_filepath, '\\');
+    const char *name = filename_only ? filename_only + 1 : player->current_filepath;
+    memcpy(status->filename, name, strnlen(name, sizeof(status->filename) - 1));  // Zeroed above
+    return 1;
+}
@@ -2,39 +2,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ws2tcpip.h>
-
-#define MULTICAST_PORT 12345
-#define MULTICAST_IP "239.255.255.250"
-
-// Get current Unix timestamp in milliseconds
-long long getUnixTimeMs() {
-    FILETIME ft;
-    ULARGE_INTEGER uli;
-    GetSystemTimeAsFileTime(&ft);
-    uli.LowPart = ft.dwLowDateTime;
-    uli.HighPart = ft.dwHighDateTime;
-    
-    // Convert from Windows FILETIME (100ns intervals since Jan 1, 1601)
-    // to Unix timestamp (ms since Jan 1, 1970)
-    return (uli.QuadPart / 10000) - 11644473600000LL;
-}
-
-// Initialize Winsock
-int initialize_winsock() {
-    WSADATA wsaData;
-    int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
-    if (result != 0) {
-        printf("WSAStartup failed: %d\n", result);
-        return 0;
-    }
-    return 1;
-}
-
-// Cleanup Winsock
-void cleanup_winsock() {
-    WSACleanup();
-}
 
 // Create multicast socket
 SOCKET create_multicast_socket() {
@@ -63,15 +30,20 @@ SOCKET create_multicast_socket() {
     return sock;
 }
 
-// Send data via multicast
+// Send a NUL-terminated string via multicast
 int send_multicast_data(SOCKET sock, const char *data) {
+    return send_multicast_packet(sock, data, (int)strlen(data));
+}
+
+// Send len bytes via multicast
+int send_multicast_packet(SOCKET sock, const char *data, int len) {
     struct sockaddr_in multicast_addr;
     memset(&multicast_addr, 0, sizeof(multicast_addr));
     multicast_addr.sin_family = AF_INET;
     multicast_addr.sin_port = htons(MULTICAST_PORT);
     inet_pton(AF_INET, MULTICAST_IP, &multicast_addr.sin_addr);
     
-    int result = sendto(sock, data, (int)strlen(data), 0,
+    int result = sendto(sock, data, len, 0,
                        (struct sockaddr*)&multicast_addr, sizeof(multicast_addr));
     
     if (result == SOCKET_ERROR) {
@@ -82,14 +54,47 @@ int send_multicast_data(SOCKET sock, const char *data) {
     return 1;
 }
 
+// Escape a string for use inside a JSON string literal: quotes, backslashes
+// and control characters. out must hold 6 bytes per input byte, plus one.
+// Bytes from 0x80 up are copied as they are -- they are UTF-8.
+static void json_escape(const char *in, char *out) {
+    static const char hex[] = "0123456789abcdef";
+    for (; *in; in++) {
+        unsigned char c = (unsigned char)*in;
+        if (c == '"' || c == '\\') {
+            *out++ = '\\';
+            *out++ = (char)c;
+        } else if (c < 0x20) {
+            *out++ = '\\';
+            *out++ = 'u';
+            *out++ = '0';
+            *out++ = '0';
+            *out++ = hex[c >> 4];
+            *out++ = hex[c & 0xf];
+        } else {
+            *out++ = (char)c;
+        }
+    }
+    *out = '\0';
+}
+
 // Create JSON status message with timestamp
 char *create_status_json_with_timestamp(const vlc_status_t *status, long long server_timestamp_ms) {
     if (!status) {
         return NULL;
     }
 
-    // Allocate buffer for JSON - make it large enough for all content
-    char *json = malloc(2048);
+    // Title and file name are escaped first: a quote or backslash in either
+    // used to go into the document as it was, and broke it.
+    char title[sizeof(status->title) * 6];
+    char filename[sizeof(status->filename) * 6];
+    json_escape(status->title, title);
+    json_escape(status->filename, filename);
+
+    // Allocate buffer for JSON - large enough for both escaped names at their
+    // longest, plus everything else
+    size_t json_len = sizeof(title) + sizeof(filename) + 512;
+    char *json = malloc(json_len);
     if (!json) {
         return NULL;
     }
@@ -112,7 +117,7 @@ char *create_status_json_with_timestamp(const vlc_status_t *status, long long se
 
     // Create JSON message
     int is_loading = status->is_loading;
-    snprintf(json, 2048,
+    snprintf(json, json_len,
              "{"
              "\"server_timestamp\": %lld,"
              "\"state\": \"%s\","
@@ -135,9 +140,76 @@ char *create_status_json_with_timestamp(const vlc_status_t *status, long long se
              media_status,
              status->time,
              status->duration,
-             status->title,
-             status->filename
+             title,
+             filename
     );
 
     return json;
+}
+
+static uint8_t *put_u16le(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_u32le(uint8_t *p, uint32_t v) {
+    p = put_u16le(p, (uint16_t)v);
+    return put_u16le(p, (uint16_t)(v >> 16));
+}
+
+static uint8_t *put_u64le(uint8_t *p, uint64_t v) {
+    p = put_u32le(p, (uint32_t)v);
+    return put_u32le(p, (uint32_t)(v >> 32));
+}
+
+// Build a binary status packet (layout in network.h) into out. No allocation
+// and no formatting, so it is cheap enough to send many times a second.
+// Returns its length, or 0 if out is too small.
+size_t create_status_packet(const vlc_status_t *status, uint32_t seq, long long server_timestamp_ms,
+                            unsigned long long server_mono_us, uint8_t *out, size_t out_len) {
+    if (!status) {
+        return 0;
+    }
+
+    uint8_t flags = 0;
+    if (status->is_playing) flags |= STATUS_FLAG_PLAYING;
+    if (status->is_paused) flags |= STATUS_FLAG_PAUSED;
+    if (status->is_stopped) flags |= STATUS_FLAG_STOPPED;
+    if (status->is_loading) flags |= STATUS_FLAG_LOADING;
+
+    const char *name = status->filename;
+    if (status->title[0] != '\0') {
+        name = status->title;
+        flags |= STATUS_FLAG_NAME_IS_TITLE;
+    }
+    size_t name_len = strlen(name);
+    if (name_len > STATUS_PACKET_MAX_NAME) {
+        name_len = STATUS_PACKET_MAX_NAME;
+        // Back off to the start of a UTF-8 character, so it is not split.
+        while (name_len > 0 && ((unsigned char)name[name_len] & 0xc0) == 0x80) {
+            name_len--;
+        }
+    }
+
+    if (out_len < STATUS_PACKET_HEADER_LEN + name_len) {
+        return 0;
+    }
+
+    uint8_t *p = out;
+    memcpy(p, STATUS_PACKET_MAGIC, 4);
+    p += 4;
+    *p++ = STATUS_PACKET_VERSION;
+    *p++ = flags;
+    p = put_u16le(p, (uint16_t)name_len);
+    p = put_u32le(p, seq);
+    p = put_u16le(p, STATUS_PACKET_HEADER_LEN);
+    p = put_u16le(p, 0);
+    p = put_u64le(p, (uint64_t)server_timestamp_ms);
+    p = put_u64le(p, (uint64_t)server_mono_us);
+    p = put_u64le(p, (uint64_t)status->time);
+    p = put_u64le(p, (uint64_t)status->duration);
+    memcpy(p, name, name_len);
+
+    return STATUS_PACKET_HEADER_LEN + name_len;
 }
\ No newline at end of file
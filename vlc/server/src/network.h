@@ -1,16 +1,60 @@
 #ifndef NETWORK_H
 #define NETWORK_H
 
-#include <windows.h>
-#include <winsock2.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "platform.h"
 #include "vlc_player.h"
 
+// Where status datagrams go. The display's receiver joins this group on this
+// port (`Receiver` in src/vlc.zig): change one, change the other.
+#define MULTICAST_IP "239.255.0.100"
+#define MULTICAST_PORT 8888
+
+// Which encoding status datagrams are sent in (--format).
+typedef enum {
+    STATUS_FORMAT_BINARY,
+    STATUS_FORMAT_JSON,
+} status_format_t;
+
+// Binary status packet, version 1. Fixed layout, every field little-endian:
+//
+//   offset  size  field
+//        0     4  magic "VLCS"
+//        4     1  version (STATUS_PACKET_VERSION)
+//        5     1  flags (STATUS_FLAG_*)
+//        6     2  name length in bytes
+//        8     4  sequence number, +1 per packet sent
+//       12     2  header length -- where the name starts
+//       14     2  reserved, zero
+//       16     8  server wall clock when sent, Unix ms
+//       24     8  server monotonic clock when sent, us
+//       32     8  play position, ms
+//       40     8  duration, ms
+//       48     n  name: the title if the media has one, else the file name;
+//                 UTF-8, not terminated
+//
+// Receivers read the name at the header length rather than at 48, so a
+// later version can append header fields without breaking them. The version
+// only changes when an existing field does.
+#define STATUS_PACKET_MAGIC "VLCS"
+#define STATUS_PACKET_VERSION 1
+#define STATUS_PACKET_HEADER_LEN 48
+#define STATUS_PACKET_MAX_NAME 255
+#define STATUS_PACKET_MAX_LEN (STATUS_PACKET_HEADER_LEN + STATUS_PACKET_MAX_NAME)
+
+#define STATUS_FLAG_PLAYING 0x01
+#define STATUS_FLAG_PAUSED 0x02
+#define STATUS_FLAG_STOPPED 0x04
+#define STATUS_FLAG_LOADING 0x08
+#define STATUS_FLAG_NAME_IS_TITLE 0x10
+
 // Function declarations
-long long getUnixTimeMs();
-int initialize_winsock();
-void cleanup_winsock();
 SOCKET create_multicast_socket();
 int send_multicast_data(SOCKET sock, const char *data);
+int send_multicast_packet(SOCKET sock, const char *data, int len);
 char *create_status_json_with_timestamp(const vlc_status_t *status, long long server_timestamp_ms);
+size_t create_status_packet(const vlc_status_t *status, uint32_t seq, long long server_timestamp_ms,
+                            unsigned long long server_mono_us, uint8_t *out, size_t out_len);
 
 #endif // NETWORK_H
\ No newline at end of file
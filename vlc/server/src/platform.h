@@ -0,0 +1,63 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+// Everything the server needs from the operating system that differs between
+// Windows and Linux: sockets, clocks, a thread, and the main loop's wait.
+// platform_win32.c and platform_linux.c implement it; CMake builds whichever
+// matches the target, and nothing above this header includes an OS header of
+// its own.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+// The Winsock names the network code is written against, for BSD sockets.
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define closesocket(s) close(s)
+#define WSAGetLastError() errno
+#endif
+
+// Socket library setup, before the first socket is created; a no-op on Linux
+int platform_net_init(void);
+void platform_net_cleanup(void);
+
+// Wall clock, Unix ms
+long long getUnixTimeMs(void);
+
+// The server's monotonic clock in microseconds. Unlike getUnixTimeMs, never
+// steps when the wall clock is adjusted, so receivers can measure the interval
+// between two packets from it. Every deadline in the server is on this clock.
+unsigned long long getMonotonicTimeUs(void);
+
+// CPU time this process has used so far, user and system, in microseconds
+unsigned long long platform_cpu_time_us(void);
+
+// A thread running fn(arg), for backends that produce events of their own
+typedef struct platform_thread platform_thread_t;
+platform_thread_t *platform_thread_start(void (*fn)(void *arg), void *arg);
+void platform_thread_join(platform_thread_t *thread);
+void platform_sleep_us(unsigned long long us);
+
+// The main loop's wait. It sleeps until platform_loop_wake is called (from
+// any thread), a timeout passes, or the OS has something for the main thread
+// -- window messages on Windows, which it dispatches itself.
+typedef struct platform_loop platform_loop_t;
+platform_loop_t *platform_loop_create(void);
+void platform_loop_destroy(platform_loop_t *loop);
+void platform_loop_wake(platform_loop_t *loop);
+// Returns 0 once the program has been asked to quit: the window closed, or
+// SIGINT/SIGTERM on Linux. Otherwise 1, whatever woke it.
+int platform_loop_wait(platform_loop_t *loop, unsigned long long timeout_us);
+
+#endif // PLATFORM_H
@@ -0,0 +1,181 @@
+#include "platform.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+int platform_net_init(void) {
+    return 1;
+}
+
+void platform_net_cleanup(void) {
+}
+
+long long getUnixTimeMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+unsigned long long getMonotonicTimeUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000;
+}
+
+unsigned long long platform_cpu_time_us(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000;
+}
+
+struct platform_thread {
+    pthread_t handle;
+    void (*fn)(void *arg);
+    void *arg;
+};
+
+static void *thread_main(void *data) {
+    platform_thread_t *thread = (platform_thread_t *)data;
+    thread->fn(thread->arg);
+    return NULL;
+}
+
+platform_thread_t *platform_thread_start(void (*fn)(void *arg), void *arg) {
+    platform_thread_t *thread = (platform_thread_t *)malloc(sizeof(platform_thread_t));
+    if (!thread) {
+        return NULL;
+    }
+    thread->fn = fn;
+    thread->arg = arg;
+    if (pthread_create(&thread->handle, NULL, thread_main, thread) != 0) {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void platform_thread_join(platform_thread_t *thread) {
+    if (!thread) return;
+    pthread_join(thread->handle, NULL);
+    free(thread);
+}
+
+void platform_sleep_us(unsigned long long us) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(us / 1000000ULL);
+    ts.tv_nsec = (long)(us % 1000000ULL) * 1000L;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+// One epoll set, three descriptors: an eventfd for wakes from other threads,
+// a timerfd for the next deadline, and a signalfd so SIGINT and SIGTERM end
+// the loop as a closed window does on Windows, rather than killing the
+// process before it has cleaned up. The timerfd takes the deadline to the
+// nanosecond, where an epoll_wait timeout would round it to a millisecond.
+struct platform_loop {
+    int epoll_fd;
+    int wake_fd;
+    int timer_fd;
+    int signal_fd;
+    int quit;
+};
+
+static int watch_fd(int epoll_fd, int fd) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+platform_loop_t *platform_loop_create(void) {
+    platform_loop_t *loop = (platform_loop_t *)malloc(sizeof(platform_loop_t));
+    if (!loop) {
+        return NULL;
+    }
+    memset(loop, 0, sizeof(platform_loop_t));
+
+    // Blocked in the creating thread before any other exists -- libvlc's
+    // included -- so every thread inherits the mask and the signals are only
+    // ever delivered through the signalfd.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop->signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (loop->epoll_fd < 0 || loop->wake_fd < 0 || loop->timer_fd < 0 || loop->signal_fd < 0 ||
+        watch_fd(loop->epoll_fd, loop->wake_fd) != 0 ||
+        watch_fd(loop->epoll_fd, loop->timer_fd) != 0 ||
+        watch_fd(loop->epoll_fd, loop->signal_fd) != 0) {
+        printf("Failed to set up the event loop: %s\n", strerror(errno));
+        platform_loop_destroy(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+void platform_loop_destroy(platform_loop_t *loop) {
+    if (!loop) return;
+    if (loop->signal_fd > 0) close(loop->signal_fd);
+    if (loop->timer_fd > 0) close(loop->timer_fd);
+    if (loop->wake_fd > 0) close(loop->wake_fd);
+    if (loop->epoll_fd > 0) close(loop->epoll_fd);
+    free(loop);
+}
+
+void platform_loop_wake(platform_loop_t *loop) {
+    uint64_t one = 1;
+    // Only fails if the counter is about to overflow, when a wake is pending
+    // anyway.
+    ssize_t written = write(loop->wake_fd, &one, sizeof(one));
+    (void)written;
+}
+
+int platform_loop_wait(platform_loop_t *loop, unsigned long long timeout_us) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = (time_t)(timeout_us / 1000000ULL);
+    spec.it_value.tv_nsec = (long)(timeout_us % 1000000ULL) * 1000L;
+    if (timeout_us == 0) {
+        spec.it_value.tv_nsec = 1;  // An all-zero value would disarm it
+    }
+    timerfd_settime(loop->timer_fd, 0, &spec, NULL);
+
+    struct epoll_event events[3];
+    int n;
+    do {
+        n = epoll_wait(loop->epoll_fd, events, 3, -1);
+    } while (n < 0 && errno == EINTR);
+
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == loop->signal_fd) {
+            struct signalfd_siginfo info;
+            while (read(fd, &info, sizeof(info)) == (ssize_t)sizeof(info)) {
+                printf("\nReceived signal %u\n", info.ssi_signo);
+                loop->quit = 1;
+            }
+        } else {
+            // eventfd and timerfd both read as a count, and reading resets it
+            uint64_t count;
+            ssize_t got = read(fd, &count, sizeof(count));
+            (void)got;
+        }
+    }
+    return !loop->quit;
+}
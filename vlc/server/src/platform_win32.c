@@ -0,0 +1,145 @@
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Initialize Winsock
+int platform_net_init(void) {
+    WSADATA wsaData;
+    int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if (result != 0) {
+        printf("WSAStartup failed: %d\n", result);
+        return 0;
+    }
+    return 1;
+}
+
+// Cleanup Winsock
+void platform_net_cleanup(void) {
+    WSACleanup();
+}
+
+// Get current Unix timestamp in milliseconds
+long long getUnixTimeMs(void) {
+    FILETIME ft;
+    ULARGE_INTEGER uli;
+    GetSystemTimeAsFileTime(&ft);
+    uli.LowPart = ft.dwLowDateTime;
+    uli.HighPart = ft.dwHighDateTime;
+
+    // Convert from Windows FILETIME (100ns intervals since Jan 1, 1601)
+    // to Unix timestamp (ms since Jan 1, 1970)
+    return (uli.QuadPart / 10000) - 11644473600000LL;
+}
+
+unsigned long long getMonotonicTimeUs(void) {
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    // Split to keep the multiplication from overflowing on a long uptime.
+    unsigned long long ticks = (unsigned long long)counter.QuadPart;
+    unsigned long long freq = (unsigned long long)frequency.QuadPart;
+    return (ticks / freq) * 1000000ULL + (ticks % freq) * 1000000ULL / freq;
+}
+
+unsigned long long platform_cpu_time_us(void) {
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+        return 0;
+    }
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 10;  // 100ns units
+}
+
+struct platform_thread {
+    HANDLE handle;
+    void (*fn)(void *arg);
+    void *arg;
+};
+
+static DWORD WINAPI thread_main(LPVOID data) {
+    platform_thread_t *thread = (platform_thread_t *)data;
+    thread->fn(thread->arg);
+    return 0;
+}
+
+platform_thread_t *platform_thread_start(void (*fn)(void *arg), void *arg) {
+    platform_thread_t *thread = (platform_thread_t *)malloc(sizeof(platform_thread_t));
+    if (!thread) {
+        return NULL;
+    }
+    thread->fn = fn;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, thread_main, thread, 0, NULL);
+    if (!thread->handle) {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void platform_thread_join(platform_thread_t *thread) {
+    if (!thread) return;
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    free(thread);
+}
+
+void platform_sleep_us(unsigned long long us) {
+    Sleep((DWORD)((us + 999) / 1000));
+}
+
+struct platform_loop {
+    HANDLE wake_event;  // Auto-reset; set by platform_loop_wake
+};
+
+platform_loop_t *platform_loop_create(void) {
+    platform_loop_t *loop = (platform_loop_t *)malloc(sizeof(platform_loop_t));
+    if (!loop) {
+        return NULL;
+    }
+    loop->wake_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!loop->wake_event) {
+        free(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+void platform_loop_destroy(platform_loop_t *loop) {
+    if (loop) {
+        CloseHandle(loop->wake_event);
+        free(loop);
+    }
+}
+
+void platform_loop_wake(platform_loop_t *loop) {
+    SetEvent(loop->wake_event);
+}
+
+int platform_loop_wait(platform_loop_t *loop, unsigned long long timeout_us) {
+    // Rounded up: waking a millisecond early would only find nothing due yet
+    unsigned long long timeout_ms = (timeout_us + 999) / 1000;
+    if (timeout_ms >= INFINITE) {
+        timeout_ms = INFINITE - 1;
+    }
+    MsgWaitForMultipleObjectsEx(1, &loop->wake_event, (DWORD)timeout_ms,
+                                QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+    // Handle Windows messages (non-blocking)
+    MSG msg;
+    while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+        if (msg.message == WM_QUIT) {
+            return 0;
+        }
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+    return 1;
+}
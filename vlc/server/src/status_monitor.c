@@ -5,55 +5,125 @@
 #include <string.h>
 #include <stdlib.h>
 
+// Status is pushed, not polled on a fixed period: the player's events wake
+// the main loop the moment the player changes state, and a packet goes out
+// right then. Multicast has no retransmission, so each change is sent as a
+// burst of identical-but-for-sequence packets rather than once. While nothing
+// changes, a heartbeat at --interval keeps a display that joined late, or
+// missed a burst, from waiting long for a resync.
+
+// Packets sent per change: the first at once, the rest BURST_SPACING_MS apart,
+// so a single lost datagram cannot hide a pause or a seek.
+#define BURST_COUNT 4
+#define BURST_SPACING_MS 40
+
+// A seek is only visible as the position jumping. A position this far from
+// where steady playback from the last packet would have put it counts as a
+// change.
+#define SEEK_THRESHOLD_MS 500
+
 // External variables
 extern int debug_mode;
 extern int suppress_vlc_status_log;
-extern vlc_player_t *g_vlc_player;
 
-// Create status monitor instance
-status_monitor_t* status_monitor_create() {
+// Runs on a player thread, which must not call back into the player. Record
+// the event and wake the main loop; it does the rest.
+static void on_player_event(unsigned events, void *data) {
+    status_monitor_t *monitor = (status_monitor_t *)data;
+    atomic_fetch_or(&monitor->pending_events, events);
+    platform_loop_wake(monitor->loop);
+}
+
+// Create status monitor instance, subscribed to player's events
+status_monitor_t* status_monitor_create(status_format_t format, uint32_t heartbeat_ms, vlc_player_t *player,
+                                        platform_loop_t *loop) {
     status_monitor_t* monitor = (status_monitor_t*)malloc(sizeof(status_monitor_t));
     if (!monitor) {
         return NULL;
     }
     
     memset(monitor, 0, sizeof(status_monitor_t));
+    monitor->format = format;
+    monitor->heartbeat_us = heartbeat_ms * 1000ULL;
+    monitor->player = player;
+    monitor->loop = loop;
+    atomic_init(&monitor->pending_events, 0);
+    monitor->started_time = getMonotonicTimeUs();
+    monitor->started_cpu_us = platform_cpu_time_us();
+    monitor->next_send_time = monitor->started_time;
+
+    if (player && !vlc_player_watch(player, on_player_event, monitor)) {
+        printf("Warning: not every player event is watched; relying on the heartbeat\n");
+    }
     return monitor;
 }
 
 // Destroy status monitor instance
 void status_monitor_destroy(status_monitor_t* monitor) {
     if (monitor) {
+        vlc_player_unwatch(monitor->player);
         free(monitor);
     }
 }
 
-// Update and broadcast VLC status
-int status_monitor_update(status_monitor_t* monitor, SOCKET multicast_sock, DWORD update_interval_ms) {
+// How long until the next packet is due if no event arrives first
+unsigned long long status_monitor_wait_us(const status_monitor_t* monitor) {
+    unsigned long long now = getMonotonicTimeUs();
+    return monitor->next_send_time > now ? monitor->next_send_time - now : 0;
+}
+
+// Whether status differs from what the last packet said in anything a display
+// shows -- allowing, while playing, for the time that has passed since.
+static int status_changed(const status_monitor_t* monitor, const vlc_status_t* status, unsigned long long now) {
+    const vlc_status_t* sent = &monitor->last_status;
+    if (status->is_playing != sent->is_playing ||
+        status->is_paused != sent->is_paused ||
+        status->is_stopped != sent->is_stopped ||
+        status->is_loading != sent->is_loading ||
+        status->duration != sent->duration ||
+        strcmp(status->title, sent->title) != 0 ||
+        strcmp(status->filename, sent->filename) != 0) {
+        return 1;
+    }
+    long long expected = sent->time;
+    if (sent->is_playing) {
+        expected += (long long)((now - monitor->last_status_time) / 1000);
+    }
+    return llabs(status->time - expected) > SEEK_THRESHOLD_MS;
+}
+
+// Send a packet if a player event changed anything, or one is due -- a burst
+// repeat or the heartbeat. Returns whether one was sent.
+int status_monitor_update(status_monitor_t* monitor, SOCKET multicast_sock) {
     if (!monitor) return 0;
     
-    DWORD current_time = GetTickCount();
-    if (current_time - monitor->last_update_time < update_interval_ms) {
-        return 0;  // Not time to update yet
+    unsigned long long current_time = getMonotonicTimeUs();
+    unsigned events = atomic_exchange(&monitor->pending_events, 0);
+    int due = current_time >= monitor->next_send_time;
+    if (!events && !due) {
+        return 0;  // Woken for something else, nothing to send
     }
     
     // Debug interval tracking
     if (debug_mode && !suppress_vlc_status_log) {
         if (monitor->last_query_time > 0) {
-            printf("[DEBUG] Query interval: %lu ms\n", current_time - monitor->last_query_time);
+            printf("[DEBUG] Query interval: %llu us (events 0x%x)\n",
+                   current_time - monitor->last_query_time, events);
         }
         monitor->last_query_time = current_time;
     }
 
-    // Get server timestamp at poll time (UTC milliseconds)
+    // Get server timestamp at poll time (UTC milliseconds); the monotonic
+    // clock alongside it for the binary packet is current_time
     long long server_timestamp_ms = getUnixTimeMs();
+    unsigned long long server_mono_us = current_time;
 
     // Query VLC status directly from libvlc
     if (debug_mode && !suppress_vlc_status_log) {
         printf("[DEBUG] About to query VLC status...\n");
     }
 
-    int status_ok = query_vlc_status(g_vlc_player, &monitor->current_status);
+    int status_ok = query_vlc_status(monitor->player, &monitor->current_status);
 
     if (debug_mode && !suppress_vlc_status_log) {
         printf("[DEBUG] Query VLC status completed, status_ok: %d\n", status_ok);
@@ -63,48 +133,73 @@ int status_monitor_update(status_monitor_t* monitor, SOCKET multicast_sock, DWOR
         // Update status bar with current playback info
         update_status_bar(&monitor->current_status);
 
-        // Check if status changed significantly
-        int status_changed = 0;
-        if (monitor->current_status.is_playing != monitor->last_status.is_playing ||
-            monitor->current_status.is_paused != monitor->last_status.is_paused ||
-            monitor->current_status.is_stopped != monitor->last_status.is_stopped ||
-            abs((int)(monitor->current_status.time - monitor->last_status.time)) > 2000 ||  // Time diff > 2 sec
-            strcmp(monitor->current_status.title, monitor->last_status.title) != 0 ||
-            strcmp(monitor->current_status.filename, monitor->last_status.filename) != 0) {
-            status_changed = 1;
-        }
+        // A change starts a new burst, replacing any still in progress
+        int status_changed_now = !monitor->has_sent ||
+            status_changed(monitor, &monitor->current_status, current_time);
 
-        if (debug_mode && (!suppress_vlc_status_log || status_changed)) {
+        if (debug_mode && (!suppress_vlc_status_log || status_changed_now)) {
             printf("[DEBUG] Query result - Playing: %s, Time: %lld ms, Status changed: %s\n",
                    monitor->current_status.is_playing ? "Yes" : "No",
                    monitor->current_status.time,
-                   status_changed ? "Yes" : "No");
+                   status_changed_now ? "Yes" : "No");
         }
 
-        if (status_changed) {
-            // Update last status
-            memcpy(&monitor->last_status, &monitor->current_status, sizeof(vlc_status_t));
+        if (status_changed_now) {
+            monitor->burst_remaining = BURST_COUNT;
+        } else if (!due) {
+            return 0;  // A position update that matched steady playback
+        }
+        // A repeat within a burst is not worth a line of its own in the log
+        int repeat = !status_changed_now && monitor->burst_remaining > 0;
+        if (!status_changed_now) {
+            unsigned long long late = current_time - monitor->next_send_time;
+            monitor->scheduled_sends++;
+            monitor->lateness_sum_us += late;
+            if (late > monitor->lateness_max_us) {
+                monitor->lateness_max_us = late;
+            }
         }
 
-        // Always send the current status
-        char *json_message = create_status_json_with_timestamp(&monitor->current_status, server_timestamp_ms);
-        if (json_message) {
+        // Send the current status, in whichever format was chosen.
+        // The binary packet is built on the stack; JSON is formatted into a
+        // heap buffer freed below.
+        uint8_t packet[STATUS_PACKET_MAX_LEN];
+        size_t packet_len = 0;
+        char *json_message = NULL;
+        if (monitor->format == STATUS_FORMAT_BINARY) {
+            packet_len = create_status_packet(&monitor->current_status, monitor->seq, server_timestamp_ms,
+                                              server_mono_us, packet, sizeof(packet));
+            monitor->seq++;
+        } else {
+            json_message = create_status_json_with_timestamp(&monitor->current_status, server_timestamp_ms);
+        }
+        if (packet_len > 0 || json_message) {
             if (debug_mode && !suppress_vlc_status_log) {
-                printf("[DEBUG] Multicast JSON: %s\n", json_message);
+                if (json_message) {
+                    printf("[DEBUG] Multicast JSON: %s\n", json_message);
+                } else {
+                    printf("[DEBUG] Multicast packet %lu: %u bytes\n",
+                           (unsigned long)(monitor->seq - 1), (unsigned)packet_len);
+                }
             }
             // Send via multicast
-            if (send_multicast_data(multicast_sock, json_message)) {
+            int sent = json_message
+                ? send_multicast_data(multicast_sock, json_message)
+                : send_multicast_packet(multicast_sock, (const char *)packet, (int)packet_len);
+            if (sent) {
+                monitor->packets_sent++;
+
                 // Get current timestamp with subsecond precision (UTC)
-                SYSTEMTIME st;
-                GetSystemTime(&st);
+                long long ms_of_day = server_timestamp_ms % 86400000LL;
                 char time_str[32];
                 snprintf(time_str, sizeof(time_str), "%02d:%02d:%02d.%03d",
-                       st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
+                       (int)(ms_of_day / 3600000), (int)(ms_of_day / 60000 % 60),
+                       (int)(ms_of_day / 1000 % 60), (int)(ms_of_day % 1000));
 
-                if (!suppress_vlc_status_log) {
+                if (!suppress_vlc_status_log && !repeat) {
                     // Determine status text for broadcast
                     const char *status_text;
-                    if (g_vlc_player && g_vlc_player->is_loading) {
+                    if (monitor->player && monitor->player->is_loading) {
                         status_text = "Loading";
                     } else if (monitor->current_status.is_playing) {
                         status_text = "Playing";
@@ -124,6 +219,14 @@ int status_monitor_update(status_monitor_t* monitor, SOCKET multicast_sock, DWOR
             
             free(json_message);
         }
+
+        // What the next change is judged against
+        memcpy(&monitor->last_status, &monitor->current_status, sizeof(vlc_status_t));
+        monitor->last_status_time = current_time;
+        monitor->has_sent = 1;
+        if (monitor->burst_remaining > 0) {
+            monitor->burst_remaining--;
+        }
     } else {
         // VLC query failed - set default stopped status
         monitor->current_status.is_playing = 0;
@@ -138,6 +241,26 @@ int status_monitor_update(status_monitor_t* monitor, SOCKET multicast_sock, DWOR
         update_status_bar(&monitor->current_status);
     }
 
-    monitor->last_update_time = current_time;
+    monitor->next_send_time = current_time +
+        (monitor->burst_remaining > 0 ? BURST_SPACING_MS * 1000ULL : monitor->heartbeat_us);
     return 1;  // Updated successfully
-}
\ No newline at end of file
+}
+
+// What the server did over its run, for comparing builds and platforms: how
+// many packets, how punctually the scheduled ones left, and what it all cost
+// in CPU.
+void status_monitor_print_stats(const status_monitor_t* monitor) {
+    if (!monitor) return;
+    unsigned long long elapsed_us = getMonotonicTimeUs() - monitor->started_time;
+    unsigned long long cpu_us = platform_cpu_time_us() - monitor->started_cpu_us;
+    double elapsed_s = elapsed_us > 0 ? elapsed_us / 1e6 : 1e-6;
+    printf("Sent %lu packets in %.1f s (%.2f/s)\n", monitor->packets_sent, elapsed_s,
+           monitor->packets_sent / elapsed_s);
+    if (monitor->scheduled_sends > 0) {
+        printf("Scheduled sends: %lu, late by %.3f ms on average, %.3f ms at most\n",
+               monitor->scheduled_sends,
+               monitor->lateness_sum_us / 1e3 / monitor->scheduled_sends,
+               monitor->lateness_max_us / 1e3);
+    }
+    printf("CPU: %.3f s (%.2f%% of one core)\n", cpu_us / 1e6, cpu_us / 1e4 / elapsed_s);
+}
@@ -1,21 +1,46 @@
 #ifndef STATUS_MONITOR_H
 #define STATUS_MONITOR_H
 
-#include <windows.h>
-#include <winsock2.h>
+#include <stdatomic.h>
+#include "platform.h"
 #include "vlc_player.h"
+#include "network.h"
 
-// Status monitor state structure
+// Status monitor state structure. Times are getMonotonicTimeUs.
 typedef struct {
-    DWORD last_update_time;
     vlc_status_t current_status;
-    vlc_status_t last_status;
-    DWORD last_query_time;  // For debug interval tracking
+    vlc_status_t last_status;      // As of the last packet sent
+    unsigned long long last_status_time;  // When last_status was queried
+    int has_sent;                  // Whether anything has been sent yet
+    unsigned long long last_query_time;  // For debug interval tracking
+    status_format_t format; // Encoding of each datagram sent
+    uint32_t seq;           // Sequence number of the next binary packet
+
+    unsigned long long heartbeat_us;    // Send period while nothing changes
+    unsigned long long next_send_time;  // When the next packet is due
+    int burst_remaining;           // Repeats still to send for the last change
+
+    // The player calls back on its own threads; the callback only records
+    // what happened and wakes the main loop, which does everything else.
+    vlc_player_t *player;
+    platform_loop_t *loop;
+    atomic_uint pending_events;    // VLC_PLAYER_EVENT_* bits not yet looked at
+
+    // Totals for status_monitor_print_stats
+    unsigned long long started_time;
+    unsigned long long started_cpu_us;
+    unsigned long packets_sent;
+    unsigned long scheduled_sends;      // Burst repeats and heartbeats
+    unsigned long long lateness_sum_us; // How far past due those went out
+    unsigned long long lateness_max_us;
 } status_monitor_t;
 
 // Function declarations
-status_monitor_t* status_monitor_create();
+status_monitor_t* status_monitor_create(status_format_t format, uint32_t heartbeat_ms, vlc_player_t *player,
+                                        platform_loop_t *loop);
 void status_monitor_destroy(status_monitor_t* monitor);
-int status_monitor_update(status_monitor_t* monitor, SOCKET multicast_sock, DWORD update_interval_ms);
+int status_monitor_update(status_monitor_t* monitor, SOCKET multicast_sock);
+unsigned long long status_monitor_wait_us(const status_monitor_t* monitor);
+void status_monitor_print_stats(const status_monitor_t* monitor);
 
-#endif // STATUS_MONITOR_H
\ No newline at end of file
+#endif // STATUS_MONITOR_H
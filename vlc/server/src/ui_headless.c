@@ -0,0 +1,12 @@
+#include "ui.h"
+
+// Builds without a window (Linux) have no status bar to keep current. The
+// status monitor's own log lines say the same on the console.
+
+void update_status_bar_message(const char *message) {
+    (void)message;
+}
+
+void update_status_bar(const vlc_status_t *status) {
+    (void)status;
+}
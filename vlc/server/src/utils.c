@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "network.h"
 #include <stdio.h>
 
 // Format time in milliseconds to HH:MM:SS.mmm or MM:SS.mmm format
@@ -28,9 +29,17 @@ void print_usage(const char *program_name) {
     printf("Options:\n");
     printf("  --help, -h         Show this help message\n");
     printf("  --debug            Enable debug output\n");
+    printf("  --format <fmt>     Status datagram format: binary (default) or json\n");
+    printf("  --interval <ms>    Heartbeat period while nothing changes, at least 10 (default 1000)\n");
     printf("  --file <path>, -f  Open specified file on startup\n\n");
     printf("Environment Variables:\n");
-    printf("  VLC_NO_STATUS_LOG  Set to '1' to suppress repetitive status debug messages\n\n");
+    printf("  VLC_NO_STATUS_LOG  Set to '1' to suppress repetitive status debug messages\n");
+#ifdef VLC_STATUS_MOCK_PLAYER
+    printf("  VLC_MOCK_CHANGE_MS      Mock player: pause, resume or seek every this many ms\n");
+    printf("  VLC_MOCK_TIME_EVENT_MS  Mock player: position event period (default 250)\n");
+#endif
+    printf("\n");
+#ifdef _WIN32
     printf("Controls:\n");
     printf("  Space              Play/Pause\n");
     printf("  Left Arrow         Seek backward 10 seconds\n");
@@ -38,8 +47,12 @@ void print_usage(const char *program_name) {
     printf("  Home               Seek to beginning\n");
     printf("  Right-click        Open file dialog\n");
     printf("  Escape             Stop playback\n\n");
+#else
+    printf("Runs headless: the --file given is played at once. Ctrl+C stops it\n");
+    printf("and prints what was sent.\n\n");
+#endif
     printf("Network:\n");
-    printf("  Multicast IP:      239.255.255.250\n");
-    printf("  Multicast Port:    12345\n");
-    printf("  Update Interval:   250ms\n\n");
+    printf("  Multicast IP:      %s\n", MULTICAST_IP);
+    printf("  Multicast Port:    %d\n", MULTICAST_PORT);
+    printf("  Updates:           On every player event, plus a heartbeat every 1000ms\n\n");
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "vlc_player.h"
+#include "platform.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,7 +21,7 @@ vlc_player_t *vlc_player_create() {
     // Create VLC instance - use minimal arguments for better compatibility
     const char *vlc_args[] = {
         "--quiet",              // Suppress VLC console output
-        "--no-xlib",            // Disable X11 (not needed on Windows)
+        "--no-xlib",            // No Xlib (none on Windows; headless on Linux)
         "--extraintf=dummy",    // Use dummy interface
         "--intf=dummy",         // No interface
         "--no-video-title-show" // Don't show video title overlay
@@ -59,7 +60,9 @@ void vlc_player_destroy(vlc_player_t *player) {
     // Stop playback first
     if (player->media_player) {
         libvlc_media_player_stop(player->media_player);
+#ifdef _WIN32
         libvlc_media_player_set_hwnd(player->media_player, NULL);
+#endif
     }
 
     // Release media
@@ -92,7 +95,7 @@ int vlc_player_open_file(vlc_player_t *player, const char *filepath) {
 
     // Set loading state
     player->is_loading = 1;
-    player->loading_start_time = GetTickCount();
+    player->loading_start_us = getMonotonicTimeUs();
 
     // Store the filepath for filename extraction
     strncpy(player->current_filepath, filepath, sizeof(player->current_filepath) - 1);
@@ -172,6 +175,70 @@ int vlc_player_toggle_play_pause(vlc_player_t *player) {
     }
 }
 
+// The player events that can change what a display shows. TimeChanged fires
+// continually during playback; it is passed on, and the watcher decides
+// whether the position jumped.
+static const libvlc_event_type_t watched_events[] = {
+    libvlc_MediaPlayerMediaChanged,
+    libvlc_MediaPlayerOpening,
+    libvlc_MediaPlayerPlaying,
+    libvlc_MediaPlayerPaused,
+    libvlc_MediaPlayerStopped,
+    libvlc_MediaPlayerEndReached,
+    libvlc_MediaPlayerEncounteredError,
+    libvlc_MediaPlayerTimeChanged,
+    libvlc_MediaPlayerLengthChanged,
+};
+
+// Runs on a libvlc thread
+static void on_vlc_event(const struct libvlc_event_t *event, void *data) {
+    vlc_player_t *player = (vlc_player_t *)data;
+    unsigned events;
+    switch (event->type) {
+        case libvlc_MediaPlayerTimeChanged:
+            events = VLC_PLAYER_EVENT_TIME;
+            break;
+        case libvlc_MediaPlayerMediaChanged:
+            events = VLC_PLAYER_EVENT_MEDIA;
+            break;
+        default:
+            events = VLC_PLAYER_EVENT_STATE;
+            break;
+    }
+    player->event_cb(events, player->event_data);
+}
+
+// Call cb on every player event, until vlc_player_unwatch. One watcher at a
+// time. Returns 0 if some events could not be subscribed to, in which case
+// those changes go unreported.
+int vlc_player_watch(vlc_player_t *player, vlc_player_event_cb cb, void *data) {
+    if (!player || !player->media_player || !cb) {
+        return 0;
+    }
+    player->event_cb = cb;
+    player->event_data = data;
+    player->event_manager = libvlc_media_player_event_manager(player->media_player);
+    int all = 1;
+    for (size_t i = 0; i < sizeof(watched_events) / sizeof(watched_events[0]); i++) {
+        if (libvlc_event_attach(player->event_manager, watched_events[i], on_vlc_event, player) != 0) {
+            printf("Warning: could not subscribe to VLC event %d\n", (int)watched_events[i]);
+            all = 0;
+        }
+    }
+    return all;
+}
+
+void vlc_player_unwatch(vlc_player_t *player) {
+    if (!player || !player->event_manager) {
+        return;
+    }
+    for (size_t i = 0; i < sizeof(watched_events) / sizeof(watched_events[0]); i++) {
+        libvlc_event_detach(player->event_manager, watched_events[i], on_vlc_event, player);
+    }
+    player->event_manager = NULL;
+    player->event_cb = NULL;
+}
+
 // Simplified query VLC status function
 int query_vlc_status(vlc_player_t *player, vlc_status_t *status) {
     if (!player || !status) {
@@ -207,7 +274,7 @@ int query_vlc_status(vlc_player_t *player, vlc_status_t *status) {
         status->is_stopped = 0;
         if (status->time == 0 && vlc_is_playing && !player->is_loading) {
             player->is_loading = 1;
-            player->loading_start_time = GetTickCount();
+            player->loading_start_us = getMonotonicTimeUs();
         }
     } else {
         status->is_playing = 0;
@@ -217,7 +284,7 @@ int query_vlc_status(vlc_player_t *player, vlc_status_t *status) {
     }
 
     // Check for loading timeout
-    if (player->is_loading && GetTickCount() - player->loading_start_time > 45000) {
+    if (player->is_loading && getMonotonicTimeUs() - player->loading_start_us > 45000000ULL) {
         player->is_loading = 0;
     }
 
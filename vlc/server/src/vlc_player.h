@@ -1,8 +1,9 @@
 #ifndef VLC_PLAYER_H
 #define VLC_PLAYER_H
 
+#ifndef VLC_STATUS_MOCK_PLAYER
 #include <vlc/vlc.h>
-#include <windows.h>
+#endif
 
 // VLC status structure
 typedef struct {
@@ -16,16 +17,41 @@ typedef struct {
     char filename[256];
 } vlc_status_t;
 
-// VLC player structure
+// What a player event can have changed, as bits passed to a
+// vlc_player_event_cb. TIME is the position moving -- continually during
+// playback -- and is only interesting when it jumps.
+#define VLC_PLAYER_EVENT_STATE 0x1
+#define VLC_PLAYER_EVENT_TIME 0x2
+#define VLC_PLAYER_EVENT_MEDIA 0x4
+
+// Called on a thread of the player's own, which must not call back into the
+// player; see vlc_player_watch.
+typedef void (*vlc_player_event_cb)(unsigned events, void *data);
+
+#ifdef VLC_STATUS_MOCK_PLAYER
+typedef struct mock_player mock_player_t;
+#endif
+
+// VLC player structure. Built against either libvlc (vlc_player.c) or a
+// simulated player with no media at all (mock_player.c, with
+// VLC_STATUS_MOCK_PLAYER defined), which plays a file by the clock so the
+// server can be run and measured where VLC is not installed.
 typedef struct {
+#ifdef VLC_STATUS_MOCK_PLAYER
+    mock_player_t *mock;
+#else
     libvlc_instance_t *vlc_instance;
     libvlc_media_player_t *media_player;
     libvlc_media_t *current_media;
+    libvlc_event_manager_t *event_manager;  // Non-NULL while watched
+#endif
     char current_filepath[1024];  // Store the original filepath for fallback filename extraction
     int initialized;
     int desired_playing_state;  // 1=should be playing, 0=should be paused/stopped
     int is_loading;  // 1=currently loading a file, 0=not loading
-    DWORD loading_start_time;  // When loading started (for timeout detection)
+    unsigned long long loading_start_us;  // When loading started (for timeout detection)
+    vlc_player_event_cb event_cb;
+    void *event_data;
 } vlc_player_t;
 
 // External variables
@@ -40,6 +66,8 @@ int vlc_player_play(vlc_player_t *player);
 int vlc_player_pause(vlc_player_t *player);
 int vlc_player_stop(vlc_player_t *player);
 int vlc_player_toggle_play_pause(vlc_player_t *player);
+int vlc_player_watch(vlc_player_t *player, vlc_player_event_cb cb, void *data);
+void vlc_player_unwatch(vlc_player_t *player);
 int query_vlc_status(vlc_player_t *player, vlc_status_t *status);
 void print_status(const vlc_status_t *status);
 
@@ -1,29 +1,37 @@
 /*
  * VLC Status Server - Main Entry Point
  * 
- * A Windows application that provides VLC media player control and broadcasts
- * playback status via multicast UDP for remote monitoring.
+ * Provides VLC media player control and broadcasts playback status via
+ * multicast UDP for remote monitoring. On Windows it is a windowed player; on
+ * Linux it runs headless, playing the --file it is given.
  * 
  * Features:
  * - VLC media player integration with file loading and playback controls
- * - Real-time status broadcasting via UDP multicast (239.255.255.250:12345)
+ * - Real-time status broadcasting via UDP multicast (239.255.0.100:8888),
+ *   pushed on each player event with a slow heartbeat in between
  * - Windows UI with status bar and keyboard/mouse controls
- * - Drag & drop file support
+ * - Drag & drop file support (Windows)
  * - Command line options and debug modes
  * 
  * Architecture:
  * - src/vlc_player.c: VLC integration and media control
- * - src/network.c: UDP multicast and JSON status broadcasting
+ * - src/mock_player.c: a simulated player in its place, for measuring the
+ *   server without VLC (VLC_STATUS_MOCK_PLAYER)
+ * - src/status_monitor.c: when to send, and what
+ * - src/network.c: UDP multicast, binary and JSON status encoding
+ * - src/platform_win32.c, src/platform_linux.c: sockets, clocks, threads and
+ *   the main loop's wait -- a message/event wait on Windows, epoll on Linux
  * - src/ui.c: Windows GUI, keyboard/mouse handling, file dialogs
+ *   (src/ui_headless.c elsewhere)
  * - src/utils.c: Utility functions (time formatting, help text)
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <windows.h>
-#include <winsock2.h>
 
 // Include our modular components
+#include "src/platform.h"
 #include "src/vlc_player.h"
 #include "src/network.h"
 #include "src/ui.h"
@@ -32,18 +40,22 @@
 #include "src/status_monitor.h"
 
 // Constants
-#define UPDATE_INTERVAL_MS 250
+#define DEFAULT_HEARTBEAT_MS 1000
 
 // Global variables
 int debug_mode = 0;
 int suppress_vlc_status_log = 0;
 vlc_player_t *g_vlc_player = NULL;
+#ifdef _WIN32
 HWND g_status_bar = NULL;
+#endif
 
 
 // Main application entry point
 int main(int argc, char *argv[]) {
     char *initial_file = NULL;
+    status_format_t status_format = STATUS_FORMAT_BINARY;
+    int heartbeat_ms = DEFAULT_HEARTBEAT_MS;
 
     // Check for VLC_NO_STATUS_LOG environment variable
     char *no_status_log_env = getenv("VLC_NO_STATUS_LOG");
@@ -60,6 +72,23 @@ int main(int argc, char *argv[]) {
         if (strcmp(argv[i], "--debug") == 0) {
             debug_mode = 1;
             printf("Debug mode enabled.\n");
+        } else if (strcmp(argv[i], "--format") == 0) {
+            if (i + 1 < argc && strcmp(argv[i + 1], "binary") == 0) {
+                status_format = STATUS_FORMAT_BINARY;
+            } else if (i + 1 < argc && strcmp(argv[i + 1], "json") == 0) {
+                status_format = STATUS_FORMAT_JSON;
+            } else {
+                printf("Error: --format option requires 'binary' or 'json'\n");
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--interval") == 0) {
+            heartbeat_ms = i + 1 < argc ? atoi(argv[i + 1]) : 0;
+            if (heartbeat_ms < 10) {
+                printf("Error: --interval option requires a period of at least 10 ms\n");
+                return 1;
+            }
+            i++;
         } else if (strcmp(argv[i], "--file") == 0 || strcmp(argv[i], "-f") == 0) {
             if (i + 1 < argc) {
                 initial_file = argv[i + 1];
@@ -77,9 +106,18 @@ int main(int argc, char *argv[]) {
         printf("VLC status logging suppressed (VLC_NO_STATUS_LOG=1)\n");
     }
 
-    // Initialize Winsock for network communication
-    if (!initialize_winsock()) {
-        printf("Failed to initialize Winsock\n");
+    // The main loop's wait, created first: on Linux it blocks SIGINT and
+    // SIGTERM, which must happen before any other thread starts
+    platform_loop_t *loop = platform_loop_create();
+    if (!loop) {
+        printf("Failed to create the event loop\n");
+        return 1;
+    }
+
+    // Initialize the socket library for network communication
+    if (!platform_net_init()) {
+        printf("Failed to initialize networking\n");
+        platform_loop_destroy(loop);
         return 1;
     }
 
@@ -87,7 +125,8 @@ int main(int argc, char *argv[]) {
     SOCKET multicast_sock = create_multicast_socket();
     if (multicast_sock == INVALID_SOCKET) {
         printf("Failed to create multicast socket\n");
-        cleanup_winsock();
+        platform_net_cleanup();
+        platform_loop_destroy(loop);
         return 1;
     }
 
@@ -96,17 +135,20 @@ int main(int argc, char *argv[]) {
     if (!g_vlc_player) {
         printf("Failed to create VLC player\n");
         closesocket(multicast_sock);
-        cleanup_winsock();
+        platform_net_cleanup();
+        platform_loop_destroy(loop);
         return 1;
     }
 
+#ifdef _WIN32
     // Create main window
     HWND main_window = create_player_window();
     if (!main_window) {
         printf("Failed to create main window\n");
         vlc_player_destroy(g_vlc_player);
         closesocket(multicast_sock);
-        cleanup_winsock();
+        platform_net_cleanup();
+        platform_loop_destroy(loop);
         return 1;
     }
 
@@ -121,7 +163,11 @@ int main(int argc, char *argv[]) {
 
     printf("VLC Status Server running. Window created.\n");
     printf("Controls: Space=Play/Pause, Arrows=Seek, Home=Start, Right-click=Open File\n");
-    printf("Broadcasting status on 239.255.255.250:12345 every %dms\n", UPDATE_INTERVAL_MS);
+#else
+    printf("VLC Status Server running headless. Ctrl+C to stop.\n");
+#endif
+    printf("Broadcasting %s status on %s:%d on every change, and every %dms otherwise\n",
+           status_format == STATUS_FORMAT_BINARY ? "binary" : "JSON", MULTICAST_IP, MULTICAST_PORT, heartbeat_ms);
 
     // Load initial file if specified
     if (initial_file && g_vlc_player) {
@@ -132,37 +178,34 @@ int main(int argc, char *argv[]) {
     }
 
     // Create status monitor
-    status_monitor_t* status_monitor = status_monitor_create();
+    status_monitor_t* status_monitor = status_monitor_create(status_format, (uint32_t)heartbeat_ms, g_vlc_player,
+                                                             loop);
     if (!status_monitor) {
         printf("Failed to create status monitor\n");
         vlc_player_destroy(g_vlc_player);
         closesocket(multicast_sock);
-        cleanup_winsock();
+        platform_net_cleanup();
+        platform_loop_destroy(loop);
         return 1;
     }
 
-    // Main event loop with status broadcasting
-    MSG msg;
-
-    while (1) {
-        // Handle Windows messages (non-blocking)
-        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
-            if (msg.message == WM_QUIT) {
-                goto cleanup;
-            }
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
-        }
-
-        // Update VLC status and broadcast at regular intervals
-        status_monitor_update(status_monitor, multicast_sock, UPDATE_INTERVAL_MS);
-
-        // Small sleep to prevent busy waiting
-        Sleep(10);
+#ifndef _WIN32
+    // Headless, nothing else will press play
+    if (initial_file) {
+        vlc_player_play(g_vlc_player);
     }
+#endif
+
+    // Main event loop with status broadcasting. It sleeps until there is
+    // something to do -- a window message, a player event, or the next packet
+    // falling due -- rather than polling.
+    do {
+        // Broadcast whatever changed, or is due
+        status_monitor_update(status_monitor, multicast_sock);
+    } while (platform_loop_wait(loop, status_monitor_wait_us(status_monitor)));
 
-cleanup:
     printf("\nShutting down VLC Status Server...\n");
+    status_monitor_print_stats(status_monitor);
     
     // Cleanup status monitor
     status_monitor_destroy(status_monitor);
@@ -175,7 +218,8 @@ cleanup:
     
     // Cleanup network
     closesocket(multicast_sock);
-    cleanup_winsock();
+    platform_net_cleanup();
+    platform_loop_destroy(loop);
     
     printf("Cleanup completed. Goodbye!\n");
     return 0;